@@ -53,6 +53,9 @@
 @class NSURL;
 @class AVFrameDecoder;
 @class AVResourceLoader;
+@class AVReverseFrameCache;
+
+struct MVFrameRing;
 
 typedef enum AVAnimatorPlayerState {
 	ALLOCATED = 0,
@@ -149,6 +152,28 @@ typedef enum AVAnimatorPlayerState {
 	BOOL reportTimeFromFallbackClock;
   
 	BOOL m_reverse;
+  
+  // Reverse playback of a movie with delta frames decodes a window
+  // of frames forward and then displays the window backwards.
+  
+  NSUInteger m_reverseNumCachedFrames;
+  AVReverseFrameCache *m_reverseFrameCache;
+  
+  // Set to TRUE when each frame in a .mvid has its own duration,
+  // then frame display times come from the frame decoder.
+  
+  BOOL m_hasFrameDurations;
+  
+  // Decode ahead state, frames are decoded in a secondary thread
+  // and handed to the main thread via a lock free frame ring.
+  
+  NSUInteger m_decodeAheadNumFrames;
+  struct MVFrameRing *m_frameRing;
+  NSInteger m_decodeAheadFrame;
+  dispatch_semaphore_t m_decodeAheadWakeSemaphore;
+  dispatch_semaphore_t m_decodeAheadDoneSemaphore;
+  volatile BOOL m_decodeAheadStop;
+  BOOL m_isDecodingAhead;
 }
 
 // public properties
@@ -156,16 +181,43 @@ typedef enum AVAnimatorPlayerState {
 @property (nonatomic, retain) AVResourceLoader *resourceLoader;
 @property (nonatomic, retain) AVFrameDecoder *frameDecoder;
 
+// The time each frame is displayed. Read from the media when not set.
+// When a .mvid file stores a duration for each frame, this is the shortest
+// frame duration and the frames are displayed for their own durations unless
+// this property was set explicitly.
+
 @property (nonatomic, assign) NSTimeInterval animatorFrameDuration;
 @property (nonatomic, assign) NSUInteger animatorNumFrames;
 
 @property (nonatomic, assign) NSUInteger animatorRepeatCount;
 
 // Set this property to TRUE to play the media backwards.
-// Note that the decoder must support random access.
+// Note that the decoder must support random access, or it must be
+// an AVMvidFrameDecoder. When a .mvid file contains delta frames,
+// frames are decoded forward from a keyframe in windows of
+// reverseNumCachedFrames frames and each window is displayed
+// backwards, so a frame is not decoded from the start of the
+// movie each time it is displayed. Checkpoint copies of frames
+// before each window are kept, see AVReverseFrameCache.h.
 
 @property (nonatomic, assign) BOOL reverse;
 
+// The number of frames in a reverse playback window, 8 by default.
+// Each frame in the window holds a framebuffer, so a larger window
+// means fewer decodes from the keyframe but more memory.
+
+@property (nonatomic, assign) NSUInteger reverseNumCachedFrames;
+
+// Set this property to a non-zero value to decode up to N frames ahead of
+// the display time in a secondary thread. The main thread then only picks
+// up frames that are already decoded, so a slow decode of one frame does not
+// delay the display of the frames before it. A frame that is not decoded by
+// the time it should be displayed is skipped. This property is 0 by default
+// and is only supported for AVMvidFrameDecoder. Each decoded frame holds a
+// framebuffer, so memory usage goes up by N framebuffers.
+
+@property (nonatomic, assign) NSUInteger decodeAheadNumFrames;
+
 // TRUE when the animator has an audio track. This property is not set until the
 // resource loaded is done loading and AVAnimatorPreparedToAnimateNotification
 // has been delivered.
@@ -16,9 +16,13 @@
 #import "AVResourceLoader.h"
 #import "AVFrame.h"
 #import "AVFrameDecoder.h"
+#import "AVMvidFrameDecoder.h"
+#import "AVReverseFrameCache.h"
 
 #import "AVAppResourceLoader.h"
 
+#include "maxvid_ring.h"
+
 // Uncomment to enable debug output, note that this kill FPS performance of decoder!
 //#define DEBUG_OUTPUT
 
@@ -124,6 +128,9 @@
 @synthesize decodedLastFrame = m_decodedLastFrame;
 @synthesize reportTimeFromFallbackClock;
 @synthesize reverse = m_reverse;
+@synthesize reverseNumCachedFrames = m_reverseNumCachedFrames;
+@synthesize reverseFrameCache = m_reverseFrameCache;
+@synthesize decodeAheadNumFrames = m_decodeAheadNumFrames;
 
 - (void) dealloc {
 	// This object can't be deallocated while animating, this could
@@ -139,6 +146,18 @@
 	self.prevFrame = nil;
 	self.nextFrame = nil;
   
+  [self _stopDecodeAhead:TRUE];
+  
+  self.reverseFrameCache = nil;
+  
+#if __has_feature(objc_arc)
+#else
+  if (self->m_decodeAheadWakeSemaphore != NULL) {
+    dispatch_release(self->m_decodeAheadWakeSemaphore);
+    dispatch_release(self->m_decodeAheadDoneSemaphore);
+  }
+#endif // objc_arc
+  
   // Release resource loader and frame decoder
   // after image related objects, in case the image
   // objects held a ref to frame buffers in the
@@ -201,6 +220,7 @@
   if ((self = [super init])) {
     self.state = ALLOCATED;
     self.currentFrame = -1;
+    self.reverseNumCachedFrames = 8;
   }
   return self;
 }
@@ -331,6 +351,12 @@
     NSTimeInterval duration = [decoder frameDuration];
     NSAssert(duration != 0.0, @"frame duration can't be zero");
     self.animatorFrameDuration = duration;
+    
+    // Frames in a .mvid with frame durations are displayed for their own durations
+    
+    if ([decoder isKindOfClass:[AVMvidFrameDecoder class]]) {
+      self->m_hasFrameDurations = [(AVMvidFrameDecoder*)decoder hasFrameDurations];
+    }
   }
 
   // Record how many frame there are in the animation
@@ -648,7 +674,7 @@
   
 	// Calculate upper limit for time that maps to specific frames.
   
-	self.animatorMaxClockTime = ((self.animatorNumFrames - 1) * self.animatorFrameDuration) -
+	self.animatorMaxClockTime = [self _frameStartTime:(self.animatorNumFrames - 1)] -
     (self.animatorFrameDuration / 10);
   
   self.repeatedFrameCount = 0;
@@ -657,10 +683,14 @@
   NSAssert(self.animatorDisplayTimer == nil, @"animatorDisplayTimer");
   
   // If the reverse flag is set, verify that the deoder supports
-  // random access.
+  // random access. A .mvid decoder with delta frames plays in
+  // reverse via a window of frames decoded forward.
   
-  if (self.reverse) {
-    NSAssert(self.frameDecoder.isAllKeyframes == true, @"media.reverse flag set for decoder that does not support random frame access");
+  if (self.reverse && self.frameDecoder.isAllKeyframes == FALSE) {
+    NSAssert([self.frameDecoder isKindOfClass:[AVMvidFrameDecoder class]], @"media.reverse flag set for decoder that does not support random frame access");
+    
+    AVMvidFrameDecoder *decoder = (AVMvidFrameDecoder*) self.frameDecoder;
+    self.reverseFrameCache = [AVReverseFrameCache aVReverseFrameCache:decoder numCachedFrames:self.reverseNumCachedFrames];
   }
   
   // Display the initial frame right away. The initial frame callback logic
@@ -674,6 +704,10 @@
   [self showFrame:0];
   NSAssert(self.currentFrame == 0, @"currentFrame must be zero");  
   
+  // Decode frames after the initial frame in a secondary thread
+  
+  [self _startDecodeAhead];
+  
   // Schedule delayed start callback to start audio playback and kick
   // off decode callback cycle.
   
@@ -747,6 +781,10 @@
 	[self.animatorDisplayTimer invalidate];
 	self.animatorDisplayTimer = nil;
   
+  [self _stopDecodeAhead:TRUE];
+  
+  self.reverseFrameCache = nil;
+  
   if (self.avAudioPlayer) {
     [self.avAudioPlayer stop];
     self.avAudioPlayer.currentTime = 0.0;
@@ -811,6 +849,10 @@
 	[self.animatorDisplayTimer invalidate];
 	self.animatorDisplayTimer = nil;
   
+  // Decoded frames are kept so that decoding continues from the same frame on unpause
+  
+  [self _stopDecodeAhead:FALSE];
+  
   if (self.avAudioPlayer) {
     [self.avAudioPlayer pause];
   } else {
@@ -874,6 +916,8 @@
     
     NSAssert(self.animatorDisplayTimer == nil, @"animatorDisplayTimer not nil");
     
+    [self _startDecodeAhead];
+    
     NSTimeInterval displayDelta = 0.001;
     
     self.animatorDisplayTimer = [NSTimer timerWithTimeInterval: displayDelta
@@ -987,6 +1031,15 @@
 		frameNow = 0;
 	} else if (currentTime > self.animatorMaxClockTime) {
 		frameNow = self.animatorNumFrames - 1 - 1;
+	} else if (self->m_hasFrameDurations) {
+		// Binary search of the frame start times, a time that is very close
+		// to the start of the next frame is treated as that frame.
+    
+		frameNow = [self _frameIndexAtTime:(currentTime + (self.animatorFrameDuration / 100.0))];
+    
+		if (frameNow > (self.animatorNumFrames - 1 - 1)) {
+			frameNow = self.animatorNumFrames - 1 - 1;
+		}
 	} else {
 		frameNow = (NSUInteger) (currentTime / self.animatorFrameDuration);
     
@@ -1031,7 +1084,7 @@
 	}
 #endif	
     
-  float aboutHalf = (self.animatorFrameDuration / 2.0);
+  float aboutHalf = ([self _frameStartTime:1] / 2.0);
   aboutHalf -= aboutHalf / 20.0f;
   
 	if (currentTime < aboutHalf) {
@@ -1117,7 +1170,7 @@
 	if (TRUE) {
 		NSUInteger secondToLastFrameIndex = self.animatorNumFrames - 1 - 1;
     
-		NSTimeInterval timeExpected = (frameNow * self.animatorFrameDuration) +
+		NSTimeInterval timeExpected = [self _frameStartTime:frameNow] +
       self.animatorDecodeTimerInterval;
 		NSTimeInterval timeDelta = currentTime - timeExpected;
 		NSString *formatted = [NSString stringWithFormat:@"%@%@%d%@%d%@%d%@%@%.4f%@%.4f",
@@ -1204,7 +1257,7 @@
       NSAssert(FALSE, @"isAudioClockStuck is FALSE");
     }
     
-		nextFrameExpectedTime = (nextFrameIndex * self.animatorFrameDuration);
+		nextFrameExpectedTime = [self _frameStartTime:nextFrameIndex];
 		delta = nextFrameExpectedTime - currentTime;
     //if (delta <= 0.0) {
     //  NSAssert(FALSE, @"display delta is not a positive number");
@@ -1253,10 +1306,10 @@
 		if (isAudioClockStuck) {
 			delta = self.animatorFrameDuration;
 		} else if (shouldScheduleLastFrameCallback) {
-			nextFrameExpectedTime = ((nextFrameIndex + 1) * self.animatorFrameDuration);
+			nextFrameExpectedTime = [self _frameStartTime:(nextFrameIndex + 1)];
 			delta = nextFrameExpectedTime - currentTime;
 		} else {
-			nextFrameExpectedTime = (nextFrameIndex * self.animatorFrameDuration) + self.animatorDecodeTimerInterval;
+			nextFrameExpectedTime = [self _frameStartTime:nextFrameIndex] + self.animatorDecodeTimerInterval;
 			delta = nextFrameExpectedTime - currentTime;
 		}
     //if (delta <= 0.0) {
@@ -1322,7 +1375,7 @@
   
   [self _queryCurrentClockTimeAndCalcFrameNow:&currentTime frameNowPtr:&frameNow];
   
-  NSTimeInterval timeExpected = ((self.currentFrame+2) * self.animatorFrameDuration);
+  NSTimeInterval timeExpected = [self _frameStartTime:(self.currentFrame+2)];
   
   NSTimeInterval timeDelta = currentTime - timeExpected;  
   
@@ -1369,7 +1422,7 @@
 	[self _queryCurrentClockTimeAndCalcFrameNow:&currentTime frameNowPtr:&frameNow];		
   
 	if (TRUE) {
-		NSTimeInterval timeExpected = ((self.currentFrame+1) * self.animatorFrameDuration);
+		NSTimeInterval timeExpected = [self _frameStartTime:(self.currentFrame+1)];
     
 		NSTimeInterval timeDelta = currentTime - timeExpected;
     
@@ -1497,6 +1550,12 @@
         prevFrame = nil;
 	}
   
+  // When decoding ahead, the frame was decoded in the secondary thread
+  
+  if (self->m_isDecodingAhead) {
+    return [self _acquireDecodedAheadFrame:nextFrameNum];
+  }
+  
   // Advance the "current frame" in the movie. In the case where
   // the next frame is exactly the same as the previous frame,
   // then the isDuplicate flag is TRUE.
@@ -1511,27 +1570,341 @@
   if (self.reverse) {
     actualFrameNum = (int)self.frameDecoder.numFrames - 1 - (int)nextFrameNum;
     //NSLog(@"reverse : nextFrameNum %d : actualFrameNum %d", (int)nextFrameNum, (int)actualFrameNum);
-    
-    [decoder rewind];
   } else {
     //NSLog(@"nextFrameNum %d : actualFrameNum %d", (int)nextFrameNum, (int)actualFrameNum);
   }
   
-  AVFrame *frame = [decoder advanceToFrame:actualFrameNum];
+  AVFrame *frame;
+  
+  if (self.reverse) {
+    frame = [self _reverseFrameAtIndex:actualFrameNum];
+  } else {
+    frame = [decoder advanceToFrame:actualFrameNum];
+  }
       
   //NSLog(@"decoded frame %@", frame);
   
-  self.nextFrame = frame;
-      
-  if (frame.isDuplicate == TRUE) {
+  if (self.reverse) {
+    // The duplicate flag refers to the frame before this one in the movie,
+    // but that frame is displayed after this one. Compare to the displayed image.
+    
+    if (frame.image != self.renderer.AVFrame.image) {
+      if (frame.isDuplicate) {
+        AVFrame *changedFrame = [AVFrame aVFrame];
+        changedFrame.image = frame.image;
+        changedFrame.cgFrameBuffer = frame.cgFrameBuffer;
+        frame = changedFrame;
+      }
+      wasChanged = TRUE;
+    } else {
+      wasChanged = FALSE;
+    }
+  } else if (frame.isDuplicate == TRUE) {
     wasChanged = FALSE;
   } else {
     wasChanged = TRUE;
   }
+  
+  self.nextFrame = frame;
+  }
+  return wasChanged;
+}
+
+// Return the frame at frameIndex in the movie when playing in reverse. A decoder
+// that supports random access decodes the frame directly, otherwise the frame
+// comes from the window of frames decoded forward from a keyframe.
+
+- (AVFrame*) _reverseFrameAtIndex:(NSUInteger)frameIndex
+{
+  AVReverseFrameCache *reverseFrameCache = self.reverseFrameCache;
+  
+  if (reverseFrameCache != nil) {
+    return [reverseFrameCache frameAtIndex:frameIndex];
+  }
+  
+  AVFrameDecoder *decoder = self.frameDecoder;
+  [decoder rewind];
+  return [decoder advanceToFrame:frameIndex];
+}
+
+// Time from the start of the animation when the frame at frameIndex is displayed.
+// Frames are animatorFrameDuration apart unless the .mvid has frame durations,
+// in reverse the frame durations are also in reverse order.
+
+- (NSTimeInterval) _frameStartTime:(NSUInteger)frameIndex
+{
+  if (self->m_hasFrameDurations == FALSE) {
+    return frameIndex * self.animatorFrameDuration;
+  }
+  
+  AVMvidFrameDecoder *decoder = (AVMvidFrameDecoder*) self.frameDecoder;
+  
+  if (self.reverse) {
+    NSUInteger numFrames = self.animatorNumFrames;
+    return [decoder frameStartTime:numFrames] - [decoder frameStartTime:(numFrames - frameIndex)];
+  } else {
+    return [decoder frameStartTime:frameIndex];
+  }
+}
+
+// Index of the frame displayed at a time from the start of the animation,
+// only used when the .mvid has frame durations.
+
+- (NSUInteger) _frameIndexAtTime:(NSTimeInterval)time
+{
+  NSAssert(self->m_hasFrameDurations, @"hasFrameDurations");
+  
+  AVMvidFrameDecoder *decoder = (AVMvidFrameDecoder*) self.frameDecoder;
+  
+  if (self.reverse) {
+    NSUInteger numFrames = self.animatorNumFrames;
+    NSTimeInterval reverseTime = [decoder frameStartTime:numFrames] - time;
+    NSUInteger frameIndex = [decoder frameIndexAtTime:reverseTime];
+    
+    // The time at the start of a frame in reverse is the time at the end
+    // of that frame going forward.
+    
+    if (frameIndex > 0 && [decoder frameStartTime:frameIndex] == reverseTime) {
+      frameIndex--;
+    }
+    
+    return numFrames - 1 - frameIndex;
+  } else {
+    return [decoder frameIndexAtTime:time];
+  }
+}
+
+// Decode ahead support. The secondary thread owns the frame decoder from
+// _startDecodeAhead until _stopDecodeAhead returns, the main thread only
+// acquires decoded frames from the frame ring in between.
+
+static
+void AVAnimatorMediaReleaseRingFrame(void *frame)
+{
+  if (frame != NULL) {
+    CFRelease(frame);
+  }
+}
+
+- (void) _startDecodeAhead
+{
+  if (self.decodeAheadNumFrames == 0 || self->m_isDecodingAhead) {
+    return;
+  }
+  
+  if ([self.frameDecoder isKindOfClass:[AVMvidFrameDecoder class]] == FALSE) {
+    return;
+  }
+  
+  if (self->m_frameRing == NULL) {
+    // The ring holds one slot in addition to the frames decoded ahead so
+    // that a frame can be decoded while the main thread holds a slot.
+    
+    uint32_t numSlots = (uint32_t) self.decodeAheadNumFrames + 1;
+    
+    self->m_frameRing = malloc(sizeof(MVFrameRing));
+    uint32_t status = maxvid_ring_init(self->m_frameRing, numSlots, AVAnimatorMediaReleaseRingFrame);
+    if (status != 0) {
+      free(self->m_frameRing);
+      self->m_frameRing = NULL;
+      return;
+    }
+    
+    // Each frame in the ring holds a framebuffer. The renderer, prevFrame,
+    // nextFrame and a frame waiting for a free slot hold one more each.
+    
+    AVMvidFrameDecoder *decoder = (AVMvidFrameDecoder*) self.frameDecoder;
+    decoder.numFrameBuffers = numSlots + 4;
+    
+    // In reverse, the window of frames is decoded in the secondary thread
+    // while the main thread displays frames from the previous window.
+    
+    if (self.reverseFrameCache != nil) {
+      decoder.numFrameBuffers = numSlots + 4 + self.reverseFrameCache.numCachedFrames;
+    }
+    
+    self->m_decodeAheadFrame = self.currentFrame + 1;
+  }
+  
+  if (self->m_decodeAheadWakeSemaphore == NULL) {
+    self->m_decodeAheadWakeSemaphore = dispatch_semaphore_create(0);
+    self->m_decodeAheadDoneSemaphore = dispatch_semaphore_create(0);
+  }
+  
+  self->m_decodeAheadStop = FALSE;
+  self->m_isDecodingAhead = TRUE;
+  
+  [NSThread detachNewThreadSelector:@selector(_decodeAheadThreadEntryPoint) toTarget:self withObject:nil];
+}
+
+// Stop the decode thread and wait for it to exit. If flush is TRUE then
+// all decoded frames are released, otherwise decoding can be restarted
+// with the frames already in the ring.
+
+- (void) _stopDecodeAhead:(BOOL)flush
+{
+  if (self->m_isDecodingAhead) {
+    self->m_decodeAheadStop = TRUE;
+    dispatch_semaphore_signal(self->m_decodeAheadWakeSemaphore);
+    dispatch_semaphore_wait(self->m_decodeAheadDoneSemaphore, DISPATCH_TIME_FOREVER);
+    self->m_isDecodingAhead = FALSE;
+  }
+  
+  if (flush && self->m_frameRing != NULL) {
+    maxvid_ring_free(self->m_frameRing);
+    free(self->m_frameRing);
+    self->m_frameRing = NULL;
+  }
+}
+
+- (void) _decodeAheadThreadEntryPoint
+{
+  @autoreleasepool {
+  
+  AVFrameDecoder *decoder = self.frameDecoder;
+  MVFrameRing *frameRing = self->m_frameRing;
+  NSTimeInterval frameDuration = self.animatorFrameDuration;
+  NSInteger numFrames = (NSInteger) self.animatorNumFrames;
+  BOOL reverse = self.reverse;
+  NSInteger frameNum = self->m_decodeAheadFrame;
+  
+  while (self->m_decodeAheadStop == FALSE) {
+    if (frameNum >= numFrames) {
+      // All frames have been decoded, wait until stopped
+      
+      dispatch_semaphore_wait(self->m_decodeAheadWakeSemaphore, DISPATCH_TIME_FOREVER);
+      continue;
+    }
+    
+    // When the decoder has fallen behind the display, skip the frames that
+    // would never be displayed.
+    
+    NSTimeInterval requestedTime = maxvid_ring_requested_time(frameRing);
+    NSInteger requestedFrame;
+    if (self->m_hasFrameDurations) {
+      requestedFrame = (NSInteger) [self _frameIndexAtTime:(requestedTime + (frameDuration / 100.0))];
+    } else {
+      requestedFrame = (NSInteger) round(requestedTime / frameDuration);
+    }
+    if (requestedFrame > frameNum && requestedFrame < numFrames) {
+      frameNum = requestedFrame;
+    }
+    
+    @autoreleasepool {
+      AVFrame *frame;
+      
+      if (reverse) {
+        frame = [self _reverseFrameAtIndex:(NSUInteger) (numFrames - 1 - frameNum)];
+      } else {
+        frame = [decoder advanceToFrame:(NSUInteger) frameNum];
+      }
+      
+      // A frame that could not be decoded is skipped, the frame displayed
+      // before it is displayed until the next frame is pushed.
+      
+      if (frame == nil) {
+        frameNum++;
+        continue;
+      }
+
+      void *retainedFrame = (void*) CFBridgingRetain(frame);
+      
+      // Wait for the main thread to pick up a frame when the ring is full
+      
+      BOOL wasPushed = FALSE;
+      
+      while (wasPushed == FALSE) {
+        wasPushed = (maxvid_ring_push(frameRing, retainedFrame, (uint32_t) frameNum, [self _frameStartTime:frameNum]) == 0);
+        
+        if (wasPushed == FALSE && self->m_decodeAheadStop) {
+          CFRelease(retainedFrame);
+          break;
+        } else if (wasPushed == FALSE) {
+          dispatch_time_t timeout = dispatch_time(DISPATCH_TIME_NOW, (int64_t) (frameDuration * NSEC_PER_SEC));
+          dispatch_semaphore_wait(self->m_decodeAheadWakeSemaphore, timeout);
+        }
+      }
+      
+      if (wasPushed) {
+        frameNum++;
+      }
+    }
+  }
+  
+  // A frame that was not pushed is decoded again on restart, advancing
+  // the decoder to the same frame again returns the same frame.
+  
+  self->m_decodeAheadFrame = frameNum;
+  
   }
+  
+  dispatch_semaphore_signal(self->m_decodeAheadDoneSemaphore);
+}
+
+// Acquire the frame to be displayed at the time of frameNum from the frame ring.
+// Returns FALSE when no frame that differs from the one displayed now is ready.
+
+- (BOOL) _acquireDecodedAheadFrame:(NSInteger)frameNum
+{
+  BOOL wasChanged = FALSE;
+  
+  MVFrameRingSlot *slot = maxvid_ring_acquire(self->m_frameRing, [self _frameStartTime:frameNum]);
+  
+  if (slot != NULL) {
+    AVFrame *frame = (__bridge AVFrame*) slot->frame;
+    
+    // The decoder flags a frame as a duplicate of the frame decoded before it,
+    // but that frame could have been skipped. Compare to the displayed image.
+    
+    if (frame != nil && frame.image != self.renderer.AVFrame.image) {
+      if (frame.isDuplicate) {
+        AVFrame *changedFrame = [AVFrame aVFrame];
+        changedFrame.image = frame.image;
+        changedFrame.cgFrameBuffer = frame.cgFrameBuffer;
+        frame = changedFrame;
+      }
+      
+      self.nextFrame = frame;
+      wasChanged = TRUE;
+    }
+    
+    maxvid_ring_release(self->m_frameRing, slot);
+  }
+  
+  // Frames before this one can now be reclaimed
+  
+  dispatch_semaphore_signal(self->m_decodeAheadWakeSemaphore);
+  
   return wasChanged;
 }
 
+// Copy the framebuffer of the displayed frame, returns nil if there is none
+
+- (AVFrame*) _duplicateDisplayedFrame
+{
+  CGFrameBuffer *displayedFrameBuffer = self.renderer.AVFrame.cgFrameBuffer;
+  
+  if (displayedFrameBuffer == nil) {
+    return nil;
+  }
+  
+  CGFrameBuffer *cgFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:displayedFrameBuffer.bitsPerPixel
+                                                                         width:displayedFrameBuffer.width
+                                                                        height:displayedFrameBuffer.height];
+  
+  if (displayedFrameBuffer.colorspace != NULL) {
+    cgFrameBuffer.colorspace = displayedFrameBuffer.colorspace;
+  }
+  
+  [cgFrameBuffer memcopyPixels:displayedFrameBuffer];
+  
+  AVFrame *frame = [AVFrame aVFrame];
+  frame.cgFrameBuffer = cgFrameBuffer;
+  [frame makeImageFromFramebuffer];
+  
+  return frame;
+}
+
 - (BOOL) hasAudio
 {
   return (self.avAudioPlayer != nil);
@@ -1603,7 +1976,12 @@
 
   AVFrame *resultFrame = nil;
   
-  if (copyFinalFrame) {
+  if (copyFinalFrame && self.decodeAheadNumFrames > 0) {
+    // The decoder could have decoded frames after the displayed frame,
+    // so copy the framebuffer of the displayed frame.
+    
+    resultFrame = [self _duplicateDisplayedFrame];
+  } else if (copyFinalFrame) {
     resultFrame = [self.frameDecoder duplicateCurrentFrame];
   }
 #if defined(__GNUC__) && !defined(__clang__)
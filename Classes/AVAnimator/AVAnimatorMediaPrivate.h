@@ -65,6 +65,8 @@
 @property (nonatomic, assign) BOOL decodedLastFrame;
 @property (nonatomic, assign) BOOL reportTimeFromFallbackClock;
 
+@property (nonatomic, retain) AVReverseFrameCache *reverseFrameCache;
+
 // private methods
 
 - (BOOL) _animatorDecodeNextFrame;
@@ -77,6 +79,22 @@
 
 -(void) _setAudioSessionCategory;
 
+- (void) _startDecodeAhead;
+
+- (void) _stopDecodeAhead:(BOOL)flush;
+
+- (void) _decodeAheadThreadEntryPoint;
+
+- (BOOL) _acquireDecodedAheadFrame:(NSInteger)frameNum;
+
+- (AVFrame*) _duplicateDisplayedFrame;
+
+- (AVFrame*) _reverseFrameAtIndex:(NSUInteger)frameIndex;
+
+- (NSTimeInterval) _frameStartTime:(NSUInteger)frameIndex;
+
+- (NSUInteger) _frameIndexAtTime:(NSTimeInterval)time;
+
 // These next two method should be invoked from a renderer to signal
 // when this media item is attached to and detached from a renderer.
 
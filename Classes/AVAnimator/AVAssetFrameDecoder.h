@@ -84,6 +84,13 @@
 
 + (AVAssetFrameDecoder*) aVAssetFrameDecoder;
 
+// Render the next decoded frame into frameBuffer instead of the framebuffer
+// allocated by the decoder. The framebuffer must be 24 BPP and the size of
+// the asset. A converter that owns a ring of framebuffers invokes this before
+// each advanceToFrame so that the decoded pixels are not copied.
+
+- (void) setRenderFrameBuffer:(CGFrameBuffer*)frameBuffer;
+
 @end
 
 #endif // HAS_AVASSET_CONVERT_MAXVID
@@ -26,6 +26,8 @@
 
 #import "AVMvidFileWriter.h" // for countTrailingNopFrames
 
+#include "maxvid_yuv.h"
+
 #if defined(HAS_AVASSET_CONVERT_MAXVID)
 
 //#define LOGGING
@@ -566,45 +568,102 @@ typedef enum
   }
 }
 
-// Render YUV 4:2:0 pixels in a CoreVideo image buffer as a flat BGRA framebuffer
+// Return the framebuffer that frames are rendered into, a framebuffer is allocated
+// on the first call.
 
-- (BOOL) renderCVYUVImageBufferRefIntoFramebuffer:(CVImageBufferRef)imageBuffer frameBuffer:(CGFrameBuffer**)frameBufferPtr
+- (CGFrameBuffer*) frameBufferForWidth:(size_t)width height:(size_t)height frameBuffer:(CGFrameBuffer**)frameBufferPtr
 {
-#if TARGET_IPHONE_SIMULATOR
-  // CoreImage does not support yuv420 pixels
-  assert(0);
+  CGFrameBuffer *frameBuffer = *frameBufferPtr;
+  
+  // Note that this object is not autoreleased, instead the caller must explicitly release the ref.
+  
+  if (frameBuffer == NULL) {
+    frameBuffer = [[CGFrameBuffer alloc] initWithBppDimensions:24 width:width height:height];
+#if __has_feature(objc_arc)
 #else
-  CIContext *context = [CIContext contextWithOptions:nil];
-  NSAssert(context, @"CIContext");
+    frameBuffer = [frameBuffer autorelease];
+#endif // objc_arc
+    NSAssert(frameBuffer, @"frameBuffer");
+    *frameBufferPtr = frameBuffer;
+
+    // Also save allocated framebuffer as a property in the object
+    self.currentFrameBuffer = frameBuffer;
+    
+    // Use sRGB by default on iOS. Explicitly set sRGB as colorspace on MacOSX.
+    
+#if TARGET_OS_IPHONE
+    // No-op
+#else
+    // MacOSX
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    frameBuffer.colorspace = colorSpace;
+    CGColorSpaceRelease(colorSpace);
+#endif // TARGET_OS_IPHONE
+  }
   
-  CIImage *image = [CIImage imageWithCVPixelBuffer:imageBuffer];
+  return frameBuffer;
+}
+
+// Render YUV 4:2:0 pixels in a CoreVideo image buffer as a flat BGRA framebuffer.
+// The planes are converted straight into the framebuffer pixels, see maxvid_yuv.h,
+// so no CIContext or intermediate BGRA pixel buffer is needed.
+
+- (BOOL) renderCVYUVImageBufferRefIntoFramebuffer:(CVImageBufferRef)imageBuffer frameBuffer:(CGFrameBuffer**)frameBufferPtr
+{
+  int numPlanes = (int) CVPixelBufferGetPlaneCount(imageBuffer);
+  NSAssert(numPlanes == 2 || numPlanes == 3, @"numPlanes");
   
-  CIImage* outputImage = image;
+  OSType pixelFormat = CVPixelBufferGetPixelFormatType(imageBuffer);
   
-  CGRect extent = [outputImage extent];
+  MVYUVRange range = MV_YUV_RANGE_VIDEO;
+  if (pixelFormat == kCVPixelFormatType_420YpCbCr8BiPlanarFullRange ||
+      pixelFormat == kCVPixelFormatType_420YpCbCr8PlanarFullRange) {
+    range = MV_YUV_RANGE_FULL;
+  }
   
-  CGSize size = extent.size;
-  CVPixelBufferRef conversionBuffer = NULL;
-  CVReturn status = CVPixelBufferCreate(kCFAllocatorDefault,
-                                        size.width,
-                                        size.height,
-                                        kCVPixelFormatType_32BGRA,
-                                        (__bridge CFDictionaryRef) @{
-                                                                     (__bridge NSString *)kCVPixelBufferIOSurfacePropertiesKey: @{},
-                                                                     (__bridge NSString *)kCVPixelFormatOpenGLESCompatibility : @(YES),
-                                                                     },
-                                        &conversionBuffer);
+  // H.264 content is BT.709 when tagged as such, untagged content is treated
+  // as BT.601 like CoreImage does.
   
-  if (status == kCVReturnSuccess) {
-    [context render:image toCVPixelBuffer:conversionBuffer];
+  MVYUVMatrix matrix = MV_YUV_MATRIX_BT601;
+  CFTypeRef matrixAttachment = CVBufferGetAttachment(imageBuffer, kCVImageBufferYCbCrMatrixKey, NULL);
+  if (matrixAttachment != NULL && CFEqual(matrixAttachment, kCVImageBufferYCbCrMatrix_ITU_R_709_2)) {
+    matrix = MV_YUV_MATRIX_BT709;
   }
   
-  BOOL worked = [self renderCVBGRAImageBufferRefIntoFramebuffer:conversionBuffer frameBuffer:frameBufferPtr];
+  MVYUVCoefficients coefficients;
+  uint32_t status = maxvid_yuv_init(&coefficients, matrix, range);
+  NSAssert(status == 0, @"maxvid_yuv_init");
+  
+  size_t width = CVPixelBufferGetWidth(imageBuffer);
+  size_t height = CVPixelBufferGetHeight(imageBuffer);
+  
+  CGFrameBuffer *frameBuffer = [self frameBufferForWidth:width height:height frameBuffer:frameBufferPtr];
+  
+  CVPixelBufferLockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
+  
+  const uint8_t *yPlane = CVPixelBufferGetBaseAddressOfPlane(imageBuffer, 0);
+  uint32_t yBytesPerRow = (uint32_t) CVPixelBufferGetBytesPerRowOfPlane(imageBuffer, 0);
+  
+  const uint8_t *uPlane = CVPixelBufferGetBaseAddressOfPlane(imageBuffer, 1);
+  uint32_t uvBytesPerRow = (uint32_t) CVPixelBufferGetBytesPerRowOfPlane(imageBuffer, 1);
+  
+  uint32_t *outPixels = (uint32_t*) frameBuffer.pixels;
+  uint32_t outBytesPerRow = (uint32_t) (width * sizeof(uint32_t));
+  
+  if (numPlanes == 2) {
+    status = maxvid_yuv_nv12_to_bgra(&coefficients, outPixels, outBytesPerRow,
+                                     yPlane, yBytesPerRow, uPlane, uvBytesPerRow,
+                                     NULL, 0, (uint32_t) width, (uint32_t) height);
+  } else {
+    const uint8_t *vPlane = CVPixelBufferGetBaseAddressOfPlane(imageBuffer, 2);
+    status = maxvid_yuv_i420_to_bgra(&coefficients, outPixels, outBytesPerRow,
+                                     yPlane, yBytesPerRow, uPlane, vPlane, uvBytesPerRow,
+                                     NULL, 0, (uint32_t) width, (uint32_t) height);
+  }
   
-  CVPixelBufferRelease(conversionBuffer);
+  CVPixelBufferUnlockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
   
-  return worked;
-#endif // TARGET_IPHONE_SIMULATOR
+  return (status == 0);
 }
 
 // Render BGRA pixels in a CoreVideo image buffer as a flat BGRA framebuffer
@@ -669,32 +728,9 @@ typedef enum
 	CGColorSpaceRelease(colorSpace);
   CGDataProviderRelease(dataProvider);
   
-  // Render CoreGraphics image into a flat bitmap framebuffer. Note that this object is
-  // not autoreleased, instead the caller must explicitly release the ref.
+  // Render CoreGraphics image into a flat bitmap framebuffer
   
-  if (frameBuffer == NULL) {
-    frameBuffer = [[CGFrameBuffer alloc] initWithBppDimensions:24 width:width height:height];
-#if __has_feature(objc_arc)
-#else
-    frameBuffer = [frameBuffer autorelease];
-#endif // objc_arc
-    NSAssert(frameBuffer, @"frameBuffer");
-    *frameBufferPtr = frameBuffer;
-
-    // Also save allocated framebuffer as a property in the object
-    self.currentFrameBuffer = frameBuffer;
-    
-    // Use sRGB by default on iOS. Explicitly set sRGB as colorspace on MacOSX.
-    
-#if TARGET_OS_IPHONE
-    // No-op
-#else
-    // MacOSX
-    colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
-    frameBuffer.colorspace = colorSpace;
-    CGColorSpaceRelease(colorSpace);
-#endif // TARGET_OS_IPHONE
-  }
+  frameBuffer = [self frameBufferForWidth:width height:height frameBuffer:frameBufferPtr];
   
   // FIXME: This render operation to flatten the input framebuffer into a known
   // framebuffer layout is 98% of the alpha frame decode time, so optimization
@@ -1147,6 +1183,16 @@ typedef enum
   return frame;
 }
 
+// The framebuffer is rendered into by the next frame read since
+// frameBufferForWidth only allocates when there is no current framebuffer.
+
+- (void) setRenderFrameBuffer:(CGFrameBuffer*)frameBuffer
+{
+  NSAssert(frameBuffer.bitsPerPixel == 24, @"bitsPerPixel");
+  NSAssert(self.produceCoreVideoPixelBuffers == FALSE, @"produceCoreVideoPixelBuffers");
+  self.currentFrameBuffer = frameBuffer;
+}
+
 // Properties
 
 - (NSUInteger) width
@@ -22,6 +22,8 @@
 
 #import "movdata.h"
 
+#include "maxvid_alpha.h"
+
 #include "AVStreamEncodeDecode.h"
 
 //#define LOGGING
@@ -426,143 +428,14 @@
 
 // Join the RGB and Alpha components of two input framebuffers
 // so that the final output result contains native premultiplied
-// 32 BPP pixels.
+// 32 BPP pixels, see maxvid_alpha.h for the alpha fixups.
 
 + (void) combineRGBAndAlphaPixels:(uint32_t)numPixels
                    combinedPixels:(uint32_t*)combinedPixels
                         rgbPixels:(uint32_t*)rgbPixels
                       alphaPixels:(uint32_t*)alphaPixels
 {
-  for (uint32_t pixeli = 0; pixeli < numPixels; pixeli++) {
-    uint32_t pixelAlpha = alphaPixels[pixeli];
-    uint32_t pixelRGB = rgbPixels[pixeli];
-    
-    // All 3 components of the ALPHA pixel should be the same in grayscale mode.
-    // If these are not exactly the same, this is likely caused by limited precision
-    // ranges in the hardware color conversion logic.
-    
-    uint32_t pixelAlphaRed = (pixelAlpha >> 16) & 0xFF;
-    uint32_t pixelAlphaGreen = (pixelAlpha >> 8) & 0xFF;
-    uint32_t pixelAlphaBlue = (pixelAlpha >> 0) & 0xFF;
-    
-#if defined(DEBUG)
-    if ((0)) {
-      uint32_t pixelRed = (pixelRGB >> 16) & 0xFF;
-      uint32_t pixelGreen = (pixelRGB >> 8) & 0xFF;
-      uint32_t pixelBlue = (pixelRGB >> 0) & 0xFF;
-      
-      NSLog(@"processing pixeli %d : (%3d %3d %3d) : alpha grayscale %3d %3d %3d", pixeli, pixelRed, pixelGreen, pixelBlue, pixelAlphaRed, pixelAlphaGreen, pixelAlphaBlue);
-    }
-#endif // DEBUG
-    
-//    if ((pixeli % 256) == 0) {
-//      NSLog(@"processing row %d", (pixeli / 256));
-//    }
-    
-//    if ((pixeli >= (2 * 256)) && (pixeli < (3 * 256))) {
-//      // Third row
-//      combinedPixels[pixeli] = combinedPixels[pixeli];
-//    }
-    
-    if (pixelAlphaRed != pixelAlphaGreen || pixelAlphaRed != pixelAlphaBlue) {
-      //NSLog(@"Input Alpha MVID input movie R G B components (%d %d %d) do not match at pixel %d", pixelAlphaRed, pixelAlphaGreen, pixelAlphaBlue, pixeli);
-      //return FALSE;
-      
-      uint32_t sum = pixelAlphaRed + pixelAlphaGreen + pixelAlphaBlue;
-      if (sum == 1) {
-        // If two values are 0 and the other is 1, then assume the alpha value is zero. The iOS h264
-        // decoding hardware seems to emit (R=0 G=0 B=1) even when the input is a grayscale black pixel.
-        pixelAlpha = 0;
-      } else if (sum == 2 && (pixelAlphaRed == 0 && pixelAlphaGreen == 2 && pixelAlphaBlue == 0)) {
-        // The h.264 decoder seems to generate (R=0 G=2 B=0) for black in some weird cases on ARM64.
-        pixelAlpha = 0;
-#if defined(__arm64__) && __arm64__
-      } else if ((pixelAlphaRed == pixelAlphaBlue) && (pixelAlphaRed+1 == pixelAlphaGreen)) {
-        // The h.264 decoder in newer ARM64 devices seems to decode the grayscale values (2 2 2) as
-        // (1 2 1) in certain cases. Choose an output grayscale value of 2 in these cases only
-        // for this specific hardware decoder.
-
-        pixelAlpha = pixelAlphaGreen;
-      } else if ((pixelAlphaRed == pixelAlphaBlue) && (pixelAlphaRed+2 == pixelAlphaGreen)) {
-        // The h.264 decoder in newer ARM64 devices seems to decode the grayscale values (3 3 3) as
-        // (2 4 2) in certain cases. Choose an output grayscale value of 3 in these cases only
-        // for this specific hardware decoder.
-        
-        pixelAlpha = pixelAlphaRed + 1;
-#endif // __arm64__
-      } else if (pixelAlphaRed == pixelAlphaBlue) {
-        // The R and B pixel values are equal but these two values are not the same as the G pixel.
-        // This indicates that the grayscale conversion should have resulted in value between the
-        // two numbers.
-        //
-        // R G B components
-        //
-        // (3 1 3)       -> 2   <- (2, 2, 2) (sim)
-        // (2 0 2)       -> 1   <- (1, 1, 1) (sim)
-        // (18 16 18)    -> 17  <- (17, 17, 17) (sim)
-        // (219 218 219) -> 218 <- (218, 218, 218) (sim)
-        //
-        // Note that in some cases the original values (5, 5, 5) get decoded as (5, 4, 5) and that results in 4 as the
-        // alpha value. These cases are few and we just ignore them because the alpha is very close.
-        
-        if (pixelAlphaRed == 0) {
-          pixelAlpha = 0;
-        } else {
-          pixelAlpha = pixelAlphaRed - 1;
-        }
-        
-        //NSLog(@"Input Alpha MVID input movie R G B components (%d %d %d) do not match at pixel %d in frame %d", pixelAlphaRed, pixelAlphaGreen, pixelAlphaBlue, pixeli, frameIndex);
-        //NSLog(@"Using RED/BLUE Alpha level %d at pixel %d in frame %d", pixelAlpha, pixeli, frameIndex);
-      } else if ((pixelAlphaRed == (pixelAlphaGreen + 1)) && (pixelAlphaRed == (pixelAlphaBlue - 1))) {
-        // Common case seen in hardware decoder output, average is the middle value.
-        //
-        // R G B components
-        // (62, 61, 63)    -> 62  <- (62, 62, 62) (sim)
-        // (111, 110, 112) -> 111 <- (111, 111, 111) (sim)
-        
-        pixelAlpha = pixelAlphaRed;
-        
-        //NSLog(@"Input Alpha MVID input movie R G B components (%d %d %d) do not match at pixel %d in frame %d", pixelAlphaRed, pixelAlphaGreen, pixelAlphaBlue, pixeli, frameIndex);
-        //NSLog(@"Using RED (easy ave) Alpha level %d at pixel %d in frame %d", pixelAlpha, pixeli, frameIndex);
-      } else {
-        // Output did not match one of the know common patterns seen coming from iOS H264 decoder hardware.
-        // Since this branch does not seem to ever be executed, just use the red component which is
-        // basically the same as the branch above.
-        
-        //pixelAlpha = sum / 3;
-        pixelAlpha = pixelAlphaRed;
-        
-        //NSLog(@"Input Alpha MVID input movie R G B components (%d %d %d) do not match at pixel %d in frame %d", pixelAlphaRed, pixelAlphaGreen, pixelAlphaBlue, pixeli, frameIndex);
-        //NSLog(@"Using AVE Alpha level %d at pixel %d in frame %d", pixelAlpha, pixeli, frameIndex);
-      }
-      
-      //NSLog(@"will use pixelAlpha %d", pixelAlpha);
-    } else {
-      // All values are equal, does not matter which channel we use as the alpha value
-      
-      pixelAlpha = pixelAlphaRed;
-    }
-    
-    // Automatically filter out zero pixel values, because there are just so many
-    //if (pixelAlpha != 0) {
-    //fprintf(fp, "A[%d][%d] = %d\n", frameIndex, pixeli, pixelAlpha);
-    //fprintf(fp, "A[%d][%d] = %d <- (%d, %d, %d)\n", frameIndex, pixeli, pixelAlpha, pixelAlphaRed, pixelAlphaGreen, pixelAlphaBlue);
-    //}
-    
-    // RGB componenets are 24 BPP non pre-multiplied values
-    
-    uint32_t pixelRed = (pixelRGB >> 16) & 0xFF;
-    uint32_t pixelGreen = (pixelRGB >> 8) & 0xFF;
-    uint32_t pixelBlue = (pixelRGB >> 0) & 0xFF;
-    
-    uint32_t combinedPixel = premultiply_bgra_inline(pixelRed, pixelGreen, pixelBlue, pixelAlpha);
-    
-    //NSLog(@"output combinedPixel 0x%08X", combinedPixel);
-    
-    combinedPixels[pixeli] = combinedPixel;
-  }
-  
-  return;
+  maxvid_alpha_join_pixels(combinedPixels, rgbPixels, alphaPixels, NULL, numPixels);
 }
 
 // This method is invoked in the secondary thread to decode the contents of the
@@ -22,6 +22,8 @@
 
 #import "movdata.h"
 
+#include "maxvid_alpha.h"
+
 //#define LOGGING
 
 @interface AVAssetMixAlphaResourceLoader ()
@@ -32,17 +34,6 @@
 
 @end
 
-// Static API
-
-@interface AVAssetJoinAlphaResourceLoader ()
-
-+ (void) combineRGBAndAlphaPixels:(uint32_t)numPixels
-                   combinedPixels:(uint32_t*)combinedPixels
-                        rgbPixels:(uint32_t*)rgbPixels
-                      alphaPixels:(uint32_t*)alphaPixels;
-
-@end
-
 
 @implementation AVAssetMixAlphaResourceLoader
 
@@ -279,9 +270,13 @@
   
   fileWriter.movieSize = size;
   
+  // The RGB frame is copied into the combined framebuffer and joined with the alpha
+  // frame in place. The previous combined frame is kept so that the join can find
+  // a frame that did not change in the same pass.
+  
   CGFrameBuffer *combinedFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
   
-  CGFrameBuffer *copyFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
+  CGFrameBuffer *prevFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
 
   // Pixel dump used to compare exected results to actual results produced by iOS decoder hardware
   //NSString *tmpFilename = [NSString stringWithFormat:@"%@%@", joinedMvidPath, @".adump"];
@@ -328,12 +323,13 @@
     
     if (frameIndex == 0) {
       combinedFrameBuffer.colorspace = cgFrameBuffer.colorspace;
+      prevFrameBuffer.colorspace = cgFrameBuffer.colorspace;
     }
     
     // Need to make a copy of the RGB framebuffer at this point, since the AVAssetFrameDecoder
-    // logic maintains only a single framebuffer.
+    // logic maintains only a single framebuffer. The copy is made into the output buffer.
     
-    [copyFrameBuffer copyPixels:cgFrameBuffer];
+    [combinedFrameBuffer copyPixels:cgFrameBuffer];
     
     cgFrameBuffer = nil;
     frame = nil;
@@ -364,29 +360,41 @@
     //fprintf(fp, "Frame %d\n", frameIndex);
     //NSLog(@"Frame %d\n", frameIndex);
     
-    // Join RGB and ALPHA
+    // Join RGB and ALPHA in place, premultiply, and compare to the previous frame in one pass
     
     uint32_t numPixels = width * height;
     uint32_t *combinedPixels = (uint32_t*)combinedFrameBuffer.pixels;
-    uint32_t *rgbPixels = (uint32_t*)copyFrameBuffer.pixels;
     uint32_t *alphaPixels = (uint32_t*)cgFrameBuffer.pixels;
+    uint32_t *prevPixels = (frameIndex == 0) ? NULL : (uint32_t*)prevFrameBuffer.pixels;
     
-    [AVAssetJoinAlphaResourceLoader combineRGBAndAlphaPixels:numPixels
-                                              combinedPixels:combinedPixels
-                                                   rgbPixels:rgbPixels
-                                                 alphaPixels:alphaPixels];
-    
-    // Write combined RGBA pixles as a keyframe, we do not attempt to calculate
-    // frame diffs when processing on the device as that takes too long.
+    uint32_t numChanged = maxvid_alpha_join_pixels(combinedPixels, combinedPixels, alphaPixels, prevPixels, numPixels);
     
-    int numBytesInBuffer = (int) combinedFrameBuffer.numBytes;
-        
-    worked = [fileWriter writeKeyframe:(char*)combinedPixels bufferSize:numBytesInBuffer];
-    
-    if (worked == FALSE) {
-      NSLog(@"cannot write keyframe data to mvid file \"%@\"", joinedMvidPath);
-      return FALSE;
+    if (numChanged == 0) {
+      // Identical to the previous frame
+      
+      worked = [fileWriter writeNopFrame];
+      
+      if (worked == FALSE) {
+        NSLog(@"cannot write nop frame to mvid file \"%@\"", joinedMvidPath);
+        return FALSE;
+      }
+    } else {
+      // Write combined RGBA pixles as a keyframe, we do not attempt to calculate
+      // frame diffs when processing on the device as that takes too long.
+      
+      int numBytesInBuffer = (int) combinedFrameBuffer.numBytes;
+      
+      worked = [fileWriter writeKeyframe:(char*)combinedPixels bufferSize:numBytesInBuffer];
+      
+      if (worked == FALSE) {
+        NSLog(@"cannot write keyframe data to mvid file \"%@\"", joinedMvidPath);
+        return FALSE;
+      }
     }
+    
+    CGFrameBuffer *tmp = prevFrameBuffer;
+    prevFrameBuffer = combinedFrameBuffer;
+    combinedFrameBuffer = tmp;
   }
   
   //fclose(fp);
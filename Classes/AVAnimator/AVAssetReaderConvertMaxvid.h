@@ -15,7 +15,7 @@
 
 #if defined(HAS_AVASSET_CONVERT_MAXVID)
 
-#import "AVMvidFileWriter.h"
+#import "AVFrameSourceConvertMaxvid.h"
 
 // The following notification is delivered when the conversion process is complete.
 // The notification is delivered in both the success and failure case. The caller
@@ -23,32 +23,21 @@
 
 extern NSString * const AVAssetReaderConvertMaxvidCompletedNotification;
 
-@class AVAssetFrameDecoder;
+// The wasSuccessful and compressed properties are defined in AVFrameSourceConvertMaxvid.
 
-@interface AVAssetReaderConvertMaxvid : AVMvidFileWriter {
+@interface AVAssetReaderConvertMaxvid : AVFrameSourceConvertMaxvid {
 @private
   NSURL *m_assetURL;
-  AVAssetFrameDecoder *m_frameDecoder;
-  BOOL m_wasSuccessful;
-#if defined(HAS_LIB_COMPRESSION_API)
-  BOOL m_compressed;
-#endif // HAS_LIB_COMPRESSION_API
 }
 
 @property (nonatomic, copy) NSURL         *assetURL;
 
-@property (nonatomic, assign) BOOL          wasSuccessful;
-
-#if defined(HAS_LIB_COMPRESSION_API)
-@property (nonatomic, assign) BOOL          compressed;
-#endif // HAS_LIB_COMPRESSION_API
-
 + (AVAssetReaderConvertMaxvid*) aVAssetReaderConvertMaxvid;
 
 // This method is a blocking call that will read data from the
-// asset and write the output as a .mvid file. Note that decoding
-// is done in the calling thread, so this method should typically
-// be invoked only from a secondary thread.
+// asset and write the output as a .mvid file. Note that frames are
+// decoded in a secondary thread while the calling thread writes,
+// this method should typically be invoked only from a secondary thread.
 // Return TRUE if successful, FALSE otherwise.
 
 - (BOOL) blockingDecode;
@@ -17,8 +17,6 @@
 
 #import "CGFrameBuffer.h"
 
-#include "AVStreamEncodeDecode.h"
-
 #if __has_feature(objc_arc)
 #else
 #import "AutoPropertyRelease.h"
@@ -28,53 +26,43 @@
 
 NSString * const AVAssetReaderConvertMaxvidCompletedNotification = @"AVAssetReaderConvertMaxvidCompletedNotification";
 
-// Private API
+// Frame source that decodes the frames of the video track of an asset.
+// A frame that is the same as the previous frame is not copied.
 
-@interface AVAssetReaderConvertMaxvid ()
+@interface AVAssetReaderFrameSource : NSObject <AVMvidFrameSource> {
+@private
+  NSURL *m_assetURL;
+  AVAssetFrameDecoder *m_frameDecoder;
+  NSUInteger m_frameIndex;
+}
 
-@property (nonatomic, retain) AVAssetFrameDecoder *frameDecoder;
+@property (nonatomic, copy) NSURL *assetURL;
 
-@property (nonatomic, retain) CGFrameBuffer *resizeFramebuffer;
+@property (nonatomic, retain) AVAssetFrameDecoder *frameDecoder;
 
 @end
 
-@implementation AVAssetReaderConvertMaxvid
+@implementation AVAssetReaderFrameSource
 
 @synthesize assetURL = m_assetURL;
 @synthesize frameDecoder = m_frameDecoder;
-@synthesize wasSuccessful = m_wasSuccessful;
-
-#if defined(HAS_LIB_COMPRESSION_API)
-@synthesize compressed = m_compressed;
-#endif // HAS_LIB_COMPRESSION_API
 
 - (void) dealloc
 {
 #if __has_feature(objc_arc)
 #else
-  [AutoPropertyRelease releaseProperties:self thisClass:AVAssetReaderConvertMaxvid.class];
+  [AutoPropertyRelease releaseProperties:self thisClass:AVAssetReaderFrameSource.class];
   [super dealloc];
 #endif // objc_arc
 }
 
-+ (AVAssetReaderConvertMaxvid*) aVAssetReaderConvertMaxvid
-{
-  AVAssetReaderConvertMaxvid *obj = [[AVAssetReaderConvertMaxvid alloc] init];
-  obj.genV3 = TRUE; // enable extended file size out to 64bit offsets
-#if __has_feature(objc_arc)
-  return obj;
-#else
-  return [obj autorelease];
-#endif // objc_arc
-}
-
 // This utility method will setup the asset so that it is opened and ready
 // to decode frames of video data.
 
-- (BOOL) setupAssetDecoder
+- (BOOL) openFrameSource
 {
   NSAssert(self.assetURL, @"assetURL");
-  NSAssert(self.mvidPath, @"mvidPath");
+  NSAssert(self.frameDecoder == nil, @"frameDecoder property should be nil");
   
   AVAssetFrameDecoder *frameDecoder = [AVAssetFrameDecoder aVAssetFrameDecoder];
   
@@ -92,213 +80,143 @@ NSString * const AVAssetReaderConvertMaxvidCompletedNotification = @"AVAssetRead
     return FALSE;
   }
   
+  m_frameIndex = 0;
+  
   return TRUE;
 }
 
-// Emit frame of data
+// Explicitly release the frame decoder in case this frees up memory sooner.
+// An asset frame decoder can only be used once anyway
 
-- (BOOL) blockingDecodeEmitFrame:(AVFrame*)avFrame
+- (void) closeFrameSource
 {
-  BOOL worked;
+  [self.frameDecoder close];
+  self.frameDecoder = nil;
+}
+
+- (CGSize) frameSourceSize
+{
+  return CGSizeMake(self.frameDecoder.width, self.frameDecoder.height);
+}
 
-  CGFrameBuffer *frameBuffer = avFrame.cgFrameBuffer;
+- (NSTimeInterval) frameSourceFrameDuration
+{
+  return self.frameDecoder.frameDuration;
+}
+
+- (NSUInteger) frameSourceNumFrames
+{
+  return self.frameDecoder.numFrames;
+}
+
+// The h264 format supports only 24 BPP mode
+
+- (uint32_t) frameSourceBpp
+{
+  return 24;
+}
+
+- (uint32_t) readFrame:(CGFrameBuffer*)outFrameBuffer info:(AVMvidFrameSourceInfo*)info
+{
+  if (m_frameIndex == self.frameDecoder.numFrames) {
+    return AV_FRAME_SOURCE_END_OF_STREAM;
+  }
+  
+  // When the frame is the size of the output movie, the decoder renders
+  // straight into the converter framebuffer so that the pixels are not copied.
+  
+  BOOL sameWidth = (outFrameBuffer.width == self.frameDecoder.width);
+  BOOL sameHeight = (outFrameBuffer.height == self.frameDecoder.height);
+  BOOL sameSize = (sameWidth && sameHeight && outFrameBuffer.bitsPerPixel == 24);
+  
+  if (sameSize) {
+    [self.frameDecoder setRenderFrameBuffer:outFrameBuffer];
+  }
+  
+  AVFrame *frame = [self.frameDecoder advanceToFrame:m_frameIndex];
+  
+  if (frame == nil) {
+    return MV_ERROR_CODE_READ_FAILED;
+  }
+  
+  m_frameIndex++;
+  
+  info->duration = 0.0f;
+  
+  if (frame.isDuplicate) {
+    info->dirtyRect = CGRectZero;
+    return 0;
+  }
+  
+  CGFrameBuffer *frameBuffer = frame.cgFrameBuffer;
   NSAssert(frameBuffer, @"frameBuffer");
   
   NSAssert(frameBuffer.isLockedByDataProvider, @"isLockedByDataProvider");
   
-  int bufferSize;
-  void *pixelsPtr;
-  
   // If the frame width and height do not match the expected
   // output width and height then the frame data must be resized
   // before it can be written as pixels.
   
-  int width = (int) self.movieSize.width;
-  int height = (int) self.movieSize.height;
-  
-  BOOL sameWidth = (width == frameBuffer.width);
-  BOOL sameHeight = (height == frameBuffer.height);
-  
-  if (!sameWidth || !sameHeight) {
-    CGFrameBuffer *resizeFramebuffer = self.resizeFramebuffer;
-    
-    if (resizeFramebuffer == nil) {
-      resizeFramebuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:frameBuffer.bitsPerPixel width:self.movieSize.width height:self.movieSize.height];
-      
-      NSAssert(resizeFramebuffer, @"resizeFramebuffer with dimensions %d x %d", (int)self.movieSize.width, (int)self.movieSize.height);
-      
-      self.resizeFramebuffer = resizeFramebuffer;
-    }
-    
-    CGImageRef cgImage = avFrame.image.CGImage;
-      
-    [resizeFramebuffer renderCGImage:cgImage];
-    
-    // Calculate how many bytes make up the image via (bytesPerRow * height). The
-    // numBytes value may be padded out to fit to an OS page bound. If the buffer
-    // is padded in the case of an odd number of pixels, pass the buffer size
-    // including the padding pixels.
-    
-    bufferSize  = (int) resizeFramebuffer.numBytes;
-    pixelsPtr = resizeFramebuffer.pixels;
+  if (sameSize) {
+    NSAssert(frameBuffer == outFrameBuffer, @"frame not rendered into outFrameBuffer");
   } else {
+    CGImageRef cgImage = frame.image.CGImage;
     
-    // Calculate how many bytes make up the image via (bytesPerRow * height). The
-    // numBytes value may be padded out to fit to an OS page bound. If the buffer
-    // is padded in the case of an odd number of pixels, pass the buffer size
-    // including the padding pixels.
-    
-    bufferSize  = (int) frameBuffer.numBytes;
-    pixelsPtr = frameBuffer.pixels;
+    [outFrameBuffer renderCGImage:cgImage];
   }
   
-#if defined(HAS_LIB_COMPRESSION_API)
-  // If compression is used, then generate a compressed buffer and write it as
-  // a keyframe.
+  info->dirtyRect = CGRectMake(0, 0, outFrameBuffer.width, outFrameBuffer.height);
   
-  if (self.compressed) @autoreleasepool {
-    NSData *pixelData = [NSData dataWithBytesNoCopy:pixelsPtr length:bufferSize freeWhenDone:NO];
-    
-    // FIXME: make this mutable data a member so that it is not allocated
-    // in every loop.
-    
-    NSMutableData *mEncodedData = [NSMutableData data];
-    
-    [AVStreamEncodeDecode streamDeltaAndCompress:pixelData
-                                     encodedData:mEncodedData
-                                             bpp:self.bpp
-                                       algorithm:COMPRESSION_LZ4];
-    
-    //int src_size = bufferSize;
-    assert(mEncodedData.length < 0xFFFFFFFF);
-    int dst_size = (int) mEncodedData.length;
-    
-    //printf("compressed frame size %d kB down to %d kB\n", (int)src_size/1000, (int)dst_size/1000);
-    
-    // Calculate adler based on original pixels (not the compressed representation)
-    
-    uint32_t adler = 0;
-    
-    if (self.genAdler) {
-      adler = maxvid_adler32(0, (unsigned char*)pixelsPtr, bufferSize);
-    }
-    
-    worked = [self writeKeyframe:(char*)mEncodedData.bytes bufferSize:(int)dst_size adler:adler isCompressed:TRUE];
-  } else
-#endif // HAS_LIB_COMPRESSION_API
-  {
-    // write entire buffer of raw 32bit pixels to the file.
-    // bitmap info is native (kCGImageAlphaNoneSkipFirst|kCGBitmapByteOrder32Little)
-    
-    worked = [self writeKeyframe:pixelsPtr bufferSize:bufferSize];
-  }
-  
-  if (worked) {
-    return TRUE;
-  } else {
-    return FALSE;
-  }
+  return 0;
 }
 
-// Read video data from a single track (only one video track is supported anyway)
+@end
 
-- (BOOL) blockingDecode
-{
-  BOOL worked;
-  BOOL retstatus = FALSE;
-  
-  AVAssetFrameDecoder *frameDecoder = nil;
-  
-  self.wasSuccessful = FALSE;
-  
-  NSAssert(self.frameDecoder == nil, @"frameDecoder property should be nil");
+@implementation AVAssetReaderConvertMaxvid
 
-  worked = [self setupAssetDecoder];
-  if (worked == FALSE) {
-    goto retcode;
-  }
-  
-  frameDecoder = self.frameDecoder;
-  
-  self.totalNumFrames = (int) frameDecoder.numFrames;
-  self.frameDuration = frameDecoder.frameDuration;
-  
-  if (CGSizeEqualToSize(CGSizeZero, self.movieSize)) {
-    self.movieSize = CGSizeMake(frameDecoder.width, frameDecoder.height);
-  }
+@synthesize assetURL = m_assetURL;
 
-  self.bpp = 24;
-      
-  worked = [self open];
-  
-  if (worked == FALSE) {
-    goto retcode;
-  }
-  
-  BOOL writeFailed = FALSE;
+- (void) dealloc
+{
+#if __has_feature(objc_arc)
+#else
+  [AutoPropertyRelease releaseProperties:self thisClass:AVAssetReaderConvertMaxvid.class];
+  [super dealloc];
+#endif // objc_arc
+}
 
-  int frameIndex;
-  int numFrames = (int) frameDecoder.numFrames;
-  
-  for (frameIndex = 0; (frameIndex < numFrames) && (writeFailed == FALSE); frameIndex++) @autoreleasepool {
-    AVFrame *frame = [frameDecoder advanceToFrame:frameIndex];
-    
-    if (frame.isDuplicate) {
-      [self writeNopFrame];
-    } else {
-      worked = [self blockingDecodeEmitFrame:frame];
-      
-      if (worked == FALSE) {
-        writeFailed = TRUE;
-      }
-    }
-  }
++ (AVAssetReaderConvertMaxvid*) aVAssetReaderConvertMaxvid
+{
+  AVAssetReaderConvertMaxvid *obj = [[AVAssetReaderConvertMaxvid alloc] init];
+  obj.genV3 = TRUE; // enable extended file size out to 64bit offsets
+#if __has_feature(objc_arc)
+  return obj;
+#else
+  return [obj autorelease];
+#endif // objc_arc
+}
 
-  if (writeFailed == FALSE) {
-    // Double check that we did not write too few frames.
-    
-    NSAssert(frameIndex == self.totalNumFrames, @"frameIndex == totalNumFrames");
-    NSAssert(self.frameNum == self.totalNumFrames, @"frameNum emitted");
-    
-    worked = [self rewriteHeader];    
-  }
-  
-  [self close];
-  
-  if (worked == FALSE) {
-    goto retcode;
-  }
+// Read video data from a single track (only one video track is supported anyway).
+// Each frame is written as a keyframe, or as a nop frame when the frame is a duplicate.
+
+- (BOOL) blockingDecode
+{
+  AVAssetReaderFrameSource *frameSource = [[AVAssetReaderFrameSource alloc] init];
   
-  retstatus = TRUE;
+#if __has_feature(objc_arc)
+#else
+  [frameSource autorelease];
+#endif // objc_arc
   
-retcode:
-  // Release resize framebuffer in case it is very large
+  frameSource.assetURL = self.assetURL;
   
-  self.resizeFramebuffer = nil;
+  self.frameSource = frameSource;
   
-  // Explicitly release the frame decoder in case this frees up memory sooner.
-  // An asset frame decoder can only be used once anyway
+  BOOL worked = [self blockingConvert];
   
-  [self.frameDecoder close];
-  self.frameDecoder = nil;
-  frameDecoder = nil;
-
-  if (retstatus) {
-#ifdef LOGGING
-    NSLog(@"wrote %@", self.mvidPath);
-#endif // LOGGING
-  } else {
-#ifdef LOGGING
-    NSLog(@"failed to write %@", self.mvidPath);
-#endif // LOGGING
-  }
+  self.frameSource = nil;
   
-  if (retstatus) {
-    self.wasSuccessful = TRUE;
-  } else {
-    self.wasSuccessful = FALSE;
-  }
-  return retstatus;
+  return worked;
 }
 
 
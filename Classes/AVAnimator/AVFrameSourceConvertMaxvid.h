@@ -0,0 +1,87 @@
+//
+//  AVFrameSourceConvertMaxvid.h
+//
+//  License terms defined in License.txt.
+//
+//  This module implements a .mvid conversion engine that reads frames from
+//  any object that implements the AVMvidFrameSource protocol. The stages after
+//  decoding are the same for every input format: a frame that did not change
+//  is written as a nop frame, the alpha channel is detected when the source
+//  does not know the bpp, then the frame is written as a palette frame when
+//  genPalette is set and the frame has at most 256 colors, as a delta frame,
+//  as a compressed keyframe, or as a keyframe.
+//
+//  When isPipelined is TRUE, frames are decoded in a secondary thread into a
+//  small ring of framebuffers while the calling thread encodes and writes the
+//  previous frames, so that decoding and encoding run at the same time. The
+//  source decodes into a framebuffer owned by the engine and that framebuffer
+//  is written as is, the pixels are not copied between stages.
+
+#import "AVMvidFileWriter.h"
+
+#import "AVMvidFrameSource.h"
+
+#import "AVAssetConvertCommon.h" // HAS_LIB_COMPRESSION_API
+
+// Number of framebuffers frames are decoded into when pipelined
+
+#define AV_FRAME_SOURCE_NUM_BUFFERS 4
+
+@interface AVFrameSourceConvertMaxvid : AVMvidFileWriter {
+@private
+  id<AVMvidFrameSource> m_frameSource;
+  uint32_t m_encodeFlags;
+  BOOL m_genDeltas;
+  BOOL m_isPipelined;
+  BOOL m_wasSuccessful;
+#if defined(HAS_LIB_COMPRESSION_API)
+  BOOL m_compressed;
+#endif // HAS_LIB_COMPRESSION_API
+  NSMutableArray *m_frameBuffers;
+  AVMvidFrameSourceInfo m_frameInfos[AV_FRAME_SOURCE_NUM_BUFFERS];
+  uint32_t m_frameStatus[AV_FRAME_SOURCE_NUM_BUFFERS];
+  uint32_t m_detectedBpp;
+  dispatch_semaphore_t m_freeSemaphore;
+  dispatch_semaphore_t m_filledSemaphore;
+  dispatch_semaphore_t m_readDoneSemaphore;
+  volatile BOOL m_stopReading;
+}
+
+@property (nonatomic, retain) id<AVMvidFrameSource> frameSource;
+
+// FALSE by default, set to TRUE to write frames that change only a part of
+// the image as delta frames. A frame with no changes is written as a nop frame.
+
+@property (nonatomic, assign) BOOL genDeltas;
+
+// Lossy encode flags applied to delta frames, see maxvid_encode.h
+
+@property (nonatomic, assign) uint32_t encodeFlags;
+
+// TRUE by default, set to FALSE to decode frames in the calling thread
+
+@property (nonatomic, assign) BOOL isPipelined;
+
+#if defined(HAS_LIB_COMPRESSION_API)
+
+// FALSE by default, set to TRUE to write each keyframe compressed
+
+@property (nonatomic, assign) BOOL compressed;
+
+#endif // HAS_LIB_COMPRESSION_API
+
+@property (nonatomic, assign) BOOL wasSuccessful;
+
++ (AVFrameSourceConvertMaxvid*) aVFrameSourceConvertMaxvid;
+
+// This method is a blocking call that will read every frame from the frame
+// source and write the output as a .mvid file. The movieSize and frameDuration
+// are taken from the source unless already set. When the source does not know
+// the number of frames, the file is written in streaming mode. When the source
+// reports a duration for each frame, the durations are stored in a V3 file,
+// otherwise the file is written in streaming mode with nop frames.
+// Return TRUE if successful, FALSE otherwise.
+
+- (BOOL) blockingConvert;
+
+@end
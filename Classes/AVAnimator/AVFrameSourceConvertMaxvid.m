@@ -0,0 +1,489 @@
+//
+//  AVFrameSourceConvertMaxvid.m
+//
+//  License terms defined in License.txt.
+
+#import "AVFrameSourceConvertMaxvid.h"
+
+#import "CGFrameBuffer.h"
+
+#include "maxvid_encode.h"
+
+#if defined(HAS_LIB_COMPRESSION_API)
+#import "AVStreamEncodeDecode.h"
+#endif // HAS_LIB_COMPRESSION_API
+
+#if __has_feature(objc_arc)
+#else
+#import "AutoPropertyRelease.h"
+#endif // objc_arc
+
+//#define LOGGING
+
+@implementation AVFrameSourceConvertMaxvid
+
+@synthesize frameSource = m_frameSource;
+@synthesize genDeltas = m_genDeltas;
+@synthesize encodeFlags = m_encodeFlags;
+@synthesize isPipelined = m_isPipelined;
+@synthesize wasSuccessful = m_wasSuccessful;
+
+#if defined(HAS_LIB_COMPRESSION_API)
+@synthesize compressed = m_compressed;
+#endif // HAS_LIB_COMPRESSION_API
+
+- (void) dealloc
+{
+#if __has_feature(objc_arc)
+#else
+  [m_frameBuffers release];
+  [AutoPropertyRelease releaseProperties:self thisClass:AVFrameSourceConvertMaxvid.class];
+  [super dealloc];
+#endif // objc_arc
+}
+
+- (id) init
+{
+  if ((self = [super init])) {
+    self.genV3 = TRUE; // enable extended file size out to 64bit offsets
+    self.isPipelined = TRUE;
+  }
+  return self;
+}
+
++ (AVFrameSourceConvertMaxvid*) aVFrameSourceConvertMaxvid
+{
+  AVFrameSourceConvertMaxvid *obj = [[AVFrameSourceConvertMaxvid alloc] init];
+#if __has_feature(objc_arc)
+  return obj;
+#else
+  return [obj autorelease];
+#endif // objc_arc
+}
+
+- (NSUInteger) numFrameBuffers
+{
+  return self.isPipelined ? AV_FRAME_SOURCE_NUM_BUFFERS : 2;
+}
+
+// Secondary thread entry point, frames are read into the framebuffers in
+// order. A framebuffer is only written once the calling thread is done with
+// the frame that was in it, the free semaphore counts the framebuffers that
+// can be written and the filled semaphore counts the frames that are ready.
+
+- (void) readFramesThreadEntryPoint
+{
+  @autoreleasepool {
+
+  id<AVMvidFrameSource> frameSource = self.frameSource;
+  NSUInteger numFrameBuffers = [self numFrameBuffers];
+
+  for (NSUInteger frameIndex = 0; ; frameIndex++) {
+    dispatch_semaphore_wait(m_freeSemaphore, DISPATCH_TIME_FOREVER);
+
+    if (m_stopReading) {
+      break;
+    }
+
+    NSUInteger slot = frameIndex % numFrameBuffers;
+    uint32_t status;
+
+    @autoreleasepool {
+      CGFrameBuffer *frameBuffer = [m_frameBuffers objectAtIndex:slot];
+      status = [frameSource readFrame:frameBuffer info:&m_frameInfos[slot]];
+    }
+
+    m_frameStatus[slot] = status;
+
+    dispatch_semaphore_signal(m_filledSemaphore);
+
+    if (status != 0) {
+      break;
+    }
+  }
+
+  }
+
+  dispatch_semaphore_signal(m_readDoneSemaphore);
+}
+
+- (void) startReading
+{
+  m_stopReading = FALSE;
+  m_freeSemaphore = dispatch_semaphore_create(0);
+  m_filledSemaphore = dispatch_semaphore_create(0);
+  m_readDoneSemaphore = dispatch_semaphore_create(0);
+
+  // A semaphore must not be released with a value less than the initial value
+
+  for (NSUInteger i = 0; i < [self numFrameBuffers]; i++) {
+    dispatch_semaphore_signal(m_freeSemaphore);
+  }
+
+  [NSThread detachNewThreadSelector:@selector(readFramesThreadEntryPoint) toTarget:self withObject:nil];
+}
+
+// Stop the read thread and wait for it to exit, a frame being read is
+// finished first.
+
+- (void) stopReading
+{
+  m_stopReading = TRUE;
+  dispatch_semaphore_signal(m_freeSemaphore);
+  dispatch_semaphore_wait(m_readDoneSemaphore, DISPATCH_TIME_FOREVER);
+
+#if __has_feature(objc_arc)
+  m_freeSemaphore = nil;
+  m_filledSemaphore = nil;
+  m_readDoneSemaphore = nil;
+#else
+  dispatch_release(m_freeSemaphore);
+  dispatch_release(m_filledSemaphore);
+  dispatch_release(m_readDoneSemaphore);
+  m_freeSemaphore = NULL;
+  m_filledSemaphore = NULL;
+  m_readDoneSemaphore = NULL;
+#endif // objc_arc
+}
+
+// Return the status of the frame at frameIndex once it has been read
+
+- (uint32_t) waitForFrame:(NSUInteger)frameIndex
+{
+  NSUInteger slot = frameIndex % [self numFrameBuffers];
+
+  if (self.isPipelined) {
+    dispatch_semaphore_wait(m_filledSemaphore, DISPATCH_TIME_FOREVER);
+    return m_frameStatus[slot];
+  } else {
+    CGFrameBuffer *frameBuffer = [m_frameBuffers objectAtIndex:slot];
+    return [self.frameSource readFrame:frameBuffer info:&m_frameInfos[slot]];
+  }
+}
+
+// Invoked once the frame at frameIndex is no longer needed
+
+- (void) doneWithFrame:(NSUInteger)frameIndex
+{
+  if (self.isPipelined) {
+    dispatch_semaphore_signal(m_freeSemaphore);
+  }
+}
+
+// Scan for a pixel that is not opaque until one is found
+
+- (void) detectAlpha:(CGFrameBuffer*)frameBuffer
+{
+  if (m_detectedBpp == 32) {
+    return;
+  }
+
+  uint32_t *pixels = (uint32_t*) frameBuffer.pixels;
+  uint32_t numPixels = (uint32_t) (frameBuffer.width * frameBuffer.height);
+
+  for (uint32_t i = 0; i < numPixels; i++) {
+    uint8_t alpha = (pixels[i] >> 24) & 0xFF;
+    if (alpha != 0xFF) {
+      m_detectedBpp = 32;
+      self.bpp = 32;
+      break;
+    }
+  }
+}
+
+// Write the current frame as a nop frame, a palette frame, a delta from the
+// previous frame, a compressed keyframe, or a keyframe.
+
+- (BOOL) writeFrame:(CGFrameBuffer*)frameBuffer
+    prevFrameBuffer:(CGFrameBuffer*)prevFrameBuffer
+               info:(AVMvidFrameSourceInfo*)info
+{
+  BOOL worked;
+
+  uint32_t *pixels = (uint32_t*) frameBuffer.pixels;
+  int bufferSize = (int) frameBuffer.numBytes;
+
+  uint32_t width = (uint32_t) self.movieSize.width;
+  uint32_t height = (uint32_t) self.movieSize.height;
+  uint32_t numPixels = width * height;
+
+  if (prevFrameBuffer != nil && CGRectIsEmpty(info->dirtyRect)) {
+    // The source did not write the framebuffer, the pixels are needed to
+    // calculate the delta for the next frame.
+
+    if (self.genDeltas) {
+      [frameBuffer memcopyPixels:prevFrameBuffer];
+    }
+
+    worked = [self writeNopFrame];
+  } else {
+    if (m_detectedBpp != 0) {
+      [self detectAlpha:frameBuffer];
+    }
+
+    uint32_t *prevPixels = NULL;
+
+    if (self.genDeltas && prevFrameBuffer != nil) {
+      prevPixels = (uint32_t*) prevFrameBuffer.pixels;
+
+      uint32_t encodeFlags = self.encodeFlags;
+
+      if (encodeFlags & (MaxvidEncodeFlags_LOSSY_SKIP | MaxvidEncodeFlags_LOSSY_DUP)) {
+        maxvid_encode_lossy_pixels32(prevPixels, pixels, width, height, encodeFlags);
+      }
+    }
+
+    worked = FALSE;
+    BOOL emitKeyframe = TRUE;
+
+    if (self.genPalette) {
+      // A frame with more than 256 colors is written as a delta frame or
+      // as a keyframe instead.
+
+      BOOL tooManyColors = FALSE;
+
+      worked = [self writePaletteFrame:(char*)pixels
+                             prevFrame:(char*)prevPixels
+                            bufferSize:bufferSize
+                         tooManyColors:&tooManyColors];
+
+      if (worked == FALSE || tooManyColors == FALSE) {
+        emitKeyframe = FALSE;
+        prevPixels = NULL;
+      }
+    }
+
+    if (prevPixels != NULL) {
+      uint32_t encodeFlags = self.encodeFlags;
+
+      BOOL emitKeyframeAnyway = FALSE;
+
+      NSData *codes = maxvid_encode_generic_delta_pixels32(prevPixels, pixels, numPixels, width, height,
+                                                           &emitKeyframeAnyway, encodeFlags);
+
+      if (emitKeyframeAnyway == FALSE) {
+        emitKeyframe = FALSE;
+
+        if (codes == nil) {
+          worked = [self writeNopFrame];
+        } else {
+          worked = maxvid_write_delta_pixels(self, codes, pixels, bufferSize, numPixels, encodeFlags);
+        }
+      }
+    }
+
+    if (emitKeyframe) {
+#if defined(HAS_LIB_COMPRESSION_API)
+      if (self.compressed) @autoreleasepool {
+        NSData *pixelData = [NSData dataWithBytesNoCopy:pixels length:bufferSize freeWhenDone:NO];
+
+        NSMutableData *mEncodedData = [NSMutableData data];
+
+        [AVStreamEncodeDecode streamDeltaAndCompress:pixelData
+                                         encodedData:mEncodedData
+                                                 bpp:self.bpp
+                                           algorithm:COMPRESSION_LZ4];
+
+        assert(mEncodedData.length < 0xFFFFFFFF);
+        int dst_size = (int) mEncodedData.length;
+
+        // Calculate adler based on original pixels (not the compressed representation)
+
+        uint32_t adler = 0;
+
+        if (self.genAdler) {
+          adler = maxvid_adler32(0, (unsigned char*)pixels, bufferSize);
+        }
+
+        worked = [self writeKeyframe:(char*)mEncodedData.bytes bufferSize:(int)dst_size adler:adler isCompressed:TRUE];
+      } else
+#endif // HAS_LIB_COMPRESSION_API
+      {
+        worked = [self writeKeyframe:(char*)pixels bufferSize:bufferSize];
+      }
+    }
+  }
+
+  // A duration is stored in the frame table or written as nop frames, a
+  // frame table of totalNumFrames entries has no room for nop frames.
+
+  if (worked && info->duration > 0.0f) {
+    if (self.genFrameDurations || self.isStreaming) {
+      worked = [self writeTrailingNopFrames:info->duration];
+    } else if ([self.class countTrailingNopFrames:info->duration frameDuration:self.frameDuration] > 0) {
+      NSLog(@"error: frame duration %f for \"%@\" requires genFrameDurations", info->duration, self.mvidPath);
+      worked = FALSE;
+    }
+  }
+
+  return worked;
+}
+
+- (BOOL) blockingConvert
+{
+  BOOL worked;
+  BOOL retstatus = FALSE;
+  BOOL isReading = FALSE;
+  uint32_t status = 0;
+
+  id<AVMvidFrameSource> frameSource = self.frameSource;
+
+  self.wasSuccessful = FALSE;
+
+  NSAssert(frameSource, @"frameSource");
+  NSAssert(self.mvidPath, @"mvidPath");
+
+  worked = [frameSource openFrameSource];
+  if (worked == FALSE) {
+    goto retcode;
+  }
+
+  if (CGSizeEqualToSize(CGSizeZero, self.movieSize)) {
+    self.movieSize = [frameSource frameSourceSize];
+  }
+
+  if (self.frameDuration == 0.0f) {
+    self.frameDuration = (float) [frameSource frameSourceFrameDuration];
+  }
+
+  if (self.frameDuration <= 0.0f) {
+    NSLog(@"error: frame duration is not known for \"%@\"", self.mvidPath);
+    goto retcode;
+  }
+
+  NSUInteger numFrames = [frameSource frameSourceNumFrames];
+
+  BOOL hasFrameDurations = [frameSource respondsToSelector:@selector(frameSourceHasFrameDurations)] &&
+    [frameSource frameSourceHasFrameDurations];
+
+  if (hasFrameDurations && self.genV3) {
+    self.genFrameDurations = TRUE;
+  }
+
+  if (numFrames == 0 || (hasFrameDurations && self.genFrameDurations == FALSE)) {
+    self.isStreaming = TRUE;
+  } else {
+    self.totalNumFrames = (int) numFrames;
+  }
+
+  // When the source does not know the bpp, frames are scanned until a pixel
+  // that is not opaque is found.
+
+  uint32_t sourceBpp = [frameSource frameSourceBpp];
+
+  if (sourceBpp == 0) {
+    m_detectedBpp = 24;
+    self.bpp = 24;
+  } else {
+    m_detectedBpp = 0;
+    self.bpp = sourceBpp;
+  }
+
+  worked = [self open];
+  if (worked == FALSE) {
+    goto retcode;
+  }
+
+  NSUInteger numFrameBuffers = [self numFrameBuffers];
+
+#if __has_feature(objc_arc)
+  m_frameBuffers = [NSMutableArray arrayWithCapacity:numFrameBuffers];
+#else
+  [m_frameBuffers release];
+  m_frameBuffers = [[NSMutableArray alloc] initWithCapacity:numFrameBuffers];
+#endif // objc_arc
+
+  for (NSUInteger i = 0; i < numFrameBuffers; i++) {
+    CGFrameBuffer *frameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:((sourceBpp == 24) ? 24 : 32)
+                                                                          width:self.movieSize.width
+                                                                         height:self.movieSize.height];
+    NSAssert(frameBuffer, @"frameBuffer");
+    [m_frameBuffers addObject:frameBuffer];
+  }
+
+  if (self.isPipelined) {
+    [self startReading];
+    isReading = TRUE;
+  }
+
+  for (NSUInteger frameIndex = 0; ; frameIndex++) @autoreleasepool {
+    status = [self waitForFrame:frameIndex];
+    if (status != 0) {
+      break;
+    }
+
+    NSUInteger slot = frameIndex % numFrameBuffers;
+    CGFrameBuffer *frameBuffer = [m_frameBuffers objectAtIndex:slot];
+    CGFrameBuffer *prevFrameBuffer = nil;
+
+    if (frameIndex > 0) {
+      prevFrameBuffer = [m_frameBuffers objectAtIndex:((frameIndex - 1) % numFrameBuffers)];
+    }
+
+#ifdef LOGGING
+    NSLog(@"writing frame %d", (int)frameIndex);
+#endif // LOGGING
+
+    worked = [self writeFrame:frameBuffer prevFrameBuffer:prevFrameBuffer info:&m_frameInfos[slot]];
+    if (worked == FALSE) {
+      status = MV_ERROR_CODE_WRITE_FAILED;
+      break;
+    }
+
+    // The previous frame is kept while the next frame is written as a delta
+
+    if (self.genDeltas) {
+      if (frameIndex > 0) {
+        [self doneWithFrame:(frameIndex - 1)];
+      }
+    } else {
+      [self doneWithFrame:frameIndex];
+    }
+  }
+
+  if (isReading) {
+    [self stopReading];
+  }
+
+  if (status == AV_FRAME_SOURCE_END_OF_STREAM && self.frameNum > 1) {
+    worked = [self rewriteHeader];
+  } else {
+    NSLog(@"error: conversion failed with status %d after %d frames", (int)status, self.frameNum);
+    worked = FALSE;
+  }
+
+  [self close];
+
+  if (worked == FALSE) {
+    goto retcode;
+  }
+
+  retstatus = TRUE;
+
+retcode:
+  [frameSource closeFrameSource];
+
+  // Release the framebuffers in case they are very large
+
+#if __has_feature(objc_arc)
+  m_frameBuffers = nil;
+#else
+  [m_frameBuffers release];
+  m_frameBuffers = nil;
+#endif // objc_arc
+
+  if (retstatus) {
+#ifdef LOGGING
+    NSLog(@"wrote %@", self.mvidPath);
+#endif // LOGGING
+  } else {
+#ifdef LOGGING
+    NSLog(@"failed to write %@", self.mvidPath);
+#endif // LOGGING
+  }
+
+  self.wasSuccessful = retstatus;
+  return retstatus;
+}
+
+@end
@@ -14,7 +14,7 @@
 
 #import "AVFileUtil.h"
 
-#import "AVMvidFileWriter.h"
+#import "AVFrameSourceConvertMaxvid.h"
 
 #import "CGFrameBuffer.h"
 
@@ -41,6 +41,250 @@
 @end
 
 
+// Frame source that renders each frame of an animated GIF into a framebuffer.
+// Each frame is displayed for its own delay time, the shortest delay is used
+// as the frame duration of the movie.
+
+@interface AVGIF89AFrameSource : NSObject <AVMvidFrameSource> {
+@private
+  CGImageSourceRef m_srcRef;
+  float *m_frameDelays;
+  uint32_t m_numFrames;
+  uint32_t m_frameIndex;
+  uint32_t m_width;
+  uint32_t m_height;
+  float m_minDelaySeconds;
+}
+
+- (uint32_t) scanFrames:(NSData*)inGIF89AData;
+
+@end
+
+@implementation AVGIF89AFrameSource
+
+- (void) dealloc
+{
+  if (m_srcRef) {
+    CFRelease(m_srcRef);
+  }
+  
+  if (m_frameDelays) {
+    free(m_frameDelays);
+  }
+  
+#if __has_feature(objc_arc)
+#else
+  [super dealloc];
+#endif // objc_arc
+}
+
+// Read the image metadata for each subimage and determine the delay from
+// the previous frame to the current one. Return 0 on success, otherwise
+// an error code.
+
+- (uint32_t) scanFrames:(NSData*)inGIF89AData
+{
+  m_srcRef = CGImageSourceCreateWithData(
+#if __has_feature(objc_arc)
+                                         (__bridge CFDataRef)inGIF89AData
+#else
+                                         (CFDataRef)inGIF89AData
+#endif // objc_arc
+                                         , NULL);
+  
+  assert(m_srcRef);
+  
+  uint32_t const numFrames = (uint32_t) CGImageSourceGetCount(m_srcRef);
+  
+  m_numFrames = numFrames;
+  m_minDelaySeconds = 10000.0;
+  
+  m_frameDelays = malloc(sizeof(float) * (numFrames + 1));
+  if (m_frameDelays == NULL) {
+    return WRITE_ERROR;
+  }
+  //uint32_t foundHasAlphaFlag = 0;
+  
+  uint32_t width = 0;
+  uint32_t height = 0;
+  
+  for (int i=0; i < numFrames; i++) {
+    CFDictionaryRef imageFrameProperties = CGImageSourceCopyPropertiesAtIndex(m_srcRef, i, NULL);
+    assert(imageFrameProperties);
+    
+    CFDictionaryRef gifProperties = CFDictionaryGetValue(imageFrameProperties, kCGImagePropertyGIFDictionary);
+    assert(gifProperties);
+
+    // kCGImagePropertyGIFDelayTime is rounded up to 0.1 if smaller than 0.1.
+    // kCGImagePropertyGIFUnclampedDelayTime is the original value in the GIF file
+    
+    CFNumberRef delayTime = CFDictionaryGetValue(gifProperties, kCGImagePropertyGIFUnclampedDelayTime);
+    assert(delayTime);
+    
+    NSNumber *delayTimeNum;
+    
+#if __has_feature(objc_arc)
+    delayTimeNum = (__bridge NSNumber*)delayTime;
+#else
+    delayTimeNum = (NSNumber*)delayTime;
+#endif // objc_arc
+    
+    // ImageIO must return the delay time in seconds
+    
+    float delayTimeFloat = (float) [delayTimeNum doubleValue];
+
+    // Define a lower limit of about 30 FPS. The clamped value defined by kCGImagePropertyGIFDelayTime
+    // is too restrictive since a value of 0.04 corresponds to about 23 fps.
+    
+    if (delayTimeFloat <= (1.0f/30.0f)) {
+      delayTimeFloat = (1.0f/30.0f);
+    }
+    
+    if (delayTimeFloat < m_minDelaySeconds) {
+      m_minDelaySeconds = delayTimeFloat;
+    }
+    
+    m_frameDelays[i] = delayTimeFloat;
+    
+    if (width == 0) {
+      CFNumberRef pixelWidth = CFDictionaryGetValue(imageFrameProperties, @"PixelWidth");
+      CFNumberRef pixelHeight = CFDictionaryGetValue(imageFrameProperties, @"PixelHeight");
+      
+      NSNumber *pixelWidthNum;
+      NSNumber *pixelHeightNum;
+      
+#if __has_feature(objc_arc)
+      pixelWidthNum = (__bridge NSNumber*)pixelWidth;
+      pixelHeightNum = (__bridge NSNumber*)pixelHeight;
+#else
+      pixelWidthNum = (NSNumber*)pixelWidth;
+      pixelHeightNum = (NSNumber*)pixelHeight;
+#endif // objc_arc
+      
+      width = [pixelWidthNum unsignedIntValue];
+      height = [pixelHeightNum unsignedIntValue];
+    }
+    
+    // Check "HasAlpha" property for each frame, if an earlier frame does not contain
+    // a transparent pixel but a later frame does, then all frames need to be treated.
+    // This should work, but it actually does not work better than detection since it
+    // appears that images that really are 24BPP get detected as 32 BPP. Go with the
+    // scanning approach on actual rendered pixels since that works in all cases.
+    
+//    if (foundHasAlphaFlag == 0) {
+//      CFNumberRef hasAlpha = CFDictionaryGetValue(imageFrameProperties, @"HasAlpha");
+//      
+//      NSNumber *hasAlphaNum = (NSNumber*)hasAlpha;
+//      
+//      uint32_t hasAlphaValue = [hasAlphaNum intValue];
+//      if (hasAlphaValue == 1) {
+//        foundHasAlphaFlag = 1;
+//      }
+//    }
+
+    CFRelease(imageFrameProperties);
+  }
+  
+  m_width = width;
+  m_height = height;
+  
+  // If width and height were not detected, unable to process the GIF file
+  
+  if (width == 0 || height == 0) {
+    return UNSUPPORTED_FILE;
+  }
+  
+  // FIXME: might want to just pick a default duration like 1 FPS for cases like
+  // when no framerate can be detected, or when it is a plain GIF with no animation.
+  // In this case, perhaps just 1 frame is okay.
+  
+  // If fewer than 2 animation frames, then it will not be possible to animate.
+  // This could happen when there is only a single frame in a PNG file, for example.
+  // It might also happen in a 2 frame .gif where the first frame is marked as hidden.
+  
+  if (numFrames < 2) {
+    return UNSUPPORTED_FILE;
+  }
+  
+  return 0;
+}
+
+- (BOOL) openFrameSource
+{
+  m_frameIndex = 0;
+  return TRUE;
+}
+
+- (void) closeFrameSource
+{
+}
+
+- (CGSize) frameSourceSize
+{
+  return CGSizeMake(m_width, m_height);
+}
+
+- (NSTimeInterval) frameSourceFrameDuration
+{
+  return m_minDelaySeconds;
+}
+
+- (NSUInteger) frameSourceNumFrames
+{
+  return m_numFrames;
+}
+
+// The converter scans the rendered pixels for transparent pixels
+
+- (uint32_t) frameSourceBpp
+{
+  return 0;
+}
+
+// Each frame is displayed for its own delay time
+
+- (BOOL) frameSourceHasFrameDurations
+{
+  return TRUE;
+}
+
+- (uint32_t) readFrame:(CGFrameBuffer*)frameBuffer info:(AVMvidFrameSourceInfo*)info
+{
+  if (m_frameIndex == m_numFrames) {
+    return AV_FRAME_SOURCE_END_OF_STREAM;
+  }
+  
+  CGImageRef imgRef = CGImageSourceCreateImageAtIndex(m_srcRef, m_frameIndex, NULL);
+  
+  if (imgRef == NULL) {
+    return READ_ERROR;
+  }
+  
+  // Render the image contents into a framebuffer. We don't know what
+  // the exact binary layout of the GIF image data might be, though it
+  // is likely to be a flat array of 32 BPP pixels.
+  
+  uint32_t imageWidth  = (uint32_t) CGImageGetWidth(imgRef);
+  uint32_t imageHeight = (uint32_t) CGImageGetHeight(imgRef);
+  
+  assert(imageWidth == m_width);
+  assert(imageHeight == m_height);
+  
+  [frameBuffer clear];
+  [frameBuffer renderCGImage:imgRef];
+  
+  CGImageRelease(imgRef);
+  
+  info->duration = m_frameDelays[m_frameIndex];
+  info->dirtyRect = CGRectMake(0, 0, m_width, m_height);
+  
+  m_frameIndex++;
+  
+  return 0;
+}
+
+@end
+
 @implementation AVGIF89A2MvidResourceLoader
 
 @synthesize outPath = m_outPath;
@@ -215,224 +459,42 @@
   
   @autoreleasepool {
   
-  CGFrameBuffer *cgFrameBuffer = nil;
-  
-  CGImageSourceRef srcRef = CGImageSourceCreateWithData(
-#if __has_feature(objc_arc)
-                                                        (__bridge CFDataRef)inGIF89AData
-#else
-                                                        (CFDataRef)inGIF89AData
-#endif // objc_arc
-                                                        , NULL);
-    
-  assert(srcRef);
-
-  AVMvidFileWriter *aVMvidFileWriter = nil;
-  
-#undef RETCODE
-#define RETCODE(status) \
-if (status != 0) { \
-retcode = status; \
-goto retcode; \
-}
-  
-  // The initial step is to read the image metadata for each subimage and
-  // determine the delay from the previous frame to the current one.
-  // The shortest delay found will be used as the framerate.
+  AVGIF89AFrameSource *frameSource = [[AVGIF89AFrameSource alloc] init];
   
-  uint32_t const numFrames = (uint32_t) CGImageSourceGetCount(srcRef);
-  
-  float minDelaySeconds = 10000.0;
-  //uint32_t foundHasAlphaFlag = 0;
-  
-  uint32_t width = 0;
-  uint32_t height = 0;
-  
-  for (int i=0; i < numFrames; i++) {
-    CFDictionaryRef imageFrameProperties = CGImageSourceCopyPropertiesAtIndex(srcRef, i, NULL);
-    assert(imageFrameProperties);
-    
-    CFDictionaryRef gifProperties = CFDictionaryGetValue(imageFrameProperties, kCGImagePropertyGIFDictionary);
-    assert(gifProperties);
-
-    // kCGImagePropertyGIFDelayTime is rounded up to 0.1 if smaller than 0.1.
-    // kCGImagePropertyGIFUnclampedDelayTime is the original value in the GIF file
-    
-    CFNumberRef delayTime = CFDictionaryGetValue(gifProperties, kCGImagePropertyGIFUnclampedDelayTime);
-    assert(delayTime);
-    
-    NSNumber *delayTimeNum;
-    
-#if __has_feature(objc_arc)
-    delayTimeNum = (__bridge NSNumber*)delayTime;
-#else
-    delayTimeNum = (NSNumber*)delayTime;
-#endif // objc_arc
-    
-    // ImageIO must return the delay time in seconds
-    
-    float delayTimeFloat = (float) [delayTimeNum doubleValue];
-
-    // Define a lower limit of about 30 FPS. The clamped value defined by kCGImagePropertyGIFDelayTime
-    // is too restrictive since a value of 0.04 corresponds to about 23 fps.
-    
-    if (delayTimeFloat <= (1.0f/30.0f)) {
-      delayTimeFloat = (1.0f/30.0f);
-    }
-    
-    if (delayTimeFloat < minDelaySeconds) {
-      minDelaySeconds = delayTimeFloat;
-    }
-    
-    if (width == 0) {
-      CFNumberRef pixelWidth = CFDictionaryGetValue(imageFrameProperties, @"PixelWidth");
-      CFNumberRef pixelHeight = CFDictionaryGetValue(imageFrameProperties, @"PixelHeight");
-      
-      NSNumber *pixelWidthNum;
-      NSNumber *pixelHeightNum;
-      
 #if __has_feature(objc_arc)
-      pixelWidthNum = (__bridge NSNumber*)pixelWidth;
-      pixelHeightNum = (__bridge NSNumber*)pixelHeight;
 #else
-      pixelWidthNum = (NSNumber*)pixelWidth;
-      pixelHeightNum = (NSNumber*)pixelHeight;
+  [frameSource autorelease];
 #endif // objc_arc
-      
-      width = [pixelWidthNum unsignedIntValue];
-      height = [pixelHeightNum unsignedIntValue];
-    }
-    
-    // Check "HasAlpha" property for each frame, if an earlier frame does not contain
-    // a transparent pixel but a later frame does, then all frames need to be treated.
-    // This should work, but it actually does not work better than detection since it
-    // appears that images that really are 24BPP get detected as 32 BPP. Go with the
-    // scanning approach on actual rendered pixels since that works in all cases.
-    
-//    if (foundHasAlphaFlag == 0) {
-//      CFNumberRef hasAlpha = CFDictionaryGetValue(imageFrameProperties, @"HasAlpha");
-//      
-//      NSNumber *hasAlphaNum = (NSNumber*)hasAlpha;
-//      
-//      uint32_t hasAlphaValue = [hasAlphaNum intValue];
-//      if (hasAlphaValue == 1) {
-//        foundHasAlphaFlag = 1;
-//      }
-//    }
-
-    CFRelease(imageFrameProperties);
-  }
   
-  float frameDuration = minDelaySeconds;
+  retcode = [frameSource scanFrames:inGIF89AData];
   
-  // If width and height were not detected, unable to process the GIF file
-  
-  if (width == 0 || height == 0) {
-    RETCODE(UNSUPPORTED_FILE);
-  }
-  
-  // FIXME: might want to just pick a default duration like 1 FPS for cases like
-  // when no framerate can be detected, or when it is a plain GIF with no animation.
-  // In this case, perhaps just 1 frame is okay.
-  
-  // If fewer than 2 animation frames, then it will not be possible to animate.
-  // This could happen when there is only a single frame in a PNG file, for example.
-  // It might also happen in a 2 frame .gif where the first frame is marked as hidden.
-  
-  if (numFrames < 2) {
-    RETCODE(UNSUPPORTED_FILE);
-  }
-  
-  // Create .mvid file writer utility object
-  
-  aVMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
-  
-  aVMvidFileWriter.mvidPath = outMaxvidPath;
-  aVMvidFileWriter.frameDuration = frameDuration;
-  aVMvidFileWriter.totalNumFrames = numFrames;
-  aVMvidFileWriter.movieSize = CGSizeMake(width, height);
-  aVMvidFileWriter.genAdler = genAdler;
-  
-  BOOL worked = [aVMvidFileWriter open];
-  
-	if (worked == FALSE) {
-    RETCODE(WRITE_ERROR);
-  }
-  
-  // Iterate over each frame, extract the image and write the data
-  // to the mvid file. Make sure to cleanup the autorelease pool so
-  // that not all the image frames are actually loaded into memory.
-  
-  cgFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
-  uint32_t detectedBpp = 24;
-  //if (foundHasAlphaFlag) {
-  //  detectedBpp = 32;
-  //}
-  
-  for (int i=0; i < numFrames; i++) @autoreleasepool {
-    CGImageRef imgRef = CGImageSourceCreateImageAtIndex(srcRef, i, NULL);
+  if (retcode == 0) {
+    // Frames are rendered and scanned for transparent pixels in a secondary
+    // thread while the previous frame is written.
     
-    // if scan finds no transparent pixels, then detectedBpp = 24
+    AVFrameSourceConvertMaxvid *converter = [AVFrameSourceConvertMaxvid aVFrameSourceConvertMaxvid];
     
-    // Render the image contents into a framebuffer. We don't know what
-    // the exact binary layout of the GIF image data might be, though it
-    // is likely to be a flat array of 32 BPP pixels.
+    converter.frameSource = frameSource;
+    converter.mvidPath = outMaxvidPath;
+    converter.genAdler = genAdler;
     
-    uint32_t imageWidth  = (uint32_t) CGImageGetWidth(imgRef);
-    uint32_t imageHeight = (uint32_t) CGImageGetHeight(imgRef);
+    // Each GIF frame is displayed for its own delay time
     
-    assert(imageWidth == width);
-    assert(imageHeight == height);
+    converter.genV3 = TRUE;
+    converter.genFrameDurations = TRUE;
     
-    [cgFrameBuffer clear];
-    [cgFrameBuffer renderCGImage:imgRef];
+    // A GIF frame has at most 256 colors, so it is stored as 8 bit palette
+    // indexes unless frames composed over a previous frame add more colors.
     
-    // Scan the framebuffer to determine if any transparent pixels appear
-    // in the frame. This is not fast, but it works. A better approach
-    // would be to inspect the metadata to see if it indicates when
-    // transparent pixels appear in the color table.
+    converter.genPalette = TRUE;
     
-    uint32_t *pixels = (uint32_t*) cgFrameBuffer.pixels;
+    BOOL worked = [converter blockingConvert];
     
-    if (detectedBpp == 24) {
-      for (int rowi = 0; rowi < height; rowi++) {
-        for (int coli = 0; coli < width; coli++) {
-          uint32_t pixel = pixels[(rowi * width) + coli];
-          uint8_t alpha = (pixel >> 24) & 0xFF;
-          if (alpha != 0xFF) {
-            detectedBpp = 32;
-            break;
-          }
-        }
-      }
+    if (worked == FALSE) {
+      retcode = WRITE_ERROR;
     }
-    
-    CGImageRelease(imgRef);
-    
-    // Write the keyframe to the output file
-    
-    int numBytesInBuffer = (int) cgFrameBuffer.numBytes;
-    
-    worked = [aVMvidFileWriter writeKeyframe:cgFrameBuffer.pixels bufferSize:numBytesInBuffer];
-    
-    assert(worked);
-  }
-  
-  // Write .mvid header again, now that info is up to date
-  
-  aVMvidFileWriter.bpp = detectedBpp;
-  
-  worked = [aVMvidFileWriter rewriteHeader];
-  
-	if (worked == FALSE) {
-    RETCODE(WRITE_ERROR);
   }
   
-retcode:  
-  CFRelease(srcRef);
-  
-  [aVMvidFileWriter close];
-  
   }
   
 	return retcode;
@@ -18,6 +18,14 @@
 
 #import "maxvid_file.h"
 
+#import "maxvid_stats.h"
+
+#import "maxvid_writer.h"
+
+#import "maxvid_scale.h"
+
+#import "maxvid_palette.h"
+
 @interface AVMvidFileWriter : NSObject {
 @private
   NSString *m_mvidPath;
@@ -27,9 +35,12 @@
   MVFileHeader *mvHeader;
   void *mvFramesArray;
   uint32_t framesArrayNumBytes;
+  int   framesArrayBase;
+  int   framesArrayCapacity;
+  FILE *framesSpillFile;
   uint32_t m_bpp;
   
-  FILE *maxvidOutFile;
+  MVWriter *maxvidOutWriter;
 
   off_t offset;
   CGSize m_movieSize;
@@ -38,6 +49,22 @@
   BOOL  m_genAdler;
   BOOL  m_isAllKeyframes;
   BOOL  m_genV3;
+  BOOL  m_genStats;
+  BOOL  m_isStreaming;
+  BOOL  m_isDirectIO;
+  BOOL  m_isHugePageAligned;
+  BOOL  m_genFrameDurations;
+  uint32_t m_numLevels;
+  MVLevel mvLevels[MV_FILE_MAX_LEVELS];
+  void *levelFramesArrays[MV_FILE_MAX_LEVELS];
+  MVScale levelScales[MV_FILE_MAX_LEVELS];
+  void *levelPixels[MV_FILE_MAX_LEVELS];
+  void *levelPrevPixels[MV_FILE_MAX_LEVELS];
+  BOOL  m_genPalette;
+  MVPalette *palette;
+  uint32_t *paletteWords;
+  MVFileStats *m_stats;
+  CFAbsoluteTime frameStartTime;
 #if MV_ENABLE_DELTAS
   BOOL  m_isDeltas;
 #endif // MV_ENABLE_DELTAS
@@ -65,6 +92,73 @@
 
 @property (nonatomic, assign) BOOL          genV3;
 
+// Set this property to TRUE before calling open to collect encode stats
+// for each frame written. The encode time for a frame is the wall clock
+// time between the previous frame write (or open) and this frame write,
+// so it includes the time the caller spent calculating a delta. A write method
+// returns FALSE when the stats for the frame can't be recorded.
+
+@property (nonatomic, assign) BOOL          genStats;
+
+// Set this property to TRUE before calling open when the number of frames
+// is not known up front, for example with live capture. The totalNumFrames
+// property need not be set, it is set to the number of frames written when
+// rewriteHeader is invoked after the last frame. The frame table is written
+// after the frame data followed by a trailer, so the file is written in one
+// pass and the memory used by the writer does not grow with the number of
+// frames. AVMvidFrameDecoder reads either layout. The frame table entries
+// that do not fit in memory are written to a temp file, the write methods
+// return FALSE when that fails.
+
+@property (nonatomic, assign) BOOL          isStreaming;
+
+// Set this property to TRUE before calling open to write the file without
+// going through the buffer cache (O_DIRECT on Linux, F_NOCACHE on iOS).
+// This is useful when writing a huge V3 file that will not be read back
+// right away. When FALSE, frame data and padding are still batched so that
+// a keyframe is written with one system call and the zero padding after a
+// keyframe is left as a sparse hole when it covers a filesystem block.
+
+@property (nonatomic, assign) BOOL          isDirectIO;
+
+// Set this property to TRUE before calling open to start each keyframe on a
+// 2 MB bound (MV_HUGEPAGESIZE) instead of a 16 kB bound. A keyframe can then be
+// mapped into a huge page aligned framebuffer with huge pages. Only supported
+// for V3 files, the extra padding is left as a sparse hole unless writing with
+// direct IO.
+
+@property (nonatomic, assign) BOOL          isHugePageAligned;
+
+// Set this property to TRUE before calling open to store the display duration
+// of each frame in the frame table, see MV_FILE_FRAME_DURATIONS. Only supported
+// for V3 files. Instead of writing nop frames, writeTrailingNopFrames then sets
+// the duration of the frame that was just written. The frameDuration property
+// should be set to the shortest frame duration.
+
+@property (nonatomic, assign) BOOL          genFrameDurations;
+
+// Set this property before calling open to also write this many reduced size
+// levels, see MV_FILE_LEVELS. Each frame is downscaled with a box filter for
+// each level as it is written, see maxvid_scale.h. A keyframe is written as a
+// level keyframe and a delta frame as the delta between the scaled pixels of the
+// previous and current frame, so delta frames must be written with
+// writeDeltaframe:bufferSize:adler:pixels:. Only supported for V3 files that are
+// not written in streaming mode or with deltas.
+// A decoder can then read only the level that matches the display size.
+
+@property (nonatomic, assign) uint32_t      numLevels;
+
+// Set this property to TRUE before calling open to write frames that have
+// at most 256 colors as 8 bit palette frames with writePaletteFrame, see
+// MV_FILE_PALETTE. Only supported for 24 or 32 BPP V3 files without levels.
+
+@property (nonatomic, assign) BOOL          genPalette;
+
+// Stats collected when genStats is TRUE, NULL otherwise. The memory
+// is owned by the writer and is valid until the writer is deallocated.
+
+@property (nonatomic, readonly) MVFileStats *stats;
+
 #if MV_ENABLE_DELTAS
 
 // FALSE by default, if the mvid file was created with the
@@ -80,18 +174,20 @@
 
 - (void) close;
 
-// Write a single nop frame after a keyframe or a delta frame
+// Write a single nop frame after a keyframe or a delta frame. Returns FALSE
+// when the frame table can't be written, see isStreaming.
 
-- (void) writeNopFrame;
+- (BOOL) writeNopFrame;
 
 #if MV_ENABLE_DELTAS
 
 // Write special case nop frame that appears at the begining of
 // the file. The weird special case bascially means that the
 // first frame is constructed by applying a frame delta to an
-// all black framebuffer.
+// all black framebuffer. Returns FALSE and writes nothing when
+// numLevels is not zero.
 
-- (void) writeInitialNopFrame;
+- (BOOL) writeInitialNopFrame;
 
 #endif // MV_ENABLE_DELTAS
 
@@ -103,11 +199,17 @@
 + (int) countTrailingNopFrames:(float)currentFrameDuration
                  frameDuration:(float)frameDuration;
 
-// Write 0 to N trailing nop frames, pass in total frame display time
+// Write 0 to N trailing nop frames, pass in total frame display time.
+// When genFrameDurations is TRUE, the display time of the frame that
+// was just written is set instead and no nop frames are written.
+// Returns FALSE when a nop frame can't be written.
+
+- (BOOL) writeTrailingNopFrames:(float)frameDuration;
 
-- (void) writeTrailingNopFrames:(float)frameDuration;
+// Pad to the next page bound and set the offset of the next keyframe. Returns
+// FALSE when the frame table can't be written, see isStreaming.
 
-- (void) skipToNextPageBound;
+- (BOOL) skipToNextPageBound;
 
 // Write a self contained key frame. Note that the bufferSize argument
 // here should contain all the pixels and any zero pading in the case
@@ -125,6 +227,29 @@
 
 - (BOOL) writeDeltaframe:(char*)ptr bufferSize:(int)bufferSize adler:(uint32_t)adler;
 
+// This version of writeDeltaframe is also passed the full size pixels that the
+// delta frame produces, the pixels are needed to write the delta frame of each
+// level when numLevels is not zero. The version without pixels returns FALSE
+// when numLevels is not zero.
+
+- (BOOL) writeDeltaframe:(char*)ptr bufferSize:(int)bufferSize adler:(uint32_t)adler pixels:(const void*)pixels;
+
+// Write the 32 bit pixels of a frame as a palette frame, genPalette must be TRUE.
+// When prevPtr is NULL the frame is written as a keyframe, otherwise only the
+// pixels that differ from prevPtr are written and a nop frame is written when
+// no pixels changed. When the pixels have more than 256 colors nothing is
+// written and tooManyColors is set to TRUE, the caller should then write the
+// frame as a keyframe or as a delta frame.
+
+- (BOOL) writePaletteFrame:(char*)ptr
+                 prevFrame:(char*)prevPtr
+                bufferSize:(int)bufferSize
+             tooManyColors:(BOOL*)tooManyColors;
+
 - (BOOL) rewriteHeader;
 
+// Write the collected stats to a file as JSON, genStats must be TRUE
+
+- (BOOL) writeStatsJSON:(NSString*)path emitFrames:(BOOL)emitFrames;
+
 @end
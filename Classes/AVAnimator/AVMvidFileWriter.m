@@ -7,6 +7,8 @@
 
 #import "AVMvidFileWriter.h"
 
+#import "maxvid_encode.h"
+
 //#define LOGGING
 
 #ifndef __OPTIMIZE__
@@ -18,12 +20,35 @@
 #define ALWAYS_GENERATE_ADLER
 #endif // EXTRA_CHECKS
 
+// In streaming mode, this many frame table entries are kept in memory
+
+#define STREAMING_FRAMES_WINDOW_SIZE 1024
+
 @interface AVMvidFileWriter ()
 
 - (void) saveOffset;
 
+- (BOOL) reserveFrame;
+
+- (MVFrame*) mvFrameAtIndex:(int)index;
+
+- (MVV3Frame*) mvV3FrameAtIndex:(int)index;
+
+- (BOOL) writeFramesAtEnd;
+
+- (BOOL) writeLevelFrames:(const void*)pixels isKeyframe:(BOOL)isKeyframe;
+
+- (BOOL) writeLevelsAtEnd;
+
 - (uint32_t) validateFileOffset:(BOOL)isKeyFrame;
 
+- (off_t) padding:(MVWriter*)outWriter offset:(off_t)_offset boundSize:(uint32_t)boundSize;
+
+- (BOOL) appendStats:(MV_STATS_FRAME_TYPE)frameType
+                 ptr:(char*)ptr
+          bufferSize:(int)bufferSize
+        isCompressed:(BOOL)isCompressed;
+
 @end
 
 // AVMvidFileWriter
@@ -39,16 +64,33 @@
 @synthesize movieSize = m_movieSize;
 @synthesize isAllKeyframes = m_isAllKeyframes;
 @synthesize genV3 = m_genV3;
+@synthesize genStats = m_genStats;
+@synthesize isStreaming = m_isStreaming;
+@synthesize isDirectIO = m_isDirectIO;
+@synthesize isHugePageAligned = m_isHugePageAligned;
+@synthesize genFrameDurations = m_genFrameDurations;
+@synthesize numLevels = m_numLevels;
+@synthesize genPalette = m_genPalette;
+@synthesize stats = m_stats;
 
 #if MV_ENABLE_DELTAS
 @synthesize isDeltas = m_isDeltas;
 #endif // MV_ENABLE_DELTAS
 
-// Emit zero length words up to the next page bound after the keyframe data.
+// Emit zero bytes up to the next page bound after the keyframe data.
 // Pass in the current offset, function returns the new offset.
-// This method will emit zero words of padding if exactly on the page bound already.
+// This method will emit zero bytes of padding if exactly on the page bound already.
+// The padding is emitted with one call, it is written along with the next frame
+// or left as a sparse hole.
 
-- (off_t) paddingAfterKeyframe:(FILE*)outFile offset:(off_t)_offset
+- (off_t) paddingAfterKeyframe:(MVWriter*)outWriter offset:(off_t)_offset
+{
+  return [self padding:outWriter offset:_offset boundSize:MV_PAGESIZE];
+}
+
+// Emit zero bytes up to the next boundSize bound, boundSize must be a power of 2
+
+- (off_t) padding:(MVWriter*)outWriter offset:(off_t)_offset boundSize:(uint32_t)boundSize
 {
 #if defined(DEBUG)
   if (self.genV3) {
@@ -58,44 +100,25 @@
   }
 #endif // DEBUG
   
-  const uint32_t boundSize = MV_PAGESIZE;
   uint32_t bytesToBound = UINTMOD((uint32_t)_offset, boundSize);
-  assert(bytesToBound >= 0 && bytesToBound <= boundSize);
-  
-  bytesToBound = boundSize - bytesToBound;
+  assert(bytesToBound >= 0 && bytesToBound < boundSize);
   
-  if (self.genV3) {
-    uint32_t nBytesToWordBound = bytesToBound % sizeof(uint32_t);
-    uint8_t zeroByte = 0;
-    while (nBytesToWordBound != 0) {
-      size_t size = fwrite(&zeroByte, sizeof(zeroByte), 1, outFile);
-      assert(size == 1);
-      nBytesToWordBound--;
-      bytesToBound--;
-    }
+  if (bytesToBound != 0) {
+    bytesToBound = boundSize - bytesToBound;
   }
   
-  uint32_t wordsToBound = bytesToBound >> 2;
-  wordsToBound &= ((MV_PAGESIZE >> 2) - 1);
-  
 #if defined(DEBUG)
-  if (wordsToBound > 0) {
-    assert(bytesToBound == (wordsToBound * 4));
-    assert(wordsToBound < (boundSize / 4));
+  if (self.genV3) {
+    // Nop
+  } else {
+    assert((bytesToBound % 4) == 0);
   }
 #endif // DEBUG
   
-  // write aligned words
+  uint32_t status = maxvid_writer_pad(outWriter, bytesToBound);
+  assert(status == 0);
   
-  uint32_t zero = 0;
-  while (wordsToBound != 0) {
-    size_t size = fwrite(&zero, sizeof(zero), 1, outFile);
-    assert(size == 1);
-    wordsToBound--;
-  }
-  
-  off_t offsetAfterOff = ftello(outFile);
-  assert(offsetAfterOff != -1);
+  off_t offsetAfterOff = (off_t) maxvid_writer_offset(outWriter);
   
   if (self.genV3) {
     // Nop
@@ -116,16 +139,21 @@
 
 - (void) close
 {
-  if (maxvidOutFile) {
-    fclose(maxvidOutFile);
-    maxvidOutFile = NULL;
+  if (maxvidOutWriter) {
+    maxvid_writer_close(maxvidOutWriter);
+    free(maxvidOutWriter);
+    maxvidOutWriter = NULL;
+  }
+  if (framesSpillFile) {
+    fclose(framesSpillFile);
+    framesSpillFile = NULL;
   }
   isOpen = FALSE;
 }
 
 - (void) dealloc
 {
-  if (maxvidOutFile) {
+  if (maxvidOutWriter || framesSpillFile) {
     [self close];
   }
   
@@ -138,6 +166,37 @@
     free(mvFramesArray);
     mvFramesArray = NULL;
   }
+  
+  for (int i = 0; i < MV_FILE_MAX_LEVELS; i++) {
+    if (levelFramesArrays[i]) {
+      free(levelFramesArrays[i]);
+      levelFramesArrays[i] = NULL;
+    }
+    if (levelPixels[i]) {
+      free(levelPixels[i]);
+      levelPixels[i] = NULL;
+      maxvid_scale_free(&levelScales[i]);
+    }
+    if (levelPrevPixels[i]) {
+      free(levelPrevPixels[i]);
+      levelPrevPixels[i] = NULL;
+    }
+  }
+  
+  if (palette) {
+    free(palette);
+    palette = NULL;
+  }
+  
+  if (paletteWords) {
+    free(paletteWords);
+    paletteWords = NULL;
+  }
+  
+  if (m_stats) {
+    maxvid_file_stats_free(m_stats);
+    m_stats = NULL;
+  }
     
   self.mvidPath = nil;
   
@@ -160,8 +219,23 @@
 - (BOOL) open
 {
   NSAssert(isOpen == FALSE, @"isOpen");
-  NSAssert(self.totalNumFrames > 0, @"totalNumFrames > 0");
+  NSAssert(self.isStreaming || self.totalNumFrames > 0, @"totalNumFrames > 0");
   NSAssert(self.frameDuration != 0, @"frameDuration != 0");
+  NSAssert(self.isHugePageAligned == FALSE || self.genV3, @"isHugePageAligned requires genV3");
+  NSAssert(self.genFrameDurations == FALSE || self.genV3, @"genFrameDurations requires genV3");
+  NSAssert(self.numLevels <= MV_FILE_MAX_LEVELS, @"numLevels");
+  NSAssert(self.numLevels == 0 || (self.genV3 && !self.isStreaming), @"numLevels requires genV3 and can't be streamed");
+  NSAssert(self.genPalette == FALSE || (self.genV3 && self.numLevels == 0), @"genPalette requires genV3 and can't be used with levels");
+  
+#if MV_ENABLE_DELTAS
+  // The level frames are plain delta frames, they can't follow the initial
+  // nop frame of a file written with deltas.
+  
+  if (self.numLevels != 0 && self.isDeltas) {
+    NSLog(@"error: levels can't be written to \"%@\" with deltas", self.mvidPath);
+    return FALSE;
+  }
+#endif // MV_ENABLE_DELTAS
   
 #ifdef ALWAYS_GENERATE_ADLER
   const int genAdler = 1;
@@ -175,9 +249,20 @@
   
   char *mvidStr = (char*)[self.mvidPath UTF8String];
   
-  maxvidOutFile = fopen(mvidStr, "wb");
+  maxvidOutWriter = malloc(sizeof(MVWriter));
+  if (maxvidOutWriter == NULL) {
+    return FALSE;
+  }
+  
+  // Zero padding is left as a sparse hole unless writing with direct IO
+  
+  uint32_t writerFlags = MV_WRITER_SPARSE;
+  if (self.isDirectIO) {
+    writerFlags |= MV_WRITER_DIRECT;
+  }
   
-  if (maxvidOutFile == NULL) {
+  if (maxvid_writer_open(maxvidOutWriter, mvidStr, writerFlags) != 0) {
+    [self close];
     return FALSE;
   }
   
@@ -189,21 +274,25 @@
 
   // Write zeroed file header
   
-  int numWritten = 0;
-  
-  numWritten = (int) fwrite(mvHeader, sizeof(MVFileHeader), 1, maxvidOutFile);
-  if (numWritten != 1) {
+  uint32_t status = maxvid_writer_write(maxvidOutWriter, mvHeader, sizeof(MVFileHeader));
+  if (status != 0) {
     return FALSE;
   }
   
-  // Write zeroed frames header
+  // Write zeroed frames header. In streaming mode the frame table is written
+  // after the frame data, so only a window of frame entries is allocated.
   
-  int numOutputFrames = self.totalNumFrames;
+  if (self.isStreaming) {
+    framesArrayCapacity = STREAMING_FRAMES_WINDOW_SIZE;
+  } else {
+    framesArrayCapacity = self.totalNumFrames;
+  }
+  framesArrayBase = 0;
   
   if (self.genV3) {
-    framesArrayNumBytes = sizeof(MVV3Frame) * numOutputFrames;
+    framesArrayNumBytes = sizeof(MVV3Frame) * framesArrayCapacity;
   } else {
-    framesArrayNumBytes = sizeof(MVFrame) * numOutputFrames;
+    framesArrayNumBytes = sizeof(MVFrame) * framesArrayCapacity;
   }
   int numBytes = framesArrayNumBytes;
   mvFramesArray = malloc(numBytes);
@@ -211,15 +300,41 @@
     return FALSE;
   }
   memset(mvFramesArray, 0, numBytes);
-  numWritten = (int) fwrite(mvFramesArray, numBytes, 1, maxvidOutFile);
-  if (numWritten != 1) {
-    return FALSE;
+  
+  if (self.isStreaming == FALSE) {
+    status = maxvid_writer_pad(maxvidOutWriter, numBytes);
+    if (status != 0) {
+      return FALSE;
+    }
+  }
+  
+  // Each level has its own frame table, the scale state is set up when the
+  // first keyframe is written since the bpp may not be known yet.
+  
+  for (int level = 1; level <= self.numLevels; level++) {
+    MVLevel *mvLevel = &mvLevels[level - 1];
+    mvLevel->width = maxvid_file_level_dimension((uint32_t)self.movieSize.width, level);
+    mvLevel->height = maxvid_file_level_dimension((uint32_t)self.movieSize.height, level);
+    mvLevel->framesOffset = 0;
+    
+    levelFramesArrays[level - 1] = calloc(self.totalNumFrames, sizeof(MVV3Frame));
+    if (levelFramesArrays[level - 1] == NULL) {
+      return FALSE;
+    }
   }
   
   // Store the offset immediately after writing the header
   
   [self saveOffset];
   
+  if (self.genStats) {
+    m_stats = maxvid_file_stats_alloc();
+    if (m_stats == NULL) {
+      return FALSE;
+    }
+    frameStartTime = CFAbsoluteTimeGetCurrent();
+  }
+  
   self->isOpen = TRUE;
   self.isAllKeyframes = TRUE;
   
@@ -230,18 +345,21 @@
 // A nop frame has the exact same offset, length, and flags settings
 // as the previous frame, with the additional nop flag also set.
 
-- (void) writeNopFrame
+- (BOOL) writeNopFrame
 {
 #ifdef LOGGING
   NSLog(@"writeNopFrame %d", frameNum);
 #endif // LOGGING
   
   NSAssert(frameNum != 0, @"nop frame can't be first frame");
-  NSAssert(frameNum < self.totalNumFrames, @"totalNumFrames");
+  
+  if ([self reserveFrame] == FALSE) {
+    return FALSE;
+  }
   
   if (self.genV3) {
-    MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
-    MVV3Frame *prevMvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum-1]);
+    MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
+    MVV3Frame *prevMvFrame = [self mvV3FrameAtIndex:frameNum-1];
     
     maxvid_v3_frame_setoffset(mvFrame, maxvid_v3_frame_offset(prevMvFrame));
     maxvid_v3_frame_setlength(mvFrame, maxvid_v3_frame_length(prevMvFrame));
@@ -251,9 +369,18 @@
     }
     
     maxvid_v3_frame_setnopframe(mvFrame);
+    
+    for (int level = 1; level <= self.numLevels; level++) {
+      MVV3Frame *levelFrame = maxvid_v3_file_frame(levelFramesArrays[level - 1], frameNum);
+      MVV3Frame *prevLevelFrame = maxvid_v3_file_frame(levelFramesArrays[level - 1], frameNum-1);
+      *levelFrame = *prevLevelFrame;
+      levelFrame->adler = 0;
+      levelFrame->duration = 0;
+      maxvid_v3_frame_setnopframe(levelFrame);
+    }
   } else {
-    MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
-    MVFrame *prevMvFrame = &(((MVFrame*)mvFramesArray)[frameNum-1]);
+    MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
+    MVFrame *prevMvFrame = [self mvFrameAtIndex:frameNum-1];
     
     maxvid_frame_setoffset(mvFrame, maxvid_frame_offset(prevMvFrame));
     maxvid_frame_setlength(mvFrame, maxvid_frame_length(prevMvFrame));
@@ -267,7 +394,11 @@
   
   // Note that an adler is not generated for a no-op frame
   
+  BOOL worked = [self appendStats:MV_STATS_NOPFRAME ptr:NULL bufferSize:0 isCompressed:FALSE];
+  
   frameNum++;
+  
+  return worked;
 }
 
 #if MV_ENABLE_DELTAS
@@ -277,17 +408,25 @@
 // first frame is constructed by applying a frame delta to an
 // all black framebuffer.
 
-- (void) writeInitialNopFrame
+- (BOOL) writeInitialNopFrame
 {
 #ifdef LOGGING
   NSLog(@"writeInitialNopFrame %d", frameNum);
 #endif // LOGGING
   
   NSAssert(frameNum == 0, @"initial nop frame must be first frame");
-  NSAssert(frameNum < self.totalNumFrames, @"totalNumFrames");
+  
+  if (self.numLevels != 0) {
+    NSLog(@"error: initial nop frame can't be written to \"%@\" with levels", self.mvidPath);
+    return FALSE;
+  }
+  
+  if ([self reserveFrame] == FALSE) {
+    return FALSE;
+  }
   
   if (self.genV3) {
-    MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
+    MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
     
     maxvid_v3_frame_setoffset(mvFrame, 0);
     maxvid_v3_frame_setlength(mvFrame, 0);
@@ -304,7 +443,7 @@
     
     mvFrame->adler = 0xFFFFFFFF;
   } else {
-    MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
+    MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
     
     maxvid_frame_setoffset(mvFrame, 0);
     maxvid_frame_setlength(mvFrame, 0);
@@ -322,7 +461,11 @@
     mvFrame->adler = 0xFFFFFFFF;
   }
   
+  BOOL worked = [self appendStats:MV_STATS_NOPFRAME ptr:NULL bufferSize:0 isCompressed:FALSE];
+  
   frameNum++;
+  
+  return worked;
 }
 
 #endif // MV_ENABLE_DELTAS
@@ -339,28 +482,335 @@
   }
 }
 
-- (void) writeTrailingNopFrames:(float)currentFrameDuration
+- (BOOL) writeTrailingNopFrames:(float)currentFrameDuration
 {
+  if (self.genFrameDurations) {
+    NSAssert(frameNum > 0, @"no frame written before duration");
+    MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum-1];
+    uint32_t duration = (uint32_t) round(currentFrameDuration * 1000000.0);
+    if (duration == 0) {
+      duration = 1;
+    }
+    maxvid_v3_frame_setduration(mvFrame, duration);
+    return TRUE;
+  }
+  
   int count = [self.class countTrailingNopFrames:currentFrameDuration frameDuration:self.frameDuration];
   
   if (count > 0) {
     for (; count; count--) {
-      [self writeNopFrame];
+      if ([self writeNopFrame] == FALSE) {
+        return FALSE;
+      }
     }
   }
+  
+  return TRUE;
+}
+
+// Return the frame table entry for the frame at index. In streaming mode
+// only a window of the most recent entries is kept in memory.
+
+- (MVFrame*) mvFrameAtIndex:(int)index
+{
+  NSAssert(index >= framesArrayBase && index < (framesArrayBase + framesArrayCapacity), @"frame %d not in memory", index);
+  return &(((MVFrame*)mvFramesArray)[index - framesArrayBase]);
+}
+
+- (MVV3Frame*) mvV3FrameAtIndex:(int)index
+{
+  NSAssert(index >= framesArrayBase && index < (framesArrayBase + framesArrayCapacity), @"frame %d not in memory", index);
+  return &(((MVV3Frame*)mvFramesArray)[index - framesArrayBase]);
+}
+
+// Make sure that the frame table entry for frameNum is in memory before a
+// frame is written. In streaming mode, a full window of entries is appended
+// to a temp file except for the last entry since a nop frame copies the
+// entry of the previous frame. Memory use does not depend on the number
+// of frames written. Returns FALSE when the temp file can't be written.
+
+- (BOOL) reserveFrame
+{
+  if (self.isStreaming == FALSE) {
+    NSAssert(frameNum < self.totalNumFrames, @"totalNumFrames");
+    return TRUE;
+  }
+  
+  if ((frameNum - framesArrayBase) < framesArrayCapacity) {
+    return TRUE;
+  }
+  
+  uint32_t frameNumBytes = self.genV3 ? sizeof(MVV3Frame) : sizeof(MVFrame);
+  int numToSpill = framesArrayCapacity - 1;
+  
+  if (framesSpillFile == NULL) {
+    framesSpillFile = tmpfile();
+    
+    if (framesSpillFile == NULL) {
+      NSLog(@"error: can't create a temp file for the frame table of \"%@\"", self.mvidPath);
+      return FALSE;
+    }
+  }
+  
+  size_t size = fwrite(mvFramesArray, frameNumBytes * numToSpill, 1, framesSpillFile);
+  
+  if (size != 1) {
+    NSLog(@"error: can't write the frame table of \"%@\" to a temp file", self.mvidPath);
+    return FALSE;
+  }
+  
+  char *framesBytes = (char*) mvFramesArray;
+  memmove(framesBytes, framesBytes + (frameNumBytes * numToSpill), frameNumBytes);
+  memset(framesBytes + frameNumBytes, 0, frameNumBytes * numToSpill);
+  
+  framesArrayBase += numToSpill;
+  
+  return TRUE;
+}
+
+// In streaming mode, append the frame table and the trailer after the last frame.
+// The frame table begins on a double word bound so that a mapped MVV3Frame is
+// aligned, see MVFileTrailer.
+
+- (BOOL) writeFramesAtEnd
+{
+  off_t framesOffset = (off_t) maxvid_writer_offset(maxvidOutWriter);
+  
+  if ((framesOffset % 8) != 0) {
+    uint32_t numPadding = 8 - (uint32_t)(framesOffset % 8);
+    if (maxvid_writer_pad(maxvidOutWriter, numPadding) != 0) {
+      return FALSE;
+    }
+    framesOffset += numPadding;
+  }
+  
+  if (self.genV3) {
+    // Nop
+  } else {
+    NSAssert(framesOffset < 0xFFFFFFFF, @"frames offset must fit into 32 bits, got %qd", framesOffset);
+  }
+  
+  // Copy entries that were written to the temp file, then the entries in memory
+  
+  if (framesSpillFile) {
+    char buffer[MV_PAGESIZE];
+    size_t numRead;
+    
+    rewind(framesSpillFile);
+    
+    while ((numRead = fread(buffer, 1, sizeof(buffer), framesSpillFile)) > 0) {
+      if (maxvid_writer_write(maxvidOutWriter, buffer, (uint32_t)numRead) != 0) {
+        return FALSE;
+      }
+    }
+  }
+  
+  uint32_t frameNumBytes = self.genV3 ? sizeof(MVV3Frame) : sizeof(MVFrame);
+  int numInMemory = frameNum - framesArrayBase;
+  
+  if (numInMemory > 0) {
+    if (maxvid_writer_write(maxvidOutWriter, mvFramesArray, frameNumBytes * numInMemory) != 0) {
+      return FALSE;
+    }
+  }
+  
+  MVFileTrailer trailer;
+  trailer.framesOffset = framesOffset;
+  trailer.numFrames = frameNum;
+  trailer.magic = MV_FILE_TRAILER_MAGIC;
+  
+  if (maxvid_writer_write(maxvidOutWriter, &trailer, sizeof(MVFileTrailer)) != 0) {
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
+// Scale the frame that was just written for each level and write the level
+// frame. The level pixels of a keyframe are written as a keyframe of that level.
+// For a delta frame, the difference from the previous level pixels is written
+// as a delta frame of that level, or a nop frame when no scaled pixel changed
+// or a keyframe when every scaled pixel changed. Each level keyframe begins on
+// a page bound, like a keyframe of the full size level.
+
+- (BOOL) writeLevelFrames:(const void*)pixels isKeyframe:(BOOL)isKeyframe
+{
+  for (int level = 1; level <= self.numLevels; level++) {
+    MVScale *scale = &levelScales[level - 1];
+    
+    // A level buffer holds an even number of pixels so that the keyframe length
+    // is the same as a keyframe written from a CGFrameBuffer.
+    
+    if (levelPixels[level - 1] == NULL) {
+      uint32_t status = maxvid_scale_init(scale, (uint32_t)self.movieSize.width, (uint32_t)self.movieSize.height,
+                                          self.bpp, level, MV_SCALE_BOX);
+      if (status != 0) {
+        return FALSE;
+      }
+      
+      levelPixels[level - 1] = calloc(1, maxvid_scale_num_bytes(scale) + sizeof(uint32_t));
+      levelPrevPixels[level - 1] = calloc(1, maxvid_scale_num_bytes(scale) + sizeof(uint32_t));
+      if (levelPixels[level - 1] == NULL || levelPrevPixels[level - 1] == NULL) {
+        return FALSE;
+      }
+    }
+    
+    void *outPixels = levelPixels[level - 1];
+    void *prevPixels = levelPrevPixels[level - 1];
+    
+    maxvid_scale_keyframe(scale, outPixels, pixels);
+    
+    const uint32_t width = scale->scaledWidth;
+    const uint32_t height = scale->scaledHeight;
+    uint32_t numPixels = width * height;
+    uint32_t numBytes = (numPixels + (numPixels & 0x1)) * ((scale->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+    
+    MVV3Frame *levelFrame = maxvid_v3_file_frame(levelFramesArrays[level - 1], frameNum);
+    
+    BOOL isLevelKeyframe = isKeyframe;
+    NSMutableData *mC4Data = nil;
+    
+    if (isKeyframe == FALSE) {
+      NSAssert(frameNum != 0, @"delta frame can't be first frame");
+      
+      BOOL emitKeyframeAnyway = FALSE;
+      NSData *codes;
+      
+      if (scale->bpp == 16) {
+        codes = maxvid_encode_generic_delta_pixels16(prevPixels, outPixels, numPixels, width, height, &emitKeyframeAnyway, 0);
+      } else {
+        codes = maxvid_encode_generic_delta_pixels32(prevPixels, outPixels, numPixels, width, height, &emitKeyframeAnyway, 0);
+      }
+      
+      if (emitKeyframeAnyway) {
+        isLevelKeyframe = TRUE;
+      } else if (codes == nil) {
+        // The scaled pixels did not change, write a nop frame like writeNopFrame
+        
+        MVV3Frame *prevLevelFrame = maxvid_v3_file_frame(levelFramesArrays[level - 1], frameNum-1);
+        *levelFrame = *prevLevelFrame;
+        levelFrame->adler = 0;
+        levelFrame->duration = 0;
+        maxvid_v3_frame_setnopframe(levelFrame);
+        continue;
+      } else {
+        uint32_t *maxvidCodeBuffer = (uint32_t*)codes.bytes;
+        uint32_t numMaxvidCodeWords = (uint32_t) (codes.length / sizeof(uint32_t));
+        uint32_t status;
+        
+        mC4Data = [NSMutableData dataWithCapacity:numBytes];
+        
+        if (scale->bpp == 16) {
+          status = maxvid_encode_c4_sample16(maxvidCodeBuffer, numMaxvidCodeWords, numPixels, mC4Data, 0);
+        } else {
+          status = maxvid_encode_c4_sample32(maxvidCodeBuffer, numMaxvidCodeWords, numPixels, mC4Data, 0);
+        }
+        
+        if (status != 0) {
+          return FALSE;
+        }
+      }
+    }
+    
+    // A level keyframe written after a delta frame does not begin on a page bound yet
+    
+    if (isLevelKeyframe) {
+      offset = [self paddingAfterKeyframe:maxvidOutWriter offset:offset];
+    }
+    
+    off_t levelOffset = (off_t) maxvid_writer_offset(maxvidOutWriter);
+    
+    if (isLevelKeyframe) {
+      if (maxvid_writer_write(maxvidOutWriter, outPixels, numBytes) != 0) {
+        return FALSE;
+      }
+      
+      maxvid_v3_frame_setoffset(levelFrame, levelOffset);
+      maxvid_v3_frame_setlength(levelFrame, numBytes);
+      maxvid_v3_frame_setkeyframe(levelFrame);
+      
+      offset = [self paddingAfterKeyframe:maxvidOutWriter offset:(levelOffset + numBytes)];
+    } else {
+      if (maxvid_writer_write(maxvidOutWriter, mC4Data.bytes, (uint32_t)mC4Data.length) != 0) {
+        return FALSE;
+      }
+      
+      maxvid_v3_frame_setoffset(levelFrame, levelOffset);
+      maxvid_v3_frame_setlength(levelFrame, (uint32_t)mC4Data.length);
+      
+      offset = (off_t) maxvid_writer_offset(maxvidOutWriter);
+    }
+    
+    // The adler is calculated from the level pixels that the decoder will produce
+    
+    if (self.genAdler) {
+      levelFrame->adler = maxvid_adler32(0, (unsigned char*)outPixels, numBytes);
+    }
+    
+    // The level pixels just written are the previous pixels of the next frame
+    
+    levelPixels[level - 1] = prevPixels;
+    levelPrevPixels[level - 1] = outPixels;
+  }
+  
+  return TRUE;
+}
+
+// Append the level table followed by the frame table of each level after the
+// last frame, see MV_FILE_LEVELS. The display duration of a level frame is the
+// same as the full size frame.
+
+- (BOOL) writeLevelsAtEnd
+{
+  off_t levelsOffset = (off_t) maxvid_writer_offset(maxvidOutWriter);
+  
+  if ((levelsOffset % 8) != 0) {
+    uint32_t numPadding = 8 - (uint32_t)(levelsOffset % 8);
+    if (maxvid_writer_pad(maxvidOutWriter, numPadding) != 0) {
+      return FALSE;
+    }
+    levelsOffset += numPadding;
+  }
+  
+  uint32_t tableNumBytes = sizeof(MVV3Frame) * self.totalNumFrames;
+  uint64_t framesOffset = levelsOffset + (sizeof(MVLevel) * self.numLevels);
+  
+  for (int level = 1; level <= self.numLevels; level++) {
+    mvLevels[level - 1].framesOffset = framesOffset;
+    framesOffset += tableNumBytes;
+    
+    for (int i = 0; i < self.totalNumFrames; i++) {
+      MVV3Frame *levelFrame = maxvid_v3_file_frame(levelFramesArrays[level - 1], i);
+      levelFrame->duration = maxvid_v3_frame_duration([self mvV3FrameAtIndex:i]);
+    }
+  }
+  
+  if (maxvid_writer_write(maxvidOutWriter, mvLevels, sizeof(MVLevel) * self.numLevels) != 0) {
+    return FALSE;
+  }
+  
+  for (int level = 1; level <= self.numLevels; level++) {
+    if (maxvid_writer_write(maxvidOutWriter, levelFramesArrays[level - 1], tableNumBytes) != 0) {
+      return FALSE;
+    }
+  }
+  
+  mvHeader->numLevels = self.numLevels;
+  mvHeader->levelsOffset = levelsOffset;
+  
+  return TRUE;
 }
 
 // Store the current file offset
 
 - (void) saveOffset
 {
-  offset = ftello(maxvidOutFile);
-  NSAssert(offset != -1, @"ftello returned -1");
+  offset = (off_t) maxvid_writer_offset(maxvidOutWriter);
   
   if (self.genV3) {
     // Nop
   } else {
-    NSAssert(offset < 0xFFFFFFFF, @"ftello offset must fit into 32 bits, got %qd", offset);
+    NSAssert(offset < 0xFFFFFFFF, @"offset must fit into 32 bits, got %qd", offset);
   }
   
 #ifdef LOGGING
@@ -374,11 +824,17 @@
 // This method assumes that the offset was saved with an earlier call
 // to saveOffset
 
-- (void) skipToNextPageBound
+- (BOOL) skipToNextPageBound
 {
-  offset = [self paddingAfterKeyframe:maxvidOutFile offset:offset];
+  if (self.isHugePageAligned) {
+    offset = [self padding:maxvidOutWriter offset:offset boundSize:MV_HUGEPAGESIZE];
+  } else {
+    offset = [self paddingAfterKeyframe:maxvidOutWriter offset:offset];
+  }
  
-  NSAssert(frameNum < self.totalNumFrames, @"totalNumFrames");
+  if ([self reserveFrame] == FALSE) {
+    return FALSE;
+  }
   
   if (self.genV3) {
     // Write the total number of whole memory pages. Note that
@@ -396,7 +852,7 @@
     NSLog(@"skipToNextPageBound %d : next page offset %llu bytes or %d pages", frameNum, offset, numPages);
 #endif // LOGGING
     
-    MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
+    MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
     
     uint64_t fileOffset = (uint64_t)numPages * (uint64_t)MV_PAGESIZE;
     
@@ -405,11 +861,13 @@
   } else {
     // Without the V3 flag file offsets are limited to 32 bits
   
-    MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
+    MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
     
     maxvid_frame_setoffset(mvFrame, (uint32_t)offset);
     maxvid_frame_setkeyframe(mvFrame);
   }
+  
+  return TRUE;
 }
 
 - (BOOL) writeKeyframe:(char*)ptr bufferSize:(int)bufferSize
@@ -423,18 +881,18 @@
   NSLog(@"writeKeyframe %d : bufferSize %d : adler %08X", frameNum, bufferSize, adler);
 #endif // LOGGING
   
-  [self skipToNextPageBound];
+  if ([self skipToNextPageBound] == FALSE) {
+    return FALSE;
+  }
   
-  int numWritten = (int) fwrite(ptr, bufferSize, 1, maxvidOutFile);
+  uint32_t status = maxvid_writer_write(maxvidOutWriter, ptr, bufferSize);
   
-  if (numWritten != 1) {
+  if (status != 0) {
     return FALSE;
   } else {
     // Finish emitting frame data
     
     uint32_t length = [self validateFileOffset:TRUE];
-        
-    NSAssert(frameNum < self.totalNumFrames, @"totalNumFrames");
     
     NSAssert(length == bufferSize, @"length");
     
@@ -443,14 +901,14 @@
 #endif // LOGGING
     
     if (self.genV3) {
-      MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
+      MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
       maxvid_v3_frame_setlength(mvFrame, length);
       
       if (isCompressed) {
         maxvid_v3_frame_setcompressed(mvFrame);
       }
     } else {
-      MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
+      MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
       maxvid_frame_setlength(mvFrame, length);
     }
     
@@ -469,32 +927,42 @@
       // Set adler in frame
       
       if (self.genV3) {
-        MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
+        MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
         mvFrame->adler = calcAdler;
       } else {
-        MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
+        MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
         mvFrame->adler = calcAdler;
       }
     }
     
     // zero pad to next page bound
     
-    offset = [self paddingAfterKeyframe:maxvidOutFile offset:offset];
+    offset = [self paddingAfterKeyframe:maxvidOutWriter offset:offset];
     assert(offset > 0); // silence compiler/analyzer warning
     
+    if (self.numLevels > 0) {
+      NSAssert(isCompressed == FALSE, @"compressed keyframe can't be written with levels");
+      
+      if ([self writeLevelFrames:ptr isKeyframe:TRUE] == FALSE) {
+        return FALSE;
+      }
+    }
+    
 #ifdef LOGGING
     if (self.genV3) {
-      MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
+      MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
       NSLog(@"frame[%d] : offset %llu : length %u : adler %u", frameNum, maxvid_v3_frame_offset(mvFrame), maxvid_v3_frame_length(mvFrame),  mvFrame->adler);
     } else {
-      MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
+      MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
       NSLog(@"frame[%d] : offset %u : length %u : adler %u", frameNum, maxvid_frame_offset(mvFrame), maxvid_frame_length(mvFrame),  mvFrame->adler);
     }
 #endif // LOGGING
     
+    BOOL worked = [self appendStats:MV_STATS_KEYFRAME ptr:ptr bufferSize:bufferSize isCompressed:isCompressed];
+    
     frameNum++;
     
-    return TRUE;
+    return worked;
   }
 }
 
@@ -512,6 +980,12 @@
   mvHeader->frameDuration = self.frameDuration;
   assert(mvHeader->frameDuration > 0.0);
   
+  // In streaming mode, the number of frames is known once the last frame is written
+  
+  if (self.isStreaming) {
+    self.totalNumFrames = frameNum;
+  }
+  
   // The number of frames must always be at least 2 frames.
   
   NSAssert(self.totalNumFrames > 1, @"animation must have at least 2 frames, not %d", self.totalNumFrames);  
@@ -540,28 +1014,50 @@
   
 #endif // MV_ENABLE_DELTAS
   
-  (void)fseek(maxvidOutFile, 0L, SEEK_SET);
+  if (self.genFrameDurations) {
+    maxvid_file_set_frame_durations(mvHeader);
+  }
   
-  int numWritten = (int) fwrite(mvHeader, sizeof(MVFileHeader), 1, maxvidOutFile);
-  if (numWritten != 1) {
-    return FALSE;
+  if (self.genPalette) {
+    maxvid_file_set_palette(mvHeader);
   }
   
-  numWritten = (int) fwrite(mvFramesArray, framesArrayNumBytes, 1, maxvidOutFile);
-  if (numWritten != 1) {
+  if (self.isStreaming) {
+    maxvid_file_set_frames_at_end(mvHeader);
+    
+    if ([self writeFramesAtEnd] == FALSE) {
+      return FALSE;
+    }
+  }
+  
+  if (self.numLevels > 0) {
+    maxvid_file_set_levels(mvHeader);
+    
+    if ([self writeLevelsAtEnd] == FALSE) {
+      return FALSE;
+    }
+  }
+  
+  uint32_t status = maxvid_writer_rewrite(maxvidOutWriter, mvHeader, sizeof(MVFileHeader), 0);
+  if (status != 0) {
     return FALSE;
-  }  
+  }
+  
+  if (self.isStreaming == FALSE) {
+    status = maxvid_writer_rewrite(maxvidOutWriter, mvFramesArray, framesArrayNumBytes, sizeof(MVFileHeader));
+    if (status != 0) {
+      return FALSE;
+    }
+  }
   
   // Once all valid data and headers have been written, it is now safe to write the
   // file header magic number. This ensures that any threads reading the first word
   // of the file looking for a valid magic number will only ever get consistent
   // data in a read when a valid magic number is read.
   
-  (void)fseek(maxvidOutFile, 0L, SEEK_SET);
-  
   uint32_t magic = MV_FILE_MAGIC;
-  numWritten = (int) fwrite(&magic, sizeof(uint32_t), 1, maxvidOutFile);
-  if (numWritten != 1) {
+  status = maxvid_writer_rewrite(maxvidOutWriter, &magic, sizeof(uint32_t), 0);
+  if (status != 0) {
     return FALSE;
   }
   
@@ -571,26 +1067,38 @@
 // write delta frame, non-zero adler must be passed if adler is enabled
 
 - (BOOL) writeDeltaframe:(char*)ptr bufferSize:(int)bufferSize adler:(uint32_t)adler
+{
+  return [self writeDeltaframe:ptr bufferSize:bufferSize adler:adler pixels:NULL];
+}
+
+- (BOOL) writeDeltaframe:(char*)ptr bufferSize:(int)bufferSize adler:(uint32_t)adler pixels:(const void*)pixels
 {
 #ifdef LOGGING
   NSLog(@"writeDeltaframe %d : bufferSize %d", frameNum, bufferSize);
 #endif // LOGGING
     
+  if (self.numLevels != 0 && pixels == NULL) {
+    NSLog(@"error: delta frame %d can't be written to \"%@\" with levels without the pixels", frameNum, self.mvidPath);
+    return FALSE;
+  }
+  
   self.isAllKeyframes = FALSE;
   
+  if ([self reserveFrame] == FALSE) {
+    return FALSE;
+  }
+  
   [self saveOffset];
   
-  int numWritten = (int) fwrite(ptr, bufferSize, 1, maxvidOutFile);
+  uint32_t status = maxvid_writer_write(maxvidOutWriter, ptr, bufferSize);
   
-  if (numWritten != 1) {
+  if (status != 0) {
     return FALSE;
   } else {
     // Finish writing the frame data
-
-    NSAssert(frameNum < self.totalNumFrames, @"totalNumFrames");
     
     if (self.genV3) {
-      MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
+      MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
       
       // Note that offset must be saved before validateFileOffset is invoked
       
@@ -602,7 +1110,7 @@
       
       mvFrame->adler = adler;
     } else {
-      MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
+      MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
       
       // Note that offset must be saved before validateFileOffset is invoked
       
@@ -617,18 +1125,122 @@
     
 #ifdef LOGGING
     if (self.genV3) {
-      MVV3Frame *mvFrame = &(((MVV3Frame*)mvFramesArray)[frameNum]);
+      MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
       NSLog(@"frame[%d] : offset %llu : length %u : adler %u", frameNum, maxvid_v3_frame_offset(mvFrame), maxvid_v3_frame_length(mvFrame),  mvFrame->adler);
     } else {
-      MVFrame *mvFrame = &(((MVFrame*)mvFramesArray)[frameNum]);
+      MVFrame *mvFrame = [self mvFrameAtIndex:frameNum];
       NSLog(@"frame[%d] : offset %u : length %u : adler %u", frameNum, maxvid_frame_offset(mvFrame), maxvid_frame_length(mvFrame),  mvFrame->adler);
     }
 #endif // LOGGING
     
+    if (self.numLevels > 0) {
+      if ([self writeLevelFrames:pixels isKeyframe:FALSE] == FALSE) {
+        return FALSE;
+      }
+    }
+    
+    BOOL worked = [self appendStats:MV_STATS_DELTAFRAME ptr:ptr bufferSize:bufferSize isCompressed:FALSE];
+    
     frameNum++;
     
+    return worked;
+  }
+}
+
+// Encode the frame with maxvid_palette_encode() and write the palette frame.
+// A palette keyframe is decoded into the framebuffer, so it does not need to
+// begin on a page bound.
+
+- (BOOL) writePaletteFrame:(char*)ptr
+                 prevFrame:(char*)prevPtr
+                bufferSize:(int)bufferSize
+             tooManyColors:(BOOL*)tooManyColors
+{
+  NSAssert(self.genPalette, @"genPalette");
+  NSAssert(self.bpp != 16, @"palette frame requires 24 or 32 BPP pixels");
+#if MV_ENABLE_DELTAS
+  NSAssert(self.isDeltas == FALSE, @"palette frame can't be written with deltas");
+#endif // MV_ENABLE_DELTAS
+  
+  *tooManyColors = FALSE;
+  
+  const uint32_t numPixels = (uint32_t) (self.movieSize.width * self.movieSize.height);
+  
+  if (palette == NULL) {
+    palette = malloc(sizeof(MVPalette));
+    paletteWords = malloc(maxvid_palette_max_num_words(numPixels) * sizeof(uint32_t));
+    
+    if (palette == NULL || paletteWords == NULL) {
+      return FALSE;
+    }
+  }
+  
+  uint32_t numWords;
+  uint32_t status = maxvid_palette_encode(palette, (const uint32_t*)prevPtr, (const uint32_t*)ptr, numPixels, paletteWords, &numWords);
+  
+  if (status != 0) {
+    *tooManyColors = TRUE;
     return TRUE;
   }
+  
+  BOOL isKeyframe = (prevPtr == NULL);
+  
+  if (!isKeyframe && palette->numColors == 0) {
+    return [self writeNopFrame];
+  }
+  
+#ifdef LOGGING
+  NSLog(@"writePaletteFrame %d : %d colors : %d words : keyframe %d", frameNum, palette->numColors, numWords, isKeyframe);
+#endif // LOGGING
+  
+  if (!isKeyframe) {
+    self.isAllKeyframes = FALSE;
+  }
+  
+  if ([self reserveFrame] == FALSE) {
+    return FALSE;
+  }
+  
+  [self saveOffset];
+  
+  uint32_t numBytes = numWords * sizeof(uint32_t);
+  
+  status = maxvid_writer_write(maxvidOutWriter, paletteWords, numBytes);
+  
+  if (status != 0) {
+    return FALSE;
+  }
+  
+  MVV3Frame *mvFrame = [self mvV3FrameAtIndex:frameNum];
+  
+  // Note that offset must be saved before validateFileOffset is invoked
+  
+  maxvid_v3_frame_setoffset(mvFrame, offset);
+  
+  uint32_t length = [self validateFileOffset:isKeyframe];
+  
+  NSAssert(length == numBytes, @"length");
+  
+  maxvid_v3_frame_setlength(mvFrame, length);
+  maxvid_v3_frame_setpalette(mvFrame);
+  
+  if (isKeyframe) {
+    maxvid_v3_frame_setkeyframe(mvFrame);
+  }
+  
+  // The adler is calculated from the pixels that the decoder will produce
+  
+  if (self.genAdler) {
+    mvFrame->adler = maxvid_adler32(0, (unsigned char*)ptr, bufferSize);
+  }
+  
+  // The palette codes are not c4 codes, only the frame size is recorded
+  
+  BOOL worked = [self appendStats:(isKeyframe ? MV_STATS_KEYFRAME : MV_STATS_DELTAFRAME) ptr:(char*)paletteWords bufferSize:numBytes isCompressed:TRUE];
+  
+  frameNum++;
+  
+  return worked;
 }
 
 // Check the previous and current file offset and return the length
@@ -638,13 +1250,12 @@
 - (uint32_t) validateFileOffset:(BOOL)isKeyFrame
 {
   off_t offsetBefore = self->offset;
-  offset = ftello(maxvidOutFile);
-  NSAssert(offset != -1, @"ftello returned -1");
+  offset = (off_t) maxvid_writer_offset(maxvidOutWriter);
   
   if (self.genV3) {
     // nop
   } else {
-    NSAssert(offset < 0xFFFFFFFF, @"ftello offset must fit into 32 bits, got %qd", offset);
+    NSAssert(offset < 0xFFFFFFFF, @"offset must fit into 32 bits, got %qd", offset);
   }
   off_t lengthOff = offset - offsetBefore;
   assert(lengthOff < 0xFFFFFFFF);
@@ -671,11 +1282,10 @@
     if ((length % 4) != 0) {
       // Write a zero half-word to the file so that additional padding is in terms of whole words.
       uint16_t zeroHalfword = 0;
-      size_t size = fwrite(&zeroHalfword, sizeof(zeroHalfword), 1, maxvidOutFile);
-      assert(size == 1);
-      offset = ftello(maxvidOutFile);
-      NSAssert(offset != -1, @"ftello returned -1");
-      NSAssert(offset < 0xFFFFFFFF, @"ftello offset must fit into 32 bits, got %qd", offset);
+      uint32_t status = maxvid_writer_write(maxvidOutWriter, &zeroHalfword, sizeof(zeroHalfword));
+      assert(status == 0);
+      offset = (off_t) maxvid_writer_offset(maxvidOutWriter);
+      NSAssert(offset < 0xFFFFFFFF, @"offset must fit into 32 bits, got %qd", offset);
       // Note that length is not recalculated. If a delta frame appears after this
       // one, it must begin on a word bound. The frame length ignores the halfword padding.
       //length = ...;
@@ -687,4 +1297,80 @@
   return length;
 }
 
+// Record stats for the frame that was just written. For an uncompressed
+// delta frame the c4 codes are walked to count each type of code. Returns
+// FALSE when the codes are invalid or the stats can't be grown.
+
+- (BOOL) appendStats:(MV_STATS_FRAME_TYPE)frameType
+                 ptr:(char*)ptr
+          bufferSize:(int)bufferSize
+        isCompressed:(BOOL)isCompressed
+{
+  if (m_stats == NULL) {
+    return TRUE;
+  }
+  
+  MVFrameStats frameStats;
+  maxvid_frame_stats_init(&frameStats, frameNum, frameType);
+  
+  frameStats.numBytes = bufferSize;
+  
+  CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+  frameStats.encodeTime = now - frameStartTime;
+  frameStartTime = now;
+  
+  if ((frameType == MV_STATS_DELTAFRAME) && (isCompressed == FALSE)) {
+    const uint32_t *inputBuffer32 = (const uint32_t *) ptr;
+    const uint32_t inputBuffer32NumWords = bufferSize / sizeof(uint32_t);
+    const uint32_t frameBufferNumPixels = (uint32_t) (self.movieSize.width * self.movieSize.height);
+    uint32_t status;
+    
+    if (self.bpp == 16) {
+      status = maxvid_frame_stats_count_c4_codes16(&frameStats, inputBuffer32, inputBuffer32NumWords, frameBufferNumPixels);
+    } else {
+      status = maxvid_frame_stats_count_c4_codes32(&frameStats, inputBuffer32, inputBuffer32NumWords, frameBufferNumPixels);
+    }
+    
+    if (status != 0) {
+      NSLog(@"error: invalid c4 codes in delta frame %d of \"%@\"", frameNum, self.mvidPath);
+      return FALSE;
+    }
+  }
+  
+  uint32_t status = maxvid_file_stats_append(m_stats, &frameStats);
+  
+  if (status != 0) {
+    NSLog(@"error: can't append stats for frame %d of \"%@\"", frameNum, self.mvidPath);
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
+- (BOOL) writeStatsJSON:(NSString*)path emitFrames:(BOOL)emitFrames
+{
+  NSAssert(self.genStats, @"genStats");
+  
+  if (m_stats == NULL) {
+    return FALSE;
+  }
+  
+  m_stats->width = self.movieSize.width;
+  m_stats->height = self.movieSize.height;
+  m_stats->bpp = self.bpp;
+  
+  FILE *outFile = fopen((char*)[path UTF8String], "w");
+  if (outFile == NULL) {
+    return FALSE;
+  }
+  
+  uint32_t status = maxvid_file_stats_write_json(outFile, m_stats, emitFrames);
+  
+  if (fclose(outFile) != 0) {
+    status = MV_ERROR_CODE_WRITE_FAILED;
+  }
+  
+  return (status == 0);
+}
+
 @end
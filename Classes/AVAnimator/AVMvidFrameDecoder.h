@@ -24,6 +24,7 @@
   NSString *m_filePath;
   MVFileHeader m_mvHeader;
   void *m_mvFrames;
+  double *m_frameStartTimes;
   BOOL m_isOpen;
   
 #if defined(USE_SEGMENTED_MMAP)
@@ -52,6 +53,10 @@
 #endif // REGRESSION_TESTS
   
   BOOL m_upgradeFromV1;
+  BOOL m_validateInput;
+  NSUInteger m_numFrameBuffers;
+  CGSize m_displaySize;
+  uint32_t m_level;
 }
 
 @property (nonatomic, copy) NSString *filePath;
@@ -76,6 +81,34 @@
 
 @property (nonatomic, assign) BOOL upgradeFromV1;
 
+// This property must be set before the file is opened when the
+// .mvid comes from a source that can't be trusted, for example
+// a file downloaded at runtime. The header and frame table are
+// validated against the file size when opened and each delta
+// frame is decoded with bounds checks, see maxvid_validate.h.
+
+@property (nonatomic, assign) BOOL validateInput;
+
+// The number of framebuffers frames are decoded into, 3 by default. A frame
+// holds on to its framebuffer until the frame is released, so a caller that
+// holds on to N decoded frames at once must set this to at least N + 2.
+// Additional framebuffers are allocated on the next decode when this
+// value is increased.
+
+@property (nonatomic, assign) NSUInteger numFrameBuffers;
+
+// The size in pixels the frames will be displayed at, CGSizeZero by default.
+// When set before the file is opened and the file contains reduced size levels,
+// see MV_FILE_LEVELS, the smallest level that is at least this large is read
+// instead of the full size frames. The width and height then return the size
+// of that level.
+
+@property (nonatomic, assign) CGSize displaySize;
+
+// The level that was read when the file was opened, 0 for the full size frames
+
+@property (nonatomic, readonly) uint32_t level;
+
 + (AVMvidFrameDecoder*) aVMvidFrameDecoder;
 
 // Open resource identified by path
@@ -94,6 +127,14 @@
 
 - (AVFrame*) advanceToFrame:(NSUInteger)newFrameIndex;
 
+// Continue decoding from a copy of the pixels of the frame at newFrameIndex,
+// saved from the currentFrameBuffer after that frame was decoded earlier.
+// The pixels are copied into a framebuffer of the decoder and the frame is
+// returned as if advanceToFrame had decoded it, so that advanceToFrame can
+// go on to the frames after it without decoding from the keyframe again.
+
+- (AVFrame*) restartAtFrame:(NSUInteger)newFrameIndex frameBuffer:(CGFrameBuffer*)frameBuffer;
+
 // Decoding frames may require additional resources that are not required
 // to open the file and examine the header contents. This method will
 // allocate decoding resources that are required to actually decode the
@@ -139,6 +180,27 @@
 
 - (BOOL) isAllKeyframes;
 
+// Index of the last keyframe at or before frameIndex, decoding forward from this
+// frame gets to frameIndex without the frames before it. Nop frames are
+// never returned since they depend on the frame before.
+
+- (NSUInteger) keyframeIndexAtOrBefore:(NSUInteger)frameIndex;
+
+// True when each frame has its own display duration, see MV_FILE_FRAME_DURATIONS.
+// Otherwise each frame is displayed for frameDuration.
+
+- (BOOL) hasFrameDurations;
+
+// Time from the start of the movie when the frame is displayed. Pass numFrames
+// to get the total duration of the movie.
+
+- (NSTimeInterval) frameStartTime:(NSUInteger)frameIndex;
+
+// Index of the frame displayed at a time from the start of the movie, found
+// with a binary search of the frame start times.
+
+- (NSUInteger) frameIndexAtTime:(NSTimeInterval)time;
+
 #if MV_ENABLE_DELTAS
 
 // If the mvid file was created with the -deltas encoding
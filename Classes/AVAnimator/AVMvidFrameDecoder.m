@@ -13,6 +13,12 @@
 
 #import "maxvid_file.h"
 
+#include "maxvid_validate.h"
+
+#include "maxvid_palette.h"
+
+#include <sys/stat.h>
+
 #import "AVAssetConvertCommon.h"
 
 //#define LOGGING
@@ -74,6 +80,10 @@
 #endif // REGRESSION_TESTS
 
 @synthesize upgradeFromV1 = m_upgradeFromV1;
+@synthesize validateInput = m_validateInput;
+@synthesize numFrameBuffers = m_numFrameBuffers;
+@synthesize displaySize = m_displaySize;
+@synthesize level = m_level;
 
 - (void) dealloc
 {
@@ -84,6 +94,11 @@
     self->m_mvFrames = NULL;
   }
   
+  if (self->m_frameStartTimes) {
+    free(self->m_frameStartTimes);
+    self->m_frameStartTimes = NULL;
+  }
+  
   self.filePath = nil;
   self.mappedData = nil;
   self.currentFrameBuffer = nil;
@@ -135,6 +150,7 @@
   if ((self = [super init]) != nil) {
     self->frameIndex = -1;
     self->m_resourceUsageLimit = TRUE;
+    self->m_numFrameBuffers = 3;
   }
   return self;
 }
@@ -161,7 +177,7 @@
 {
   // create buffers used for loading image data
   
-  if (self.cgFrameBuffers != nil) {
+  if (self.cgFrameBuffers != nil && self.cgFrameBuffers.count >= self.numFrameBuffers) {
     // Already allocated the frame buffers
     return;
   }
@@ -173,11 +189,21 @@
 
   uint32_t bitsPerPixel = [self header]->bpp;
   
-  CGFrameBuffer *cgFrameBuffer1 = [CGFrameBuffer cGFrameBufferWithBppDimensions:bitsPerPixel width:renderWidth height:renderHeight];
-  CGFrameBuffer *cgFrameBuffer2 = [CGFrameBuffer cGFrameBufferWithBppDimensions:bitsPerPixel width:renderWidth height:renderHeight];
-  CGFrameBuffer *cgFrameBuffer3 = [CGFrameBuffer cGFrameBufferWithBppDimensions:bitsPerPixel width:renderWidth height:renderHeight];
+  // Framebuffers that were allocated already are kept, they could be in use
+  
+  NSMutableArray *cgFrameBuffers = [NSMutableArray array];
+  if (self.cgFrameBuffers != nil) {
+    [cgFrameBuffers addObjectsFromArray:self.cgFrameBuffers];
+  }
+  
+  while (cgFrameBuffers.count < self.numFrameBuffers) {
+    CGFrameBuffer *cgFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:bitsPerPixel width:renderWidth height:renderHeight];
+    [cgFrameBuffers addObject:cgFrameBuffer];
+  }
+  
+  self.cgFrameBuffers = cgFrameBuffers;
   
-  self.cgFrameBuffers = [NSArray arrayWithObjects:cgFrameBuffer1, cgFrameBuffer2, cgFrameBuffer3, nil];
+  CGFrameBuffer *cgFrameBuffer1 = [cgFrameBuffers objectAtIndex:0];
   
   // Double check size assumptions
   
@@ -283,6 +309,23 @@
     worked = FALSE;
   }
   
+  // An untrusted header is checked before any field is used, so that an
+  // invalid file is reported as an open failure instead of an assert.
+  
+  off_t fileNumBytes = 0;
+  
+  if (worked && self.validateInput) {
+    struct stat fileStat;
+    if (fstat(fileno(fp), &fileStat) != 0) {
+      worked = FALSE;
+    } else {
+      fileNumBytes = fileStat.st_size;
+    }
+    
+    if (worked && maxvid_file_validate_header(hPtr, fileNumBytes) != 0) {
+      worked = FALSE;
+    }
+  }
   
   if (worked) {
     uint32_t magic = hPtr->magic;
@@ -316,6 +359,90 @@
     }
   }
   
+  // The frame table immediately follows the header, unless the file was written
+  // in streaming mode. In that case the trailer at the end of the file contains
+  // the offset of the frame table.
+  
+  off_t framesOffset = sizeof(MVFileHeader);
+  
+  self->m_level = 0;
+  
+  // When a reduced size level matches the display size, the cached header is
+  // changed to the size of the level and the frame table of the level is read.
+  
+  if (worked && maxvid_file_is_levels(hPtr) && !CGSizeEqualToSize(self.displaySize, CGSizeZero)) {
+    MVLevel levels[MV_FILE_MAX_LEVELS];
+    
+    if (hPtr->numLevels > MV_FILE_MAX_LEVELS || fseeko(fp, (off_t)hPtr->levelsOffset, SEEK_SET) != 0) {
+      worked = FALSE;
+    }
+    
+    if (worked) {
+      int numRead = (int) fread(levels, sizeof(MVLevel) * hPtr->numLevels, 1, fp);
+      if (numRead != 1) {
+        worked = FALSE;
+      }
+    }
+    
+    if (worked && self.validateInput) {
+      if (maxvid_file_validate_levels(hPtr, levels, fileNumBytes) != 0) {
+        worked = FALSE;
+      }
+    }
+    
+    if (worked) {
+      uint32_t level = maxvid_file_select_level(hPtr, levels,
+                                                (uint32_t) self.displaySize.width,
+                                                (uint32_t) self.displaySize.height);
+      
+      if (level > 0) {
+        MVLevel *mvLevel = &levels[level - 1];
+        hPtr->width = mvLevel->width;
+        hPtr->height = mvLevel->height;
+        framesOffset = (off_t) mvLevel->framesOffset;
+        self->m_level = level;
+      }
+      
+      if (fseeko(fp, framesOffset, SEEK_SET) != 0) {
+        worked = FALSE;
+      }
+    }
+  }
+  
+  if (worked && maxvid_file_is_frames_at_end(hPtr)) {
+    MVFileTrailer trailer;
+    
+    if (fseeko(fp, -((off_t)sizeof(MVFileTrailer)), SEEK_END) != 0) {
+      worked = FALSE;
+    }
+    
+    if (worked) {
+      int numRead = (int) fread(&trailer, sizeof(MVFileTrailer), 1, fp);
+      if (numRead != 1) {
+        worked = FALSE;
+      }
+    }
+    
+    if (worked) {
+      if (self.validateInput) {
+        if (maxvid_file_validate_trailer(hPtr, &trailer, fileNumBytes) != 0) {
+          worked = FALSE;
+        }
+      } else if (trailer.magic != MV_FILE_TRAILER_MAGIC || trailer.numFrames != hPtr->numFrames) {
+        // Reading the trailer worked, but the file was not finalized correctly
+        worked = FALSE;
+      }
+    }
+    
+    if (worked) {
+      framesOffset = (off_t) trailer.framesOffset;
+      
+      if (fseeko(fp, framesOffset, SEEK_SET) != 0) {
+        worked = FALSE;
+      }
+    }
+  }
+  
   if (worked) {
     // Read array of MVFrame objects into dynamically allocated array.
     
@@ -346,6 +473,29 @@
         worked = FALSE;
       }      
     }    
+    
+    if (worked && self.validateInput) {
+      if (maxvid_file_validate(hPtr, self->m_mvFrames, framesOffset, fileNumBytes) != 0) {
+        worked = FALSE;
+      }
+    }
+    
+    // Frame start times are calculated once so that a time can be mapped
+    // to a frame with a binary search.
+    
+    if (worked) {
+      if (self->m_frameStartTimes) {
+        free(self->m_frameStartTimes);
+      }
+      
+      self->m_frameStartTimes = malloc(sizeof(double) * (numFrames + 1));
+      
+      if (self->m_frameStartTimes == NULL) {
+        worked = FALSE;
+      } else {
+        maxvid_file_frame_start_times(hPtr, self->m_mvFrames, self->m_frameStartTimes);
+      }
+    }
   }
   
   fclose(fp);
@@ -765,6 +915,7 @@
 #endif // EXTRA_CHECKS
       
       int isCompressedFrame = 0;
+      int isPaletteFrame = 0;
       
       // Calculate offset where frame starts and length of frame
       off_t frameStartOffset;
@@ -776,6 +927,7 @@
         uint32_t numBytes = maxvid_v3_frame_length(frame);
         
         isCompressedFrame = maxvid_v3_frame_iscompressed(frame);
+        isPaletteFrame = maxvid_v3_frame_ispalette(frame);
         
         if (isCompressedFrame) {
 #if defined(HAS_LIB_COMPRESSION_API)
@@ -852,6 +1004,35 @@
         // recent frame that was successfully decoded.
         
         frameIndex -= 1;
+      } else if (isPaletteFrame) {
+        // Input buffer is a palette keyframe or a palette delta frame, the
+        // indexes are expanded straight into the 32 bit framebuffer.
+        
+        changeFrameData = TRUE;
+        
+        if (!isDeltaFrame) {
+          [nextFrameBuffer doneZeroCopyPixels];
+        }
+        
+        uint32_t *frameBuffer32 = (uint32_t*)nextFrameBuffer.pixels;
+#ifdef EXTRA_CHECKS
+        NSAssert(frameBuffer32, @"frameBuffer32");
+        NSAssert(bpp != 16, @"palette frame requires 24 or 32 BPP pixels");
+#endif // EXTRA_CHECKS
+        
+        // Each code is checked as it is decoded, an invalid frame is not
+        // correct but no memory outside of the framebuffer is touched.
+        
+        uint32_t status = maxvid_palette_decode(frameBuffer32, inputBuffer32, inputBuffer32NumBytes >> 2, frameBufferSize);
+        
+        if (status != 0) {
+          NSLog(@"invalid palette frame %d in %@", actualFrameIndex, [self.filePath lastPathComponent]);
+        }
+        NSAssert(self.validateInput || status == 0, @"status");
+        
+#if defined(EXTRA_CHECKS) || defined(ALWAYS_CHECK_ADLER)
+        [self assertSameAdler:frame->adler frameBuffer:frameBuffer32 frameBufferNumBytes:frameBufferNumBytes];
+#endif // EXTRA_CHECKS || ALWAYS_CHECK_ADLER
       } else if (isDeltaFrame) {
         // Apply delta from input buffer over the existing framebuffer
 
@@ -906,12 +1087,26 @@
         
 #endif // MV_ENABLE_DELTAS
         
-        if (bpp == 16) {
-          status = maxvid_decode_c4_sample16(frameBuffer, actualInputBuffer32, inputBuffer32NumWords, frameBufferSize);
+        if (self.validateInput) {
+          // An invalid delta stops at the first bad code, so the frame is
+          // not correct but no memory outside of the framebuffer is touched.
+          
+          if (bpp == 16) {
+            status = maxvid_decode_c4_sample16_validated(frameBuffer, actualInputBuffer32, inputBuffer32NumWords, frameBufferSize);
+          } else {
+            status = maxvid_decode_c4_sample32_validated(frameBuffer, actualInputBuffer32, inputBuffer32NumWords, frameBufferSize);
+          }
+          if (status != 0) {
+            NSLog(@"invalid delta frame %d in %@", actualFrameIndex, [self.filePath lastPathComponent]);
+          }
         } else {
-          status = maxvid_decode_c4_sample32(frameBuffer, actualInputBuffer32, inputBuffer32NumWords, frameBufferSize);
+          if (bpp == 16) {
+            status = maxvid_decode_c4_sample16(frameBuffer, actualInputBuffer32, inputBuffer32NumWords, frameBufferSize);
+          } else {
+            status = maxvid_decode_c4_sample32(frameBuffer, actualInputBuffer32, inputBuffer32NumWords, frameBufferSize);
+          }
+          NSAssert(status == 0, @"status");
         }
-        NSAssert(status == 0, @"status");
         
 #if defined(EXTRA_CHECKS) || defined(ALWAYS_CHECK_ADLER)
         // Mvid file verison 0 would calculate a delta checksum and not include zero padding pixels
@@ -1087,6 +1282,31 @@
   }
 }
 
+- (AVFrame*) restartAtFrame:(NSUInteger)newFrameIndex frameBuffer:(CGFrameBuffer*)frameBuffer
+{
+  NSAssert(newFrameIndex < [self numFrames], @"%@: %d", @"can't restart past last frame", (int) newFrameIndex);
+  
+  [self rewind];
+  
+  CGFrameBuffer *nextFrameBuffer = [self _getNextFramebuffer];
+  
+  [nextFrameBuffer memcopyPixels:frameBuffer];
+  
+  self.currentFrameBuffer = nextFrameBuffer;
+  frameIndex = (int) newFrameIndex;
+  
+  AVFrame *frame = [AVFrame aVFrame];
+  NSAssert(frame, @"AVFrame is nil");
+  
+  frame.cgFrameBuffer = nextFrameBuffer;
+  
+  [frame makeImageFromFramebuffer];
+  
+  self.lastFrame = frame;
+  
+  return frame;
+}
+
 - (AVFrame*) duplicateCurrentFrame
 {
   if (self.currentFrameBuffer == nil) {
@@ -1222,6 +1442,57 @@
   }
 }
 
+- (NSUInteger) keyframeIndexAtOrBefore:(NSUInteger)frameIndex
+{
+  NSAssert(frameIndex < [self numFrames], @"frameIndex");
+  
+#if MV_ENABLE_DELTAS
+  if ([self isDeltas]) {
+    // Every frame is a delta from the frame before it
+    return 0;
+  }
+#endif // MV_ENABLE_DELTAS
+  
+  int isV3 = (maxvid_file_version([self header]) == MV_FILE_VERSION_THREE);
+  
+  for (NSUInteger i = frameIndex; i > 0; i--) {
+    if (isV3) {
+      MVV3Frame *frame = maxvid_v3_file_frame(self->m_mvFrames, (uint32_t)i);
+      if (!maxvid_v3_frame_isnopframe(frame) && maxvid_v3_frame_iskeyframe(frame)) {
+        return i;
+      }
+    } else {
+      MVFrame *frame = maxvid_file_frame(self->m_mvFrames, (uint32_t)i);
+      if (!maxvid_frame_isnopframe(frame) && maxvid_frame_iskeyframe(frame)) {
+        return i;
+      }
+    }
+  }
+  
+  return 0;
+}
+
+- (BOOL) hasFrameDurations
+{
+  uint32_t isCond = maxvid_file_is_frame_durations([self header]);
+  if (isCond) {
+    return TRUE;
+  } else {
+    return FALSE;
+  }
+}
+
+- (NSTimeInterval) frameStartTime:(NSUInteger)frameIndex
+{
+  NSAssert(frameIndex <= [self numFrames], @"frameIndex");
+  return self->m_frameStartTimes[frameIndex];
+}
+
+- (NSUInteger) frameIndexAtTime:(NSTimeInterval)time
+{
+  return maxvid_file_frame_at_time(self->m_frameStartTimes, (uint32_t) [self numFrames], time);
+}
+
 - (NSString*) description
 {
   return [NSString stringWithFormat:@"AVMvidFrameDecoder %p, file %@, isOpen %d, isMapped %d, w/h %d x %d, numFrames %d",
@@ -0,0 +1,80 @@
+//
+//  AVMvidFrameSource.h
+//
+//  License terms defined in License.txt.
+//
+//  This protocol defines a source of video frames that can be converted to
+//  a .mvid file with AVFrameSourceConvertMaxvid. A source only decodes frames,
+//  the converter handles the stages common to all formats, detecting an alpha
+//  channel, calculating deltas, compression, and writing the file. Frames are
+//  pulled from the source one at a time and each frame is decoded straight
+//  into a framebuffer owned by the converter, so the source need not keep a
+//  framebuffer of its own.
+
+#import <Foundation/Foundation.h>
+
+#import <QuartzCore/QuartzCore.h>
+
+#include "maxvid_decode.h"
+
+@class CGFrameBuffer;
+
+// Returned by readFrame when there are no more frames
+
+#define AV_FRAME_SOURCE_END_OF_STREAM 0x80
+
+typedef struct {
+  // Display time of the frame in seconds, or 0 when the frame is displayed
+  // for the frame duration of the source.
+  float duration;
+  // The region of the frame that can differ from the previous frame. When
+  // the rect is empty, the frame is the same as the previous frame and the
+  // framebuffer was not written.
+  CGRect dirtyRect;
+} AVMvidFrameSourceInfo;
+
+@protocol AVMvidFrameSource <NSObject>
+
+// Open the source, once open the frame size and duration are known.
+// Return TRUE if successful, FALSE otherwise.
+
+- (BOOL) openFrameSource;
+
+// Release decode resources, invoked once all frames are read or on error.
+
+- (void) closeFrameSource;
+
+- (CGSize) frameSourceSize;
+
+// The shortest duration of a frame in seconds
+
+- (NSTimeInterval) frameSourceFrameDuration;
+
+// The number of frames, or 0 when not known until all frames are read
+
+- (NSUInteger) frameSourceNumFrames;
+
+// 24 or 32, or 0 when the converter should scan the pixels of each frame
+// for an alpha channel.
+
+- (uint32_t) frameSourceBpp;
+
+// Decode the next frame into frameBuffer as premultiplied BGRA pixels. The
+// framebuffer is the size of the output movie, this can be larger or smaller
+// than the source. This method can be invoked from a secondary thread, but
+// only one frame is read at a time. Return 0 on success,
+// AV_FRAME_SOURCE_END_OF_STREAM after the last frame, otherwise an
+// error code like MV_ERROR_CODE_READ_FAILED.
+
+- (uint32_t) readFrame:(CGFrameBuffer*)frameBuffer info:(AVMvidFrameSourceInfo*)info;
+
+@optional
+
+// TRUE when readFrame can report a duration other than 0. The converter then
+// stores the duration of each frame, or writes in streaming mode when the
+// output is not a V3 file, since a frame table of frameSourceNumFrames
+// entries has no room for the nop frames that would stand in for the duration.
+
+- (BOOL) frameSourceHasFrameDurations;
+
+@end
@@ -0,0 +1,71 @@
+//
+//  AVReverseFrameCache.h
+//
+//  License terms defined in License.txt.
+//
+//  This class returns the frames of a .mvid file with delta frames in reverse
+//  order without decoding every frame from the start of the movie for each
+//  frame. A window of up to numCachedFrames frames that ends at the requested
+//  frame is decoded forward, starting at the nearest keyframe, and the decoded
+//  frames are held so that the frames before the requested frame in the window
+//  are returned without another decode. When a frame before the window is
+//  requested, the next window is decoded. Each frame holds a framebuffer, so
+//  the number of framebuffers in the decoder is raised to hold the window.
+//
+//  While decoding forward to the start of a window, a copy of the pixels of
+//  some frames is saved as a checkpoint and the next window is decoded from the
+//  nearest checkpoint instead of the keyframe. The checkpoints are placed so
+//  that each later window starts right after one, so playing a movie backwards
+//  decodes each frame about twice instead of about N / (2 * numCachedFrames)
+//  times. Half of the free checkpoints are used for each window, so when the
+//  keyframes are more than maxNumCheckpoints windows apart a frame is decoded
+//  a few more times but the cost still does not grow with N squared.
+
+#import <Foundation/Foundation.h>
+
+@class AVMvidFrameDecoder;
+@class AVFrame;
+
+@interface AVReverseFrameCache : NSObject {
+@private
+  AVMvidFrameDecoder *m_frameDecoder;
+  NSMutableArray *m_frames;
+  NSUInteger m_firstFrameIndex;
+  NSUInteger m_numCachedFrames;
+  NSUInteger m_numFramesDecoded;
+  NSMutableArray *m_checkpointIndexes;
+  NSMutableArray *m_checkpointFrameBuffers;
+  NSMutableArray *m_spareFrameBuffers;
+  NSUInteger m_maxNumCheckpoints;
+}
+
+@property (nonatomic, readonly) AVMvidFrameDecoder *frameDecoder;
+
+// Max number of decoded frames held at once
+
+@property (nonatomic, readonly) NSUInteger numCachedFrames;
+
+// Max number of checkpoint framebuffers held at once, 16 by default. Each
+// checkpoint is a full size framebuffer, set to 0 to disable checkpoints.
+
+@property (nonatomic, assign) NSUInteger maxNumCheckpoints;
+
+// Number of frames decoded so far, including the frames from a keyframe to
+// the start of a window.
+
+@property (nonatomic, readonly) NSUInteger numFramesDecoded;
+
++ (AVReverseFrameCache*) aVReverseFrameCache:(AVMvidFrameDecoder*)frameDecoder
+                             numCachedFrames:(NSUInteger)numCachedFrames;
+
+// Return the frame at frameIndex, the cached frames after frameIndex are released.
+// The returned frame is flagged as a duplicate when it is a duplicate of the
+// frame before it in the movie, not the frame returned by the previous call.
+
+- (AVFrame*) frameAtIndex:(NSUInteger)frameIndex;
+
+// Release all cached frames and checkpoints
+
+- (void) flush;
+
+@end
@@ -0,0 +1,225 @@
+//
+//  AVReverseFrameCache.m
+//
+//  License terms defined in License.txt.
+
+#import "AVReverseFrameCache.h"
+
+#import "AVMvidFrameDecoder.h"
+
+#import "AVFrame.h"
+
+#import "CGFrameBuffer.h"
+
+@implementation AVReverseFrameCache
+
+@synthesize frameDecoder = m_frameDecoder;
+@synthesize numCachedFrames = m_numCachedFrames;
+@synthesize numFramesDecoded = m_numFramesDecoded;
+@synthesize maxNumCheckpoints = m_maxNumCheckpoints;
+
++ (AVReverseFrameCache*) aVReverseFrameCache:(AVMvidFrameDecoder*)frameDecoder
+                             numCachedFrames:(NSUInteger)numCachedFrames
+{
+  NSAssert(frameDecoder != nil, @"frameDecoder");
+  NSAssert(numCachedFrames > 0, @"numCachedFrames");
+
+  AVReverseFrameCache *obj = [[AVReverseFrameCache alloc] init];
+
+#if __has_feature(objc_arc)
+  obj->m_frameDecoder = frameDecoder;
+  obj->m_frames = [NSMutableArray array];
+  obj->m_checkpointIndexes = [NSMutableArray array];
+  obj->m_checkpointFrameBuffers = [NSMutableArray array];
+  obj->m_spareFrameBuffers = [NSMutableArray array];
+#else
+  obj->m_frameDecoder = [frameDecoder retain];
+  obj->m_frames = [[NSMutableArray alloc] init];
+  obj->m_checkpointIndexes = [[NSMutableArray alloc] init];
+  obj->m_checkpointFrameBuffers = [[NSMutableArray alloc] init];
+  obj->m_spareFrameBuffers = [[NSMutableArray alloc] init];
+#endif // objc_arc
+
+  obj->m_numCachedFrames = numCachedFrames;
+  obj->m_maxNumCheckpoints = 16;
+
+  // The renderer and the previous frame can hold on to frames that were
+  // released from the window, in addition to the 2 the decoder needs.
+
+  if (frameDecoder.numFrameBuffers < (numCachedFrames + 4)) {
+    frameDecoder.numFrameBuffers = numCachedFrames + 4;
+  }
+
+#if __has_feature(objc_arc)
+  return obj;
+#else
+  return [obj autorelease];
+#endif // objc_arc
+}
+
+- (void) dealloc
+{
+#if __has_feature(objc_arc)
+#else
+  [m_frameDecoder release];
+  [m_frames release];
+  [m_checkpointIndexes release];
+  [m_checkpointFrameBuffers release];
+  [m_spareFrameBuffers release];
+  [super dealloc];
+#endif // objc_arc
+}
+
+- (void) flush
+{
+  [m_frames removeAllObjects];
+  [m_checkpointIndexes removeAllObjects];
+  [m_checkpointFrameBuffers removeAllObjects];
+  [m_spareFrameBuffers removeAllObjects];
+}
+
+// Drop the checkpoints at or after frameIndex, the framebuffers are kept
+// so that the next checkpoints can reuse them.
+
+- (void) _dropCheckpointsFrom:(NSUInteger)frameIndex
+{
+  while (m_checkpointIndexes.count > 0) {
+    NSUInteger lastIndex = [[m_checkpointIndexes lastObject] unsignedIntegerValue];
+    if (lastIndex < frameIndex) {
+      break;
+    }
+    [m_spareFrameBuffers addObject:[m_checkpointFrameBuffers lastObject]];
+    [m_checkpointIndexes removeLastObject];
+    [m_checkpointFrameBuffers removeLastObject];
+  }
+}
+
+// Save a copy of the pixels the decoder just decoded for frameIndex
+
+- (void) _saveCheckpoint:(NSUInteger)frameIndex
+{
+  CGFrameBuffer *currentFrameBuffer = self.frameDecoder.currentFrameBuffer;
+  NSAssert(currentFrameBuffer != nil, @"currentFrameBuffer");
+  
+  CGFrameBuffer *cgFrameBuffer = [m_spareFrameBuffers lastObject];
+  
+  if (cgFrameBuffer != nil) {
+#if __has_feature(objc_arc)
+#else
+    [[cgFrameBuffer retain] autorelease];
+#endif // objc_arc
+    [m_spareFrameBuffers removeLastObject];
+  } else {
+    cgFrameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:currentFrameBuffer.bitsPerPixel
+                                                            width:currentFrameBuffer.width
+                                                           height:currentFrameBuffer.height];
+    NSAssert(cgFrameBuffer != nil, @"cGFrameBufferWithBppDimensions");
+  }
+  
+  [cgFrameBuffer memcopyPixels:currentFrameBuffer];
+  
+  [m_checkpointIndexes addObject:[NSNumber numberWithUnsignedInteger:frameIndex]];
+  [m_checkpointFrameBuffers addObject:cgFrameBuffer];
+}
+
+- (AVFrame*) frameAtIndex:(NSUInteger)frameIndex
+{
+  NSUInteger numFrames = m_frames.count;
+
+  if (numFrames > 0 && frameIndex >= m_firstFrameIndex && frameIndex < (m_firstFrameIndex + numFrames)) {
+    // The frames after this one will not be requested again, release them so
+    // that their framebuffers can be reused.
+
+    NSUInteger offset = frameIndex - m_firstFrameIndex;
+    [m_frames removeObjectsInRange:NSMakeRange(offset + 1, numFrames - (offset + 1))];
+    return [m_frames lastObject];
+  }
+
+  [m_frames removeAllObjects];
+
+  // Decode the window that ends at frameIndex, the window does not extend
+  // back past the keyframe since decoding has to start there anyway.
+
+  AVMvidFrameDecoder *frameDecoder = self.frameDecoder;
+
+  NSUInteger keyframeIndex = [frameDecoder keyframeIndexAtOrBefore:frameIndex];
+  NSUInteger startIndex = keyframeIndex;
+
+  if ((frameIndex - keyframeIndex + 1) > m_numCachedFrames) {
+    startIndex = frameIndex - m_numCachedFrames + 1;
+  }
+
+  // The decoder can only go forward, it continues from the current frame when
+  // that frame is between the keyframe and the start of the window.
+
+  NSInteger decodedIndex = frameDecoder.frameIndex;
+
+  if (decodedIndex < (NSInteger)keyframeIndex || decodedIndex > (NSInteger)startIndex) {
+    [frameDecoder rewind];
+    decodedIndex = (NSInteger)keyframeIndex - 1;
+  }
+
+  // Restart from the last checkpoint before the window when it is closer than
+  // the decoder. The frame at startIndex is still decoded so that it is flagged
+  // as a duplicate in the same way as when decoding from the keyframe.
+
+  [self _dropCheckpointsFrom:startIndex];
+
+  if (m_checkpointIndexes.count > 0) {
+    NSUInteger checkpointIndex = [[m_checkpointIndexes lastObject] unsignedIntegerValue];
+
+    if ((NSInteger)checkpointIndex > decodedIndex) {
+      AVFrame *frame = [frameDecoder restartAtFrame:checkpointIndex frameBuffer:[m_checkpointFrameBuffers lastObject]];
+      NSAssert(frame != nil, @"restartAtFrame");
+      decodedIndex = (NSInteger)checkpointIndex;
+    }
+  }
+
+  // The next windows end at startIndex - 1, startIndex - 1 - numCachedFrames and
+  // so on. Save the frame just before each of those windows, or every Nth one
+  // when there are not enough free checkpoints. Only half of the free
+  // checkpoints are used so that the gaps between them can be filled in
+  // when the windows get to them.
+
+  NSUInteger stride = 0;
+  NSUInteger numFree = 0;
+
+  if (m_maxNumCheckpoints > m_checkpointIndexes.count) {
+    numFree = (m_maxNumCheckpoints - m_checkpointIndexes.count + 1) / 2;
+  }
+
+  if (numFree > 0 && (NSInteger)startIndex >= (decodedIndex + 2)) {
+    NSUInteger numWindows = (startIndex - (NSUInteger)(decodedIndex + 2)) / m_numCachedFrames;
+    if (numWindows > 0) {
+      stride = m_numCachedFrames * ((numWindows + numFree - 1) / numFree);
+    }
+  }
+
+  for (NSUInteger i = (NSUInteger)(decodedIndex + 1); i < startIndex; i++) {
+    @autoreleasepool {
+      AVFrame *frame = [frameDecoder advanceToFrame:i];
+      NSAssert(frame != nil, @"advanceToFrame");
+
+      NSUInteger distance = startIndex - 1 - i;
+
+      if (stride > 0 && distance > 0 && (distance % stride) == 0) {
+        [self _saveCheckpoint:i];
+      }
+    }
+  }
+
+  for (NSUInteger i = startIndex; i <= frameIndex; i++) {
+    @autoreleasepool {
+      AVFrame *frame = [frameDecoder advanceToFrame:i];
+      NSAssert(frame != nil, @"advanceToFrame");
+      [m_frames addObject:frame];
+    }
+  }
+
+  m_numFramesDecoded += frameIndex - decodedIndex;
+  m_firstFrameIndex = startIndex;
+
+  return [m_frames lastObject];
+}
+
+@end
@@ -0,0 +1,63 @@
+//
+//  AVY4MConvertMaxvid.h
+//
+//  License terms defined in License.txt.
+//
+//  This module implements a Y4M to MVID converter that does not depend on
+//  AVFoundation. Video is decoded by an external tool and read as YUV4MPEG2
+//  or raw I420 frames from a file or a pipe, see maxvid_y4m.h. The same
+//  conversion stages as the AVAsset loaders are supported, an RGB video can
+//  be joined with a separate alpha video, or a mixed video where RGB and
+//  alpha frames alternate can be unmixed. The output is written as keyframes
+//  or as delta frames, so the whole alpha video ingest path can be run and
+//  measured from the command line, see Tools/mvidy4m.m. The genDeltas and
+//  encodeFlags properties are defined in AVFrameSourceConvertMaxvid.
+
+#import "AVFrameSourceConvertMaxvid.h"
+
+#import "maxvid_y4m.h"
+
+@interface AVY4MConvertMaxvid : AVFrameSourceConvertMaxvid {
+@private
+  NSString *m_inputPath;
+  NSString *m_alphaPath;
+  CGSize m_rawSize;
+  MVYUVMatrix m_matrix;
+  BOOL m_isMixedAlpha;
+}
+
+// Path of the Y4M input, "-" reads from stdin
+
+@property (nonatomic, copy) NSString *inputPath;
+
+// Path of the Y4M alpha video to join with the input, nil by default. The Y
+// plane of each alpha frame is the alpha channel, it can be a mono stream.
+
+@property (nonatomic, copy) NSString *alphaPath;
+
+// When not zero, the inputs are raw I420 frames of this size instead of Y4M.
+// The frameDuration property must then be set, a Y4M input sets it from the
+// frame rate in the stream header when it is not already set.
+
+@property (nonatomic, assign) CGSize rawSize;
+
+// BT.601 by default, Y4M has no way to indicate the matrix
+
+@property (nonatomic, assign) MVYUVMatrix matrix;
+
+// FALSE by default, set to TRUE when the input frames alternate between an
+// RGB frame and the alpha frame for it.
+
+@property (nonatomic, assign) BOOL isMixedAlpha;
+
++ (AVY4MConvertMaxvid*) aVY4MConvertMaxvid;
+
+// This method is a blocking call that will read frames from the input and
+// write the output as a .mvid file. The number of frames need not be known
+// up front, so the file is written in streaming mode. Frames are converted
+// from YUV in a secondary thread while the previous frame is encoded.
+// Return TRUE if successful, FALSE otherwise.
+
+- (BOOL) blockingConvert;
+
+@end
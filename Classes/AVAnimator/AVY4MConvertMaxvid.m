@@ -0,0 +1,310 @@
+//
+//  AVY4MConvertMaxvid.m
+//
+//  License terms defined in License.txt.
+
+#import "AVY4MConvertMaxvid.h"
+
+#import "CGFrameBuffer.h"
+
+#include <fcntl.h>
+
+#if __has_feature(objc_arc)
+#else
+#import "AutoPropertyRelease.h"
+#endif // objc_arc
+
+//#define LOGGING
+
+// Frame source that reads Y4M or raw I420 frames and converts each frame,
+// joined with the alpha frame for it, to BGRA pixels.
+
+@interface AVY4MFrameSource : NSObject <AVMvidFrameSource> {
+@private
+  NSString *m_inputPath;
+  NSString *m_alphaPath;
+  CGSize m_rawSize;
+  MVYUVMatrix m_matrix;
+  BOOL m_isMixedAlpha;
+  MVY4MReader m_reader;
+  MVY4MReader m_alphaReader;
+  MVY4MFrame m_frame;
+  MVY4MFrame m_alphaFrame;
+  MVYUVCoefficients m_coefficients;
+}
+
+@property (nonatomic, copy) NSString *inputPath;
+
+@property (nonatomic, copy) NSString *alphaPath;
+
+@property (nonatomic, assign) CGSize rawSize;
+
+@property (nonatomic, assign) MVYUVMatrix matrix;
+
+@property (nonatomic, assign) BOOL isMixedAlpha;
+
+@end
+
+@implementation AVY4MFrameSource
+
+@synthesize inputPath = m_inputPath;
+@synthesize alphaPath = m_alphaPath;
+@synthesize rawSize = m_rawSize;
+@synthesize matrix = m_matrix;
+@synthesize isMixedAlpha = m_isMixedAlpha;
+
+- (void) dealloc
+{
+  [self closeFrameSource];
+
+#if __has_feature(objc_arc)
+#else
+  [AutoPropertyRelease releaseProperties:self thisClass:AVY4MFrameSource.class];
+  [super dealloc];
+#endif // objc_arc
+}
+
+- (id) init
+{
+  if ((self = [super init])) {
+    m_reader.fd = -1;
+    m_alphaReader.fd = -1;
+  }
+  return self;
+}
+
+- (BOOL) hasAlpha
+{
+  return (self.isMixedAlpha || (self.alphaPath != nil));
+}
+
+// Open the input at path and read the stream header, "-" is stdin
+
+- (BOOL) openReader:(MVY4MReader*)reader path:(NSString*)path
+{
+  int fd;
+
+  if ([path isEqualToString:@"-"]) {
+    fd = STDIN_FILENO;
+  } else {
+    fd = open([path UTF8String], O_RDONLY);
+  }
+
+  if (fd < 0) {
+    NSLog(@"error: cannot open Y4M input \"%@\"", path);
+    return FALSE;
+  }
+
+  uint32_t status;
+
+  if (CGSizeEqualToSize(self.rawSize, CGSizeZero)) {
+    status = maxvid_y4m_open(reader, fd);
+  } else {
+    status = maxvid_y4m_open_raw(reader, fd, (uint32_t) self.rawSize.width, (uint32_t) self.rawSize.height);
+  }
+
+  if (status != 0) {
+    NSLog(@"error: invalid Y4M header in \"%@\"", path);
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    reader->fd = -1;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
++ (void) closeReader:(MVY4MReader*)reader
+{
+  if (reader->fd >= 0 && reader->fd != STDIN_FILENO) {
+    close(reader->fd);
+  }
+  reader->fd = -1;
+}
+
+- (BOOL) openFrameSource
+{
+  NSAssert(self.inputPath, @"inputPath");
+  NSAssert(!(self.isMixedAlpha && self.alphaPath != nil), @"mixed alpha input can't also join an alpha input");
+
+  memset(&m_frame, 0, sizeof(m_frame));
+  memset(&m_alphaFrame, 0, sizeof(m_alphaFrame));
+
+  BOOL worked = [self openReader:&m_reader path:self.inputPath];
+  if (worked == FALSE) {
+    return FALSE;
+  }
+
+  if (self.alphaPath != nil) {
+    worked = [self openReader:&m_alphaReader path:self.alphaPath];
+    if (worked == FALSE) {
+      return FALSE;
+    }
+
+    if (m_alphaReader.width != m_reader.width || m_alphaReader.height != m_reader.height) {
+      NSLog(@"error: RGB movie size (%d, %d) does not match alpha movie size (%d, %d)",
+            (int)m_reader.width, (int)m_reader.height, (int)m_alphaReader.width, (int)m_alphaReader.height);
+      return FALSE;
+    }
+  }
+
+  if (maxvid_y4m_frame_alloc(&m_reader, &m_frame) != 0) {
+    return FALSE;
+  }
+
+  if (self.isMixedAlpha) {
+    if (maxvid_y4m_frame_alloc(&m_reader, &m_alphaFrame) != 0) {
+      return FALSE;
+    }
+  } else if (self.alphaPath != nil) {
+    if (maxvid_y4m_frame_alloc(&m_alphaReader, &m_alphaFrame) != 0) {
+      return FALSE;
+    }
+  }
+
+  if (maxvid_yuv_init(&m_coefficients, self.matrix, m_reader.range) != 0) {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+- (void) closeFrameSource
+{
+  maxvid_y4m_frame_free(&m_frame);
+  maxvid_y4m_frame_free(&m_alphaFrame);
+
+  [self.class closeReader:&m_reader];
+  [self.class closeReader:&m_alphaReader];
+}
+
+- (CGSize) frameSourceSize
+{
+  return CGSizeMake(m_reader.width, m_reader.height);
+}
+
+// The frame rate from the stream header, a raw input has no header
+
+- (NSTimeInterval) frameSourceFrameDuration
+{
+  if (m_reader.frameRateNum == 0) {
+    return 0.0;
+  }
+  return (double)m_reader.frameRateDen / m_reader.frameRateNum;
+}
+
+// A Y4M stream does not indicate the number of frames
+
+- (NSUInteger) frameSourceNumFrames
+{
+  return 0;
+}
+
+- (uint32_t) frameSourceBpp
+{
+  return [self hasAlpha] ? 32 : 24;
+}
+
+// Read the next RGB frame and the alpha frame for it, then convert to BGRA.
+
+- (uint32_t) readFrame:(CGFrameBuffer*)frameBuffer info:(AVMvidFrameSourceInfo*)info
+{
+  uint32_t status = maxvid_y4m_read_frame(&m_reader, &m_frame);
+  if (status == MV_Y4M_END_OF_STREAM) {
+    return AV_FRAME_SOURCE_END_OF_STREAM;
+  } else if (status != 0) {
+    return status;
+  }
+
+  if (self.isMixedAlpha) {
+    status = maxvid_y4m_read_frame(&m_reader, &m_alphaFrame);
+  } else if (self.alphaPath != nil) {
+    status = maxvid_y4m_read_frame(&m_alphaReader, &m_alphaFrame);
+  }
+
+  // The alpha input must not end before the RGB input
+
+  if (status == MV_Y4M_END_OF_STREAM) {
+    status = MV_ERROR_CODE_READ_FAILED;
+  }
+  if (status != 0) {
+    return status;
+  }
+
+  status = maxvid_y4m_frame_to_bgra(&m_frame, [self hasAlpha] ? &m_alphaFrame : NULL, &m_coefficients, (uint32_t*) frameBuffer.pixels);
+  if (status != 0) {
+    return status;
+  }
+
+  info->duration = 0.0f;
+  info->dirtyRect = CGRectMake(0, 0, m_reader.width, m_reader.height);
+
+  return 0;
+}
+
+@end
+
+@implementation AVY4MConvertMaxvid
+
+@synthesize inputPath = m_inputPath;
+@synthesize alphaPath = m_alphaPath;
+@synthesize rawSize = m_rawSize;
+@synthesize matrix = m_matrix;
+@synthesize isMixedAlpha = m_isMixedAlpha;
+
+- (void) dealloc
+{
+#if __has_feature(objc_arc)
+#else
+  [AutoPropertyRelease releaseProperties:self thisClass:AVY4MConvertMaxvid.class];
+  [super dealloc];
+#endif // objc_arc
+}
+
++ (AVY4MConvertMaxvid*) aVY4MConvertMaxvid
+{
+  AVY4MConvertMaxvid *obj = [[AVY4MConvertMaxvid alloc] init];
+  obj.genV3 = TRUE; // enable extended file size out to 64bit offsets
+  obj.matrix = MV_YUV_MATRIX_BT601;
+#if __has_feature(objc_arc)
+  return obj;
+#else
+  return [obj autorelease];
+#endif // objc_arc
+}
+
+- (BOOL) blockingConvert
+{
+  NSAssert(self.inputPath, @"inputPath");
+
+  AVY4MFrameSource *frameSource = [[AVY4MFrameSource alloc] init];
+
+#if __has_feature(objc_arc)
+#else
+  [frameSource autorelease];
+#endif // objc_arc
+
+  frameSource.inputPath = self.inputPath;
+  frameSource.alphaPath = self.alphaPath;
+  frameSource.rawSize = self.rawSize;
+  frameSource.matrix = self.matrix;
+  frameSource.isMixedAlpha = self.isMixedAlpha;
+
+  // The movie is always the size of the input
+
+  self.movieSize = CGSizeZero;
+  self.frameSource = frameSource;
+
+  BOOL worked = [super blockingConvert];
+
+  self.frameSource = nil;
+
+#ifdef LOGGING
+  NSLog(@"Y4M conversion of \"%@\" %@", self.inputPath, worked ? @"done" : @"failed");
+#endif // LOGGING
+
+  return worked;
+}
+
+@end
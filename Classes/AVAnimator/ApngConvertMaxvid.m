@@ -489,7 +489,9 @@ process_apng_frame(
   if (delta_x == 0 && delta_y == 0 && delta_width == 0 && delta_height == 0) {
     // The no-op delta case
 
-    [aVMvidFileWriter writeNopFrame];
+    if ([aVMvidFileWriter writeNopFrame] == FALSE) {
+      return WRITE_ERROR;
+    }
   } else {
     
     // Each pixel in the framebuffer must be prepared before it can be passed to the CoreGraphics framebuffer.
@@ -539,23 +541,35 @@ process_apng_frame(
     outPtr = userDataPtr->cgFrameBuffer;
 #endif // objc_arc
     
-    // Each frame is emitted as a keyframe
+    // Each frame is emitted as a keyframe, a palette APNG frame has at most
+    // 256 colors and is written as a palette keyframe.
     
-    BOOL worked = [aVMvidFileWriter writeKeyframe:(char*)outPtr bufferSize:framebufferNumBytes];
+    BOOL tooManyColors = FALSE;
+    
+    BOOL worked = [aVMvidFileWriter writePaletteFrame:(char*)outPtr
+                                            prevFrame:NULL
+                                           bufferSize:framebufferNumBytes
+                                        tooManyColors:&tooManyColors];
+    
+    if (worked && tooManyColors) {
+      worked = [aVMvidFileWriter writeKeyframe:(char*)outPtr bufferSize:framebufferNumBytes];
+    }
     
     if (worked == FALSE) {
       return WRITE_ERROR;
     }
   }
   
-  // When the delay after the frame is longer than 1 frame, emit trailing nop frames
+  // Store the delay after the frame as the frame duration
   
 #ifdef DEBUG_PRINT_FRAME_DURATION
   int numFramesDelay = round(frameDisplayTime / aVMvidFileWriter.frameDuration);
   fprintf(stdout, "frame delay after APNG frame %d is %d\n", framei, numFramesDelay);
 #endif
   
-  [aVMvidFileWriter writeTrailingNopFrames:frameDisplayTime];
+  if ([aVMvidFileWriter writeTrailingNopFrames:frameDisplayTime] == FALSE) {
+    return WRITE_ERROR;
+  }
     
   return 0;
 }
@@ -702,10 +716,16 @@ goto retcode; \
   
   aVMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
   
+  // Each APNG frame is written as one frame with its own duration, so that
+  // a long delay does not need to be filled in with nop frames.
+  
   aVMvidFileWriter.mvidPath = outMaxvidPath;
   aVMvidFileWriter.frameDuration = frameDuration;
-  aVMvidFileWriter.totalNumFrames = numOutputFrames;
+  aVMvidFileWriter.totalNumFrames = numApngFrames;
   aVMvidFileWriter.genAdler = genAdler;
+  aVMvidFileWriter.genV3 = TRUE;
+  aVMvidFileWriter.genFrameDurations = TRUE;
+  aVMvidFileWriter.genPalette = TRUE;
   
   BOOL worked = [aVMvidFileWriter open];
   
@@ -115,6 +115,12 @@
 
 - (void) memcopyPixels:(CGFrameBuffer *)anotherFrameBuffer;
 
+// Convert the pixels of another framebuffer with the same dimensions from 16 BPP
+// to 24 or 32 BPP, or from 24 or 32 BPP to 16 BPP, without going through
+// CoreGraphics. A 16 BPP result is dithered when dither is TRUE.
+
+- (void) convertPixels:(CGFrameBuffer *)anotherFrameBuffer dither:(BOOL)dither;
+
 // Zero copy from an external read-only location
 
 - (void) zeroCopyPixels:(void*)zeroCopyPtr mappedData:(NSData*)mappedData;
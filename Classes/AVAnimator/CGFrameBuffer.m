@@ -24,7 +24,12 @@
 // Using page copy makes a huge diff, 24 bpp goes from 15->20 FPS to 30 FPS!
 #define USE_MACH_VM_ALLOCATE 1
 
-#if defined(USE_ALIGNED_VALLOC) || defined(USE_MACH_VM_ALLOCATE)
+// Framebuffers are acquired from a shared pool so that the buffers of a movie that
+// has finished playing are reused by the next one, see maxvid_pool.h. Pool memory
+// is page aligned so page copy with vm_copy() works the same way.
+#define USE_FRAMEBUFFER_POOL 1
+
+#if defined(USE_ALIGNED_VALLOC) || defined(USE_MACH_VM_ALLOCATE) || defined(USE_FRAMEBUFFER_POOL)
 #import <unistd.h> // getpagesize()
 #endif
 
@@ -32,6 +37,14 @@
 #import <mach/mach.h>
 #endif
 
+#if defined(USE_FRAMEBUFFER_POOL)
+#import "maxvid_pool.h"
+#endif
+
+#import "maxvid_convert.h"
+
+#import "maxvid_blit.h"
+
 //#define DEBUG_LOGGING
 
 void CGFrameBufferProviderReleaseData (void *info, const void *data, size_t size);
@@ -129,7 +142,19 @@ void CGFrameBufferProviderReleaseData (void *info, const void *data, size_t size
 	char* buffer;
   size_t allocNumBytes;
   
-#if defined(USE_MACH_VM_ALLOCATE)
+#if defined(USE_FRAMEBUFFER_POOL)
+  // The pool block can be larger than the page rounded size, but only
+  // allocNumBytes is ever copied with vm_copy().
+  size_t pagesize = (size_t)getpagesize();
+  size_t numpages = (inNumBytes / pagesize);
+  if (inNumBytes % pagesize) {
+    numpages++;
+  }
+  allocNumBytes = numpages * pagesize;
+  
+  // Memory acquired from the pool is zeroed
+  buffer = (char*) maxvid_pool_acquire(inNumBytes);
+#elif defined(USE_MACH_VM_ALLOCATE)
   size_t pagesize = (size_t)getpagesize();
   size_t numpages = (inNumBytes / pagesize);
   if (inNumBytes % pagesize) {
@@ -201,7 +226,13 @@ void CGFrameBufferProviderReleaseData (void *info, const void *data, size_t size
     self->m_width = width;
     self->m_height = height;
   } else {
+#if defined(USE_FRAMEBUFFER_POOL)
+    maxvid_pool_release(buffer, inNumBytes);
+#elif defined(USE_MACH_VM_ALLOCATE)
+    vm_deallocate((vm_map_t) mach_task_self(), (vm_address_t) buffer, (vm_size_t) allocNumBytes);
+#else
     free(buffer);
+#endif
   }
 
 	return self;
@@ -637,10 +668,15 @@ void CGFrameBufferProviderReleaseData (void *info, const void *data, size_t size
     assert(0);
   }
 #else
-  // FIXME: add assert here to check num bytes
-  // FIXME: this code will not compile if USE_MACH_VM_ALLOCATE is not defined
-  memcpy(self->m_pixels, anotherFrameBufferPixelsPtr, anotherFrameBuffer.numBytes);
-#endif  
+  // Without Mach VM, the pixels are copied. The source is either the pixels of
+  // another framebuffer of the same size or a zero copy pointer to a keyframe
+  // in a mapped file, so numBytes can be read in both cases. See
+  // maxvid_framebuffer.h for page level copy on write without Mach VM. A
+  // frame larger than the cache share is written around the cache.
+
+  assert(srcPtr != NULL);
+  maxvid_blit_copy(self->m_pixels, srcPtr, self.numBytes);
+#endif
 }
 
 - (void) copyPixels:(CGFrameBuffer *)anotherFrameBuffer
@@ -688,7 +724,32 @@ void CGFrameBufferProviderReleaseData (void *info, const void *data, size_t size
     anotherFrameBufferPixelsPtr = anotherFrameBuffer.pixels;
   }
   
-  memcpy(self.pixels, anotherFrameBufferPixelsPtr, anotherFrameBuffer.numBytes);
+  // A multi MB frame is copied with non-temporal stores so that it does not
+  // evict the pixels and codes of other clips, see maxvid_blit.h.
+  
+  maxvid_blit_copy(self.pixels, anotherFrameBufferPixelsPtr, anotherFrameBuffer.numBytes);
+}
+
+- (void) convertPixels:(CGFrameBuffer *)anotherFrameBuffer dither:(BOOL)dither
+{
+  assert(self.width == anotherFrameBuffer.width);
+  assert(self.height == anotherFrameBuffer.height);
+  assert((self.bitsPerPixel == 16) != (anotherFrameBuffer.bitsPerPixel == 16));
+  
+  [self doneZeroCopyPixels];
+  
+  void *anotherFrameBufferPixelsPtr = anotherFrameBuffer.zeroCopyPixels;
+  if (anotherFrameBufferPixelsPtr == NULL) {
+    anotherFrameBufferPixelsPtr = anotherFrameBuffer.pixels;
+  }
+  
+  if (self.bitsPerPixel == 16) {
+    maxvid_convert_8888_to_555((uint16_t*)self.pixels, (const uint32_t*)anotherFrameBufferPixelsPtr,
+                               (uint32_t)self.width, (uint32_t)self.height, dither ? 1 : 0);
+  } else {
+    maxvid_convert_555_to_8888((uint32_t*)self.pixels, (const uint16_t*)anotherFrameBufferPixelsPtr,
+                               (uint32_t)(self.width * self.height));
+  }
 }
 
 // Copy the contents of the zero copy buffer to the allocated framebuffer and
@@ -751,7 +812,11 @@ void CGFrameBufferProviderReleaseData (void *info, const void *data, size_t size
 
 	self.colorspace = NULL;
   
-#if defined(USE_MACH_VM_ALLOCATE)
+#if defined(USE_FRAMEBUFFER_POOL)
+	if (self.pixels != NULL) {
+    maxvid_pool_release(self.pixels, self.numBytes);
+  }
+#elif defined(USE_MACH_VM_ALLOCATE)
 	if (self.pixels != NULL) {
     kern_return_t ret;
     ret = vm_deallocate((vm_map_t) mach_task_self(), (vm_address_t) self.pixels, (vm_size_t) self.numBytesAllocated);
@@ -0,0 +1,100 @@
+// maxvid_alpha module
+//
+//  License terms defined in License.txt.
+//
+// This module implements the join of RGB and alpha frames into premultiplied
+// BGRA pixels, see maxvid_alpha.h.
+
+#include "maxvid_alpha.h"
+
+#include "movdata.h"
+
+// All 3 components of the ALPHA pixel should be the same in grayscale mode.
+// If these are not exactly the same, this is likely caused by limited precision
+// ranges in the hardware color conversion logic.
+
+static inline
+uint32_t maxvid_alpha_from_gray(uint32_t pixelAlpha) {
+  uint32_t pixelAlphaRed = (pixelAlpha >> 16) & 0xFF;
+  uint32_t pixelAlphaGreen = (pixelAlpha >> 8) & 0xFF;
+  uint32_t pixelAlphaBlue = (pixelAlpha >> 0) & 0xFF;
+
+  if (pixelAlphaRed == pixelAlphaGreen && pixelAlphaRed == pixelAlphaBlue) {
+    // All values are equal, does not matter which channel we use as the alpha value
+    return pixelAlphaRed;
+  }
+
+  uint32_t sum = pixelAlphaRed + pixelAlphaGreen + pixelAlphaBlue;
+
+  if (sum == 1) {
+    // If two values are 0 and the other is 1, then assume the alpha value is zero. The iOS h264
+    // decoding hardware seems to emit (R=0 G=0 B=1) even when the input is a grayscale black pixel.
+    return 0;
+  } else if (sum == 2 && (pixelAlphaRed == 0 && pixelAlphaGreen == 2 && pixelAlphaBlue == 0)) {
+    // The h.264 decoder seems to generate (R=0 G=2 B=0) for black in some weird cases on ARM64.
+    return 0;
+#if defined(__arm64__) && __arm64__
+  } else if ((pixelAlphaRed == pixelAlphaBlue) && (pixelAlphaRed+1 == pixelAlphaGreen)) {
+    // The h.264 decoder in newer ARM64 devices seems to decode the grayscale values (2 2 2) as
+    // (1 2 1) in certain cases. Choose an output grayscale value of 2 in these cases only
+    // for this specific hardware decoder.
+    return pixelAlphaGreen;
+  } else if ((pixelAlphaRed == pixelAlphaBlue) && (pixelAlphaRed+2 == pixelAlphaGreen)) {
+    // The h.264 decoder in newer ARM64 devices seems to decode the grayscale values (3 3 3) as
+    // (2 4 2) in certain cases. Choose an output grayscale value of 3 in these cases only
+    // for this specific hardware decoder.
+    return pixelAlphaRed + 1;
+#endif // __arm64__
+  } else if (pixelAlphaRed == pixelAlphaBlue) {
+    // The R and B pixel values are equal but these two values are not the same as the G pixel.
+    // This indicates that the grayscale conversion should have resulted in value between the
+    // two numbers, for example (3 1 3) -> 2 and (219 218 219) -> 218.
+    return (pixelAlphaRed == 0) ? 0 : (pixelAlphaRed - 1);
+  } else {
+    // Common case seen in hardware decoder output is (62, 61, 63) -> 62, where the red
+    // component is the middle value. Other patterns do not seem to be emitted by the
+    // iOS H264 decoder hardware, the red component is basically the same there.
+    return pixelAlphaRed;
+  }
+}
+
+uint32_t
+maxvid_alpha_join_pixels(uint32_t *outPixels,
+                         const uint32_t *rgbPixels,
+                         const uint32_t * restrict alphaPixels,
+                         const uint32_t * restrict prevPixels,
+                         uint32_t numPixels)
+{
+  uint32_t numChanged = 0;
+
+  for (uint32_t pixeli = 0; pixeli < numPixels; pixeli++) {
+    uint32_t pixelAlpha = maxvid_alpha_from_gray(alphaPixels[pixeli]);
+    uint32_t pixelRGB = rgbPixels[pixeli];
+    uint32_t combinedPixel;
+
+    // Fully transparent and fully opaque pixels are most of an alpha matte,
+    // these need no table lookup.
+
+    if (pixelAlpha == 0) {
+      combinedPixel = 0;
+    } else if (pixelAlpha == 0xFF) {
+      combinedPixel = 0xFF000000 | pixelRGB;
+    } else {
+      // RGB componenets are 24 BPP non pre-multiplied values
+
+      uint32_t pixelRed = (pixelRGB >> 16) & 0xFF;
+      uint32_t pixelGreen = (pixelRGB >> 8) & 0xFF;
+      uint32_t pixelBlue = (pixelRGB >> 0) & 0xFF;
+
+      combinedPixel = premultiply_bgra_inline(pixelRed, pixelGreen, pixelBlue, pixelAlpha);
+    }
+
+    outPixels[pixeli] = combinedPixel;
+
+    if (prevPixels != NULL) {
+      numChanged += (prevPixels[pixeli] != combinedPixel);
+    }
+  }
+
+  return (prevPixels == NULL) ? numPixels : numChanged;
+}
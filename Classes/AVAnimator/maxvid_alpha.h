@@ -0,0 +1,36 @@
+// maxvid_alpha module
+//
+//  License terms defined in License.txt.
+//
+// This module implements the join of an RGB frame and a grayscale alpha frame
+// decoded from H.264 into premultiplied BGRA pixels. The alpha value of each
+// pixel is picked from the R, G, and B components of the alpha pixel, with
+// fixups for the off by one results the iOS hardware decoder emits for gray
+// pixels, then the RGB components are premultiplied.
+//
+// The join, the premultiply, and the compare to the previous output frame are
+// done in one pass over the pixels, so that a loader need not make a copy of
+// the RGB frame and then scan the result again to find the changed pixels.
+// The premultiply table must be set up with premultiply_init() first.
+
+#ifndef MAXVID_ALPHA_H
+#define MAXVID_ALPHA_H
+
+#include "maxvid_decode.h"
+
+// Join numPixels RGB pixels and alpha pixels into premultiplied BGRA pixels.
+// The RGB pixels are 24 bpp, so the high byte is ignored. outPixels can be the
+// same buffer as rgbPixels, so the RGB frame can be joined in place. When
+// prevPixels is not NULL, it is the previous output frame and the number of
+// output pixels that differ from it is returned. A return value of zero means
+// the frame can be written as a nop frame. When prevPixels is NULL, numPixels
+// is returned.
+
+uint32_t
+maxvid_alpha_join_pixels(uint32_t *outPixels,
+                         const uint32_t *rgbPixels,
+                         const uint32_t * restrict alphaPixels,
+                         const uint32_t * restrict prevPixels,
+                         uint32_t numPixels);
+
+#endif // MAXVID_ALPHA_H
@@ -0,0 +1,229 @@
+// maxvid_blit module
+//
+//  License terms defined in License.txt.
+//
+// This module implements wide fills and copies of framebuffer memory, see
+// maxvid_blit.h.
+
+#include "maxvid_blit.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif // __APPLE__
+
+typedef uint32_t MVBlitVec __attribute__((vector_size(16)));
+
+// A source vector is loaded with this type, it need not be 16 byte aligned
+
+typedef uint32_t MVBlitUnalignedVec __attribute__((vector_size(16), aligned(1)));
+
+#define MV_BLIT_VEC_NUM_WORDS (sizeof(MVBlitVec) / sizeof(uint32_t))
+
+// clang emits STNP on ARM64 and MOVNTDQ on x86 for a non-temporal store of
+// a vector. gcc has no such builtin, the SSE2 intrinsic is used on x86 and
+// other targets fall back to a regular store.
+
+#if defined(__clang__)
+# define MV_BLIT_STREAM_STORE(ptr, vec) __builtin_nontemporal_store((vec), (ptr))
+#elif defined(__SSE2__)
+# define MV_BLIT_STREAM_STORE(ptr, vec) _mm_stream_si128((__m128i *)(ptr), (__m128i)(vec))
+#else
+# define MV_BLIT_STREAM_STORE(ptr, vec) (*(ptr) = (vec))
+#endif
+
+// Non-temporal stores are weakly ordered, so they must be fenced before the
+// framebuffer is handed to another thread.
+
+static inline
+void maxvid_blit_stream_fence(void) {
+#if defined(__SSE2__)
+  _mm_sfence();
+#else
+  __sync_synchronize();
+#endif // __SSE2__
+}
+
+// The cache size is queried once by the first decoder thread that needs it.
+// A size set with maxvid_blit_set_stream_min_num_bytes() is kept apart so
+// that it can be changed and cleared at any time, 0 means not set.
+
+static pthread_once_t maxvidBlitStreamOnce = PTHREAD_ONCE_INIT;
+
+static size_t maxvidBlitStreamDefaultNumBytes = MV_BLIT_STREAM_DEFAULT_MIN_NUM_BYTES;
+
+static atomic_size_t maxvidBlitStreamNumBytes;
+
+// Return the size of the last level cache in bytes, or 0 if not known.
+// The sysconf cache names are glibc only, Darwin has sysctl names instead.
+
+static
+size_t maxvid_blit_llc_num_bytes(void) {
+#if defined(__APPLE__)
+  uint64_t numBytes = 0;
+  size_t size = sizeof(numBytes);
+  if (sysctlbyname("hw.l3cachesize", &numBytes, &size, NULL, 0) == 0 && numBytes > 0) {
+    return (size_t) numBytes;
+  }
+  numBytes = 0;
+  size = sizeof(numBytes);
+  if (sysctlbyname("hw.l2cachesize", &numBytes, &size, NULL, 0) == 0 && numBytes > 0) {
+    return (size_t) numBytes;
+  }
+#else
+  long numBytes = 0;
+# if defined(_SC_LEVEL3_CACHE_SIZE)
+  numBytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (numBytes > 0) {
+    return (size_t) numBytes;
+  }
+# endif // _SC_LEVEL3_CACHE_SIZE
+# if defined(_SC_LEVEL2_CACHE_SIZE)
+  numBytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (numBytes > 0) {
+    return (size_t) numBytes;
+  }
+# endif // _SC_LEVEL2_CACHE_SIZE
+  (void) numBytes;
+#endif // __APPLE__
+  return 0;
+}
+
+static
+void maxvid_blit_stream_init(void) {
+  size_t numBytes = maxvid_blit_llc_num_bytes() / 2;
+  if (numBytes > MV_BLIT_STREAM_DEFAULT_MIN_NUM_BYTES) {
+    maxvidBlitStreamDefaultNumBytes = numBytes;
+  }
+}
+
+size_t
+maxvid_blit_stream_min_num_bytes(void)
+{
+  size_t numBytes = atomic_load_explicit(&maxvidBlitStreamNumBytes, memory_order_relaxed);
+
+  if (numBytes != 0) {
+    return numBytes;
+  }
+
+  pthread_once(&maxvidBlitStreamOnce, maxvid_blit_stream_init);
+  return maxvidBlitStreamDefaultNumBytes;
+}
+
+void
+maxvid_blit_set_stream_min_num_bytes(size_t numBytes)
+{
+  atomic_store_explicit(&maxvidBlitStreamNumBytes, numBytes, memory_order_relaxed);
+}
+
+void
+maxvid_blit_fill32_wide(uint32_t * restrict ptr, const uint32_t word, const uint32_t numWords)
+{
+  uint32_t numLeft = numWords;
+
+  // Fill single words up to a 16 byte bound
+
+  while ((((uintptr_t) ptr) & (sizeof(MVBlitVec) - 1)) != 0 && numLeft > 0) {
+    *ptr++ = word;
+    numLeft--;
+  }
+
+  const MVBlitVec vec = { word, word, word, word };
+  MVBlitVec *vecPtr = (MVBlitVec *) ptr;
+  uint32_t numVecs = numLeft / MV_BLIT_VEC_NUM_WORDS;
+
+  // Store a 64 byte cache line per loop
+
+  if (((size_t)numWords * sizeof(uint32_t)) >= maxvid_blit_stream_min_num_bytes()) {
+    for ( ; numVecs >= 4; numVecs -= 4, vecPtr += 4) {
+      MV_BLIT_STREAM_STORE(&vecPtr[0], vec);
+      MV_BLIT_STREAM_STORE(&vecPtr[1], vec);
+      MV_BLIT_STREAM_STORE(&vecPtr[2], vec);
+      MV_BLIT_STREAM_STORE(&vecPtr[3], vec);
+    }
+    for ( ; numVecs > 0; numVecs--, vecPtr++) {
+      MV_BLIT_STREAM_STORE(vecPtr, vec);
+    }
+    maxvid_blit_stream_fence();
+  } else {
+    for ( ; numVecs >= 4; numVecs -= 4, vecPtr += 4) {
+      vecPtr[0] = vec;
+      vecPtr[1] = vec;
+      vecPtr[2] = vec;
+      vecPtr[3] = vec;
+    }
+    for ( ; numVecs > 0; numVecs--, vecPtr++) {
+      *vecPtr = vec;
+    }
+  }
+
+  // Fill the last 1 to 3 words
+
+  ptr = (uint32_t *) vecPtr;
+  numLeft &= (MV_BLIT_VEC_NUM_WORDS - 1);
+
+  while (numLeft > 0) {
+    *ptr++ = word;
+    numLeft--;
+  }
+}
+
+void
+maxvid_blit_copy(void * restrict dst, const void * restrict src, size_t numBytes)
+{
+  if (numBytes < maxvid_blit_stream_min_num_bytes()) {
+    memcpy(dst, src, numBytes);
+    return;
+  }
+
+  uint8_t *dstPtr = (uint8_t *) dst;
+  const uint8_t *srcPtr = (const uint8_t *) src;
+
+  // Copy bytes up to a 16 byte bound in dst, the framebuffer is page aligned
+  // so this is normally a no-op.
+
+  size_t numLead = (sizeof(MVBlitVec) - (((uintptr_t) dstPtr) & (sizeof(MVBlitVec) - 1))) & (sizeof(MVBlitVec) - 1);
+  if (numLead > numBytes) {
+    numLead = numBytes;
+  }
+  memcpy(dstPtr, srcPtr, numLead);
+  dstPtr += numLead;
+  srcPtr += numLead;
+  numBytes -= numLead;
+
+  MVBlitVec *vecPtr = (MVBlitVec *) dstPtr;
+  const MVBlitUnalignedVec *srcVecPtr = (const MVBlitUnalignedVec *) srcPtr;
+  size_t numVecs = numBytes / sizeof(MVBlitVec);
+
+  // Copy a 64 byte cache line per loop. The source is read once, so it is
+  // prefetched into the outer cache levels only. A prefetch that bypasses the
+  // cache completely (locality 0) was half as fast on x86. Prefetch past the
+  // end of the source is harmless, it does not fault.
+
+  for ( ; numVecs >= 4; numVecs -= 4, vecPtr += 4, srcVecPtr += 4) {
+    __builtin_prefetch(((const uint8_t *) srcVecPtr) + MV_BLIT_PREFETCH_NUM_BYTES, 0, 1);
+    const MVBlitVec v0 = srcVecPtr[0];
+    const MVBlitVec v1 = srcVecPtr[1];
+    const MVBlitVec v2 = srcVecPtr[2];
+    const MVBlitVec v3 = srcVecPtr[3];
+    MV_BLIT_STREAM_STORE(&vecPtr[0], v0);
+    MV_BLIT_STREAM_STORE(&vecPtr[1], v1);
+    MV_BLIT_STREAM_STORE(&vecPtr[2], v2);
+    MV_BLIT_STREAM_STORE(&vecPtr[3], v3);
+  }
+  for ( ; numVecs > 0; numVecs--, vecPtr++, srcVecPtr++) {
+    const MVBlitVec v0 = *srcVecPtr;
+    MV_BLIT_STREAM_STORE(vecPtr, v0);
+  }
+  maxvid_blit_stream_fence();
+
+  // Copy the last 1 to 15 bytes
+
+  memcpy(vecPtr, srcVecPtr, numBytes & (sizeof(MVBlitVec) - 1));
+}
@@ -0,0 +1,74 @@
+// maxvid_blit module
+//
+//  License terms defined in License.txt.
+//
+// This module implements wide fills and copies of framebuffer memory. Large
+// solid color areas are common in UI animation, a full screen color wipe is
+// decoded as a DUP that covers the whole framebuffer. A long DUP is filled
+// with 16 byte aligned vector stores, and once the fill is larger than the
+// cache it would evict, with non-temporal streaming stores that write around
+// the cache. A keyframe that is not zero copied is copied the same way, so
+// that a multi MB frame does not evict the working set of other clips.
+
+#ifndef MAXVID_BLIT_H
+#define MAXVID_BLIT_H
+
+#include "maxvid_decode.h"
+
+// A DUP shorter than this many words is filled with a simple word loop,
+// the setup for aligned vector stores costs more than it saves.
+
+#define MV_BLIT_WIDE_MIN_NUM_WORDS 32
+
+// A fill or copy of at least maxvid_blit_stream_min_num_bytes() bytes uses
+// non-temporal stores. By default this is half of the last level cache, so
+// that a frame written through the cache leaves room for the codes being
+// decoded and the frames of other clips. When the cache size can't be
+// queried, 1 MB is used, most of the L2 of a mobile CPU.
+
+#define MV_BLIT_STREAM_DEFAULT_MIN_NUM_BYTES (1024 * 1024)
+
+// The source of a streamed copy is prefetched this many bytes ahead
+
+#define MV_BLIT_PREFETCH_NUM_BYTES 512
+
+// Return the size at which fills and copies switch to non-temporal stores,
+// the last level cache size is queried once. Safe to call from any thread.
+
+size_t
+maxvid_blit_stream_min_num_bytes(void);
+
+// Override the size at which fills and copies switch to non-temporal
+// stores, 0 restores the cache size default. SIZE_MAX disables streaming.
+
+void
+maxvid_blit_set_stream_min_num_bytes(size_t numBytes);
+
+// Fill numWords words with the aligned vector loop, ptr must be word aligned.
+
+void
+maxvid_blit_fill32_wide(uint32_t * restrict ptr, const uint32_t word, const uint32_t numWords);
+
+// Fill numWords words at ptr with word. A 16 BPP DUP fills words that
+// contain the pixel twice.
+
+static inline
+void
+maxvid_blit_fill32(uint32_t * restrict ptr, const uint32_t word, const uint32_t numWords) {
+  if (numWords < MV_BLIT_WIDE_MIN_NUM_WORDS) {
+    for (uint32_t i = 0; i < numWords; i++) {
+      ptr[i] = word;
+    }
+  } else {
+    maxvid_blit_fill32_wide(ptr, word, numWords);
+  }
+}
+
+// Copy numBytes from src to dst, the buffers must not overlap. A copy
+// smaller than maxvid_blit_stream_min_num_bytes() is a memcpy, a larger copy
+// prefetches the source and writes dst with non-temporal stores.
+
+void
+maxvid_blit_copy(void * restrict dst, const void * restrict src, size_t numBytes);
+
+#endif // MAXVID_BLIT_H
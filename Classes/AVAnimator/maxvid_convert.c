@@ -0,0 +1,176 @@
+// maxvid_convert module
+//
+//  License terms defined in License.txt.
+//
+// This module implements conversion between 16 bpp and 32 bpp pixels,
+// see maxvid_convert.h.
+
+#include "maxvid_convert.h"
+
+#include "maxvid_blit.h"
+
+// 8 pixels are converted at a time, as two 128 bit vectors of 32 bit pixels
+
+typedef uint16_t MVConvertVec16 __attribute__((vector_size(16)));
+typedef uint32_t MVConvertVec32 __attribute__((vector_size(32)));
+
+#define MV_CONVERT_VEC_NUM_PIXELS 8
+
+// 4x4 ordered dither matrix
+
+static const uint8_t maxvid_convert_bayer[4][4] = {
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 }
+};
+
+// Threshold added to (channel * 31) before the divide by 255. A channel that
+// was expanded from 5 bits is within [-21, 21] of (value5 * 255), so any
+// threshold in [21, 233] maps it back to the same 5 bit value. Rounding uses
+// 127, dithering spreads the thresholds over [22, 232].
+
+#define MV_CONVERT_ROUND_THRESHOLD 127
+
+static inline
+uint32_t maxvid_convert_threshold(uint32_t x, uint32_t y) {
+  return 22 + (14 * maxvid_convert_bayer[y & 0x3][x & 0x3]);
+}
+
+// ((channel * 31) + threshold) / 255 without a multiply or divide, so that the
+// vector form does not depend on a 32 bit vector multiply. The divide by 255 is
+// exact for values below 65535.
+
+#define MV_CONVERT_TO_5_BITS(channel, threshold) \
+  ({ __typeof__(channel) v = ((channel) << 5) - (channel) + (threshold); (v + (v >> 8) + 1) >> 8; })
+
+static inline
+uint32_t maxvid_convert_pixel_8888_to_555(uint32_t pixel, uint32_t threshold) {
+  uint32_t red = MV_CONVERT_TO_5_BITS((pixel >> 16) & 0xFF, threshold);
+  uint32_t green = MV_CONVERT_TO_5_BITS((pixel >> 8) & 0xFF, threshold);
+  uint32_t blue = MV_CONVERT_TO_5_BITS(pixel & 0xFF, threshold);
+  return (red << 10) | (green << 5) | blue;
+}
+
+void
+maxvid_convert_555_to_8888(uint32_t * restrict outPixels, const uint16_t * restrict inPixels, uint32_t numPixels)
+{
+  uint32_t i = 0;
+
+  for ( ; (i + MV_CONVERT_VEC_NUM_PIXELS) <= numPixels; i += MV_CONVERT_VEC_NUM_PIXELS) {
+    MVConvertVec16 in16;
+    memcpy(&in16, &inPixels[i], sizeof(in16));
+    MVConvertVec32 in32 = __builtin_convertvector(in16, MVConvertVec32);
+
+    MVConvertVec32 red = (in32 >> 10) & 0x1F;
+    MVConvertVec32 green = (in32 >> 5) & 0x1F;
+    MVConvertVec32 blue = in32 & 0x1F;
+    red = (red << 3) | (red >> 2);
+    green = (green << 3) | (green >> 2);
+    blue = (blue << 3) | (blue >> 2);
+
+    MVConvertVec32 out32 = (red << 16) | (green << 8) | blue | 0xFF000000;
+    memcpy(&outPixels[i], &out32, sizeof(out32));
+  }
+
+  for ( ; i < numPixels; i++) {
+    outPixels[i] = maxvid_convert_pixel_555_to_8888(inPixels[i]);
+  }
+}
+
+void
+maxvid_convert_8888_to_555(uint16_t * restrict outPixels, const uint32_t * restrict inPixels,
+                           uint32_t width, uint32_t height, uint32_t dither)
+{
+  for (uint32_t y = 0; y < height; y++) {
+    const uint32_t *inRow = inPixels + (y * width);
+    uint16_t *outRow = outPixels + (y * width);
+
+    // The dither pattern repeats every 4 columns, so it is the same for each
+    // vector of 8 pixels in a row.
+
+    MVConvertVec32 threshold;
+    for (uint32_t x = 0; x < MV_CONVERT_VEC_NUM_PIXELS; x++) {
+      threshold[x] = dither ? maxvid_convert_threshold(x, y) : MV_CONVERT_ROUND_THRESHOLD;
+    }
+
+    uint32_t x = 0;
+
+    for ( ; (x + MV_CONVERT_VEC_NUM_PIXELS) <= width; x += MV_CONVERT_VEC_NUM_PIXELS) {
+      MVConvertVec32 in32;
+      memcpy(&in32, &inRow[x], sizeof(in32));
+
+      MVConvertVec32 red = MV_CONVERT_TO_5_BITS((in32 >> 16) & 0xFF, threshold);
+      MVConvertVec32 green = MV_CONVERT_TO_5_BITS((in32 >> 8) & 0xFF, threshold);
+      MVConvertVec32 blue = MV_CONVERT_TO_5_BITS(in32 & 0xFF, threshold);
+
+      MVConvertVec32 out32 = (red << 10) | (green << 5) | blue;
+      MVConvertVec16 out16 = __builtin_convertvector(out32, MVConvertVec16);
+      memcpy(&outRow[x], &out16, sizeof(out16));
+    }
+
+    for ( ; x < width; x++) {
+      uint32_t t = dither ? maxvid_convert_threshold(x, y) : MV_CONVERT_ROUND_THRESHOLD;
+      outRow[x] = (uint16_t) maxvid_convert_pixel_8888_to_555(inRow[x], t);
+    }
+  }
+}
+
+// The code walk below checks bounds in the same way as
+// maxvid_decode_c4_sample16_validated() in maxvid_validate.c
+
+uint32_t
+maxvid_decode_c4_sample16_to32(uint32_t * restrict frameBuffer32,
+                               const uint32_t * restrict inputBuffer32,
+                               const uint32_t inputBuffer32NumWords,
+                               const uint32_t frameBufferSize)
+{
+  uint32_t offset = 0;
+  const uint32_t * restrict inPtr = inputBuffer32;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    const uint32_t inW1 = *inPtr++;
+    const uint32_t opCode = inW1 >> 30;
+
+    if (opCode == SKIP) {
+      const uint32_t numPixels = inW1 & MV_MAX_30_BITS;
+      if (numPixels == 0 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      offset += numPixels;
+    } else if (opCode == DUP) {
+      const uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels < 2 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      maxvid_blit_fill32(frameBuffer32 + offset, maxvid_convert_pixel_555_to_8888(inW1 & 0xFFFF), numPixels);
+      offset += numPixels;
+    } else if (opCode == COPY) {
+      uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels == 0 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      // The first pixel is stored in the code word when the framebuffer
+      // is half word aligned or when only one pixel is copied.
+      if ((numPixels == 1) || ((offset & 0x1) != 0)) {
+        frameBuffer32[offset] = maxvid_convert_pixel_555_to_8888(inW1 & 0xFFFF);
+        offset++;
+        numPixels--;
+      }
+      const uint32_t numWords = (numPixels + 1) >> 1;
+      if (numWords > (inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      maxvid_convert_555_to_8888(frameBuffer32 + offset, (const uint16_t *) inPtr, numPixels);
+      offset += numPixels;
+      inPtr += numWords;
+    } else {
+      return 0;
+    }
+  }
+
+  // No DONE code found before the end of the input
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
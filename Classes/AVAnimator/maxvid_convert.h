@@ -0,0 +1,61 @@
+// maxvid_convert module
+//
+//  License terms defined in License.txt.
+//
+// This module implements conversion between 16 bpp XRRRRRGGGGGBBBBB pixels and
+// 32 bpp BGRA pixels, and decoding of 16 bpp c4 delta frames straight into a
+// 32 bpp framebuffer so that a 16 bpp movie can be composited as 32 bpp pixels
+// without an intermediate 16 bpp framebuffer.
+//
+// A 5 bit channel is expanded to 8 bits by repeating the high bits, so 0x1F
+// becomes 0xFF, and the alpha of an expanded pixel is 0xFF. Converting back to
+// 16 bpp rounds each channel to the nearest 5 bit value, or with dithering,
+// adds a 4x4 ordered dither threshold first. In both cases a pixel that was
+// expanded from 16 bpp converts back to the same 16 bpp pixel. The alpha is
+// dropped, so a premultiplied pixel converts as if composited over black.
+//
+// The kernels are written with vector types, so that the compiler emits NEON
+// on ARM and SSE on x86 for the main loop.
+
+#ifndef MAXVID_CONVERT_H
+#define MAXVID_CONVERT_H
+
+#include "maxvid_decode.h"
+
+// Expand one 16 bpp pixel to a 32 bpp BGRA pixel
+
+static inline
+uint32_t maxvid_convert_pixel_555_to_8888(uint32_t pixel) {
+  uint32_t red = (pixel >> 10) & 0x1F;
+  uint32_t green = (pixel >> 5) & 0x1F;
+  uint32_t blue = pixel & 0x1F;
+  red = (red << 3) | (red >> 2);
+  green = (green << 3) | (green >> 2);
+  blue = (blue << 3) | (blue >> 2);
+  return 0xFF000000 | (red << 16) | (green << 8) | blue;
+}
+
+// Expand numPixels 16 bpp pixels to 32 bpp BGRA pixels
+
+void
+maxvid_convert_555_to_8888(uint32_t * restrict outPixels, const uint16_t * restrict inPixels, uint32_t numPixels);
+
+// Convert width x height 32 bpp pixels to 16 bpp pixels, with a 4x4 ordered
+// dither when dither is non-zero.
+
+void
+maxvid_convert_8888_to_555(uint16_t * restrict outPixels, const uint32_t * restrict inPixels,
+                           uint32_t width, uint32_t height, uint32_t dither);
+
+// Decode one 16 bpp c4 delta frame over a 32 bpp framebuffer of frameBufferSize
+// pixels, each pixel is expanded as it is written. Each code is checked like
+// maxvid_decode_c4_sample16_validated(), returns 0 on success or
+// MV_ERROR_CODE_INVALID_INPUT as soon as an invalid code is found.
+
+uint32_t
+maxvid_decode_c4_sample16_to32(uint32_t * restrict frameBuffer32,
+                               const uint32_t * restrict inputBuffer32,
+                               const uint32_t inputBuffer32NumWords,
+                               const uint32_t frameBufferSize);
+
+#endif // MAXVID_CONVERT_H
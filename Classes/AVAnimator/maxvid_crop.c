@@ -0,0 +1,260 @@
+// maxvid_crop module
+//
+//  License terms defined in License.txt.
+//
+// This module implements decoding of a crop rectangle from keyframes and c4
+// delta frames, see maxvid_crop.h.
+
+#include "maxvid_crop.h"
+
+uint32_t
+maxvid_crop_init(MVCrop *crop, uint32_t width, uint32_t height, uint32_t bpp,
+                 uint32_t cropX, uint32_t cropY, uint32_t cropWidth, uint32_t cropHeight)
+{
+  memset(crop, 0, sizeof(MVCrop));
+
+  if (width == 0 || height == 0 || cropWidth == 0 || cropHeight == 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  if (cropX >= width || cropWidth > (width - cropX) || cropY >= height || cropHeight > (height - cropY)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  if (bpp != 16 && bpp != 24 && bpp != 32) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  crop->width = width;
+  crop->height = height;
+  crop->bpp = (bpp == 16) ? 16 : 32;
+  crop->cropX = cropX;
+  crop->cropY = cropY;
+  crop->cropWidth = cropWidth;
+  crop->cropHeight = cropHeight;
+
+  return 0;
+}
+
+// Apply numPixels pixels starting at a pixel offset in the full size frame. Only
+// the part of each row inside the crop rectangle is written. Pixel i of the run
+// is read from src at index (i * srcStride), a DUP run passes a srcStride of zero.
+
+static inline
+void maxvid_crop_run(const MVCrop *crop, void *cropFrameBuffer,
+                     uint32_t offset, uint32_t numPixels,
+                     const void *src, const uint32_t srcStride, const uint32_t bpp) {
+  const uint32_t width = crop->width;
+  const uint32_t endOffset = offset + numPixels;
+  const uint32_t cropEndY = crop->cropY + crop->cropHeight;
+
+  uint32_t y = offset / width;
+  if (y < crop->cropY) {
+    y = crop->cropY;
+  }
+
+  for ( ; y < cropEndY; y++) {
+    const uint32_t rowOffset = y * width;
+    if (rowOffset >= endOffset) {
+      break;
+    }
+
+    // Intersect [offset, endOffset) with the cropped columns of this row
+
+    uint32_t first = rowOffset + crop->cropX;
+    uint32_t last = first + crop->cropWidth;
+    if (first < offset) {
+      first = offset;
+    }
+    if (last > endOffset) {
+      last = endOffset;
+    }
+    if (first >= last) {
+      continue;
+    }
+
+    const uint32_t outIndex = ((y - crop->cropY) * crop->cropWidth) + (first - rowOffset - crop->cropX);
+    const uint32_t srcIndex = (first - offset) * srcStride;
+    const uint32_t count = last - first;
+
+    if (bpp == 16) {
+      uint16_t *outPtr = ((uint16_t *) cropFrameBuffer) + outIndex;
+      const uint16_t *srcPtr = ((const uint16_t *) src) + srcIndex;
+      if (srcStride == 0) {
+        for (uint32_t i = 0; i < count; i++) {
+          outPtr[i] = *srcPtr;
+        }
+      } else {
+        memcpy(outPtr, srcPtr, count * sizeof(uint16_t));
+      }
+    } else {
+      uint32_t *outPtr = ((uint32_t *) cropFrameBuffer) + outIndex;
+      const uint32_t *srcPtr = ((const uint32_t *) src) + srcIndex;
+      if (srcStride == 0) {
+        for (uint32_t i = 0; i < count; i++) {
+          outPtr[i] = *srcPtr;
+        }
+      } else {
+        memcpy(outPtr, srcPtr, count * sizeof(uint32_t));
+      }
+    }
+  }
+}
+
+void
+maxvid_crop_keyframe(const MVCrop *crop, void *cropFrameBuffer, const void *keyframe)
+{
+  const uint32_t numBytesInPixel = (crop->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t);
+  const uint32_t numBytesInRow = crop->cropWidth * numBytesInPixel;
+
+  for (uint32_t row = 0; row < crop->cropHeight; row++) {
+    const uint32_t offset = ((crop->cropY + row) * crop->width) + crop->cropX;
+    memcpy(((char *) cropFrameBuffer) + (row * numBytesInRow),
+           ((const char *) keyframe) + (offset * numBytesInPixel),
+           numBytesInRow);
+  }
+}
+
+// The code walks below check bounds in the same way as the validated decoders
+// in maxvid_validate.c, but a run is passed to maxvid_crop_run() only when it
+// could touch the crop rectangle.
+
+static
+uint32_t
+maxvid_decode_c4_cropped16(const MVCrop *crop,
+                           void *cropFrameBuffer,
+                           const uint32_t * restrict inputBuffer32,
+                           const uint32_t inputBuffer32NumWords)
+{
+  const uint32_t frameBufferSize = crop->width * crop->height;
+  const uint32_t cropStart = (crop->cropY * crop->width) + crop->cropX;
+  const uint32_t cropEnd = ((crop->cropY + crop->cropHeight - 1) * crop->width) + crop->cropX + crop->cropWidth;
+  uint32_t offset = 0;
+  const uint32_t * restrict inPtr = inputBuffer32;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    if (offset >= cropEnd) {
+      // The rest of the frame is below the crop rectangle
+      return 0;
+    }
+
+    const uint32_t inW1 = *inPtr++;
+    const uint32_t opCode = inW1 >> 30;
+
+    if (opCode == SKIP) {
+      const uint32_t numPixels = inW1 & MV_MAX_30_BITS;
+      if (numPixels == 0 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      offset += numPixels;
+    } else if (opCode == DUP) {
+      const uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels < 2 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      if ((offset + numPixels) > cropStart) {
+        const uint16_t pixel = (uint16_t) inW1;
+        maxvid_crop_run(crop, cropFrameBuffer, offset, numPixels, &pixel, 0, 16);
+      }
+      offset += numPixels;
+    } else if (opCode == COPY) {
+      uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels == 0 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      // The first pixel is stored in the code word when the framebuffer
+      // is half word aligned or when only one pixel is copied.
+      if ((numPixels == 1) || ((offset & 0x1) != 0)) {
+        if (offset >= cropStart) {
+          const uint16_t pixel = (uint16_t) inW1;
+          maxvid_crop_run(crop, cropFrameBuffer, offset, 1, &pixel, 0, 16);
+        }
+        offset++;
+        numPixels--;
+      }
+      const uint32_t numWords = (numPixels + 1) >> 1;
+      if (numWords > (inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      if ((offset + numPixels) > cropStart) {
+        maxvid_crop_run(crop, cropFrameBuffer, offset, numPixels, inPtr, 1, 16);
+      }
+      offset += numPixels;
+      inPtr += numWords;
+    } else {
+      return 0;
+    }
+  }
+
+  // No DONE code found before the end of the input
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+static
+uint32_t
+maxvid_decode_c4_cropped32(const MVCrop *crop,
+                           void *cropFrameBuffer,
+                           const uint32_t * restrict inputBuffer32,
+                           const uint32_t inputBuffer32NumWords)
+{
+  const uint32_t frameBufferSize = crop->width * crop->height;
+  const uint32_t cropStart = (crop->cropY * crop->width) + crop->cropX;
+  const uint32_t cropEnd = ((crop->cropY + crop->cropHeight - 1) * crop->width) + crop->cropX + crop->cropWidth;
+  uint32_t offset = 0;
+  const uint32_t * restrict inPtr = inputBuffer32;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    if (offset >= cropEnd) {
+      return 0;
+    }
+
+    const uint32_t inW1 = *inPtr++;
+    MV32_PARSE_OP_NUM_SKIP(inW1, opCode, numPixels, skipAfter);
+
+    if (opCode == DONE) {
+      return 0;
+    }
+
+    if (numPixels < ((opCode == DUP) ? 2 : 1) || (numPixels + skipAfter) > (frameBufferSize - offset)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    const int touchesCrop = ((offset + numPixels) > cropStart);
+
+    if (opCode == DUP) {
+      if (inPtr == inEnd) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      if (touchesCrop) {
+        maxvid_crop_run(crop, cropFrameBuffer, offset, numPixels, inPtr, 0, 32);
+      }
+      inPtr++;
+    } else if (opCode == COPY) {
+      if (numPixels > (inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      if (touchesCrop) {
+        maxvid_crop_run(crop, cropFrameBuffer, offset, numPixels, inPtr, 1, 32);
+      }
+      inPtr += numPixels;
+    }
+
+    offset += numPixels + skipAfter;
+  }
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+uint32_t
+maxvid_decode_c4_cropped(const MVCrop *crop,
+                         void *cropFrameBuffer,
+                         const uint32_t * restrict inputBuffer32,
+                         const uint32_t inputBuffer32NumWords)
+{
+  if (crop->bpp == 16) {
+    return maxvid_decode_c4_cropped16(crop, cropFrameBuffer, inputBuffer32, inputBuffer32NumWords);
+  } else {
+    return maxvid_decode_c4_cropped32(crop, cropFrameBuffer, inputBuffer32, inputBuffer32NumWords);
+  }
+}
@@ -0,0 +1,67 @@
+// maxvid_crop module
+//
+//  License terms defined in License.txt.
+//
+// This module implements decoding of a crop rectangle from keyframes and c4
+// delta frames into a compact framebuffer that holds only the cropped pixels,
+// rows are cropWidth pixels apart. A SKIP, DUP or COPY run that does not touch
+// the crop rectangle only moves the pixel offset, the COPY pixel data is
+// stepped over without being read. Decoding a delta frame stops as soon as the
+// pixel offset is past the last cropped row, so the codes after that point are
+// not read or checked.
+//
+// A delta frame writes absolute pixel values, so the pixels inside the crop
+// rectangle only depend on earlier pixels inside the same rectangle. The
+// compact framebuffer is the complete state needed to decode the next delta
+// frame, as long as decoding starts at a keyframe and the crop rectangle does
+// not change. After the crop rectangle changes, decoding must start over at
+// a keyframe.
+
+#ifndef MAXVID_CROP_H
+#define MAXVID_CROP_H
+
+#include "maxvid_decode.h"
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  // 16 for 16 bpp pixels, 32 for 24 or 32 bpp pixels
+  uint32_t bpp;
+  uint32_t cropX;
+  uint32_t cropY;
+  uint32_t cropWidth;
+  uint32_t cropHeight;
+} MVCrop;
+
+// Setup to crop the rectangle at (cropX, cropY) of cropWidth x cropHeight pixels
+// from frames of width x height pixels. The rectangle must be inside the frame
+// and not empty. Returns 0 on success, otherwise MV_ERROR_CODE_INVALID_INPUT.
+
+uint32_t
+maxvid_crop_init(MVCrop *crop, uint32_t width, uint32_t height, uint32_t bpp,
+                 uint32_t cropX, uint32_t cropY, uint32_t cropWidth, uint32_t cropHeight);
+
+// Number of bytes in the cropped framebuffer
+
+static inline
+uint32_t maxvid_crop_num_bytes(const MVCrop *crop) {
+  return crop->cropWidth * crop->cropHeight * ((crop->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+// Copy the cropped rows of a width x height keyframe into the cropped framebuffer
+
+void
+maxvid_crop_keyframe(const MVCrop *crop, void *cropFrameBuffer, const void *keyframe);
+
+// Decode one delta frame over the cropped framebuffer. Each code up to the end
+// of the crop rectangle is checked like maxvid_decode_c4_sample16_validated() and
+// maxvid_decode_c4_sample32_validated(), returns 0 on success or
+// MV_ERROR_CODE_INVALID_INPUT as soon as an invalid code is found.
+
+uint32_t
+maxvid_decode_c4_cropped(const MVCrop *crop,
+                         void *cropFrameBuffer,
+                         const uint32_t * restrict inputBuffer32,
+                         const uint32_t inputBuffer32NumWords);
+
+#endif // MAXVID_CROP_H
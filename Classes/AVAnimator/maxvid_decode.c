@@ -121,6 +121,8 @@
 // the test module, then the default symbols are not declared to avoid accidently using them.
 #include "maxvid_decode.h"
 
+#include "maxvid_blit.h"
+
 // Fancy macro expansion so that FUNCTION_NAME(MODULE_PREFIX, decode_sample16) -> maxvid_decode_sample16
 #define MAKE_FN_NAME(mprefix, x) mprefix ## x
 #define FUNCTION_NAME(mprefix, fname) MAKE_FN_NAME(mprefix, fname)
@@ -2062,8 +2064,7 @@ DUPBIG_16BPP:
                         );
 #else // USE_INLINE_ARM_ASM
   {
-    uint32_t inWordPtr = pixel32Alias;
-    memset_pattern4(frameBuffer16, &inWordPtr, numWords << 2);
+    maxvid_blit_fill32((uint32_t *) frameBuffer16, pixel32Alias, numWords);
     frameBuffer16 += numWords << 1;
 #ifdef EXTRA_CHECKS
     numWords = 0;
@@ -3960,8 +3961,7 @@ DUPBIG_32BPP:
                         );
 #else // USE_INLINE_ARM_ASM
   {
-    uint32_t inWordPtr = WR1;
-    memset_pattern4(frameBuffer32, &inWordPtr, numPixels << 2);
+    maxvid_blit_fill32(frameBuffer32, WR1, numPixels);
     frameBuffer32 += numPixels;
 #ifdef EXTRA_CHECKS
     numPixels = 0;
@@ -4,6 +4,9 @@
 //
 // This module defines a runtime execution speed optimized video decoder library for iOS.
 
+#ifndef MAXVID_DECODE_H
+#define MAXVID_DECODE_H
+
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
@@ -29,6 +32,7 @@ typedef enum {
 #define MV_ERROR_CODE_INVALID_OUTPUT 2
 #define MV_ERROR_CODE_WRITE_FAILED 3
 #define MV_ERROR_CODE_READ_FAILED 4
+#define MV_ERROR_CODE_OUT_OF_MEMORY 5
 
 // These bit packing macros should not be invoked in user code
 
@@ -55,6 +59,11 @@ typedef enum {
 
 #define MV_PAGESIZE (4096*4)
 
+// A V3 file can align keyframes to the 2 MB huge page size so that a keyframe
+// mapped into a framebuffer that is also 2 MB aligned can use huge pages.
+
+#define MV_HUGEPAGESIZE (2*1024*1024)
+
 #define MV16_NUM_PIXELS_ONE_PAGE (MV_PAGESIZE / sizeof(uint16_t))
 #define MV_NUM_WORDS_ONE_PAGE (MV_PAGESIZE / sizeof(uint32_t))
 
@@ -110,3 +119,5 @@ maxvid_decode_c4_sample32(
                           const uint32_t frameBufferSize);
 
 #endif // MAXVID_DEFAULT_MODULE_PREFIX
+
+#endif // MAXVID_DECODE_H
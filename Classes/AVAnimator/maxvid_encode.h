@@ -226,4 +226,70 @@ maxvid_write_delta_pixels(AVMvidFileWriter *mvidWriter,
                           NSUInteger frameBufferNumPixels,
                           const uint32_t encodeFlags);
 
+// MaxvidEncodeFlags_MERGE_DUP : unchanged pixels that split a solid color
+// area into one DUP for each row are written again so that a single DUP
+// covers the area. The output is the same, the decoder fills the whole
+// area with one wide fill instead of decoding a DUP and a SKIP for each row.
+
+#define MaxvidEncodeFlags_MERGE_DUP 0x8
+
+// Lossy encoding flags. These trade a small and bounded error in pixel values
+// for a much smaller delta frame. Input that was decoded from a lossy source
+// like H.264 contains compression noise, so most pixels differ by a tiny
+// amount from one frame to the next even when the image is not changing.
+//
+// MaxvidEncodeFlags_LOSSY_SKIP : a pixel that is within the tolerance of the
+// previous frame for every channel is treated as unchanged (SKIP).
+//
+// MaxvidEncodeFlags_LOSSY_DUP : a run of changed pixels that are all within
+// the tolerance of the first pixel in the run is quantized to that one
+// value so that the run can be emitted as a single DUP.
+//
+// The per channel tolerance is stored in bits 8 -> 15 of the encode flags,
+// use MaxvidEncodeFlags_TOLERANCE(tol) to set it. The tolerance is defined in
+// terms of 8 bit channel values, for 16 BPP pixels the value is scaled down
+// to 5 bits and rounded up, so that a tolerance of 1 to 8 means 1 step in a
+// RGB555 channel.
+//
+// These flags are applied only by maxvid_encode_lossy_pixels16/32(), the
+// delta encoders and maxvid_write_delta_pixels() ignore them. The lossy pass
+// must be run on the current frame before it is encoded.
+
+#define MaxvidEncodeFlags_LOSSY_SKIP 0x2
+#define MaxvidEncodeFlags_LOSSY_DUP 0x4
+
+#define MaxvidEncodeFlags_TOLERANCE(tol) ((((uint32_t)(tol)) & MV_MAX_8_BITS) << 8)
+
+static inline
+uint32_t
+maxvid_encode_flags_tolerance(const uint32_t encodeFlags) {
+  return (encodeFlags >> 8) & MV_MAX_8_BITS;
+}
+
+// Apply lossy encoding flags to the current framebuffer before invoking
+// maxvid_encode_generic_delta_pixels16/32(). Pixels that are close enough
+// to be considered unchanged are reset to the previous value and nearly flat
+// runs are reset to one value, this is done in place in currentInputBuffer.
+// The same buffer must then be passed to maxvid_write_delta_pixels() so that
+// the adler checksum matches what the decoder will produce. Because the
+// modified buffer is exactly what the decoder will produce, using it as the
+// previous buffer for the next frame means pixels are always compared to what
+// is actually on screen. Error can't build up over a series of frames, a slow
+// drift gets emitted as soon as it goes past the tolerance. Returns the number
+// of pixels that were modified.
+
+uint32_t
+maxvid_encode_lossy_pixels16(const uint16_t * restrict prevInputBuffer16,
+                             uint16_t * restrict currentInputBuffer16,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t encodeFlags);
+
+uint32_t
+maxvid_encode_lossy_pixels32(const uint32_t * restrict prevInputBuffer32,
+                             uint32_t * restrict currentInputBuffer32,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t encodeFlags);
+
 #undef EXTRA_CHECKS
@@ -1848,6 +1848,110 @@ NSArray* calculateDeltaPixels32(
   return deltaPixels;
 }
 
+// With MaxvidEncodeFlags_MERGE_DUP, unchanged pixels between two changed
+// pixels are added to the delta when the gap is no longer than a row and
+// every pixel in it has the same value as both changed pixels. This happens
+// when a solid color fill covers an area that partly had that color already,
+// the DUP for each row is then merged with the DUP for the next row.
+
+static
+NSArray* mergeDupDeltaPixels16(NSArray *deltaPixels,
+                               const uint16_t * restrict currentInputBuffer16,
+                               uint32_t width)
+{
+  NSMutableArray *mergedPixels = [NSMutableArray arrayWithCapacity:[deltaPixels count]];
+  
+  DeltaPixel *prevDeltaPixel = nil;
+  
+  for (DeltaPixel *deltaPixel in deltaPixels) {
+    if (prevDeltaPixel != nil) {
+      uint32_t gapStart = prevDeltaPixel->offset + 1;
+      uint32_t gapEnd = deltaPixel->offset;
+      uint16_t pixel = (uint16_t) deltaPixel->newValue;
+      
+      if ((gapEnd > gapStart) && ((gapEnd - gapStart) <= width) && (prevDeltaPixel->newValue == pixel)) {
+        uint32_t offset = gapStart;
+        
+        while ((offset < gapEnd) && (currentInputBuffer16[offset] == pixel)) {
+          offset++;
+        }
+        
+        if (offset == gapEnd) {
+          for (offset = gapStart; offset < gapEnd; offset++) {
+            DeltaPixel *mergedPixel = [[DeltaPixel alloc] init];
+            mergedPixel->x = offset % width;
+            mergedPixel->y = offset / width;
+            mergedPixel->offset = offset;
+            mergedPixel->oldValue = pixel;
+            mergedPixel->newValue = pixel;
+            
+            [mergedPixels addObject:mergedPixel];
+            
+#if __has_feature(objc_arc)
+#else
+            [mergedPixel release];
+#endif // objc_arc
+          }
+        }
+      }
+    }
+    
+    [mergedPixels addObject:deltaPixel];
+    prevDeltaPixel = deltaPixel;
+  }
+  
+  return mergedPixels;
+}
+
+static
+NSArray* mergeDupDeltaPixels32(NSArray *deltaPixels,
+                               const uint32_t * restrict currentInputBuffer32,
+                               uint32_t width)
+{
+  NSMutableArray *mergedPixels = [NSMutableArray arrayWithCapacity:[deltaPixels count]];
+  
+  DeltaPixel *prevDeltaPixel = nil;
+  
+  for (DeltaPixel *deltaPixel in deltaPixels) {
+    if (prevDeltaPixel != nil) {
+      uint32_t gapStart = prevDeltaPixel->offset + 1;
+      uint32_t gapEnd = deltaPixel->offset;
+      uint32_t pixel = deltaPixel->newValue;
+      
+      if ((gapEnd > gapStart) && ((gapEnd - gapStart) <= width) && (prevDeltaPixel->newValue == pixel)) {
+        uint32_t offset = gapStart;
+        
+        while ((offset < gapEnd) && (currentInputBuffer32[offset] == pixel)) {
+          offset++;
+        }
+        
+        if (offset == gapEnd) {
+          for (offset = gapStart; offset < gapEnd; offset++) {
+            DeltaPixel *mergedPixel = [[DeltaPixel alloc] init];
+            mergedPixel->x = offset % width;
+            mergedPixel->y = offset / width;
+            mergedPixel->offset = offset;
+            mergedPixel->oldValue = pixel;
+            mergedPixel->newValue = pixel;
+            
+            [mergedPixels addObject:mergedPixel];
+            
+#if __has_feature(objc_arc)
+#else
+            [mergedPixel release];
+#endif // objc_arc
+          }
+        }
+      }
+    }
+    
+    [mergedPixels addObject:deltaPixel];
+    prevDeltaPixel = deltaPixel;
+  }
+  
+  return mergedPixels;
+}
+
 // Calculate delta between previous framebuffer and the current one. If there is
 // no change, then nil is returned.
 
@@ -1875,6 +1979,10 @@ maxvid_encode_generic_delta_pixels16(const uint16_t * restrict prevInputBuffer16
     *emitKeyframeAnyway = TRUE;
     return nil;
   } else {
+    if ((encodeFlags & MaxvidEncodeFlags_MERGE_DUP) && ((encodeFlags & MaxvidEncodeFlags_NO_DUP) == 0)) {
+      deltaPixels = mergeDupDeltaPixels16(deltaPixels, currentInputBuffer16, width);
+    }
+    
     // FIXME: what if this method fails? What would we return?
     BOOL worked = maxvid_calculate_delta_pixels(deltaPixels,
                                                 16,
@@ -1916,6 +2024,10 @@ maxvid_encode_generic_delta_pixels32(const uint32_t * restrict prevInputBuffer32
     *emitKeyframeAnyway = TRUE;
     return nil;
   } else {
+    if ((encodeFlags & MaxvidEncodeFlags_MERGE_DUP) && ((encodeFlags & MaxvidEncodeFlags_NO_DUP) == 0)) {
+      deltaPixels = mergeDupDeltaPixels32(deltaPixels, currentInputBuffer32, width);
+    }
+    
     // FIXME: what if this method fails? What would we return?
     BOOL worked = maxvid_calculate_delta_pixels(deltaPixels,
                                                 32,
@@ -1929,6 +2041,175 @@ maxvid_encode_generic_delta_pixels32(const uint32_t * restrict prevInputBuffer32
   return [NSData dataWithData:mData];
 }
 
+// Lossy encoding logic. A nearly flat run must contain at least this many
+// pixels before it is quantized to a single DUP value. Shorter runs are
+// typically edges or fine detail and quantizing those would be visible.
+
+#define MV_LOSSY_DUP_MIN_RUN 4
+
+// Return TRUE if each RGB555 channel in p1 and p2 is within tolerance
+
+static inline
+BOOL maxvid_lossy_within_tolerance16(const uint16_t p1, const uint16_t p2, const int tolerance) {
+  for (int shift = 0; shift < 15; shift += 5) {
+    int c1 = (p1 >> shift) & MV_MAX_5_BITS;
+    int c2 = (p2 >> shift) & MV_MAX_5_BITS;
+    if (abs(c1 - c2) > tolerance) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// Return TRUE if each BGRA channel in p1 and p2 is within tolerance
+
+static inline
+BOOL maxvid_lossy_within_tolerance32(const uint32_t p1, const uint32_t p2, const int tolerance) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    int c1 = (p1 >> shift) & MV_MAX_8_BITS;
+    int c2 = (p2 >> shift) & MV_MAX_8_BITS;
+    if (abs(c1 - c2) > tolerance) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// Rewrite pixels in the current 16 BPP framebuffer in place according to the
+// lossy encode flags. Returns the number of pixels that were modified.
+
+uint32_t
+maxvid_encode_lossy_pixels16(const uint16_t * restrict prevInputBuffer16,
+                             uint16_t * restrict currentInputBuffer16,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t encodeFlags)
+{
+  // 8 bit tolerance is scaled to the 5 bit channel range, rounded up so that
+  // a tolerance less than 8 is not ignored
+  
+  const int tolerance = (maxvid_encode_flags_tolerance(encodeFlags) + 7) >> 3;
+  const uint32_t numPixels = width * height;
+  uint32_t numModified = 0;
+  
+  if (tolerance == 0) {
+    return 0;
+  }
+  
+  if (encodeFlags & MaxvidEncodeFlags_LOSSY_SKIP) {
+    for (uint32_t i = 0; i < numPixels; i++) {
+      uint16_t prevPixel = prevInputBuffer16[i];
+      uint16_t currPixel = currentInputBuffer16[i];
+      
+      if ((prevPixel != currPixel) && maxvid_lossy_within_tolerance16(prevPixel, currPixel, tolerance)) {
+        currentInputBuffer16[i] = prevPixel;
+        numModified++;
+      }
+    }
+  }
+  
+  if ((encodeFlags & MaxvidEncodeFlags_LOSSY_DUP) && ((encodeFlags & MaxvidEncodeFlags_NO_DUP) == 0)) {
+    uint32_t i = 0;
+    
+    while (i < numPixels) {
+      if (currentInputBuffer16[i] == prevInputBuffer16[i]) {
+        i++;
+        continue;
+      }
+      
+      // Find the end of a run of changed pixels that are close to the first one
+      
+      const uint16_t runPixel = currentInputBuffer16[i];
+      uint32_t runEnd = i + 1;
+      
+      while ((runEnd < numPixels) &&
+             (currentInputBuffer16[runEnd] != prevInputBuffer16[runEnd]) &&
+             maxvid_lossy_within_tolerance16(runPixel, currentInputBuffer16[runEnd], tolerance)) {
+        runEnd++;
+      }
+      
+      if ((runEnd - i) >= MV_LOSSY_DUP_MIN_RUN) {
+        for (uint32_t j = i + 1; j < runEnd; j++) {
+          if (currentInputBuffer16[j] != runPixel) {
+            currentInputBuffer16[j] = runPixel;
+            numModified++;
+          }
+        }
+      }
+      
+      i = runEnd;
+    }
+  }
+  
+  return numModified;
+}
+
+// Rewrite pixels in the current 24 or 32 BPP framebuffer in place according to the
+// lossy encode flags. Returns the number of pixels that were modified.
+
+uint32_t
+maxvid_encode_lossy_pixels32(const uint32_t * restrict prevInputBuffer32,
+                             uint32_t * restrict currentInputBuffer32,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t encodeFlags)
+{
+  const int tolerance = maxvid_encode_flags_tolerance(encodeFlags);
+  const uint32_t numPixels = width * height;
+  uint32_t numModified = 0;
+  
+  if (tolerance == 0) {
+    return 0;
+  }
+  
+  if (encodeFlags & MaxvidEncodeFlags_LOSSY_SKIP) {
+    for (uint32_t i = 0; i < numPixels; i++) {
+      uint32_t prevPixel = prevInputBuffer32[i];
+      uint32_t currPixel = currentInputBuffer32[i];
+      
+      if ((prevPixel != currPixel) && maxvid_lossy_within_tolerance32(prevPixel, currPixel, tolerance)) {
+        currentInputBuffer32[i] = prevPixel;
+        numModified++;
+      }
+    }
+  }
+  
+  if ((encodeFlags & MaxvidEncodeFlags_LOSSY_DUP) && ((encodeFlags & MaxvidEncodeFlags_NO_DUP) == 0)) {
+    uint32_t i = 0;
+    
+    while (i < numPixels) {
+      if (currentInputBuffer32[i] == prevInputBuffer32[i]) {
+        i++;
+        continue;
+      }
+      
+      // Find the end of a run of changed pixels that are close to the first one
+      
+      const uint32_t runPixel = currentInputBuffer32[i];
+      uint32_t runEnd = i + 1;
+      
+      while ((runEnd < numPixels) &&
+             (currentInputBuffer32[runEnd] != prevInputBuffer32[runEnd]) &&
+             maxvid_lossy_within_tolerance32(runPixel, currentInputBuffer32[runEnd], tolerance)) {
+        runEnd++;
+      }
+      
+      if ((runEnd - i) >= MV_LOSSY_DUP_MIN_RUN) {
+        for (uint32_t j = i + 1; j < runEnd; j++) {
+          if (currentInputBuffer32[j] != runPixel) {
+            currentInputBuffer32[j] = runPixel;
+            numModified++;
+          }
+        }
+      }
+      
+      i = runEnd;
+    }
+  }
+  
+  return numModified;
+}
+
 // Emit a DUP code for a specific run of pixels with all the same value
 
 static
@@ -2328,7 +2609,7 @@ maxvid_write_delta_pixels(AVMvidFileWriter *mvidWriter,
   if (retcode == 0) {
     // Write codes to mvid file
     
-    BOOL worked = [mvidWriter writeDeltaframe:(void*)mC4Data.bytes bufferSize:(int)mC4Data.length adler:adler];
+    BOOL worked = [mvidWriter writeDeltaframe:(void*)mC4Data.bytes bufferSize:(int)mC4Data.length adler:adler pixels:inputBuffer];
     
     if (worked == FALSE) {
       retcode = MV_ERROR_CODE_WRITE_FAILED;
@@ -56,3 +56,76 @@ uint32_t maxvid_adler32(
   
 	return result;
 }
+
+void
+maxvid_file_frame_start_times(MVFileHeader *fileHeaderPtr, void *framesPtr, double *startTimes)
+{
+  const uint32_t numFrames = fileHeaderPtr->numFrames;
+  const double frameDuration = fileHeaderPtr->frameDuration;
+  const uint32_t isFrameDurations = maxvid_file_is_frame_durations(fileHeaderPtr) &&
+    (maxvid_file_version(fileHeaderPtr) == MV_FILE_VERSION_THREE);
+  
+  double time = 0.0;
+  
+  for (uint32_t i = 0; i < numFrames; i++) {
+    startTimes[i] = time;
+    
+    uint32_t duration = 0;
+    if (isFrameDurations) {
+      duration = maxvid_v3_frame_duration(maxvid_v3_file_frame(framesPtr, i));
+    }
+    
+    if (duration == 0) {
+      time += frameDuration;
+    } else {
+      time += duration / 1000000.0;
+    }
+  }
+  
+  startTimes[numFrames] = time;
+}
+
+uint32_t
+maxvid_file_frame_at_time(const double *startTimes, uint32_t numFrames, double time)
+{
+  // A file without frames has no frame table, so there is nothing to search
+  
+  if (numFrames == 0) {
+    return 0;
+  }
+  
+  // Find the last start time <= time in [low, high]
+  
+  uint32_t low = 0;
+  uint32_t high = numFrames - 1;
+  
+  while (low < high) {
+    uint32_t mid = low + ((high - low + 1) >> 1);
+    if (startTimes[mid] <= time) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  
+  return low;
+}
+
+uint32_t
+maxvid_file_select_level(const MVFileHeader *fileHeaderPtr, const MVLevel *levels,
+                         uint32_t width, uint32_t height)
+{
+  uint32_t selected = 0;
+  
+  // Levels get smaller, so stop at the first level that is too small
+  
+  for (uint32_t level = 1; level <= fileHeaderPtr->numLevels; level++) {
+    const MVLevel *mvLevel = &levels[level - 1];
+    if (mvLevel->width < width || mvLevel->height < height) {
+      break;
+    }
+    selected = level;
+  }
+  
+  return selected;
+}
@@ -4,6 +4,9 @@
 //
 // This module defines the format and logic to read and write a maxvid file.
 
+#ifndef MAXVID_FILE_H
+#define MAXVID_FILE_H
+
 #include "maxvid_decode.h"
 
 // If this define is set to 1, then support for the experimental "deltas"
@@ -33,12 +36,51 @@
 #define MV_FILE_DELTAS 0x4
 #endif // MV_ENABLE_DELTAS
 
+// This flag is set for a .mvid file that was written in streaming mode, where the
+// number of frames is not known until the last frame has been written. The frame
+// table is written after all the frame data and a MVFileTrailer at the very end
+// of the file contains the offset of the frame table.
+
+#define MV_FILE_FRAMES_AT_END 0x8
+
+// This flag is set for a version 3 .mvid file where each frame has its own display
+// duration, stored in the MVV3Frame. A source with irregular frame timing, like
+// an animated GIF or APNG, is then written as one frame per source frame instead
+// of inserting nop frames at the shortest frame duration. The frameDuration in the
+// header is the shortest frame duration and is used for a frame with a zero duration.
+
+#define MV_FILE_FRAME_DURATIONS 0x10
+
+// This flag is set for a version 3 .mvid file that also contains reduced size
+// renditions of the video, called levels. Each level is half the width and height
+// of the previous level and has its own frame table, so that a decoder can read
+// only the level that matches the display size. The header numLevels field is
+// the number of levels after the full size level and levelsOffset is the file
+// offset of a table of numLevels MVLevel entries, each followed level frame table
+// is located after the level table. All frame data is located before levelsOffset.
+// A level frame is a keyframe, delta frame or nop frame like a full size frame.
+
+#define MV_FILE_LEVELS 0x20
+
+// A level is at most 1/8 the width and height, see MV_SCALE_MAX_SHIFT
+
+#define MV_FILE_MAX_LEVELS 3
+
+// This flag is set for a version 3 .mvid file that contains 8 bit palette frames,
+// see maxvid_palette.h. A frame with at most 256 colors can be stored as one byte
+// per pixel and each palette frame has the MV_FRAME_IS_PALETTE flag set. The bpp
+// in the header is the bpp of the decoded pixels, a frame with more colors is
+// stored as a regular keyframe or delta frame.
+
+#define MV_FILE_PALETTE 0x40
+
 // These flags are set for a specific frame. A keyframe is not a delta. When
 // data does not change from one frame to the next, that is a nop frame.
 
 #define MV_FRAME_IS_KEYFRAME (1 << 0)
 #define MV_FRAME_IS_NOPFRAME (1 << 1)
 #define MV_FRAME_IS_COMPRESSED (1 << 2)
+#define MV_FRAME_IS_PALETTE (1 << 3)
 
 // These constants define .mvid file revision constants. For example, AVAnimator 1.0
 // versions made use of the value 0, while AVAnimator 2.0 now emits files with the
@@ -57,7 +99,7 @@
 // invalid. This assumption is based on the fact that most usage will involve
 // generating a maxvid file based on an intermediate format that can be validated.
 // Instead of validating on data access on the embedded device, we validate on write
-// typically done on the desktop.
+// typically done on the desktop. See maxvid_validate.h for input that can't be trusted.
 
 typedef struct {
   uint32_t magic;
@@ -71,8 +113,12 @@ typedef struct {
   // version of the file needs to be read by a later version of the library.
   // The version portion is the first 8 bits while the rest are bit flags.
   uint32_t versionAndFlags;
+  // Number of reduced size levels, zero unless MV_FILE_LEVELS is set
+  uint32_t numLevels;
+  // File offset of the MVLevel table, zero unless MV_FILE_LEVELS is set
+  uint64_t levelsOffset;
   // Padding out to 16 words, so that there is room to add additional fields later
-  uint32_t padding[16-7];
+  uint32_t padding[16-10];
 } MVFileHeader;
 
 // After the MVFileHeader, an array of numFrames MVFrame word pairs.
@@ -83,6 +129,30 @@ typedef struct {
     uint32_t adler; // adler32 checksum of the decoded framebuffer
 } MVFrame;
 
+// A file with the MV_FILE_FRAMES_AT_END flag set ends with this trailer,
+// the frame table is located at framesOffset and is followed by the trailer.
+// The framesOffset is always a multiple of 8 so that the frame table can
+// be accessed directly when the file is mapped into memory.
+
+#define MV_FILE_TRAILER_MAGIC 0xCAFED00D
+
+typedef struct {
+  uint64_t framesOffset; // file offset where the frame table is located
+  uint32_t numFrames; // same as the numFrames in the header
+  uint32_t magic; // MV_FILE_TRAILER_MAGIC
+} MVFileTrailer;
+
+// A file with the MV_FILE_LEVELS flag set contains a table of these entries,
+// one for each reduced size level. The frame table of a level contains the
+// same number of MVV3Frame entries as the full size level. The framesOffset
+// is always a multiple of 8.
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint64_t framesOffset; // file offset where the frame table of the level is located
+} MVLevel;
+
 // Full support for very large (larger than 2 gigs) files was
 // added for both delta and keyframe files as of version 4.
 // This version requires a larger type of frame since the
@@ -93,7 +163,7 @@ typedef struct {
   uint32_t length; // length in bytes
   uint32_t flags; // flags for frame
   uint32_t adler; // adler32 checksum of the decoded framebuffer
-  uint32_t dummy; // zero to fill out to double word length
+  uint32_t duration; // display time in microseconds, zero unless MV_FILE_FRAME_DURATIONS is set
 } MVV3Frame;
 
 static inline
@@ -121,6 +191,11 @@ void maxvid_v3_frame_setcompressed(MVV3Frame *mvFrame) {
   mvFrame->flags |= MV_FRAME_IS_COMPRESSED;
 }
 
+static inline
+void maxvid_v3_frame_setpalette(MVV3Frame *mvFrame) {
+  mvFrame->flags |= MV_FRAME_IS_PALETTE;
+}
+
 // Set/Get frame offset and length, both in terms of bytes
 
 static inline
@@ -145,6 +220,18 @@ void maxvid_v3_frame_setlength(MVV3Frame *mvFrame, uint32_t size) {
   mvFrame->length = size;
 }
 
+// Set/Get frame display duration in microseconds, see MV_FILE_FRAME_DURATIONS
+
+static inline
+void maxvid_v3_frame_setduration(MVV3Frame *mvFrame, uint32_t duration) {
+  mvFrame->duration = duration;
+}
+
+static inline
+uint32_t maxvid_v3_frame_duration(MVV3Frame *mvFrame) {
+  return mvFrame->duration;
+}
+
 static inline
 uint32_t maxvid_frame_iskeyframe(MVFrame *mvFrame) {
   return ((mvFrame->lengthAndFlags & MV_FRAME_IS_KEYFRAME) != 0);
@@ -170,6 +257,11 @@ uint32_t maxvid_v3_frame_iscompressed(MVV3Frame *mvFrame) {
   return ((mvFrame->flags & MV_FRAME_IS_COMPRESSED) != 0);
 }
 
+static inline
+uint32_t maxvid_v3_frame_ispalette(MVV3Frame *mvFrame) {
+  return ((mvFrame->flags & MV_FRAME_IS_PALETTE) != 0);
+}
+
 static inline
 uint32_t maxvid_frame_offset(MVFrame *mvFrame) {
   return mvFrame->offset;
@@ -365,9 +457,124 @@ void maxvid_file_set_deltas(MVFileHeader *fileHeaderPtr) {
 
 #endif // MV_ENABLE_DELTAS
 
+// Return TRUE if the frame table is located at the end of the file, see MVFileTrailer.
+
+static inline
+uint32_t maxvid_file_is_frames_at_end(MVFileHeader *fileHeaderPtr) {
+  uint32_t flags = fileHeaderPtr->versionAndFlags >> 8;
+  uint32_t isFramesAtEnd = flags & MV_FILE_FRAMES_AT_END;
+  return isFramesAtEnd;
+}
+
+// Explicitly set the frames at end flag.
+
+static inline
+void maxvid_file_set_frames_at_end(MVFileHeader *fileHeaderPtr) {
+  fileHeaderPtr->versionAndFlags |= (MV_FILE_FRAMES_AT_END << 8);
+}
+
+// Return TRUE if each frame has its own display duration, see MV_FILE_FRAME_DURATIONS.
+
+static inline
+uint32_t maxvid_file_is_frame_durations(MVFileHeader *fileHeaderPtr) {
+  uint32_t flags = fileHeaderPtr->versionAndFlags >> 8;
+  uint32_t isFrameDurations = flags & MV_FILE_FRAME_DURATIONS;
+  return isFrameDurations;
+}
+
+// Explicitly set the frame durations flag.
+
+static inline
+void maxvid_file_set_frame_durations(MVFileHeader *fileHeaderPtr) {
+  fileHeaderPtr->versionAndFlags |= (MV_FILE_FRAME_DURATIONS << 8);
+}
+
+// Return TRUE if the file contains reduced size levels, see MV_FILE_LEVELS.
+
+static inline
+uint32_t maxvid_file_is_levels(MVFileHeader *fileHeaderPtr) {
+  uint32_t flags = fileHeaderPtr->versionAndFlags >> 8;
+  uint32_t isLevels = flags & MV_FILE_LEVELS;
+  return isLevels;
+}
+
+// Explicitly set the levels flag.
+
+static inline
+void maxvid_file_set_levels(MVFileHeader *fileHeaderPtr) {
+  fileHeaderPtr->versionAndFlags |= (MV_FILE_LEVELS << 8);
+}
+
+// Return TRUE if the file contains palette frames, see MV_FILE_PALETTE.
+
+static inline
+uint32_t maxvid_file_is_palette(MVFileHeader *fileHeaderPtr) {
+  uint32_t flags = fileHeaderPtr->versionAndFlags >> 8;
+  uint32_t isPalette = flags & MV_FILE_PALETTE;
+  return isPalette;
+}
+
+// Explicitly set the palette flag.
+
+static inline
+void maxvid_file_set_palette(MVFileHeader *fileHeaderPtr) {
+  fileHeaderPtr->versionAndFlags |= (MV_FILE_PALETTE << 8);
+}
+
+// Return the width or height of the given level, level 0 is the full size.
+// Each level is half the size of the previous level, rounded up.
+
+static inline
+uint32_t maxvid_file_level_dimension(uint32_t fullDimension, uint32_t level) {
+  return (fullDimension + (1 << level) - 1) >> level;
+}
+
+// Get the file offset of the frame table in a file that has been mapped into
+// memory. The frame table follows the header unless the frames at end flag is
+// set, in that case the offset is read from the trailer at the end of the file.
+// The caller must make sure that fileNumBytes is large enough to hold the header
+// and the trailer.
+
+static inline
+uint64_t maxvid_file_frames_offset(void *mappedPtr, uint64_t fileNumBytes) {
+  MVFileHeader *fileHeaderPtr = (MVFileHeader *)mappedPtr;
+  if (maxvid_file_is_frames_at_end(fileHeaderPtr)) {
+    MVFileTrailer *trailerPtr = (MVFileTrailer *) ((char*)mappedPtr + fileNumBytes - sizeof(MVFileTrailer));
+    return trailerPtr->framesOffset;
+  } else {
+    return sizeof(MVFileHeader);
+  }
+}
+
+// Fill in the display start time in seconds of each frame, startTimes must hold
+// (numFrames + 1) entries and the last entry is set to the total duration. When
+// the frame durations flag is not set, each frame is displayed for frameDuration.
+
+void
+maxvid_file_frame_start_times(MVFileHeader *fileHeaderPtr, void *framesPtr, double *startTimes);
+
+// Return the index of the frame displayed at the given time, meaning the last
+// frame with a start time at or before the time. This is a binary search over
+// the start times returned by maxvid_file_frame_start_times(). Returns 0 when
+// numFrames is 0.
+
+uint32_t
+maxvid_file_frame_at_time(const double *startTimes, uint32_t numFrames, double time);
+
+// Return the level that should be decoded to display the video at width x height
+// pixels, this is the smallest level that is at least as large as the display in
+// both dimensions. Returns 0 when the full size level should be decoded, otherwise
+// a level number from 1 to numLevels, the MVLevel is at index (level - 1).
+
+uint32_t
+maxvid_file_select_level(const MVFileHeader *fileHeaderPtr, const MVLevel *levels,
+                         uint32_t width, uint32_t height);
+
 // adler32 calculation method
 
 uint32_t maxvid_adler32(
                         uint32_t adler,
                         unsigned char const *buf,
                         uint32_t len);
+
+#endif // MAXVID_FILE_H
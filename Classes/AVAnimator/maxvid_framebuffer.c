@@ -0,0 +1,127 @@
+// maxvid_framebuffer module
+//
+//  License terms defined in License.txt.
+//
+// This module implements page level copy on write for framebuffers.
+
+#include "maxvid_framebuffer.h"
+
+#include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS)
+# define MAP_ANONYMOUS MAP_ANON
+#endif // MAP_ANONYMOUS
+
+// A framebuffer is a whole number of file pages, or of system pages when
+// the system page size is larger than MV_PAGESIZE.
+
+static inline
+size_t maxvid_framebuffer_pagesize(void) {
+  size_t pagesize = (size_t) getpagesize();
+  return (pagesize > MV_PAGESIZE) ? pagesize : MV_PAGESIZE;
+}
+
+static inline
+size_t maxvid_framebuffer_num_bytes_allocated(size_t numBytes) {
+  size_t pagesize = maxvid_framebuffer_pagesize();
+  return (numBytes + pagesize - 1) & ~(pagesize - 1);
+}
+
+void*
+maxvid_framebuffer_alloc(size_t numBytes)
+{
+  return maxvid_framebuffer_alloc_flags(numBytes, 0);
+}
+
+// Huge pages are used via madvise() and not MAP_HUGETLB since a hugetlbfs mapping
+// can't be partly replaced with a file mapping by maxvid_framebuffer_map() and it
+// needs pages reserved by the administrator.
+
+void*
+maxvid_framebuffer_alloc_flags(size_t numBytes, uint32_t flags)
+{
+  size_t numBytesAllocated = maxvid_framebuffer_num_bytes_allocated(numBytes);
+
+  if ((flags & MV_FRAMEBUFFER_HUGEPAGES) == 0) {
+    void *frameBuffer = mmap(NULL, numBytesAllocated, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (frameBuffer == MAP_FAILED) {
+      return NULL;
+    }
+    return frameBuffer;
+  }
+
+  // Map an extra huge page and then unmap the head and tail so that the
+  // framebuffer starts on a huge page bound.
+
+  size_t mappedNumBytes = numBytesAllocated + MV_HUGEPAGESIZE;
+  char *mappedPtr = mmap(NULL, mappedNumBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (mappedPtr == MAP_FAILED) {
+    return NULL;
+  }
+
+  char *frameBuffer = (char*) ((((size_t)mappedPtr) + MV_HUGEPAGESIZE - 1) & ~((size_t)MV_HUGEPAGESIZE - 1));
+  size_t headNumBytes = frameBuffer - mappedPtr;
+  size_t tailNumBytes = mappedNumBytes - headNumBytes - numBytesAllocated;
+
+  if (headNumBytes > 0) {
+    munmap(mappedPtr, headNumBytes);
+  }
+  if (tailNumBytes > 0) {
+    munmap(frameBuffer + numBytesAllocated, tailNumBytes);
+  }
+
+#if defined(MADV_HUGEPAGE)
+  madvise(frameBuffer, numBytesAllocated, MADV_HUGEPAGE);
+#endif // MADV_HUGEPAGE
+
+  return frameBuffer;
+}
+
+void
+maxvid_framebuffer_free(void *frameBuffer, size_t numBytes)
+{
+  if (frameBuffer == NULL) {
+    return;
+  }
+  munmap(frameBuffer, maxvid_framebuffer_num_bytes_allocated(numBytes));
+}
+
+uint32_t
+maxvid_framebuffer_map(void *frameBuffer, size_t numBytes, int fd, uint64_t offset, uint64_t fileNumBytes)
+{
+  const size_t pagesize = (size_t) getpagesize();
+  const size_t numBytesAllocated = maxvid_framebuffer_num_bytes_allocated(numBytes);
+
+  // The file offset must be on a system page bound, a keyframe is always on
+  // a MV_PAGESIZE bound but the system page size can be larger.
+
+  if (fd == -1 || (offset % pagesize) != 0 || (((size_t)frameBuffer) % pagesize) != 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // Reading a page that is completely past the end of the file would raise
+  // SIGBUS, the part of the last page past the end of the file reads as zero.
+
+  uint64_t fileNumBytesInPages = (fileNumBytes + pagesize - 1) & ~((uint64_t)pagesize - 1);
+
+  if (offset > fileNumBytesInPages || (fileNumBytesInPages - offset) < numBytesAllocated) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  void *mappedPtr = mmap(frameBuffer, numBytesAllocated, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t)offset);
+
+  if (mappedPtr == MAP_FAILED) {
+    // A failed MAP_FIXED can discard the existing pages, so replace them
+    // with zeroed pages. The caller copies the pixels in this case.
+
+    mappedPtr = mmap(frameBuffer, numBytesAllocated, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    assert(mappedPtr == frameBuffer);
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  assert(mappedPtr == frameBuffer);
+
+  return 0;
+}
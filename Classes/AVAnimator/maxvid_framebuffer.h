@@ -0,0 +1,49 @@
+// maxvid_framebuffer module
+//
+//  License terms defined in License.txt.
+//
+// This module implements page level copy on write for framebuffers on systems
+// that do not provide the Mach vm_copy() call used by CGFrameBuffer. A keyframe
+// is stored in the .mvid file on a page bound, so instead of copying the pixels
+// the framebuffer pages are remapped MAP_PRIVATE from the file. Pages are then
+// shared with the page cache until a delta frame writes to them, only the pages
+// a delta actually dirties get physically copied. For mostly static content
+// this avoids most of the memory bandwidth of a full keyframe copy. When the
+// keyframe can't be mapped, for example when the system page size is larger
+// than the file page size, the pixels are copied with memcpy().
+
+#ifndef MAXVID_FRAMEBUFFER_H
+#define MAXVID_FRAMEBUFFER_H
+
+#include "maxvid_file.h"
+
+// Allocate a zeroed, page aligned framebuffer that is at least numBytes long.
+// The framebuffer must be released with maxvid_framebuffer_free() and not free()
+// since the pages can be replaced by a file mapping. Returns NULL on failure.
+
+void*
+maxvid_framebuffer_alloc(size_t numBytes);
+
+// Start the framebuffer on a MV_HUGEPAGESIZE bound and ask the kernel to back it
+// with transparent huge pages (MADV_HUGEPAGE on Linux). A 4K 32 BPP frame then
+// needs 16 TLB entries instead of 8100. Has no effect on the kernel side when
+// huge pages are not supported, the framebuffer is then just aligned.
+
+#define MV_FRAMEBUFFER_HUGEPAGES 0x1
+
+void*
+maxvid_framebuffer_alloc_flags(size_t numBytes, uint32_t flags);
+
+void
+maxvid_framebuffer_free(void *frameBuffer, size_t numBytes);
+
+// Replace the contents of a framebuffer allocated with maxvid_framebuffer_alloc()
+// with the numBytes located at offset in the file fd that is fileNumBytes long.
+// The file must not be modified while it is mapped. Returns 0 when the pages were
+// mapped copy on write, otherwise MV_ERROR_CODE_INVALID_INPUT and the caller should
+// then copy the pixels.
+
+uint32_t
+maxvid_framebuffer_map(void *frameBuffer, size_t numBytes, int fd, uint64_t offset, uint64_t fileNumBytes);
+
+#endif // MAXVID_FRAMEBUFFER_H
@@ -0,0 +1,271 @@
+// maxvid_palette module
+//
+//  License terms defined in License.txt.
+//
+// This module implements encoding and decoding of 8 bit palette frames,
+// see maxvid_palette.h.
+
+#include "maxvid_palette.h"
+
+#include "maxvid_blit.h"
+
+// A run of at least this many pixels of the same color is emitted as a DUP,
+// a shorter run costs less as bytes in a COPY than ending the COPY.
+
+#define MV_PALETTE_MIN_DUP 8
+
+// A run of at least this many unchanged pixels is emitted as a SKIP, a
+// shorter run is included in the COPY so that the COPY is not split.
+
+#define MV_PALETTE_MIN_SKIP 4
+
+// Return the index of a color, the color is added to the palette when it is
+// not already in it. Returns MV_PALETTE_MAX_COLORS when the palette is full.
+
+static inline
+uint32_t maxvid_palette_index(MVPalette *palette, const uint32_t color) {
+  uint32_t slot = ((color * 2654435761U) >> 16) & (MV_PALETTE_HASH_SIZE - 1);
+
+  while (1) {
+    const uint32_t index = palette->hashIndexes[slot];
+
+    if (index == 0) {
+      if (palette->numColors == MV_PALETTE_MAX_COLORS) {
+        return MV_PALETTE_MAX_COLORS;
+      }
+      palette->colors[palette->numColors] = color;
+      palette->hashColors[slot] = color;
+      palette->hashIndexes[slot] = ++palette->numColors;
+      return palette->numColors - 1;
+    } else if (palette->hashColors[slot] == color) {
+      return index - 1;
+    }
+
+    slot = (slot + 1) & (MV_PALETTE_HASH_SIZE - 1);
+  }
+}
+
+// Emit a SKIP or DUP code, a run that does not fit in 22 bits is split
+
+static inline
+uint32_t* maxvid_palette_emit_run(uint32_t *codePtr, MV_GENERIC_CODE opCode, uint32_t num, const uint32_t index) {
+  while (num > 0) {
+    const uint32_t numInCode = (num > MV_MAX_22_BITS) ? MV_MAX_22_BITS : num;
+    *codePtr++ = maxvid_palette_code(opCode, numInCode, index);
+    num -= numInCode;
+  }
+  return codePtr;
+}
+
+// Emit a COPY code followed by the index of each pixel. Returns NULL when
+// the palette is full.
+
+static inline
+uint32_t* maxvid_palette_emit_copy(MVPalette *palette, uint32_t *codePtr, const uint32_t *pixels, uint32_t num) {
+  uint32_t lastColor = 0;
+  uint32_t lastIndex = MV_PALETTE_MAX_COLORS;
+
+  while (num > 0) {
+    const uint32_t numInCode = (num > MV_MAX_22_BITS) ? MV_MAX_22_BITS : num;
+    *codePtr++ = maxvid_palette_code(COPY, numInCode, 0);
+
+    uint8_t *bytePtr = (uint8_t*) codePtr;
+
+    for (uint32_t i = 0; i < numInCode; i++) {
+      const uint32_t color = pixels[i];
+      if (color != lastColor || lastIndex == MV_PALETTE_MAX_COLORS) {
+        lastIndex = maxvid_palette_index(palette, color);
+        if (lastIndex == MV_PALETTE_MAX_COLORS) {
+          return NULL;
+        }
+        lastColor = color;
+      }
+      bytePtr[i] = (uint8_t) lastIndex;
+    }
+
+    for (uint32_t i = numInCode; (i & 0x3) != 0; i++) {
+      bytePtr[i] = 0;
+    }
+
+    codePtr += (numInCode + 3) >> 2;
+    pixels += numInCode;
+    num -= numInCode;
+  }
+
+  return codePtr;
+}
+
+// Return the end of the changed pixels that begin at offset, this is the
+// start of the first run of MV_PALETTE_MIN_SKIP unchanged pixels.
+
+static inline
+uint32_t maxvid_palette_span_end(const uint32_t *prevPixels, const uint32_t *pixels, uint32_t offset, const uint32_t numPixels) {
+  uint32_t numUnchanged = 0;
+
+  for ( ; offset < numPixels; offset++) {
+    if (prevPixels[offset] == pixels[offset]) {
+      if (++numUnchanged == MV_PALETTE_MIN_SKIP) {
+        return offset + 1 - numUnchanged;
+      }
+    } else {
+      numUnchanged = 0;
+    }
+  }
+
+  return numPixels;
+}
+
+uint32_t
+maxvid_palette_encode(MVPalette *palette,
+                      const uint32_t * restrict prevPixels,
+                      const uint32_t * restrict pixels,
+                      const uint32_t numPixels,
+                      uint32_t * restrict outWords,
+                      uint32_t *outNumWords)
+{
+  palette->numColors = 0;
+  memset(palette->hashIndexes, 0, sizeof(palette->hashIndexes));
+
+  // Codes are emitted after room for a full palette, then moved down to
+  // follow the colors that were actually used.
+
+  uint32_t * const codesStart = outWords + 1 + MV_PALETTE_MAX_COLORS;
+  uint32_t *codePtr = codesStart;
+  uint32_t offset = 0;
+
+  while (offset < numPixels) {
+    if (prevPixels != NULL && prevPixels[offset] == pixels[offset]) {
+      uint32_t skipEnd = offset + 1;
+      while (skipEnd < numPixels && prevPixels[skipEnd] == pixels[skipEnd]) {
+        skipEnd++;
+      }
+
+      // Unchanged pixels at the end of the frame need no code
+
+      if (skipEnd == numPixels) {
+        break;
+      }
+
+      codePtr = maxvid_palette_emit_run(codePtr, SKIP, skipEnd - offset, 0);
+      offset = skipEnd;
+      continue;
+    }
+
+    const uint32_t spanEnd = (prevPixels == NULL) ? numPixels : maxvid_palette_span_end(prevPixels, pixels, offset, numPixels);
+    uint32_t copyStart = offset;
+
+    while (offset < spanEnd) {
+      const uint32_t color = pixels[offset];
+      uint32_t runEnd = offset + 1;
+      while (runEnd < spanEnd && pixels[runEnd] == color) {
+        runEnd++;
+      }
+
+      if ((runEnd - offset) >= MV_PALETTE_MIN_DUP) {
+        if (offset > copyStart) {
+          codePtr = maxvid_palette_emit_copy(palette, codePtr, &pixels[copyStart], offset - copyStart);
+          if (codePtr == NULL) {
+            return MV_ERROR_CODE_INVALID_INPUT;
+          }
+        }
+
+        const uint32_t index = maxvid_palette_index(palette, color);
+        if (index == MV_PALETTE_MAX_COLORS) {
+          return MV_ERROR_CODE_INVALID_INPUT;
+        }
+
+        codePtr = maxvid_palette_emit_run(codePtr, DUP, runEnd - offset, index);
+        copyStart = runEnd;
+      }
+
+      offset = runEnd;
+    }
+
+    if (spanEnd > copyStart) {
+      codePtr = maxvid_palette_emit_copy(palette, codePtr, &pixels[copyStart], spanEnd - copyStart);
+      if (codePtr == NULL) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+    }
+  }
+
+  *codePtr++ = maxvid_palette_code(DONE, 0, 0);
+
+  const uint32_t numColors = palette->numColors;
+  const uint32_t numCodeWords = (uint32_t) (codePtr - codesStart);
+
+  outWords[0] = numColors;
+  memcpy(&outWords[1], palette->colors, numColors * sizeof(uint32_t));
+  memmove(&outWords[1 + numColors], codesStart, numCodeWords * sizeof(uint32_t));
+
+  *outNumWords = 1 + numColors + numCodeWords;
+
+  return 0;
+}
+
+uint32_t
+maxvid_palette_decode(uint32_t * restrict frameBuffer32,
+                      const uint32_t * restrict inputBuffer32,
+                      const uint32_t inputBuffer32NumWords,
+                      const uint32_t frameBufferSize)
+{
+  // The palette must be followed by at least the DONE code
+
+  if (inputBuffer32NumWords < 2) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  const uint32_t numColors = inputBuffer32[0];
+
+  if (numColors > MV_PALETTE_MAX_COLORS || numColors > (inputBuffer32NumWords - 2)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // A full table is used so that any 8 bit index can be looked up
+
+  uint32_t colors[MV_PALETTE_MAX_COLORS];
+  memcpy(colors, &inputBuffer32[1], numColors * sizeof(uint32_t));
+  memset(&colors[numColors], 0, (MV_PALETTE_MAX_COLORS - numColors) * sizeof(uint32_t));
+
+  uint32_t * restrict outPtr = frameBuffer32;
+  const uint32_t * const outEnd = frameBuffer32 + frameBufferSize;
+  const uint32_t * restrict inPtr = inputBuffer32 + 1 + numColors;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    const uint32_t inW1 = *inPtr++;
+    const uint32_t opCode = (inW1 >> 8) & MV_MAX_2_BITS;
+    const uint32_t numPixels = inW1 >> (8+2);
+    const uint32_t index = inW1 & MV_MAX_8_BITS;
+
+    if (opCode == DONE) {
+      return 0;
+    }
+
+    if (numPixels == 0 || numPixels > (uint32_t)(outEnd - outPtr)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if (opCode == SKIP) {
+      outPtr += numPixels;
+    } else if (opCode == DUP) {
+      maxvid_blit_fill32(outPtr, colors[index], numPixels);
+      outPtr += numPixels;
+    } else {
+      const uint32_t numWords = (numPixels + 3) >> 2;
+      if (numWords > (uint32_t)(inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      const uint8_t *bytePtr = (const uint8_t *) inPtr;
+      for (uint32_t i = 0; i < numPixels; i++) {
+        outPtr[i] = colors[bytePtr[i]];
+      }
+      outPtr += numPixels;
+      inPtr += numWords;
+    }
+  }
+
+  // No DONE code found before the end of the input
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
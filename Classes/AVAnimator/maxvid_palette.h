@@ -0,0 +1,89 @@
+// maxvid_palette module
+//
+//  License terms defined in License.txt.
+//
+// This module implements 8 bit palette frames. Content like an animated GIF
+// or a palette APNG has at most 256 colors in a frame, so each pixel can be
+// stored as a one byte index into a table of 24 or 32 bit pixels instead of
+// as a whole word. A palette frame is decoded straight into the 32 bit
+// framebuffer, so the framebuffer format does not change and the decoder
+// reads 1/4 as many bytes for each pixel that changes.
+//
+// The data for a palette frame is a word with the number of colors, then the
+// colors in the same format as framebuffer pixels, then c4 style word codes
+// that operate on indexes. A code word contains a 22 bit num, a 2 bit op and
+// an 8 bit index in the same layout as a 32 BPP c4 code:
+//
+// SKIP : skip over num pixels, the index is zero
+// DUP  : write the color at index to num pixels
+// COPY : num indexes follow as bytes, zero padded to a whole word
+// DONE : end of the codes, num and index are zero
+//
+// A palette keyframe has no SKIP codes, every pixel is written. Each frame
+// has its own palette, a SKIP in a delta frame leaves the previous 32 bit
+// pixel as is, so the palette can change from one frame to the next.
+
+#ifndef MAXVID_PALETTE_H
+#define MAXVID_PALETTE_H
+
+#include "maxvid_decode.h"
+
+#define MV_PALETTE_MAX_COLORS 256
+
+// Open addressing hash table from color to index, at most half full
+
+#define MV_PALETTE_HASH_SIZE (MV_PALETTE_MAX_COLORS * 4)
+
+typedef struct {
+  uint32_t numColors;
+  uint32_t colors[MV_PALETTE_MAX_COLORS];
+  // The slot is empty when the index is zero, otherwise index - 1 is the
+  // position in colors.
+  uint32_t hashColors[MV_PALETTE_HASH_SIZE];
+  uint16_t hashIndexes[MV_PALETTE_HASH_SIZE];
+} MVPalette;
+
+static inline
+uint32_t
+maxvid_palette_code(MV_GENERIC_CODE opCode, const uint32_t num, const uint32_t index) {
+  return (num << (8+2)) | (((uint32_t)opCode) << 8) | index;
+}
+
+// Max number of words a frame of numPixels can be encoded as, a COPY of one
+// pixel is the worst case at 2 words for each pixel.
+
+static inline
+uint32_t
+maxvid_palette_max_num_words(const uint32_t numPixels) {
+  return 1 + MV_PALETTE_MAX_COLORS + (2 * numPixels) + 1;
+}
+
+// Encode the pixels that differ from prevPixels as a palette frame, when
+// prevPixels is NULL every pixel is encoded as a keyframe. The outWords buffer
+// must hold maxvid_palette_max_num_words() words and the number of words
+// written is returned in outNumWords. After a delta frame is encoded, the
+// numColors in the palette is zero when no pixels changed. Returns 0 on
+// success, or MV_ERROR_CODE_INVALID_INPUT when the pixels that changed have
+// more than MV_PALETTE_MAX_COLORS colors.
+
+uint32_t
+maxvid_palette_encode(MVPalette *palette,
+                      const uint32_t * restrict prevPixels,
+                      const uint32_t * restrict pixels,
+                      const uint32_t numPixels,
+                      uint32_t * restrict outWords,
+                      uint32_t *outNumWords);
+
+// Decode a palette frame into a 32 bit framebuffer of frameBufferSize pixels.
+// Each code is checked so that nothing outside of the input and the
+// framebuffer is accessed, an index past the end of the palette is decoded as
+// a zero pixel. Returns 0 on success or MV_ERROR_CODE_INVALID_INPUT as soon
+// as an invalid code is found.
+
+uint32_t
+maxvid_palette_decode(uint32_t * restrict frameBuffer32,
+                      const uint32_t * restrict inputBuffer32,
+                      const uint32_t inputBuffer32NumWords,
+                      const uint32_t frameBufferSize);
+
+#endif // MAXVID_PALETTE_H
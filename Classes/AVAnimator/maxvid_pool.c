@@ -0,0 +1,264 @@
+// maxvid_pool module
+//
+//  License terms defined in License.txt.
+//
+// This module implements a shared pool of framebuffer memory.
+
+#include "maxvid_pool.h"
+
+#include <pthread.h>
+
+typedef struct {
+  void *ptr;
+  size_t numBytes;
+} MVPoolBlock;
+
+// Cached blocks are kept in release order, so the most recently released block
+// (the one most likely to still be in the CPU cache) is reused first and the
+// oldest block is unmapped first.
+
+static pthread_mutex_t maxvid_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static MVPoolBlock maxvid_pool_cached[MV_POOL_MAX_CACHED];
+static int maxvid_pool_num_cached = 0;
+static MVPoolStats maxvid_pool_stats_data;
+
+static inline
+size_t maxvid_pool_pagesize(void) {
+  size_t pagesize = (size_t) getpagesize();
+  return (pagesize > MV_PAGESIZE) ? pagesize : MV_PAGESIZE;
+}
+
+static inline
+size_t maxvid_pool_round_up(size_t numBytes, size_t granularity) {
+  return (numBytes + granularity - 1) / granularity * granularity;
+}
+
+// Size classes are spaced 1/8 of the nearest smaller power of two apart, so that
+// at most 12.5% of a buffer is wasted while a small change in the dimensions of
+// a movie still maps to the same class. Large classes are a multiple of the huge
+// page size.
+
+size_t
+maxvid_pool_size_class(size_t numBytes)
+{
+  size_t pagesize = maxvid_pool_pagesize();
+  size_t numBytesInPages = maxvid_pool_round_up((numBytes == 0) ? 1 : numBytes, pagesize);
+
+  size_t pow2 = 1;
+  while ((pow2 << 1) != 0 && (pow2 << 1) <= numBytesInPages) {
+    pow2 <<= 1;
+  }
+
+  size_t granularity = pow2 / 8;
+  if (granularity < pagesize) {
+    granularity = pagesize;
+  }
+  if (numBytesInPages >= MV_HUGEPAGESIZE && granularity < MV_HUGEPAGESIZE) {
+    granularity = MV_HUGEPAGESIZE;
+  }
+
+  return maxvid_pool_round_up(numBytesInPages, granularity);
+}
+
+// Blocks at least as large as a huge page are allocated with huge pages
+
+static inline
+void* maxvid_pool_map(size_t numBytes) {
+  uint32_t flags = (numBytes >= MV_HUGEPAGESIZE) ? MV_FRAMEBUFFER_HUGEPAGES : 0;
+  return maxvid_framebuffer_alloc_flags(numBytes, flags);
+}
+
+// Remove the oldest cached blocks until the pool holds no more than maxNumBytes,
+// the blocks to unmap are returned in unmapBlocks so that munmap() can be
+// invoked after the lock has been released. Must be invoked with the lock held.
+
+static
+int maxvid_pool_evict(uint64_t maxNumBytes, MVPoolBlock *unmapBlocks)
+{
+  MVPoolStats *stats = &maxvid_pool_stats_data;
+  int numEvicted = 0;
+
+  while (maxvid_pool_num_cached > numEvicted &&
+         (stats->numBytesInUse + stats->numBytesCached) > maxNumBytes) {
+    MVPoolBlock block = maxvid_pool_cached[numEvicted];
+    unmapBlocks[numEvicted++] = block;
+    stats->numBytesCached -= block.numBytes;
+  }
+
+  if (numEvicted > 0) {
+    memmove(&maxvid_pool_cached[0], &maxvid_pool_cached[numEvicted],
+            (maxvid_pool_num_cached - numEvicted) * sizeof(MVPoolBlock));
+    maxvid_pool_num_cached -= numEvicted;
+  }
+
+  return numEvicted;
+}
+
+static
+void maxvid_pool_unmap_blocks(MVPoolBlock *blocks, int numBlocks)
+{
+  for (int i = 0; i < numBlocks; i++) {
+    maxvid_framebuffer_free(blocks[i].ptr, blocks[i].numBytes);
+  }
+}
+
+static inline
+void maxvid_pool_update_high_water(void) {
+  MVPoolStats *stats = &maxvid_pool_stats_data;
+  uint64_t numBytes = stats->numBytesInUse + stats->numBytesCached;
+  if (stats->numBytesInUse > stats->maxNumBytesInUse) {
+    stats->maxNumBytesInUse = stats->numBytesInUse;
+  }
+  if (numBytes > stats->maxNumBytes) {
+    stats->maxNumBytes = numBytes;
+  }
+}
+
+void*
+maxvid_pool_acquire(size_t numBytes)
+{
+  MVPoolStats *stats = &maxvid_pool_stats_data;
+  const size_t classNumBytes = maxvid_pool_size_class(numBytes);
+  MVPoolBlock unmapBlocks[MV_POOL_MAX_CACHED];
+  int numUnmapBlocks = 0;
+  void *ptr = NULL;
+
+  pthread_mutex_lock(&maxvid_pool_mutex);
+
+  stats->numAcquired++;
+
+  for (int i = maxvid_pool_num_cached - 1; i >= 0; i--) {
+    if (maxvid_pool_cached[i].numBytes == classNumBytes) {
+      ptr = maxvid_pool_cached[i].ptr;
+      memmove(&maxvid_pool_cached[i], &maxvid_pool_cached[i+1],
+              (maxvid_pool_num_cached - i - 1) * sizeof(MVPoolBlock));
+      maxvid_pool_num_cached--;
+      stats->numBytesCached -= classNumBytes;
+      stats->numReused++;
+      break;
+    }
+  }
+
+  if (ptr == NULL && stats->budgetNumBytes > 0) {
+    // Make room for a new block by unmapping cached blocks of other sizes
+
+    if (stats->budgetNumBytes >= classNumBytes) {
+      numUnmapBlocks = maxvid_pool_evict(stats->budgetNumBytes - classNumBytes, unmapBlocks);
+    }
+
+    if ((stats->numBytesInUse + classNumBytes) > stats->budgetNumBytes) {
+      stats->numOverBudget++;
+      pthread_mutex_unlock(&maxvid_pool_mutex);
+      maxvid_pool_unmap_blocks(unmapBlocks, numUnmapBlocks);
+      return NULL;
+    }
+  }
+
+  // The bytes are counted as in use before the new block is mapped so that
+  // another thread can't go over budget while this thread is in mmap().
+
+  stats->numBytesInUse += classNumBytes;
+  maxvid_pool_update_high_water();
+
+  pthread_mutex_unlock(&maxvid_pool_mutex);
+
+  maxvid_pool_unmap_blocks(unmapBlocks, numUnmapBlocks);
+
+  if (ptr != NULL) {
+    // A reused block can contain pixels from another movie
+
+    memset(ptr, 0, classNumBytes);
+    return ptr;
+  }
+
+  ptr = maxvid_pool_map(classNumBytes);
+
+  if (ptr == NULL) {
+    pthread_mutex_lock(&maxvid_pool_mutex);
+    stats->numBytesInUse -= classNumBytes;
+    pthread_mutex_unlock(&maxvid_pool_mutex);
+  }
+
+  return ptr;
+}
+
+void
+maxvid_pool_release(void *ptr, size_t numBytes)
+{
+  MVPoolStats *stats = &maxvid_pool_stats_data;
+  const size_t classNumBytes = maxvid_pool_size_class(numBytes);
+  MVPoolBlock unmapBlocks[MV_POOL_MAX_CACHED + 1];
+  int numUnmapBlocks = 0;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&maxvid_pool_mutex);
+
+  assert(stats->numBytesInUse >= classNumBytes);
+  stats->numBytesInUse -= classNumBytes;
+
+  if (maxvid_pool_num_cached == MV_POOL_MAX_CACHED) {
+    unmapBlocks[numUnmapBlocks++] = maxvid_pool_cached[0];
+    stats->numBytesCached -= maxvid_pool_cached[0].numBytes;
+    memmove(&maxvid_pool_cached[0], &maxvid_pool_cached[1],
+            (maxvid_pool_num_cached - 1) * sizeof(MVPoolBlock));
+    maxvid_pool_num_cached--;
+  }
+
+  maxvid_pool_cached[maxvid_pool_num_cached].ptr = ptr;
+  maxvid_pool_cached[maxvid_pool_num_cached].numBytes = classNumBytes;
+  maxvid_pool_num_cached++;
+  stats->numBytesCached += classNumBytes;
+
+  // A buffer released when the pool is over budget, which can happen after
+  // the budget was lowered, is unmapped along with older cached blocks.
+
+  if (stats->budgetNumBytes > 0) {
+    numUnmapBlocks += maxvid_pool_evict(stats->budgetNumBytes, &unmapBlocks[numUnmapBlocks]);
+  }
+
+  maxvid_pool_update_high_water();
+
+  pthread_mutex_unlock(&maxvid_pool_mutex);
+
+  maxvid_pool_unmap_blocks(unmapBlocks, numUnmapBlocks);
+}
+
+void
+maxvid_pool_set_budget(uint64_t numBytes)
+{
+  MVPoolBlock unmapBlocks[MV_POOL_MAX_CACHED];
+  int numUnmapBlocks = 0;
+
+  pthread_mutex_lock(&maxvid_pool_mutex);
+  maxvid_pool_stats_data.budgetNumBytes = numBytes;
+  if (numBytes > 0) {
+    numUnmapBlocks = maxvid_pool_evict(numBytes, unmapBlocks);
+  }
+  pthread_mutex_unlock(&maxvid_pool_mutex);
+
+  maxvid_pool_unmap_blocks(unmapBlocks, numUnmapBlocks);
+}
+
+void
+maxvid_pool_trim(void)
+{
+  MVPoolBlock unmapBlocks[MV_POOL_MAX_CACHED];
+  int numUnmapBlocks;
+
+  pthread_mutex_lock(&maxvid_pool_mutex);
+  numUnmapBlocks = maxvid_pool_evict(0, unmapBlocks);
+  pthread_mutex_unlock(&maxvid_pool_mutex);
+
+  maxvid_pool_unmap_blocks(unmapBlocks, numUnmapBlocks);
+}
+
+void
+maxvid_pool_stats(MVPoolStats *stats)
+{
+  pthread_mutex_lock(&maxvid_pool_mutex);
+  *stats = maxvid_pool_stats_data;
+  pthread_mutex_unlock(&maxvid_pool_mutex);
+}
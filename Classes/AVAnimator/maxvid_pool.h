@@ -0,0 +1,66 @@
+// maxvid_pool module
+//
+//  License terms defined in License.txt.
+//
+// This module implements a process wide pool of framebuffer memory that is
+// shared by all decoders and converters. Each request is rounded up to a size
+// class and a released buffer is kept so that the next request in the same size
+// class reuses memory that is already mapped and paged in instead of calling
+// into the kernel and page faulting fresh pages. Buffers of 2 MB or more are
+// allocated on a 2 MB bound so that the kernel can back them with huge pages.
+// An optional budget limits the total memory held by the pool, buffers in use
+// plus cached buffers, and high water marks are recorded for tuning.
+
+#ifndef MAXVID_POOL_H
+#define MAXVID_POOL_H
+
+#include "maxvid_framebuffer.h"
+
+// Max number of released buffers kept for reuse, the oldest is unmapped first
+
+#define MV_POOL_MAX_CACHED 32
+
+typedef struct {
+  uint64_t budgetNumBytes;
+  uint64_t numBytesInUse;
+  uint64_t numBytesCached;
+  // High water marks for buffers in use and for all memory held by the pool
+  uint64_t maxNumBytesInUse;
+  uint64_t maxNumBytes;
+  uint32_t numAcquired;
+  uint32_t numReused;
+  uint32_t numOverBudget;
+} MVPoolStats;
+
+// Return the number of bytes actually allocated for a request of numBytes,
+// this is always a whole number of pages.
+
+size_t
+maxvid_pool_size_class(size_t numBytes);
+
+// Acquire a zeroed, page aligned buffer of at least numBytes. Returns NULL
+// if the buffer would put the pool over budget or if memory can't be mapped.
+
+void*
+maxvid_pool_acquire(size_t numBytes);
+
+// Release a buffer, numBytes must be the value passed to maxvid_pool_acquire()
+
+void
+maxvid_pool_release(void *ptr, size_t numBytes);
+
+// Set the max number of bytes held by the pool, 0 means no limit. Cached
+// buffers are unmapped as needed to stay under the budget.
+
+void
+maxvid_pool_set_budget(uint64_t numBytes);
+
+// Unmap all cached buffers, for example on a low memory warning
+
+void
+maxvid_pool_trim(void);
+
+void
+maxvid_pool_stats(MVPoolStats *stats);
+
+#endif // MAXVID_POOL_H
@@ -0,0 +1,163 @@
+// maxvid_ring module
+//
+//  License terms defined in License.txt.
+//
+// This module implements a lock free ring of decoded frames.
+//
+// A producer takes ownership of a slot by swapping the slot sequence number
+// for MV_RING_SLOT_WRITING and then checking that no consumer holds the slot.
+// A consumer increments the slot ref count and then checks that the slot is
+// not being written. Since both sides write first and read second with
+// sequentially consistent atomics, at least one side sees the other and
+// backs off, so a frame is never released while a consumer holds it.
+
+#include "maxvid_ring.h"
+
+// Store value in an atomic double if it is larger than the current value
+
+static inline
+void maxvid_ring_store_max(_Atomic double *ptr, double value) {
+  double current = atomic_load(ptr);
+  while (value > current && !atomic_compare_exchange_weak(ptr, &current, value)) {
+    // current was updated by the failed exchange
+  }
+}
+
+uint32_t
+maxvid_ring_init(MVFrameRing *ring, uint32_t numSlots, MVFrameRingReleaseFunc releaseFunc)
+{
+  memset(ring, 0, sizeof(MVFrameRing));
+
+  if (numSlots == 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  ring->slots = calloc(numSlots, sizeof(MVFrameRingSlot));
+  if (ring->slots == NULL) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  ring->numSlots = numSlots;
+  ring->releaseFunc = releaseFunc;
+
+  for (uint32_t i = 0; i < numSlots; i++) {
+    atomic_init(&ring->slots[i].seq, 0);
+    atomic_init(&ring->slots[i].numRefs, 0);
+  }
+  atomic_init(&ring->nextSeq, 1);
+  atomic_init(&ring->consumedTime, -1.0);
+  atomic_init(&ring->requestedTime, -1.0);
+
+  return 0;
+}
+
+void
+maxvid_ring_free(MVFrameRing *ring)
+{
+  if (ring->slots == NULL) {
+    return;
+  }
+  maxvid_ring_flush(ring);
+  free(ring->slots);
+  ring->slots = NULL;
+  ring->numSlots = 0;
+}
+
+void
+maxvid_ring_flush(MVFrameRing *ring)
+{
+  for (uint32_t i = 0; i < ring->numSlots; i++) {
+    MVFrameRingSlot *slot = &ring->slots[i];
+    assert(atomic_load(&slot->numRefs) == 0);
+    uint64_t seq = atomic_exchange(&slot->seq, 0);
+    assert(seq != MV_RING_SLOT_WRITING);
+    if (seq != 0 && ring->releaseFunc != NULL) {
+      ring->releaseFunc(slot->frame);
+    }
+    slot->frame = NULL;
+  }
+  atomic_store(&ring->consumedTime, -1.0);
+  atomic_store(&ring->requestedTime, -1.0);
+}
+
+uint32_t
+maxvid_ring_push(MVFrameRing *ring, void *frame, uint32_t frameIndex, double presentationTime)
+{
+  for (uint32_t i = 0; i < ring->numSlots; i++) {
+    MVFrameRingSlot *slot = &ring->slots[i];
+    uint64_t seq = atomic_load(&slot->seq);
+
+    if (seq == MV_RING_SLOT_WRITING) {
+      continue;
+    }
+    if (!atomic_compare_exchange_strong(&slot->seq, &seq, MV_RING_SLOT_WRITING)) {
+      // Another producer claimed the slot
+      continue;
+    }
+
+    // The slot can't be reused while a consumer holds it or before the frame
+    // in it has been passed over by a consumer.
+
+    if (atomic_load(&slot->numRefs) != 0 ||
+        (seq != 0 && slot->presentationTime >= atomic_load(&ring->consumedTime))) {
+      atomic_store(&slot->seq, seq);
+      continue;
+    }
+
+    void *reclaimedFrame = slot->frame;
+
+    slot->frame = frame;
+    slot->frameIndex = frameIndex;
+    slot->presentationTime = presentationTime;
+    atomic_store(&slot->seq, atomic_fetch_add(&ring->nextSeq, 1));
+
+    if (seq != 0 && ring->releaseFunc != NULL) {
+      ring->releaseFunc(reclaimedFrame);
+    }
+
+    return 0;
+  }
+
+  return MV_ERROR_CODE_INVALID_OUTPUT;
+}
+
+MVFrameRingSlot*
+maxvid_ring_acquire(MVFrameRing *ring, double displayTime)
+{
+  MVFrameRingSlot *bestSlot = NULL;
+
+  maxvid_ring_store_max(&ring->requestedTime, displayTime);
+
+  for (uint32_t i = 0; i < ring->numSlots; i++) {
+    MVFrameRingSlot *slot = &ring->slots[i];
+
+    atomic_fetch_add(&slot->numRefs, 1);
+    uint64_t seq = atomic_load(&slot->seq);
+
+    if (seq == 0 || seq == MV_RING_SLOT_WRITING ||
+        slot->presentationTime > displayTime ||
+        (bestSlot != NULL && slot->presentationTime <= bestSlot->presentationTime)) {
+      atomic_fetch_sub(&slot->numRefs, 1);
+      continue;
+    }
+
+    if (bestSlot != NULL) {
+      atomic_fetch_sub(&bestSlot->numRefs, 1);
+    }
+    bestSlot = slot;
+  }
+
+  if (bestSlot != NULL) {
+    maxvid_ring_store_max(&ring->consumedTime, bestSlot->presentationTime);
+  }
+
+  return bestSlot;
+}
+
+void
+maxvid_ring_release(MVFrameRing *ring, MVFrameRingSlot *slot)
+{
+  uint32_t numRefs = atomic_fetch_sub(&slot->numRefs, 1);
+  assert(numRefs > 0);
+  (void)numRefs;
+  (void)ring;
+}
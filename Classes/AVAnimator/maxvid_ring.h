@@ -0,0 +1,93 @@
+// maxvid_ring module
+//
+//  License terms defined in License.txt.
+//
+// This module implements a lock free ring of decoded frames that is used to
+// hand frames from one or more decode threads to any number of consumers. A
+// frame is an opaque pointer, typically a retained AVFrame, along with a frame
+// index and a presentation time. Producers write frames ahead of the display
+// time and consumers acquire the newest frame whose presentation time is not
+// after the display time. Neither side takes a lock, so a consumer on the main
+// thread never waits on a decode in progress.
+//
+// A consumer holds a slot from acquire until release, the frame in a held slot
+// is never released or overwritten. Once a consumer has acquired a frame, all
+// frames with an earlier presentation time are no longer needed and a producer
+// reclaims those slots, the release function passed to maxvid_ring_init() is
+// invoked on the producer thread for each reclaimed frame.
+
+#ifndef MAXVID_RING_H
+#define MAXVID_RING_H
+
+#include "maxvid_decode.h"
+
+#include <stdatomic.h>
+
+typedef void (*MVFrameRingReleaseFunc)(void *frame);
+
+typedef struct {
+  // 0 when empty, MV_RING_SLOT_WRITING while a producer owns the slot,
+  // otherwise the publish sequence number of the frame in the slot.
+  _Atomic uint64_t seq;
+  _Atomic uint32_t numRefs;
+  uint32_t frameIndex;
+  double presentationTime;
+  void *frame;
+} MVFrameRingSlot;
+
+typedef struct MVFrameRing {
+  MVFrameRingSlot *slots;
+  uint32_t numSlots;
+  MVFrameRingReleaseFunc releaseFunc;
+  _Atomic uint64_t nextSeq;
+  // Presentation time of the newest frame acquired by a consumer
+  _Atomic double consumedTime;
+  // Latest display time passed to maxvid_ring_acquire()
+  _Atomic double requestedTime;
+} MVFrameRing;
+
+#define MV_RING_SLOT_WRITING UINT64_MAX
+
+// Allocate numSlots slots, returns 0 on success or MV_ERROR_CODE_INVALID_INPUT
+
+uint32_t
+maxvid_ring_init(MVFrameRing *ring, uint32_t numSlots, MVFrameRingReleaseFunc releaseFunc);
+
+// Release all frames and free the slots. No producer or consumer can be active.
+
+void
+maxvid_ring_free(MVFrameRing *ring);
+
+// Release all frames and reset the clock, for example when seeking back to
+// the first frame. No producer can be active and no slot can be held.
+
+void
+maxvid_ring_flush(MVFrameRing *ring);
+
+// Producer: publish a frame. Returns 0 on success, or MV_ERROR_CODE_INVALID_OUTPUT
+// when every slot holds a frame that has not been displayed yet or that is
+// held by a consumer. The caller keeps ownership of the frame on failure.
+
+uint32_t
+maxvid_ring_push(MVFrameRing *ring, void *frame, uint32_t frameIndex, double presentationTime);
+
+// Consumer: acquire the newest frame with a presentation time at or before
+// displayTime. Returns NULL if no such frame has been published. The returned
+// slot must be passed to maxvid_ring_release() once the consumer has retained
+// the frame or is done with it.
+
+MVFrameRingSlot*
+maxvid_ring_acquire(MVFrameRing *ring, double displayTime);
+
+void
+maxvid_ring_release(MVFrameRing *ring, MVFrameRingSlot *slot);
+
+// Latest display time a consumer asked for, a producer that has fallen behind
+// can skip ahead to this time.
+
+static inline
+double maxvid_ring_requested_time(MVFrameRing *ring) {
+  return atomic_load(&ring->requestedTime);
+}
+
+#endif // MAXVID_RING_H
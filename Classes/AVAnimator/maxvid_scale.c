@@ -0,0 +1,374 @@
+// maxvid_scale module
+//
+//  License terms defined in License.txt.
+//
+// This module implements scaled decoding of keyframes and c4 delta frames,
+// see maxvid_scale.h.
+
+#include "maxvid_scale.h"
+
+// Row of scaled pixels that a delta frame changed, the columns in
+// [minCol, maxCol] could have the changed flag set.
+
+typedef struct {
+  uint32_t row;
+  uint32_t minCol;
+  uint32_t maxCol;
+} MVScaleBand;
+
+#define MV_SCALE_NO_BAND UINT32_MAX
+
+static inline
+uint32_t maxvid_scale_bytes_per_pixel(const uint32_t bpp) {
+  return (bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+uint32_t
+maxvid_scale_init(MVScale *scale, uint32_t width, uint32_t height, uint32_t bpp, uint32_t shift, uint32_t filter)
+{
+  memset(scale, 0, sizeof(MVScale));
+
+  if (width == 0 || height == 0 || shift == 0 || shift > MV_SCALE_MAX_SHIFT) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  if (bpp != 16 && bpp != 24 && bpp != 32) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  if (filter != MV_SCALE_POINT && filter != MV_SCALE_BOX) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  const uint32_t mask = (1 << shift) - 1;
+
+  scale->width = width;
+  scale->height = height;
+  scale->bpp = (bpp == 16) ? 16 : 32;
+  scale->shift = shift;
+  scale->filter = filter;
+  scale->scaledWidth = (width + mask) >> shift;
+  scale->scaledHeight = (height + mask) >> shift;
+
+  if (filter == MV_SCALE_BOX) {
+    scale->pixels = calloc((size_t)width * height, maxvid_scale_bytes_per_pixel(scale->bpp));
+    scale->changed = calloc(scale->scaledWidth, sizeof(uint8_t));
+    if (scale->pixels == NULL || scale->changed == NULL) {
+      maxvid_scale_free(scale);
+      return MV_ERROR_CODE_OUT_OF_MEMORY;
+    }
+  }
+
+  return 0;
+}
+
+void
+maxvid_scale_free(MVScale *scale)
+{
+  free(scale->pixels);
+  scale->pixels = NULL;
+  free(scale->changed);
+  scale->changed = NULL;
+}
+
+static inline
+uint32_t maxvid_scale_read(const void *pixels, uint32_t index, const uint32_t bpp) {
+  if (bpp == 16) {
+    return ((const uint16_t *) pixels)[index];
+  } else {
+    return ((const uint32_t *) pixels)[index];
+  }
+}
+
+static inline
+void maxvid_scale_write(void *pixels, uint32_t index, uint32_t pixel, const uint32_t bpp) {
+  if (bpp == 16) {
+    ((uint16_t *) pixels)[index] = (uint16_t) pixel;
+  } else {
+    ((uint32_t *) pixels)[index] = pixel;
+  }
+}
+
+// Write the average of the full size pixels in the block that the scaled
+// pixel at (col, row) covers. Channels are 5 bits for 16 bpp pixels and
+// 8 bits otherwise.
+
+static inline
+void maxvid_scale_average(MVScale *scale, void *scaledFrameBuffer, uint32_t col, uint32_t row, const uint32_t bpp) {
+  const uint32_t shift = scale->shift;
+  const uint32_t blockSize = 1 << shift;
+  const uint32_t firstRow = row << shift;
+  const uint32_t numRows = ((firstRow + blockSize) <= scale->height) ? blockSize : (scale->height - firstRow);
+  const uint32_t firstCol = col << shift;
+  const uint32_t numCols = ((firstCol + blockSize) <= scale->width) ? blockSize : (scale->width - firstCol);
+  const uint32_t numPixels = numRows * numCols;
+  uint32_t sum[4] = { 0, 0, 0, 0 };
+
+  for (uint32_t y = firstRow; y < (firstRow + numRows); y++) {
+    const uint32_t rowOffset = y * scale->width;
+    for (uint32_t x = firstCol; x < (firstCol + numCols); x++) {
+      uint32_t pixel = maxvid_scale_read(scale->pixels, rowOffset + x, bpp);
+      if (bpp == 16) {
+        sum[0] += pixel & 0x1F;
+        sum[1] += (pixel >> 5) & 0x1F;
+        sum[2] += (pixel >> 10) & 0x1F;
+      } else {
+        sum[0] += pixel & 0xFF;
+        sum[1] += (pixel >> 8) & 0xFF;
+        sum[2] += (pixel >> 16) & 0xFF;
+        sum[3] += pixel >> 24;
+      }
+    }
+  }
+
+  const uint32_t numChannels = (bpp == 16) ? 3 : 4;
+  const uint32_t numBits = (bpp == 16) ? 5 : 8;
+  uint32_t pixel = 0;
+
+  for (uint32_t c = 0; c < numChannels; c++) {
+    uint32_t value = (sum[c] + (numPixels / 2)) / numPixels;
+    pixel |= value << (c * numBits);
+  }
+
+  maxvid_scale_write(scaledFrameBuffer, (row * scale->scaledWidth) + col, pixel, bpp);
+}
+
+// Average the blocks of the current band that the delta frame changed
+
+static inline
+void maxvid_scale_flush_band(MVScale *scale, void *scaledFrameBuffer, MVScaleBand *band, const uint32_t bpp) {
+  if (band->row == MV_SCALE_NO_BAND) {
+    return;
+  }
+
+  for (uint32_t col = band->minCol; col <= band->maxCol; col++) {
+    if (scale->changed[col] == 0) {
+      continue;
+    }
+    maxvid_scale_average(scale, scaledFrameBuffer, col, band->row, bpp);
+    scale->changed[col] = 0;
+  }
+
+  band->row = MV_SCALE_NO_BAND;
+}
+
+// Apply numPixels pixels starting at a pixel offset in the full size frame.
+// Pixel i of the run is read from src at index (i * srcStride), a DUP run
+// passes a srcStride of zero.
+
+static inline
+void maxvid_scale_run(MVScale *scale, void *scaledFrameBuffer, MVScaleBand *band,
+                      uint32_t offset, uint32_t numPixels,
+                      const void *src, const uint32_t srcStride, const uint32_t bpp) {
+  const uint32_t width = scale->width;
+  const uint32_t shift = scale->shift;
+  const uint32_t mask = (1 << shift) - 1;
+
+  uint32_t y = offset / width;
+  uint32_t x = offset - (y * width);
+  uint32_t srcIndex = 0;
+
+  while (numPixels > 0) {
+    const uint32_t numInRow = ((width - x) < numPixels) ? (width - x) : numPixels;
+
+    if (scale->filter == MV_SCALE_POINT) {
+      // Only the rows and columns on a block bound are sampled
+
+      if ((y & mask) == 0) {
+        const uint32_t rowOffset = (y >> shift) * scale->scaledWidth;
+        for (uint32_t sx = (x + mask) & ~mask; sx < (x + numInRow); sx += (mask + 1)) {
+          uint32_t pixel = maxvid_scale_read(src, (srcIndex + sx - x) * srcStride, bpp);
+          maxvid_scale_write(scaledFrameBuffer, rowOffset + (sx >> shift), pixel, bpp);
+        }
+      }
+    } else {
+      const uint32_t bandRow = y >> shift;
+      if (bandRow != band->row) {
+        maxvid_scale_flush_band(scale, scaledFrameBuffer, band, bpp);
+        band->row = bandRow;
+        band->minCol = UINT32_MAX;
+        band->maxCol = 0;
+      }
+
+      // Update the full size pixels, the blocks are averaged when the band is done
+
+      const uint32_t rowOffset = (y * width) + x;
+      for (uint32_t i = 0; i < numInRow; i++) {
+        uint32_t pixel = maxvid_scale_read(src, (srcIndex + i) * srcStride, bpp);
+        maxvid_scale_write(scale->pixels, rowOffset + i, pixel, bpp);
+      }
+
+      const uint32_t minCol = x >> shift;
+      const uint32_t maxCol = (x + numInRow - 1) >> shift;
+      for (uint32_t col = minCol; col <= maxCol; col++) {
+        scale->changed[col] = 1;
+      }
+      if (minCol < band->minCol) {
+        band->minCol = minCol;
+      }
+      if (maxCol > band->maxCol) {
+        band->maxCol = maxCol;
+      }
+    }
+
+    numPixels -= numInRow;
+    srcIndex += numInRow;
+    x = 0;
+    y++;
+  }
+}
+
+void
+maxvid_scale_keyframe(MVScale *scale, void *scaledFrameBuffer, const void *keyframe)
+{
+  const uint32_t numPixels = scale->width * scale->height;
+
+  if (scale->filter == MV_SCALE_POINT) {
+    MVScaleBand band = { MV_SCALE_NO_BAND, 0, 0 };
+    if (scale->bpp == 16) {
+      maxvid_scale_run(scale, scaledFrameBuffer, &band, 0, numPixels, keyframe, 1, 16);
+    } else {
+      maxvid_scale_run(scale, scaledFrameBuffer, &band, 0, numPixels, keyframe, 1, 32);
+    }
+    return;
+  }
+
+  // Every block changes, the full size pixels are kept for the next delta frame
+
+  memcpy(scale->pixels, keyframe, (size_t)numPixels * maxvid_scale_bytes_per_pixel(scale->bpp));
+
+  for (uint32_t row = 0; row < scale->scaledHeight; row++) {
+    for (uint32_t col = 0; col < scale->scaledWidth; col++) {
+      if (scale->bpp == 16) {
+        maxvid_scale_average(scale, scaledFrameBuffer, col, row, 16);
+      } else {
+        maxvid_scale_average(scale, scaledFrameBuffer, col, row, 32);
+      }
+    }
+  }
+}
+
+// The code walks below check bounds in the same way as the validated decoders
+// in maxvid_validate.c, but a run is passed to maxvid_scale_run() instead of
+// being written to a full size framebuffer.
+
+static
+uint32_t
+maxvid_decode_c4_scaled16(MVScale *scale,
+                          void *scaledFrameBuffer,
+                          const uint32_t * restrict inputBuffer32,
+                          const uint32_t inputBuffer32NumWords)
+{
+  MVScaleBand band = { MV_SCALE_NO_BAND, 0, 0 };
+
+  const uint32_t frameBufferSize = scale->width * scale->height;
+  uint32_t offset = 0;
+  const uint32_t * restrict inPtr = inputBuffer32;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    const uint32_t inW1 = *inPtr++;
+    const uint32_t opCode = inW1 >> 30;
+
+    if (opCode == SKIP) {
+      const uint32_t numPixels = inW1 & MV_MAX_30_BITS;
+      if (numPixels == 0 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      offset += numPixels;
+    } else if (opCode == DUP) {
+      const uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels < 2 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      const uint16_t pixel = (uint16_t) inW1;
+      maxvid_scale_run(scale, scaledFrameBuffer, &band, offset, numPixels, &pixel, 0, 16);
+      offset += numPixels;
+    } else if (opCode == COPY) {
+      uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels == 0 || numPixels > (frameBufferSize - offset)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      // The first pixel is stored in the code word when the framebuffer
+      // is half word aligned or when only one pixel is copied.
+      if ((numPixels == 1) || ((offset & 0x1) != 0)) {
+        const uint16_t pixel = (uint16_t) inW1;
+        maxvid_scale_run(scale, scaledFrameBuffer, &band, offset, 1, &pixel, 0, 16);
+        offset++;
+        numPixels--;
+      }
+      const uint32_t numWords = (numPixels + 1) >> 1;
+      if (numWords > (inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      maxvid_scale_run(scale, scaledFrameBuffer, &band, offset, numPixels, inPtr, 1, 16);
+      offset += numPixels;
+      inPtr += numWords;
+    } else {
+      maxvid_scale_flush_band(scale, scaledFrameBuffer, &band, 16);
+      return 0;
+    }
+  }
+
+  // No DONE code found before the end of the input
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+static
+uint32_t
+maxvid_decode_c4_scaled32(MVScale *scale,
+                          void *scaledFrameBuffer,
+                          const uint32_t * restrict inputBuffer32,
+                          const uint32_t inputBuffer32NumWords)
+{
+  MVScaleBand band = { MV_SCALE_NO_BAND, 0, 0 };
+
+  const uint32_t frameBufferSize = scale->width * scale->height;
+  uint32_t offset = 0;
+  const uint32_t * restrict inPtr = inputBuffer32;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    const uint32_t inW1 = *inPtr++;
+    MV32_PARSE_OP_NUM_SKIP(inW1, opCode, numPixels, skipAfter);
+
+    if (opCode == DONE) {
+      maxvid_scale_flush_band(scale, scaledFrameBuffer, &band, 32);
+      return 0;
+    }
+
+    if (numPixels < ((opCode == DUP) ? 2 : 1) || (numPixels + skipAfter) > (frameBufferSize - offset)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if (opCode == DUP) {
+      if (inPtr == inEnd) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      maxvid_scale_run(scale, scaledFrameBuffer, &band, offset, numPixels, inPtr, 0, 32);
+      inPtr++;
+    } else if (opCode == COPY) {
+      if (numPixels > (inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      maxvid_scale_run(scale, scaledFrameBuffer, &band, offset, numPixels, inPtr, 1, 32);
+      inPtr += numPixels;
+    }
+
+    offset += numPixels + skipAfter;
+  }
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+uint32_t
+maxvid_decode_c4_scaled(MVScale *scale,
+                        void *scaledFrameBuffer,
+                        const uint32_t * restrict inputBuffer32,
+                        const uint32_t inputBuffer32NumWords)
+{
+  if (scale->bpp == 16) {
+    return maxvid_decode_c4_scaled16(scale, scaledFrameBuffer, inputBuffer32, inputBuffer32NumWords);
+  } else {
+    return maxvid_decode_c4_scaled32(scale, scaledFrameBuffer, inputBuffer32, inputBuffer32NumWords);
+  }
+}
@@ -0,0 +1,83 @@
+// maxvid_scale module
+//
+//  License terms defined in License.txt.
+//
+// This module implements decoding of keyframes and c4 delta frames directly
+// into a framebuffer that is 1/2, 1/4 or 1/8 the width and height of the movie,
+// so that a thumbnail or preview never needs a full size framebuffer. Each
+// SKIP, DUP and COPY run is mapped onto the scaled framebuffer as it is
+// decoded, the pixels in the scaled framebuffer are in the same 16 or 32 bit
+// format as the movie pixels.
+//
+// With MV_SCALE_POINT each scaled pixel is the top left pixel of the block it
+// covers. A delta frame only writes the pixels that land on a sampled position,
+// so the result is exactly the point sampled full size frame.
+//
+// With MV_SCALE_BOX each scaled pixel is the average of the block it covers.
+// A delta frame that changes only some pixels in a block can't be averaged
+// without the unchanged full size pixels, so the full size pixels of the last
+// frame are kept and only the blocks that a delta frame changed are averaged
+// again. The result is exactly the box filtered full size frame, but the box
+// filter needs the memory of a full size frame. Frames must be decoded in
+// order with the same MVScale, starting with a keyframe.
+
+#ifndef MAXVID_SCALE_H
+#define MAXVID_SCALE_H
+
+#include "maxvid_decode.h"
+
+#define MV_SCALE_POINT 0
+#define MV_SCALE_BOX 1
+
+#define MV_SCALE_MAX_SHIFT 3
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  // 16 for 16 bpp pixels, 32 for 24 or 32 bpp pixels
+  uint32_t bpp;
+  // The scaled size is 1 / (1 << shift) of the movie size, rounded up
+  uint32_t shift;
+  uint32_t filter;
+  uint32_t scaledWidth;
+  uint32_t scaledHeight;
+  // Box filter only, the full size pixels of the last frame and a flag for
+  // each scaled pixel in one row that the delta frame changed
+  void *pixels;
+  uint8_t *changed;
+} MVScale;
+
+// Setup to scale frames of width x height pixels by 1 / (1 << shift), shift
+// must be 1 to MV_SCALE_MAX_SHIFT. Returns 0 on success, MV_ERROR_CODE_INVALID_INPUT
+// or MV_ERROR_CODE_OUT_OF_MEMORY.
+
+uint32_t
+maxvid_scale_init(MVScale *scale, uint32_t width, uint32_t height, uint32_t bpp, uint32_t shift, uint32_t filter);
+
+void
+maxvid_scale_free(MVScale *scale);
+
+// Number of bytes in the scaled framebuffer
+
+static inline
+uint32_t maxvid_scale_num_bytes(const MVScale *scale) {
+  return scale->scaledWidth * scale->scaledHeight * ((scale->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+// Scale all width x height pixels of a keyframe into the scaled framebuffer
+
+void
+maxvid_scale_keyframe(MVScale *scale, void *scaledFrameBuffer, const void *keyframe);
+
+// Decode one delta frame over the scaled framebuffer. Each code is checked like
+// maxvid_decode_c4_sample16_validated() and maxvid_decode_c4_sample32_validated(),
+// returns 0 on success or MV_ERROR_CODE_INVALID_INPUT as soon as an invalid
+// code is found.
+
+uint32_t
+maxvid_decode_c4_scaled(MVScale *scale,
+                        void *scaledFrameBuffer,
+                        const uint32_t * restrict inputBuffer32,
+                        const uint32_t inputBuffer32NumWords);
+
+#endif // MAXVID_SCALE_H
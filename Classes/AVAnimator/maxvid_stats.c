@@ -0,0 +1,239 @@
+// maxvid_stats module
+//
+//  License terms defined in License.txt.
+//
+// This module collects statistics about the frames written to a maxvid file.
+
+#include "maxvid_stats.h"
+
+// Walk 16 BPP c4 codes. A SKIP code is one word with a 30 bit num. A DUP code
+// is one word with the pixel in the low half word. A COPY code stores the first
+// pixel in the low half word when the framebuffer is not word aligned or when
+// only 1 pixel is copied, the remaining pixels follow as packed word pairs.
+
+uint32_t
+maxvid_frame_stats_count_c4_codes16(MVFrameStats *frameStats,
+                                    const uint32_t *inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferNumPixels)
+{
+  uint32_t wordOffset = 0;
+  uint32_t pixelOffset = 0;
+
+  while (wordOffset < inputBuffer32NumWords) {
+    const uint32_t inW1 = inputBuffer32[wordOffset++];
+    const uint32_t opCode = inW1 >> 30;
+
+    if (opCode == DONE) {
+      frameStats->numCodeWords += wordOffset;
+      return 0;
+    }
+
+    uint32_t numPixels;
+
+    if (opCode == SKIP) {
+      numPixels = inW1 & MV_MAX_30_BITS;
+      frameStats->numSkipCodes++;
+      frameStats->numSkipPixels += numPixels;
+    } else {
+      numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+
+      if (opCode == DUP) {
+        frameStats->numDupCodes++;
+        frameStats->numDupPixels += numPixels;
+      } else {
+        uint32_t numPixelsInWords = numPixels;
+        if ((numPixels == 1) || ((pixelOffset & 0x1) != 0)) {
+          numPixelsInWords--;
+        }
+        wordOffset += (numPixelsInWords + 1) >> 1;
+
+        frameStats->numCopyCodes++;
+        frameStats->numCopyPixels += numPixels;
+      }
+    }
+
+    pixelOffset += numPixels;
+
+    if ((wordOffset > inputBuffer32NumWords) || (pixelOffset > frameBufferNumPixels)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+  }
+
+  // No DONE code found before the end of the input
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+// Walk 32 BPP c4 codes. Each code word contains a 22 bit num and an 8 bit
+// skip after value. A DUP code is followed by one pixel word while a COPY
+// code is followed by num pixel words. The skip after value is counted as
+// skipped pixels but not as an additional SKIP code.
+
+uint32_t
+maxvid_frame_stats_count_c4_codes32(MVFrameStats *frameStats,
+                                    const uint32_t *inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferNumPixels)
+{
+  uint32_t wordOffset = 0;
+  uint32_t pixelOffset = 0;
+
+  while (wordOffset < inputBuffer32NumWords) {
+    const uint32_t inW1 = inputBuffer32[wordOffset++];
+    MV32_PARSE_OP_NUM_SKIP(inW1, opCode, numPixels, skipAfter);
+
+    if (opCode == DONE) {
+      frameStats->numCodeWords += wordOffset;
+      return 0;
+    } else if (opCode == SKIP) {
+      frameStats->numSkipCodes++;
+      frameStats->numSkipPixels += numPixels;
+    } else if (opCode == DUP) {
+      wordOffset += 1;
+      frameStats->numDupCodes++;
+      frameStats->numDupPixels += numPixels;
+    } else {
+      wordOffset += numPixels;
+      frameStats->numCopyCodes++;
+      frameStats->numCopyPixels += numPixels;
+    }
+
+    frameStats->numSkipPixels += skipAfter;
+    pixelOffset += numPixels + skipAfter;
+
+    if ((wordOffset > inputBuffer32NumWords) || (pixelOffset > frameBufferNumPixels)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+  }
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+MVFileStats*
+maxvid_file_stats_alloc(void)
+{
+  MVFileStats *fileStats = malloc(sizeof(MVFileStats));
+  if (fileStats == NULL) {
+    return NULL;
+  }
+  memset(fileStats, 0, sizeof(MVFileStats));
+  return fileStats;
+}
+
+void
+maxvid_file_stats_free(MVFileStats *fileStats)
+{
+  if (fileStats == NULL) {
+    return;
+  }
+  if (fileStats->frames) {
+    free(fileStats->frames);
+  }
+  free(fileStats);
+}
+
+uint32_t
+maxvid_file_stats_append(MVFileStats *fileStats, const MVFrameStats *frameStats)
+{
+  if (fileStats->numFrames == fileStats->framesAllocated) {
+    uint32_t framesAllocated = (fileStats->framesAllocated == 0) ? 64 : (fileStats->framesAllocated * 2);
+    MVFrameStats *frames = realloc(fileStats->frames, framesAllocated * sizeof(MVFrameStats));
+    if (frames == NULL) {
+      return MV_ERROR_CODE_WRITE_FAILED;
+    }
+    fileStats->frames = frames;
+    fileStats->framesAllocated = framesAllocated;
+  }
+
+  fileStats->frames[fileStats->numFrames++] = *frameStats;
+
+  if (frameStats->frameType == MV_STATS_KEYFRAME) {
+    fileStats->numKeyframes++;
+  } else if (frameStats->frameType == MV_STATS_DELTAFRAME) {
+    fileStats->numDeltaframes++;
+  } else {
+    fileStats->numNopframes++;
+  }
+
+  fileStats->numSkipCodes += frameStats->numSkipCodes;
+  fileStats->numDupCodes += frameStats->numDupCodes;
+  fileStats->numCopyCodes += frameStats->numCopyCodes;
+  fileStats->numSkipPixels += frameStats->numSkipPixels;
+  fileStats->numDupPixels += frameStats->numDupPixels;
+  fileStats->numCopyPixels += frameStats->numCopyPixels;
+  fileStats->numCodeWords += frameStats->numCodeWords;
+  fileStats->numBytes += frameStats->numBytes;
+  fileStats->encodeTime += frameStats->encodeTime;
+
+  if (frameStats->numBytes > fileStats->maxFrameBytes) {
+    fileStats->maxFrameBytes = frameStats->numBytes;
+  }
+  if (frameStats->encodeTime > fileStats->maxEncodeTime) {
+    fileStats->maxEncodeTime = frameStats->encodeTime;
+  }
+
+  return 0;
+}
+
+static
+const char* maxvid_stats_frame_type_str(uint32_t frameType) {
+  if (frameType == MV_STATS_KEYFRAME) {
+    return "keyframe";
+  } else if (frameType == MV_STATS_DELTAFRAME) {
+    return "delta";
+  } else {
+    return "nop";
+  }
+}
+
+uint32_t
+maxvid_file_stats_write_json(FILE *outFile, const MVFileStats *fileStats, int emitFrames)
+{
+  fprintf(outFile, "{\n");
+  fprintf(outFile, "  \"width\": %u,\n", fileStats->width);
+  fprintf(outFile, "  \"height\": %u,\n", fileStats->height);
+  fprintf(outFile, "  \"bpp\": %u,\n", fileStats->bpp);
+  fprintf(outFile, "  \"numFrames\": %u,\n", fileStats->numFrames);
+  fprintf(outFile, "  \"numKeyframes\": %u,\n", fileStats->numKeyframes);
+  fprintf(outFile, "  \"numDeltaframes\": %u,\n", fileStats->numDeltaframes);
+  fprintf(outFile, "  \"numNopframes\": %u,\n", fileStats->numNopframes);
+  fprintf(outFile, "  \"numSkipCodes\": %llu,\n", (unsigned long long)fileStats->numSkipCodes);
+  fprintf(outFile, "  \"numDupCodes\": %llu,\n", (unsigned long long)fileStats->numDupCodes);
+  fprintf(outFile, "  \"numCopyCodes\": %llu,\n", (unsigned long long)fileStats->numCopyCodes);
+  fprintf(outFile, "  \"numSkipPixels\": %llu,\n", (unsigned long long)fileStats->numSkipPixels);
+  fprintf(outFile, "  \"numDupPixels\": %llu,\n", (unsigned long long)fileStats->numDupPixels);
+  fprintf(outFile, "  \"numCopyPixels\": %llu,\n", (unsigned long long)fileStats->numCopyPixels);
+  fprintf(outFile, "  \"numCodeWords\": %llu,\n", (unsigned long long)fileStats->numCodeWords);
+  fprintf(outFile, "  \"numBytes\": %llu,\n", (unsigned long long)fileStats->numBytes);
+  fprintf(outFile, "  \"maxFrameBytes\": %u,\n", fileStats->maxFrameBytes);
+  fprintf(outFile, "  \"encodeTime\": %.6f,\n", fileStats->encodeTime);
+  fprintf(outFile, "  \"maxEncodeTime\": %.6f", fileStats->maxEncodeTime);
+
+  if (emitFrames) {
+    fprintf(outFile, ",\n  \"frames\": [\n");
+
+    for (uint32_t i = 0; i < fileStats->numFrames; i++) {
+      const MVFrameStats *frameStats = &fileStats->frames[i];
+
+      fprintf(outFile, "    { \"frame\": %u, \"type\": \"%s\", ",
+              frameStats->frameNum, maxvid_stats_frame_type_str(frameStats->frameType));
+      fprintf(outFile, "\"skipCodes\": %u, \"dupCodes\": %u, \"copyCodes\": %u, ",
+              frameStats->numSkipCodes, frameStats->numDupCodes, frameStats->numCopyCodes);
+      fprintf(outFile, "\"skipPixels\": %u, \"dupPixels\": %u, \"copyPixels\": %u, ",
+              frameStats->numSkipPixels, frameStats->numDupPixels, frameStats->numCopyPixels);
+      fprintf(outFile, "\"codeWords\": %u, \"bytes\": %u, \"encodeTime\": %.6f }%s\n",
+              frameStats->numCodeWords, frameStats->numBytes, frameStats->encodeTime,
+              (i == (fileStats->numFrames - 1)) ? "" : ",");
+    }
+
+    fprintf(outFile, "  ]");
+  }
+
+  int status = fprintf(outFile, "\n}\n");
+
+  if ((status < 0) || ferror(outFile)) {
+    return MV_ERROR_CODE_WRITE_FAILED;
+  }
+  return 0;
+}
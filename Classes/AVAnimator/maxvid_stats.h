@@ -0,0 +1,116 @@
+// maxvid_stats module
+//
+//  License terms defined in License.txt.
+//
+// This module collects statistics about the frames written to a maxvid file.
+// Per-frame counts of the c4 SKIP, DUP, and COPY codes make it possible to see
+// how well a specific asset compresses and which frames are expensive to decode.
+// A file level summary is the sum of the per-frame values. The results can be
+// written as JSON so that tools can compare assets and encoder changes.
+
+#ifndef MAXVID_STATS_H
+#define MAXVID_STATS_H
+
+#include "maxvid_file.h"
+
+// The kind of frame that was emitted by the encoder
+
+typedef enum {
+  MV_STATS_KEYFRAME = 0,
+  MV_STATS_DELTAFRAME = 1,
+  MV_STATS_NOPFRAME = 2
+} MV_STATS_FRAME_TYPE;
+
+// Stats for one frame. The code and pixel counts are only non-zero for
+// an uncompressed delta frame since a keyframe contains only pixels.
+// The encodeTime is in seconds, it is zero when not known.
+
+typedef struct {
+  uint32_t frameNum;
+  uint32_t frameType;
+  uint32_t numSkipCodes;
+  uint32_t numDupCodes;
+  uint32_t numCopyCodes;
+  uint32_t numSkipPixels;
+  uint32_t numDupPixels;
+  uint32_t numCopyPixels;
+  uint32_t numCodeWords;
+  uint32_t numBytes;
+  double encodeTime;
+} MVFrameStats;
+
+// Stats for a whole file, the summary fields are updated as each frame
+// is appended. The frames array is owned by this struct.
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t bpp;
+  uint32_t numFrames;
+  uint32_t numKeyframes;
+  uint32_t numDeltaframes;
+  uint32_t numNopframes;
+  uint64_t numSkipCodes;
+  uint64_t numDupCodes;
+  uint64_t numCopyCodes;
+  uint64_t numSkipPixels;
+  uint64_t numDupPixels;
+  uint64_t numCopyPixels;
+  uint64_t numCodeWords;
+  uint64_t numBytes;
+  uint32_t maxFrameBytes;
+  double encodeTime;
+  double maxEncodeTime;
+  MVFrameStats *frames;
+  uint32_t framesAllocated;
+} MVFileStats;
+
+// Zero out a frame stats struct and set the frame number and type
+
+static inline
+void maxvid_frame_stats_init(MVFrameStats *frameStats, uint32_t frameNum, MV_STATS_FRAME_TYPE frameType) {
+  memset(frameStats, 0, sizeof(MVFrameStats));
+  frameStats->frameNum = frameNum;
+  frameStats->frameType = frameType;
+}
+
+// Walk the c4 codes for a 16 or 32 BPP delta frame and count each code type
+// along with the number of pixels each code type covers. Returns 0 on success,
+// otherwise MV_ERROR_CODE_INVALID_INPUT if the codes run past the end of the
+// input buffer or past the end of a framebuffer with frameBufferNumPixels.
+
+uint32_t
+maxvid_frame_stats_count_c4_codes16(MVFrameStats *frameStats,
+                                    const uint32_t *inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferNumPixels);
+
+uint32_t
+maxvid_frame_stats_count_c4_codes32(MVFrameStats *frameStats,
+                                    const uint32_t *inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferNumPixels);
+
+// Allocate and free a file stats struct, returns NULL if malloc fails
+
+MVFileStats*
+maxvid_file_stats_alloc(void);
+
+void
+maxvid_file_stats_free(MVFileStats *fileStats);
+
+// Append the stats for one frame and update the file level summary.
+// Returns 0 on success, otherwise MV_ERROR_CODE_WRITE_FAILED if memory
+// for the frames array could not be allocated.
+
+uint32_t
+maxvid_file_stats_append(MVFileStats *fileStats, const MVFrameStats *frameStats);
+
+// Write the file level summary as a JSON object. When emitFrames is non-zero,
+// a "frames" array containing an object for each frame is also emitted.
+// Returns 0 on success, otherwise MV_ERROR_CODE_WRITE_FAILED.
+
+uint32_t
+maxvid_file_stats_write_json(FILE *outFile, const MVFileStats *fileStats, int emitFrames);
+
+#endif // MAXVID_STATS_H
@@ -0,0 +1,455 @@
+// maxvid_validate module
+//
+//  License terms defined in License.txt.
+//
+// This module implements validation of maxvid data that comes from an untrusted
+// source, see maxvid_validate.h.
+
+#include "maxvid_validate.h"
+
+#include "maxvid_blit.h"
+
+uint32_t
+maxvid_file_validate_header(const MVFileHeader *header, uint64_t fileNumBytes)
+{
+  if (fileNumBytes < sizeof(MVFileHeader)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  if (header->magic != MV_FILE_MAGIC) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  if (header->bpp != 16 && header->bpp != 24 && header->bpp != 32) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  if (header->width == 0 || header->height == 0 || header->numFrames == 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // A negative, zero, or NaN duration would break frame timing logic
+
+  if (!(header->frameDuration > 0.0f) || !isfinite(header->frameDuration)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  uint8_t version = header->versionAndFlags & 0xFF;
+  if (version > MV_FILE_VERSION_THREE) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // Only a MVV3Frame has room for a frame duration
+
+  if (maxvid_file_is_frame_durations((MVFileHeader*)header) && version != MV_FILE_VERSION_THREE) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // A palette frame is flagged in a MVV3Frame and decodes to 32 bit pixels
+
+  if (maxvid_file_is_palette((MVFileHeader*)header) && (version != MV_FILE_VERSION_THREE || header->bpp == 16)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // The framebuffer size in bytes, including the zero padding pixel
+  // for an odd number of pixels, must fit in 32 bits.
+
+  uint64_t numPixels = (uint64_t)header->width * header->height;
+  numPixels += (numPixels & 0x1);
+  uint64_t numBytesInPixel = (header->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t);
+  if ((numPixels * numBytesInPixel) > MV_MAX_32_BITS) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  uint64_t frameNumBytes = (version >= MV_FILE_VERSION_THREE) ? sizeof(MVV3Frame) : sizeof(MVFrame);
+  uint64_t tableEndOffset = sizeof(MVFileHeader) + ((uint64_t)header->numFrames * frameNumBytes);
+  if (maxvid_file_is_frames_at_end((MVFileHeader*)header)) {
+    // The frame table and the trailer are checked by maxvid_file_validate_trailer()
+    tableEndOffset += sizeof(MVFileTrailer);
+  }
+  if (tableEndOffset > fileNumBytes) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // The level table and the level frame tables follow the frame data, the
+  // entries of the level table are checked by maxvid_file_validate_levels()
+
+  if (maxvid_file_is_levels((MVFileHeader*)header)) {
+    if (version != MV_FILE_VERSION_THREE || maxvid_file_is_frames_at_end((MVFileHeader*)header)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if (header->numLevels == 0 || header->numLevels > MV_FILE_MAX_LEVELS) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if ((header->levelsOffset & 0x7) != 0 || header->levelsOffset < tableEndOffset ||
+        header->levelsOffset > fileNumBytes) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    uint64_t levelsNumBytes = (uint64_t)header->numLevels * (sizeof(MVLevel) + ((uint64_t)header->numFrames * sizeof(MVV3Frame)));
+    if (levelsNumBytes > (fileNumBytes - header->levelsOffset)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_file_validate_levels(const MVFileHeader *header, const MVLevel *levels, uint64_t fileNumBytes)
+{
+  const uint64_t tableNumBytes = (uint64_t)header->numFrames * sizeof(MVV3Frame);
+  const uint64_t tablesStartOffset = header->levelsOffset + ((uint64_t)header->numLevels * sizeof(MVLevel));
+
+  for (uint32_t level = 1; level <= header->numLevels; level++) {
+    const MVLevel *mvLevel = &levels[level - 1];
+
+    // The size of each level is implied by the full size
+
+    if (mvLevel->width != maxvid_file_level_dimension(header->width, level) ||
+        mvLevel->height != maxvid_file_level_dimension(header->height, level)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if ((mvLevel->framesOffset & 0x7) != 0 || mvLevel->framesOffset < tablesStartOffset ||
+        mvLevel->framesOffset > fileNumBytes || tableNumBytes > (fileNumBytes - mvLevel->framesOffset)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_file_validate_trailer(const MVFileHeader *header, const MVFileTrailer *trailer, uint64_t fileNumBytes)
+{
+  if (trailer->magic != MV_FILE_TRAILER_MAGIC || trailer->numFrames != header->numFrames) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // The frame table is located after the header and ends where the trailer begins
+
+  const uint32_t isV3 = ((header->versionAndFlags & 0xFF) >= MV_FILE_VERSION_THREE);
+  const uint64_t frameNumBytes = isV3 ? sizeof(MVV3Frame) : sizeof(MVFrame);
+  const uint64_t tableNumBytes = (uint64_t)header->numFrames * frameNumBytes;
+
+  if ((trailer->framesOffset & 0x7) != 0 || trailer->framesOffset < sizeof(MVFileHeader)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  if (trailer->framesOffset > fileNumBytes ||
+      (fileNumBytes - trailer->framesOffset) != (tableNumBytes + sizeof(MVFileTrailer))) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_file_validate(const MVFileHeader *header, void *framesPtr, uint64_t framesOffset, uint64_t fileNumBytes)
+{
+  uint32_t status = maxvid_file_validate_header(header, fileNumBytes);
+  if (status != 0) {
+    return status;
+  }
+
+  const uint32_t isV3 = ((header->versionAndFlags & 0xFF) >= MV_FILE_VERSION_THREE);
+  const uint64_t frameNumBytes = isV3 ? sizeof(MVV3Frame) : sizeof(MVFrame);
+
+  // Frame data is located between the frame table and the end of the file,
+  // or between the header and the frame table when the table is at the end.
+
+  uint64_t dataStartOffset;
+  uint64_t dataEndOffset;
+
+  if (maxvid_file_is_frames_at_end((MVFileHeader*)header)) {
+    dataStartOffset = sizeof(MVFileHeader);
+    dataEndOffset = framesOffset;
+  } else if (maxvid_file_is_levels((MVFileHeader*)header)) {
+    // The framesOffset can be the frame table of a level, frame data of
+    // every level is located before the level table.
+    dataStartOffset = sizeof(MVFileHeader) + ((uint64_t)header->numFrames * frameNumBytes);
+    dataEndOffset = header->levelsOffset;
+  } else {
+    dataStartOffset = framesOffset + ((uint64_t)header->numFrames * frameNumBytes);
+    dataEndOffset = fileNumBytes;
+  }
+
+  if (dataStartOffset > dataEndOffset || dataEndOffset > fileNumBytes) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // A keyframe contains every pixel, with or without the zero padding pixel
+
+  const uint64_t numBytesInPixel = (header->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t);
+  const uint64_t numPixels = (uint64_t)header->width * header->height;
+  const uint64_t keyframeNumBytes = numPixels * numBytesInPixel;
+  const uint64_t paddedKeyframeNumBytes = (numPixels + (numPixels & 0x1)) * numBytesInPixel;
+
+  for (uint32_t frameIndex = 0; frameIndex < header->numFrames; frameIndex++) {
+    uint64_t offset;
+    uint64_t length;
+    uint32_t isKeyframe;
+    uint32_t isCompressed = 0;
+    uint32_t isPalette = 0;
+
+    if (isV3) {
+      MVV3Frame *frame = maxvid_v3_file_frame(framesPtr, frameIndex);
+      if (maxvid_v3_frame_isnopframe(frame)) {
+        continue;
+      }
+      offset = maxvid_v3_frame_offset(frame);
+      length = maxvid_v3_frame_length(frame);
+      isKeyframe = maxvid_v3_frame_iskeyframe(frame);
+      isCompressed = maxvid_v3_frame_iscompressed(frame);
+      isPalette = maxvid_v3_frame_ispalette(frame);
+    } else {
+      MVFrame *frame = maxvid_file_frame(framesPtr, frameIndex);
+      if (maxvid_frame_isnopframe(frame)) {
+        continue;
+      }
+      offset = maxvid_frame_offset(frame);
+      length = maxvid_frame_length(frame);
+      isKeyframe = maxvid_frame_iskeyframe(frame);
+    }
+
+    // Frame data is read as whole words and must not overlap the frame table
+
+    if ((offset & 0x3) != 0 || offset < dataStartOffset) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if (offset > dataEndOffset || length > (dataEndOffset - offset)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if (isPalette) {
+      // A palette keyframe or delta frame is a whole number of words, the
+      // codes are checked when the frame is decoded.
+
+      if (!maxvid_file_is_palette((MVFileHeader*)header) || isCompressed ||
+          length < (2 * sizeof(uint32_t)) || (length & 0x3) != 0) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+    } else if (isCompressed) {
+      // The size of the decompressed data is checked by the decompressor
+
+      if (!isKeyframe || length == 0) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+    } else if (isKeyframe) {
+      if (length != keyframeNumBytes && length != paddedKeyframeNumBytes) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+    } else {
+      // A delta frame is a whole number of c4 code words, the codes
+      // are checked when the frame is decoded.
+
+      if (length < sizeof(uint32_t) || (length & 0x3) != 0) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// Walk the 16 BPP codes in the same way as the decoder. The decoder never reads
+// past the DONE code, but it depends on every num value being in range since a
+// zero length COPY or a DUP of less than 2 pixels would underflow a counter.
+// The walk is branch free except for the loop condition so that it costs much
+// less than the decode, the pixel offset only increases so it is checked once
+// at the end.
+
+uint32_t
+maxvid_validate_c4_sample16(const uint32_t * restrict inputBuffer32,
+                            const uint32_t inputBuffer32NumWords,
+                            const uint32_t frameBufferSize)
+{
+  uint64_t wordOffset = 0;
+  uint64_t pixelOffset = 0;
+  uint32_t isInvalid = 0;
+
+  while (wordOffset < inputBuffer32NumWords) {
+    const uint32_t inW1 = inputBuffer32[wordOffset++];
+    const uint32_t opCode = inW1 >> 30;
+
+    if (opCode == DONE) {
+      isInvalid |= (pixelOffset > frameBufferSize);
+      return isInvalid ? MV_ERROR_CODE_INVALID_INPUT : 0;
+    }
+
+    const uint32_t numPixels = (opCode == SKIP) ? (inW1 & MV_MAX_30_BITS) : ((inW1 >> 16) & MV_MAX_14_BITS);
+
+    isInvalid |= (numPixels == 0);
+    isInvalid |= ((opCode == DUP) & (numPixels < 2));
+
+    // The first pixel of a COPY is stored in the code word when the framebuffer
+    // is half word aligned or when only one pixel is copied.
+
+    const uint32_t numPixelsInWords = numPixels - ((numPixels == 1) | (uint32_t)(pixelOffset & 0x1));
+    wordOffset += (opCode == COPY) ? ((numPixelsInWords + 1) >> 1) : 0;
+
+    pixelOffset += numPixels;
+  }
+
+  // No DONE code found before the end of the input, or the last COPY
+  // read past the end of the input.
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+// Walk the 32 BPP codes in the same way as the decoder. The decoder always
+// reads the word after a code, so the DONE code must be followed by the zero
+// padding word that the encoder emits.
+
+uint32_t
+maxvid_validate_c4_sample32(const uint32_t * restrict inputBuffer32,
+                            const uint32_t inputBuffer32NumWords,
+                            const uint32_t frameBufferSize)
+{
+  uint64_t wordOffset = 0;
+  uint64_t pixelOffset = 0;
+  uint32_t isInvalid = 0;
+
+  while (wordOffset < inputBuffer32NumWords) {
+    const uint32_t inW1 = inputBuffer32[wordOffset++];
+    MV32_PARSE_OP_NUM_SKIP(inW1, opCode, numPixels, skipAfter);
+
+    if (opCode == DONE) {
+      isInvalid |= (wordOffset == inputBuffer32NumWords);
+      isInvalid |= (pixelOffset > frameBufferSize);
+      return isInvalid ? MV_ERROR_CODE_INVALID_INPUT : 0;
+    }
+
+    isInvalid |= (numPixels == 0);
+    isInvalid |= ((opCode == DUP) & (numPixels < 2));
+
+    wordOffset += (opCode == COPY) ? numPixels : (opCode == DUP);
+
+    pixelOffset += numPixels + skipAfter;
+  }
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+// The validated decoders check each code as it is decoded instead of walking
+// the codes in a separate pass, so the checks are predictable compare and
+// branch instructions in a loop that has to load each code anyway. A separate
+// pass would double the number of dependent loads for a frame with many codes.
+
+uint32_t
+maxvid_decode_c4_sample16_validated(uint16_t * restrict frameBuffer16,
+                                    const uint32_t * restrict inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferSize)
+{
+  uint16_t * restrict outPtr = frameBuffer16;
+  const uint16_t * const outEnd = frameBuffer16 + frameBufferSize;
+  const uint32_t * restrict inPtr = inputBuffer32;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    const uint32_t inW1 = *inPtr++;
+    const uint32_t opCode = inW1 >> 30;
+
+    if (opCode == SKIP) {
+      const uint32_t numPixels = inW1 & MV_MAX_30_BITS;
+      if (numPixels == 0 || numPixels > (outEnd - outPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      outPtr += numPixels;
+    } else if (opCode == DUP) {
+      const uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels < 2 || numPixels > (outEnd - outPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      const uint16_t pixel = (uint16_t) inW1;
+      uint32_t numLeft = numPixels;
+      // Write one pixel to word align the framebuffer, then fill words
+      if ((((uintptr_t) outPtr) & 0x2) != 0) {
+        *outPtr++ = pixel;
+        numLeft--;
+      }
+      maxvid_blit_fill32((uint32_t *) outPtr, (((uint32_t) pixel) << 16) | pixel, numLeft >> 1);
+      if ((numLeft & 0x1) != 0) {
+        outPtr[numLeft - 1] = pixel;
+      }
+      outPtr += numLeft;
+    } else if (opCode == COPY) {
+      uint32_t numPixels = (inW1 >> 16) & MV_MAX_14_BITS;
+      if (numPixels == 0 || numPixels > (outEnd - outPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      // The first pixel is stored in the code word when the framebuffer
+      // is half word aligned or when only one pixel is copied.
+      if ((numPixels == 1) || (((outPtr - frameBuffer16) & 0x1) != 0)) {
+        *outPtr++ = (uint16_t) inW1;
+        numPixels--;
+      }
+      const uint32_t numWords = (numPixels + 1) >> 1;
+      if (numWords > (inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      const uint16_t *inPtr16 = (const uint16_t *) inPtr;
+      for (uint32_t i = 0; i < numPixels; i++) {
+        outPtr[i] = inPtr16[i];
+      }
+      outPtr += numPixels;
+      inPtr += numWords;
+    } else {
+      return 0;
+    }
+  }
+
+  // No DONE code found before the end of the input
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
+
+uint32_t
+maxvid_decode_c4_sample32_validated(uint32_t * restrict frameBuffer32,
+                                    const uint32_t * restrict inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferSize)
+{
+  uint32_t * restrict outPtr = frameBuffer32;
+  const uint32_t * const outEnd = frameBuffer32 + frameBufferSize;
+  const uint32_t * restrict inPtr = inputBuffer32;
+  const uint32_t * const inEnd = inputBuffer32 + inputBuffer32NumWords;
+
+  while (inPtr < inEnd) {
+    const uint32_t inW1 = *inPtr++;
+    MV32_PARSE_OP_NUM_SKIP(inW1, opCode, numPixels, skipAfter);
+
+    if (opCode == DONE) {
+      return 0;
+    }
+
+    if (numPixels < ((opCode == DUP) ? 2 : 1) || (numPixels + skipAfter) > (outEnd - outPtr)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    if (opCode == DUP) {
+      if (inPtr == inEnd) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      const uint32_t pixel = *inPtr++;
+      maxvid_blit_fill32(outPtr, pixel, numPixels);
+    } else if (opCode == COPY) {
+      if (numPixels > (inEnd - inPtr)) {
+        return MV_ERROR_CODE_INVALID_INPUT;
+      }
+      for (uint32_t i = 0; i < numPixels; i++) {
+        outPtr[i] = inPtr[i];
+      }
+      inPtr += numPixels;
+    }
+
+    outPtr += numPixels + skipAfter;
+  }
+
+  return MV_ERROR_CODE_INVALID_INPUT;
+}
@@ -0,0 +1,72 @@
+// maxvid_validate module
+//
+//  License terms defined in License.txt.
+//
+// This module implements validation of maxvid data that comes from an untrusted
+// source. The decoder is optimized for speed and assumes that input data was
+// validated when it was written, so a corrupt or hostile file can cause the
+// decoder to read or write past the end of a buffer. The file check verifies
+// the header and that every entry in the frame table is inside the file. The
+// validated c4 decoders check that every SKIP, DUP, and COPY stays inside both
+// the input buffer and the framebuffer as each code is decoded.
+
+#ifndef MAXVID_VALIDATE_H
+#define MAXVID_VALIDATE_H
+
+#include "maxvid_file.h"
+
+// Validate the header and the frame table of a maxvid file that is fileNumBytes
+// long. The framesPtr must point to the header->numFrames entries located at
+// framesOffset in the file, the caller should first make sure that the header
+// and frame table fit in the file with maxvid_file_validate_header() and, when
+// the frames at end flag is set, maxvid_file_validate_trailer(). Returns 0 on
+// success, otherwise MV_ERROR_CODE_INVALID_INPUT.
+
+uint32_t
+maxvid_file_validate_header(const MVFileHeader *header, uint64_t fileNumBytes);
+
+uint32_t
+maxvid_file_validate_trailer(const MVFileHeader *header, const MVFileTrailer *trailer, uint64_t fileNumBytes);
+
+uint32_t
+maxvid_file_validate(const MVFileHeader *header, void *framesPtr, uint64_t framesOffset, uint64_t fileNumBytes);
+
+// Validate the header->numLevels entries of the level table in a file with the
+// MV_FILE_LEVELS flag set, the header must first be checked with
+// maxvid_file_validate_header(). The frame table of each level is then checked
+// with maxvid_file_validate() using a header with the size of the level.
+
+uint32_t
+maxvid_file_validate_levels(const MVFileHeader *header, const MVLevel *levels, uint64_t fileNumBytes);
+
+// Validate the c4 codes for one 16 or 32 BPP delta frame without decoding.
+// Returns 0 when the codes can be passed to maxvid_decode_c4_sample16() or
+// maxvid_decode_c4_sample32(), otherwise MV_ERROR_CODE_INVALID_INPUT.
+
+uint32_t
+maxvid_validate_c4_sample16(const uint32_t * restrict inputBuffer32,
+                            const uint32_t inputBuffer32NumWords,
+                            const uint32_t frameBufferSize);
+
+uint32_t
+maxvid_validate_c4_sample32(const uint32_t * restrict inputBuffer32,
+                            const uint32_t inputBuffer32NumWords,
+                            const uint32_t frameBufferSize);
+
+// Decode one delta frame with bounds checks, the cost is close to the unchecked
+// decode. Returns MV_ERROR_CODE_INVALID_INPUT as soon as an invalid code is
+// found, the framebuffer may then contain a partially decoded frame.
+
+uint32_t
+maxvid_decode_c4_sample16_validated(uint16_t * restrict frameBuffer16,
+                                    const uint32_t * restrict inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferSize);
+
+uint32_t
+maxvid_decode_c4_sample32_validated(uint32_t * restrict frameBuffer32,
+                                    const uint32_t * restrict inputBuffer32,
+                                    const uint32_t inputBuffer32NumWords,
+                                    const uint32_t frameBufferSize);
+
+#endif // MAXVID_VALIDATE_H
@@ -0,0 +1,355 @@
+// maxvid_writer module
+//
+//  License terms defined in License.txt.
+//
+// This module implements the vectored output path used when writing a maxvid file.
+
+#include "maxvid_writer.h"
+
+#include <fcntl.h>
+#include <errno.h>
+
+// Zero padding is written from this block, it is never modified
+
+static const char maxvidWriterZeroPage[MV_PAGESIZE];
+
+// Write the pending buffers at pendingOffset. A short write is continued
+// from the first byte that was not written. Mac OS X and iOS before 14
+// do not provide pwritev(), so the fd position is tracked and writev()
+// is used after an lseek() when the position does not already match.
+
+static
+uint32_t maxvid_writer_writev(MVWriter *writer)
+{
+  struct iovec *iov = writer->iov;
+  int iovCount = writer->iovCount;
+  uint64_t fileOffset = writer->pendingOffset;
+
+  while (iovCount > 0) {
+    ssize_t numWritten;
+
+#if defined(__linux__)
+    numWritten = pwritev(writer->fd, iov, iovCount, (off_t)fileOffset);
+#else
+    if (writer->filePos != fileOffset) {
+      if (lseek(writer->fd, (off_t)fileOffset, SEEK_SET) == -1) {
+        return MV_ERROR_CODE_WRITE_FAILED;
+      }
+      writer->filePos = fileOffset;
+      writer->numSyscalls++;
+    }
+    numWritten = writev(writer->fd, iov, iovCount);
+#endif // __linux__
+
+    writer->numSyscalls++;
+
+    if (numWritten < 0 && errno == EINTR) {
+      continue;
+    }
+    if (numWritten <= 0) {
+      return MV_ERROR_CODE_WRITE_FAILED;
+    }
+
+    fileOffset += numWritten;
+    writer->filePos = fileOffset;
+
+    // Skip the buffers that were completely written
+
+    size_t numBytes = (size_t) numWritten;
+
+    while (iovCount > 0 && numBytes >= iov->iov_len) {
+      numBytes -= iov->iov_len;
+      iov++;
+      iovCount--;
+    }
+
+    if (numBytes > 0) {
+      iov->iov_base = (char*)iov->iov_base + numBytes;
+      iov->iov_len -= numBytes;
+    }
+  }
+
+  writer->iovCount = 0;
+  writer->bufferUsed = 0;
+  writer->pendingOffset = writer->offset;
+
+  return 0;
+}
+
+// Stop bypassing the buffer cache, needed before an unaligned write
+
+static
+uint32_t maxvid_writer_end_direct(MVWriter *writer)
+{
+  if ((writer->flags & MV_WRITER_DIRECT) == 0) {
+    return 0;
+  }
+
+#if defined(__linux__) && defined(O_DIRECT)
+  int fileFlags = fcntl(writer->fd, F_GETFL);
+  if (fileFlags == -1 || fcntl(writer->fd, F_SETFL, fileFlags & ~O_DIRECT) == -1) {
+    return MV_ERROR_CODE_WRITE_FAILED;
+  }
+#endif // __linux__ && O_DIRECT
+
+  writer->flags &= ~MV_WRITER_DIRECT;
+
+  return 0;
+}
+
+// Add a buffer to the pending list, the caller must make sure the list is not full.
+// A buffer that begins where the previous one ends is merged into it.
+
+static inline
+void maxvid_writer_append_iov(MVWriter *writer, const void *ptr, uint32_t numBytes)
+{
+  if (writer->iovCount > 0) {
+    struct iovec *lastIov = &writer->iov[writer->iovCount - 1];
+    if (((char*)lastIov->iov_base + lastIov->iov_len) == (char*)ptr) {
+      lastIov->iov_len += numBytes;
+      return;
+    }
+  }
+
+  struct iovec *iov = &writer->iov[writer->iovCount++];
+  iov->iov_base = (void*) ptr;
+  iov->iov_len = numBytes;
+}
+
+// Copy data into the staging buffer. In direct mode the staging buffer is the
+// only pending buffer and it is written when full, so each write is aligned.
+
+static
+uint32_t maxvid_writer_copy(MVWriter *writer, const void *ptr, uint32_t numBytes)
+{
+  const char *inPtr = ptr;
+
+  while (numBytes > 0) {
+    if ((writer->bufferUsed == MV_WRITER_BUFFER_SIZE) || (writer->iovCount == MV_WRITER_MAX_IOV)) {
+      uint32_t status = maxvid_writer_writev(writer);
+      if (status != 0) {
+        return status;
+      }
+    }
+
+    uint32_t numToCopy = MV_WRITER_BUFFER_SIZE - writer->bufferUsed;
+    if (numToCopy > numBytes) {
+      numToCopy = numBytes;
+    }
+
+    char *bufferPtr = writer->buffer + writer->bufferUsed;
+    memcpy(bufferPtr, inPtr, numToCopy);
+    maxvid_writer_append_iov(writer, bufferPtr, numToCopy);
+
+    writer->bufferUsed += numToCopy;
+    writer->offset += numToCopy;
+    inPtr += numToCopy;
+    numBytes -= numToCopy;
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_writer_open(MVWriter *writer, const char *path, uint32_t flags)
+{
+  memset(writer, 0, sizeof(MVWriter));
+  writer->fd = -1;
+  writer->flags = flags;
+
+  if (posix_memalign((void**)&writer->buffer, MV_PAGESIZE, MV_WRITER_BUFFER_SIZE) != 0) {
+    writer->buffer = NULL;
+    return MV_ERROR_CODE_WRITE_FAILED;
+  }
+
+  int openFlags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#if defined(__linux__) && defined(O_DIRECT)
+  if (flags & MV_WRITER_DIRECT) {
+    writer->fd = open(path, openFlags | O_DIRECT, 0666);
+
+    if (writer->fd == -1 && errno == EINVAL) {
+      // Filesystem does not support O_DIRECT, for example tmpfs
+      writer->flags &= ~MV_WRITER_DIRECT;
+    }
+  }
+#endif // __linux__ && O_DIRECT
+
+  if (writer->fd == -1) {
+    writer->fd = open(path, openFlags, 0666);
+  }
+
+  if (writer->fd == -1) {
+    return MV_ERROR_CODE_WRITE_FAILED;
+  }
+
+#if defined(__APPLE__)
+  if (flags & MV_WRITER_DIRECT) {
+    (void)fcntl(writer->fd, F_NOCACHE, 1);
+  }
+#endif // __APPLE__
+
+  return 0;
+}
+
+uint32_t
+maxvid_writer_write(MVWriter *writer, const void *ptr, uint32_t numBytes)
+{
+  if ((writer->flags & MV_WRITER_DIRECT) || (numBytes < (MV_WRITER_BUFFER_SIZE / 2))) {
+    return maxvid_writer_copy(writer, ptr, numBytes);
+  }
+
+  // Large write, the caller's memory is passed to the kernel along with any
+  // pending data and padding. The write must be done before returning.
+
+  if (writer->iovCount == MV_WRITER_MAX_IOV) {
+    uint32_t status = maxvid_writer_writev(writer);
+    if (status != 0) {
+      return status;
+    }
+  }
+
+  maxvid_writer_append_iov(writer, ptr, numBytes);
+  writer->offset += numBytes;
+
+  return maxvid_writer_writev(writer);
+}
+
+uint32_t
+maxvid_writer_pad(MVWriter *writer, uint32_t numBytes)
+{
+  uint32_t status;
+
+  if (writer->flags & MV_WRITER_DIRECT) {
+    while (numBytes > 0) {
+      uint32_t numToPad = (numBytes > MV_PAGESIZE) ? MV_PAGESIZE : numBytes;
+      status = maxvid_writer_copy(writer, maxvidWriterZeroPage, numToPad);
+      if (status != 0) {
+        return status;
+      }
+      numBytes -= numToPad;
+    }
+    return 0;
+  }
+
+  if ((writer->flags & MV_WRITER_SPARSE) && (numBytes >= MV_WRITER_HOLE_MIN)) {
+    // Write pending data, then leave a hole. Writing past the end of the file
+    // or setting the size on close fills the hole with zeros.
+
+    status = maxvid_writer_writev(writer);
+    if (status != 0) {
+      return status;
+    }
+    writer->offset += numBytes;
+    writer->pendingOffset = writer->offset;
+    return 0;
+  }
+
+  while (numBytes > 0) {
+    if (writer->iovCount == MV_WRITER_MAX_IOV) {
+      status = maxvid_writer_writev(writer);
+      if (status != 0) {
+        return status;
+      }
+    }
+
+    uint32_t numToPad = (numBytes > MV_PAGESIZE) ? MV_PAGESIZE : numBytes;
+    maxvid_writer_append_iov(writer, maxvidWriterZeroPage, numToPad);
+    writer->offset += numToPad;
+    numBytes -= numToPad;
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_writer_flush(MVWriter *writer)
+{
+  uint32_t status;
+
+  if (writer->iovCount > 0) {
+    // In direct mode, a partial staging buffer is not aligned
+
+    if ((writer->flags & MV_WRITER_DIRECT) && (writer->bufferUsed != MV_WRITER_BUFFER_SIZE)) {
+      status = maxvid_writer_end_direct(writer);
+      if (status != 0) {
+        return status;
+      }
+    }
+
+    status = maxvid_writer_writev(writer);
+    if (status != 0) {
+      return status;
+    }
+  }
+
+  // The file ends with a hole when the last padding was not written,
+  // so the size must be set explicitly.
+
+  if (writer->offset > writer->filePos) {
+    if (ftruncate(writer->fd, (off_t)writer->offset) != 0) {
+      return MV_ERROR_CODE_WRITE_FAILED;
+    }
+    writer->numSyscalls++;
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_writer_rewrite(MVWriter *writer, const void *ptr, uint32_t numBytes, uint64_t offset)
+{
+  assert((offset + numBytes) <= writer->offset);
+
+  uint32_t status = maxvid_writer_end_direct(writer);
+  if (status != 0) {
+    return status;
+  }
+
+  status = maxvid_writer_flush(writer);
+  if (status != 0) {
+    return status;
+  }
+
+  const char *inPtr = ptr;
+
+  while (numBytes > 0) {
+    ssize_t numWritten = pwrite(writer->fd, inPtr, numBytes, (off_t)offset);
+    writer->numSyscalls++;
+
+    if (numWritten < 0 && errno == EINTR) {
+      continue;
+    }
+    if (numWritten <= 0) {
+      return MV_ERROR_CODE_WRITE_FAILED;
+    }
+
+    inPtr += numWritten;
+    offset += numWritten;
+    numBytes -= (uint32_t) numWritten;
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_writer_close(MVWriter *writer)
+{
+  uint32_t status = 0;
+
+  if (writer->fd != -1) {
+    status = maxvid_writer_flush(writer);
+
+    if (close(writer->fd) != 0) {
+      status = MV_ERROR_CODE_WRITE_FAILED;
+    }
+    writer->fd = -1;
+  }
+
+  if (writer->buffer) {
+    free(writer->buffer);
+    writer->buffer = NULL;
+  }
+
+  return status;
+}
@@ -0,0 +1,102 @@
+// maxvid_writer module
+//
+//  License terms defined in License.txt.
+//
+// This module implements the low level output path used when writing a maxvid
+// file. Frame data and the zero padding that follows a keyframe are collected
+// as a list of buffers and written with one vectored write, so a keyframe costs
+// one system call instead of a call per word of padding. Small writes such as
+// delta frames are copied into a staging buffer and written in batches. When
+// sparse padding is enabled, padding of a whole filesystem block or more is not
+// written at all, the file offset is advanced and the filesystem reads the hole
+// back as zeros. Direct mode bypasses the buffer cache for very large files, all
+// data then passes through the page aligned staging buffer and is written in
+// whole aligned chunks.
+
+#ifndef MAXVID_WRITER_H
+#define MAXVID_WRITER_H
+
+#include "maxvid_file.h"
+
+#include <sys/uio.h>
+
+// Skip writing zero padding when it covers a whole filesystem block
+
+#define MV_WRITER_SPARSE 0x1
+
+// Bypass the buffer cache, O_DIRECT on Linux and F_NOCACHE on Mac OS X / iOS
+
+#define MV_WRITER_DIRECT 0x2
+
+// Max number of pending buffers, a flush is done when the list is full
+
+#define MV_WRITER_MAX_IOV 64
+
+// Size of the page aligned staging buffer. Writes smaller than half the
+// staging buffer are copied, larger writes are passed to the kernel as is.
+
+#define MV_WRITER_BUFFER_SIZE (64 * MV_PAGESIZE)
+
+// Padding shorter than this is written as zeros even when sparse
+
+#define MV_WRITER_HOLE_MIN 4096
+
+typedef struct {
+  int fd;
+  uint32_t flags;
+  // Logical offset of the next byte appended to the file
+  uint64_t offset;
+  // File offset of the first pending byte, pending bytes are contiguous
+  uint64_t pendingOffset;
+  // End of the last write, also the fd position when pwritev is not available
+  uint64_t filePos;
+  struct iovec iov[MV_WRITER_MAX_IOV];
+  int iovCount;
+  char *buffer;
+  uint32_t bufferUsed;
+  uint32_t numSyscalls;
+} MVWriter;
+
+// Create or truncate the file at path and set up the writer. Direct mode is
+// silently not used when the filesystem does not support it. Returns 0 on
+// success, otherwise MV_ERROR_CODE_WRITE_FAILED.
+
+uint32_t
+maxvid_writer_open(MVWriter *writer, const char *path, uint32_t flags);
+
+// Append numBytes from ptr to the file. The data is copied or written before
+// this function returns, so the caller can reuse the memory right away.
+
+uint32_t
+maxvid_writer_write(MVWriter *writer, const void *ptr, uint32_t numBytes);
+
+// Append numBytes of zero padding to the file
+
+uint32_t
+maxvid_writer_pad(MVWriter *writer, uint32_t numBytes);
+
+// Write all pending data to the file and make sure the file size includes
+// padding that was left as a hole at the end of the file.
+
+uint32_t
+maxvid_writer_flush(MVWriter *writer);
+
+// Overwrite numBytes of data that was already appended at the indicated offset,
+// used to rewrite the header once all frames are known. Pending data is written
+// first, and direct mode is turned off since the write is not aligned.
+
+uint32_t
+maxvid_writer_rewrite(MVWriter *writer, const void *ptr, uint32_t numBytes, uint64_t offset);
+
+// Write pending data and close the file. Returns 0 on success, otherwise
+// MV_ERROR_CODE_WRITE_FAILED. This function can be invoked more than once.
+
+uint32_t
+maxvid_writer_close(MVWriter *writer);
+
+static inline
+uint64_t maxvid_writer_offset(MVWriter *writer) {
+  return writer->offset;
+}
+
+#endif // MAXVID_WRITER_H
@@ -0,0 +1,304 @@
+// maxvid_y4m module
+//
+//  License terms defined in License.txt.
+//
+// This module implements a reader for YUV4MPEG2 and raw I420 frames,
+// see maxvid_y4m.h.
+
+#include "maxvid_y4m.h"
+
+#include <errno.h>
+
+#define MV_Y4M_MAGIC "YUV4MPEG2"
+#define MV_Y4M_FRAME_MAGIC "FRAME"
+
+// Only 8 bit 4:2:0 and mono colorspaces can be read, the 4:2:0 variants
+// differ only in where the chroma samples are sited. A high bit depth tag
+// like 420p10 has 16 bit samples and is rejected.
+
+static const char * const maxvidY4M420Colorspaces[] = { "420", "420jpeg", "420paldv", "420mpeg2", NULL };
+
+// Read up to numBytes, a read from a pipe can return fewer bytes than asked
+// for. Returns the number of bytes read, this is less than numBytes only at
+// the end of the input, or -1 when a read fails.
+
+static
+ssize_t maxvid_y4m_read_fully(int fd, void *ptr, size_t numBytes) {
+  size_t numRead = 0;
+
+  while (numRead < numBytes) {
+    ssize_t result = read(fd, ((char *) ptr) + numRead, numBytes - numRead);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    } else if (result == 0) {
+      break;
+    }
+    numRead += result;
+  }
+
+  return (ssize_t) numRead;
+}
+
+// Read one header line up to the newline, the newline is not included. A byte
+// at a time is read so that no part of the frame data after the line is
+// consumed. Returns 0 on success, MV_Y4M_END_OF_STREAM when the input ends
+// before the first byte, otherwise an error code.
+
+static
+uint32_t maxvid_y4m_read_line(int fd, char *line) {
+  uint32_t length = 0;
+
+  while (1) {
+    char c;
+    ssize_t result = maxvid_y4m_read_fully(fd, &c, 1);
+    if (result < 0) {
+      return MV_ERROR_CODE_READ_FAILED;
+    } else if (result == 0) {
+      return (length == 0) ? MV_Y4M_END_OF_STREAM : MV_ERROR_CODE_READ_FAILED;
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (length == (MV_Y4M_MAX_HEADER_LENGTH - 1)) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+    line[length++] = c;
+  }
+
+  line[length] = '\0';
+  return 0;
+}
+
+// Parse a positive decimal integer that fills the whole string
+
+static
+uint32_t maxvid_y4m_parse_uint(const char *str, uint32_t *result) {
+  char *end;
+  errno = 0;
+  unsigned long value = strtoul(str, &end, 10);
+  if (end == str || *end != '\0' || errno != 0 || value == 0 || value > 0xFFFF) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  *result = (uint32_t) value;
+  return 0;
+}
+
+static
+int maxvid_y4m_is_420(const char *colorspace) {
+  for (int i = 0; maxvidY4M420Colorspaces[i] != NULL; i++) {
+    if (strcmp(colorspace, maxvidY4M420Colorspaces[i]) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static
+void maxvid_y4m_init(MVY4MReader *reader, int fd) {
+  memset(reader, 0, sizeof(MVY4MReader));
+  reader->fd = fd;
+  reader->range = MV_YUV_RANGE_VIDEO;
+}
+
+uint32_t
+maxvid_y4m_open(MVY4MReader *reader, int fd)
+{
+  char line[MV_Y4M_MAX_HEADER_LENGTH];
+
+  maxvid_y4m_init(reader, fd);
+
+  uint32_t status = maxvid_y4m_read_line(fd, line);
+  if (status == MV_Y4M_END_OF_STREAM) {
+    return MV_ERROR_CODE_READ_FAILED;
+  } else if (status != 0) {
+    return status;
+  }
+
+  char *save = NULL;
+  char *token = strtok_r(line, " ", &save);
+  if (token == NULL || strcmp(token, MV_Y4M_MAGIC) != 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  while ((token = strtok_r(NULL, " ", &save)) != NULL) {
+    char *value = token + 1;
+
+    switch (token[0]) {
+      case 'W':
+        status = maxvid_y4m_parse_uint(value, &reader->width);
+        break;
+      case 'H':
+        status = maxvid_y4m_parse_uint(value, &reader->height);
+        break;
+      case 'F': {
+        // Frame rate as N:D
+        char *colon = strchr(value, ':');
+        if (colon == NULL) {
+          return MV_ERROR_CODE_INVALID_INPUT;
+        }
+        *colon = '\0';
+        status = maxvid_y4m_parse_uint(value, &reader->frameRateNum);
+        if (status == 0) {
+          status = maxvid_y4m_parse_uint(colon + 1, &reader->frameRateDen);
+        }
+        break;
+      }
+      case 'C':
+        if (maxvid_y4m_is_420(value)) {
+          reader->isMono = 0;
+        } else if (strcmp(value, "mono") == 0) {
+          reader->isMono = 1;
+        } else {
+          return MV_ERROR_CODE_INVALID_INPUT;
+        }
+        break;
+      case 'X':
+        if (strcmp(value, "COLORRANGE=FULL") == 0) {
+          reader->range = MV_YUV_RANGE_FULL;
+        }
+        break;
+      default:
+        // Interlacing, aspect ratio, and unknown parameters are ignored
+        break;
+    }
+
+    if (status != 0) {
+      return status;
+    }
+  }
+
+  if (reader->width == 0 || reader->height == 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_y4m_open_raw(MVY4MReader *reader, int fd, uint32_t width, uint32_t height)
+{
+  maxvid_y4m_init(reader, fd);
+
+  if (width == 0 || height == 0 || width > 0xFFFF || height > 0xFFFF) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  reader->isRaw = 1;
+  reader->width = width;
+  reader->height = height;
+
+  return 0;
+}
+
+uint32_t
+maxvid_y4m_frame_alloc(const MVY4MReader *reader, MVY4MFrame *frame)
+{
+  memset(frame, 0, sizeof(MVY4MFrame));
+
+  if (reader->width == 0 || reader->height == 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  // Each dimension can be up to 0xFFFF, so the size is calculated in 64 bits
+
+  const uint64_t yNumBytes = (uint64_t) reader->width * reader->height;
+  const uint64_t uvNumBytes = (uint64_t) ((reader->width + 1) / 2) * ((reader->height + 1) / 2);
+  const uint64_t numBytes = yNumBytes + (reader->isMono ? 0 : (2 * uvNumBytes));
+
+  if (numBytes > MV_Y4M_MAX_FRAME_NUM_BYTES) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  frame->width = reader->width;
+  frame->height = reader->height;
+  frame->isMono = reader->isMono;
+  frame->numBytes = (uint32_t) numBytes;
+
+  frame->yPlane = malloc(frame->numBytes);
+  if (frame->yPlane == NULL) {
+    return MV_ERROR_CODE_OUT_OF_MEMORY;
+  }
+
+  if (!reader->isMono) {
+    frame->uPlane = frame->yPlane + yNumBytes;
+    frame->vPlane = frame->uPlane + uvNumBytes;
+  }
+
+  return 0;
+}
+
+void
+maxvid_y4m_frame_free(MVY4MFrame *frame)
+{
+  free(frame->yPlane);
+  memset(frame, 0, sizeof(MVY4MFrame));
+}
+
+uint32_t
+maxvid_y4m_read_frame(MVY4MReader *reader, MVY4MFrame *frame)
+{
+  assert(frame->width == reader->width && frame->height == reader->height && frame->isMono == reader->isMono);
+
+  ssize_t result;
+
+  if (reader->isRaw) {
+    // The input ends at a frame bound when no byte of the next frame is read
+
+    result = maxvid_y4m_read_fully(reader->fd, frame->yPlane, frame->numBytes);
+    if (result == 0) {
+      return MV_Y4M_END_OF_STREAM;
+    }
+  } else {
+    // Each frame starts with a FRAME line, frame parameters are ignored
+
+    char line[MV_Y4M_MAX_HEADER_LENGTH];
+    uint32_t status = maxvid_y4m_read_line(reader->fd, line);
+    if (status != 0) {
+      return status;
+    }
+    if (strncmp(line, MV_Y4M_FRAME_MAGIC, 5) != 0 || (line[5] != '\0' && line[5] != ' ')) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+
+    result = maxvid_y4m_read_fully(reader->fd, frame->yPlane, frame->numBytes);
+  }
+
+  if (result != frame->numBytes) {
+    return MV_ERROR_CODE_READ_FAILED;
+  }
+
+  reader->numFramesRead++;
+
+  return 0;
+}
+
+uint32_t
+maxvid_y4m_frame_to_bgra(const MVY4MFrame *frame,
+                         const MVY4MFrame *alphaFrame,
+                         const MVYUVCoefficients *coefficients,
+                         uint32_t *outPixels)
+{
+  if (frame->isMono) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  const uint8_t *alphaPlane = NULL;
+
+  if (alphaFrame != NULL) {
+    if (alphaFrame->width != frame->width || alphaFrame->height != frame->height) {
+      return MV_ERROR_CODE_INVALID_INPUT;
+    }
+    alphaPlane = alphaFrame->yPlane;
+  }
+
+  const uint32_t width = frame->width;
+
+  return maxvid_yuv_i420_to_bgra(coefficients, outPixels, width * sizeof(uint32_t),
+                                 frame->yPlane, width,
+                                 frame->uPlane, frame->vPlane, (width + 1) / 2,
+                                 alphaPlane, width,
+                                 width, frame->height);
+}
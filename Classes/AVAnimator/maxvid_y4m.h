@@ -0,0 +1,111 @@
+// maxvid_y4m module
+//
+//  License terms defined in License.txt.
+//
+// This module implements a reader for YUV 4:2:0 video frames in the
+// YUV4MPEG2 (.y4m) format or as raw I420 frames with no headers, so that
+// video decoded by an external tool like ffmpeg can be converted to a .mvid
+// without AVFoundation. The input is read from a file descriptor, this is
+// either a file or a pipe from the external decoder:
+//
+// ffmpeg -i in.m4v -f yuv4mpegpipe -pix_fmt yuv420p - | ...
+//
+// A frame is only read when the caller asks for the next frame, so reading
+// from a pipe applies backpressure. Once the pipe buffer is full, the external
+// decoder blocks until the encoder catches up and memory use is bounded by
+// the frames the caller allocated.
+//
+// A frame is converted to premultiplied BGRA pixels with maxvid_yuv.h. The
+// Y plane of a second frame can be passed as the alpha channel, this second
+// frame comes from a separate alpha video when joining an RGB and an alpha
+// video, or from the next frame in the same video when the RGB and alpha
+// frames of a mixed video alternate. A grayscale alpha video can be written
+// with the mono colorspace, such a frame has only a Y plane.
+
+#ifndef MAXVID_Y4M_H
+#define MAXVID_Y4M_H
+
+#include "maxvid_yuv.h"
+
+// Returned by maxvid_y4m_read_frame() when the input ends at a frame bound
+
+#define MV_Y4M_END_OF_STREAM 0x80
+
+// Max length of the stream header or a frame header line
+
+#define MV_Y4M_MAX_HEADER_LENGTH 1024
+
+// Max size of the planes of one frame, 256 MB is more than a 16K 4:2:0 frame
+
+#define MV_Y4M_MAX_FRAME_NUM_BYTES (256 * 1024 * 1024)
+
+typedef struct {
+  int fd;
+  uint32_t isRaw;
+  uint32_t isMono;
+  uint32_t width;
+  uint32_t height;
+  // Frame rate as a fraction, both are 0 when not known
+  uint32_t frameRateNum;
+  uint32_t frameRateDen;
+  MVYUVRange range;
+  uint32_t numFramesRead;
+} MVY4MReader;
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t isMono;
+  uint8_t *yPlane;
+  // NULL when the frame is mono
+  uint8_t *uPlane;
+  uint8_t *vPlane;
+  uint32_t numBytes;
+} MVY4MFrame;
+
+// Read and parse the stream header. The W and H parameters are required, a
+// colorspace other than 8 bit 4:2:0 (420, 420jpeg, 420paldv or 420mpeg2) or
+// mono is rejected. The range is full when the
+// stream has an XCOLORRANGE=FULL parameter, otherwise it is video range.
+// Returns 0 on success, MV_ERROR_CODE_INVALID_INPUT when the header is not
+// valid, or MV_ERROR_CODE_READ_FAILED when the header could not be read. The
+// reader does not own fd, the caller closes it since it can be stdin.
+
+uint32_t
+maxvid_y4m_open(MVY4MReader *reader, int fd);
+
+// Set up a reader for raw I420 frames of the indicated size, in video range.
+
+uint32_t
+maxvid_y4m_open_raw(MVY4MReader *reader, int fd, uint32_t width, uint32_t height);
+
+// Allocate a frame buffer that can hold a frame read with this reader.
+// Returns 0 on success, MV_ERROR_CODE_INVALID_INPUT when the frame is larger
+// than MV_Y4M_MAX_FRAME_NUM_BYTES, or MV_ERROR_CODE_OUT_OF_MEMORY.
+
+uint32_t
+maxvid_y4m_frame_alloc(const MVY4MReader *reader, MVY4MFrame *frame);
+
+void
+maxvid_y4m_frame_free(MVY4MFrame *frame);
+
+// Read the next frame into a frame allocated for this reader. Returns 0 on
+// success, MV_Y4M_END_OF_STREAM when there are no more frames, or
+// MV_ERROR_CODE_READ_FAILED when the input ends in the middle of a frame or
+// a read fails.
+
+uint32_t
+maxvid_y4m_read_frame(MVY4MReader *reader, MVY4MFrame *frame);
+
+// Convert a 4:2:0 frame to width x height premultiplied BGRA pixels. When
+// alphaFrame is not NULL, its Y plane is joined as the alpha channel, it must
+// be the same size as the frame. Returns 0 on success, otherwise
+// MV_ERROR_CODE_INVALID_INPUT.
+
+uint32_t
+maxvid_y4m_frame_to_bgra(const MVY4MFrame *frame,
+                         const MVY4MFrame *alphaFrame,
+                         const MVYUVCoefficients *coefficients,
+                         uint32_t *outPixels);
+
+#endif // MAXVID_Y4M_H
@@ -0,0 +1,253 @@
+// maxvid_yuv module
+//
+//  License terms defined in License.txt.
+//
+// This module implements conversion of 4:2:0 YUV frames to 32 bpp BGRA pixels,
+// see maxvid_yuv.h.
+
+#include "maxvid_yuv.h"
+
+// 4 pixels are converted at a time, each channel is widened to 32 bits so
+// that the fixed point products do not overflow. The vectors are 128 bits,
+// wider vectors are split through memory when the target has no 256 bit
+// registers, which is much slower than the scalar code.
+
+typedef uint8_t MVYUVVec2 __attribute__((vector_size(2)));
+typedef uint8_t MVYUVVec4 __attribute__((vector_size(4)));
+typedef int32_t MVYUVVec32 __attribute__((vector_size(16)));
+typedef uint32_t MVYUVVecU32 __attribute__((vector_size(16)));
+
+#define MV_YUV_VEC_NUM_PIXELS 4
+
+#define MV_YUV_FRACTION_BITS 16
+#define MV_YUV_ROUND (1 << (MV_YUV_FRACTION_BITS - 1))
+
+// c / 255 rounded to nearest, exact for c <= (255 * 255)
+
+#define MV_YUV_DIV_255(c) \
+  ({ __typeof__(c) t = (c) + 128; (t + (t >> 8)) >> 8; })
+
+static inline
+int32_t maxvid_yuv_fixed(double value) {
+  return (int32_t) ((value * (1 << MV_YUV_FRACTION_BITS)) + 0.5);
+}
+
+uint32_t
+maxvid_yuv_init(MVYUVCoefficients *coefficients, MVYUVMatrix matrix, MVYUVRange range)
+{
+  double kr, kb;
+
+  if (matrix == MV_YUV_MATRIX_BT601) {
+    kr = 0.299;
+    kb = 0.114;
+  } else if (matrix == MV_YUV_MATRIX_BT709) {
+    kr = 0.2126;
+    kb = 0.0722;
+  } else {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  const double kg = 1.0 - kr - kb;
+
+  // Video range Y spans 219 levels and UV spans 224 levels
+
+  double yScale, uvScale;
+  int32_t yOffset;
+
+  if (range == MV_YUV_RANGE_VIDEO) {
+    yOffset = 16;
+    yScale = 255.0 / 219.0;
+    uvScale = 255.0 / 224.0;
+  } else if (range == MV_YUV_RANGE_FULL) {
+    yOffset = 0;
+    yScale = 1.0;
+    uvScale = 1.0;
+  } else {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  coefficients->yOffset = yOffset;
+  coefficients->yScale = maxvid_yuv_fixed(yScale);
+  coefficients->vToRed = maxvid_yuv_fixed(2.0 * (1.0 - kr) * uvScale);
+  coefficients->uToGreen = maxvid_yuv_fixed(2.0 * (1.0 - kb) * kb / kg * uvScale);
+  coefficients->vToGreen = maxvid_yuv_fixed(2.0 * (1.0 - kr) * kr / kg * uvScale);
+  coefficients->uToBlue = maxvid_yuv_fixed(2.0 * (1.0 - kb) * uvScale);
+
+  return 0;
+}
+
+static inline
+int32_t maxvid_yuv_clamp(int32_t c) {
+  return (c < 0) ? 0 : ((c > 255) ? 255 : c);
+}
+
+// Convert one pixel, alpha is < 0 when there is no alpha plane
+
+static inline
+uint32_t maxvid_yuv_pixel(const MVYUVCoefficients *coefficients, int32_t y, int32_t u, int32_t v, int32_t alpha) {
+  const int32_t yScaled = ((y - coefficients->yOffset) * coefficients->yScale) + MV_YUV_ROUND;
+  u -= 128;
+  v -= 128;
+
+  int32_t red = maxvid_yuv_clamp((yScaled + (v * coefficients->vToRed)) >> MV_YUV_FRACTION_BITS);
+  int32_t green = maxvid_yuv_clamp((yScaled - (u * coefficients->uToGreen) - (v * coefficients->vToGreen)) >> MV_YUV_FRACTION_BITS);
+  int32_t blue = maxvid_yuv_clamp((yScaled + (u * coefficients->uToBlue)) >> MV_YUV_FRACTION_BITS);
+
+  if (alpha < 0) {
+    return 0xFF000000 | (red << 16) | (green << 8) | blue;
+  }
+
+  alpha = maxvid_yuv_clamp((((alpha - coefficients->yOffset) * coefficients->yScale) + MV_YUV_ROUND) >> MV_YUV_FRACTION_BITS);
+  red = MV_YUV_DIV_255(red * alpha);
+  green = MV_YUV_DIV_255(green * alpha);
+  blue = MV_YUV_DIV_255(blue * alpha);
+
+  return (((uint32_t) alpha) << 24) | (red << 16) | (green << 8) | blue;
+}
+
+// A lane compare yields -1 when true and 0 when false, so the vector clamp is
+// done with masks instead of a select. This is a macro so that no vector is
+// passed to or returned from a function.
+
+#define MV_YUV_VEC_CLAMP(c) \
+  ({ MVYUVVec32 cv = (c); cv &= (cv > 0); MVYUVVec32 over = (cv > 255); (cv & ~over) | (over & 255); })
+
+// Convert 4 pixels, each lane of u4 and v4 holds the chroma sample of its pixel.
+// alphaPtr is NULL when there is no alpha plane.
+
+static inline
+void maxvid_yuv_vec(const MVYUVCoefficients *coefficients, uint32_t *outPtr,
+                    const uint8_t *yPtr, MVYUVVec4 u4, MVYUVVec4 v4, const uint8_t *alphaPtr) {
+  MVYUVVec4 y4;
+  memcpy(&y4, yPtr, sizeof(y4));
+
+  const MVYUVVec32 y = __builtin_convertvector(y4, MVYUVVec32);
+  const MVYUVVec32 u = __builtin_convertvector(u4, MVYUVVec32) - 128;
+  const MVYUVVec32 v = __builtin_convertvector(v4, MVYUVVec32) - 128;
+
+  const MVYUVVec32 yScaled = ((y - coefficients->yOffset) * coefficients->yScale) + MV_YUV_ROUND;
+
+  MVYUVVec32 red = MV_YUV_VEC_CLAMP((yScaled + (v * coefficients->vToRed)) >> MV_YUV_FRACTION_BITS);
+  MVYUVVec32 green = MV_YUV_VEC_CLAMP((yScaled - (u * coefficients->uToGreen) - (v * coefficients->vToGreen)) >> MV_YUV_FRACTION_BITS);
+  MVYUVVec32 blue = MV_YUV_VEC_CLAMP((yScaled + (u * coefficients->uToBlue)) >> MV_YUV_FRACTION_BITS);
+  MVYUVVec32 alpha;
+
+  if (alphaPtr == NULL) {
+    alpha = (MVYUVVec32) {} + 255;
+  } else {
+    MVYUVVec4 alpha4;
+    memcpy(&alpha4, alphaPtr, sizeof(alpha4));
+    alpha = __builtin_convertvector(alpha4, MVYUVVec32);
+    alpha = MV_YUV_VEC_CLAMP((((alpha - coefficients->yOffset) * coefficients->yScale) + MV_YUV_ROUND) >> MV_YUV_FRACTION_BITS);
+    red = MV_YUV_DIV_255(red * alpha);
+    green = MV_YUV_DIV_255(green * alpha);
+    blue = MV_YUV_DIV_255(blue * alpha);
+  }
+
+  const MVYUVVecU32 out32 = (__builtin_convertvector(alpha, MVYUVVecU32) << 24) |
+                            (__builtin_convertvector(red, MVYUVVecU32) << 16) |
+                            (__builtin_convertvector(green, MVYUVVecU32) << 8) |
+                            __builtin_convertvector(blue, MVYUVVecU32);
+  memcpy(outPtr, &out32, sizeof(out32));
+}
+
+static inline
+uint32_t maxvid_yuv_check_strides(uint32_t width, uint32_t height,
+                                  uint32_t outBytesPerRow, uint32_t yBytesPerRow,
+                                  uint32_t uvBytesPerRow, uint32_t uvNumBytesInRow,
+                                  const uint8_t *alphaPlane, uint32_t alphaBytesPerRow) {
+  if (width == 0 || height == 0) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  if (outBytesPerRow < (width * sizeof(uint32_t)) || yBytesPerRow < width || uvBytesPerRow < uvNumBytesInRow) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  if (alphaPlane != NULL && alphaBytesPerRow < width) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+  return 0;
+}
+
+uint32_t
+maxvid_yuv_nv12_to_bgra(const MVYUVCoefficients *coefficients,
+                        uint32_t * restrict outPixels, uint32_t outBytesPerRow,
+                        const uint8_t * restrict yPlane, uint32_t yBytesPerRow,
+                        const uint8_t * restrict uvPlane, uint32_t uvBytesPerRow,
+                        const uint8_t * restrict alphaPlane, uint32_t alphaBytesPerRow,
+                        uint32_t width, uint32_t height)
+{
+  uint32_t status = maxvid_yuv_check_strides(width, height, outBytesPerRow, yBytesPerRow,
+                                             uvBytesPerRow, ((width + 1) / 2) * 2,
+                                             alphaPlane, alphaBytesPerRow);
+  if (status != 0) {
+    return status;
+  }
+
+  for (uint32_t row = 0; row < height; row++) {
+    uint32_t *outRow = (uint32_t *) (((char *) outPixels) + (row * outBytesPerRow));
+    const uint8_t *yRow = yPlane + (row * yBytesPerRow);
+    const uint8_t *uvRow = uvPlane + ((row / 2) * uvBytesPerRow);
+    const uint8_t *alphaRow = (alphaPlane == NULL) ? NULL : (alphaPlane + (row * alphaBytesPerRow));
+
+    uint32_t x = 0;
+
+    for ( ; (x + MV_YUV_VEC_NUM_PIXELS) <= width; x += MV_YUV_VEC_NUM_PIXELS) {
+      // 2 U,V pairs cover 4 pixels, x is even so the pairs start at byte x
+      MVYUVVec4 uv;
+      memcpy(&uv, &uvRow[x], sizeof(uv));
+      const MVYUVVec4 u4 = __builtin_shufflevector(uv, uv, 0, 0, 2, 2);
+      const MVYUVVec4 v4 = __builtin_shufflevector(uv, uv, 1, 1, 3, 3);
+      maxvid_yuv_vec(coefficients, &outRow[x], &yRow[x], u4, v4, (alphaRow == NULL) ? NULL : &alphaRow[x]);
+    }
+
+    for ( ; x < width; x++) {
+      const uint32_t uvOffset = (x / 2) * 2;
+      outRow[x] = maxvid_yuv_pixel(coefficients, yRow[x], uvRow[uvOffset], uvRow[uvOffset + 1],
+                                   (alphaRow == NULL) ? -1 : alphaRow[x]);
+    }
+  }
+
+  return 0;
+}
+
+uint32_t
+maxvid_yuv_i420_to_bgra(const MVYUVCoefficients *coefficients,
+                        uint32_t * restrict outPixels, uint32_t outBytesPerRow,
+                        const uint8_t * restrict yPlane, uint32_t yBytesPerRow,
+                        const uint8_t * restrict uPlane, const uint8_t * restrict vPlane, uint32_t uvBytesPerRow,
+                        const uint8_t * restrict alphaPlane, uint32_t alphaBytesPerRow,
+                        uint32_t width, uint32_t height)
+{
+  uint32_t status = maxvid_yuv_check_strides(width, height, outBytesPerRow, yBytesPerRow,
+                                             uvBytesPerRow, (width + 1) / 2,
+                                             alphaPlane, alphaBytesPerRow);
+  if (status != 0) {
+    return status;
+  }
+
+  for (uint32_t row = 0; row < height; row++) {
+    uint32_t *outRow = (uint32_t *) (((char *) outPixels) + (row * outBytesPerRow));
+    const uint8_t *yRow = yPlane + (row * yBytesPerRow);
+    const uint8_t *uRow = uPlane + ((row / 2) * uvBytesPerRow);
+    const uint8_t *vRow = vPlane + ((row / 2) * uvBytesPerRow);
+    const uint8_t *alphaRow = (alphaPlane == NULL) ? NULL : (alphaPlane + (row * alphaBytesPerRow));
+
+    uint32_t x = 0;
+
+    for ( ; (x + MV_YUV_VEC_NUM_PIXELS) <= width; x += MV_YUV_VEC_NUM_PIXELS) {
+      MVYUVVec2 u2, v2;
+      memcpy(&u2, &uRow[x / 2], sizeof(u2));
+      memcpy(&v2, &vRow[x / 2], sizeof(v2));
+      const MVYUVVec4 u4 = __builtin_shufflevector(u2, u2, 0, 0, 1, 1);
+      const MVYUVVec4 v4 = __builtin_shufflevector(v2, v2, 0, 0, 1, 1);
+      maxvid_yuv_vec(coefficients, &outRow[x], &yRow[x], u4, v4, (alphaRow == NULL) ? NULL : &alphaRow[x]);
+    }
+
+    for ( ; x < width; x++) {
+      outRow[x] = maxvid_yuv_pixel(coefficients, yRow[x], uRow[x / 2], vRow[x / 2],
+                                   (alphaRow == NULL) ? -1 : alphaRow[x]);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+// maxvid_yuv module
+//
+//  License terms defined in License.txt.
+//
+// This module implements conversion of 4:2:0 YUV frames to 32 bpp BGRA pixels,
+// so that a decoded H.264 frame can be written straight into a framebuffer
+// without rendering through Core Image. Both the bi-planar NV12 layout, where
+// U and V are interleaved in one plane, and the tri-planar I420 layout are
+// supported, with the BT.601 or BT.709 matrix in video range (Y 16 -> 235,
+// UV 16 -> 240) or full range.
+//
+// An optional alpha plane of the same size as the Y plane can be joined as
+// the pixels are converted, this is the Y plane of the alpha channel video
+// in the same range as the RGB video. The output pixels are premultiplied, so
+// they can be used like the pixels of a joined RGB + alpha frame. Without an
+// alpha plane, the alpha of each pixel is 0xFF.
+//
+// Each row of each plane starts at a byte stride, so that the planes of a
+// CVPixelBuffer with row padding can be passed as is. The kernels are written
+// with vector types, so that the compiler emits NEON on ARM and SSE on x86 for
+// the main loop.
+
+#ifndef MAXVID_YUV_H
+#define MAXVID_YUV_H
+
+#include "maxvid_decode.h"
+
+typedef enum {
+  MV_YUV_MATRIX_BT601 = 0,
+  MV_YUV_MATRIX_BT709 = 1
+} MVYUVMatrix;
+
+typedef enum {
+  MV_YUV_RANGE_VIDEO = 0,
+  MV_YUV_RANGE_FULL = 1
+} MVYUVRange;
+
+// Fixed point coefficients with 16 fraction bits, see maxvid_yuv_init()
+
+typedef struct {
+  int32_t yOffset;
+  int32_t yScale;
+  int32_t vToRed;
+  int32_t uToGreen;
+  int32_t vToGreen;
+  int32_t uToBlue;
+} MVYUVCoefficients;
+
+// Fill in the coefficients for a matrix and a range, returns 0 on success or
+// MV_ERROR_CODE_INVALID_INPUT for an unknown matrix or range.
+
+uint32_t
+maxvid_yuv_init(MVYUVCoefficients *coefficients, MVYUVMatrix matrix, MVYUVRange range);
+
+// Convert a width x height NV12 frame to BGRA pixels. The UV plane has
+// (height + 1) / 2 rows of (width + 1) / 2 interleaved U,V byte pairs. The
+// alphaPlane is NULL when there is no alpha plane. Returns 0 on success or
+// MV_ERROR_CODE_INVALID_INPUT when a stride is too small for the width.
+
+uint32_t
+maxvid_yuv_nv12_to_bgra(const MVYUVCoefficients *coefficients,
+                        uint32_t * restrict outPixels, uint32_t outBytesPerRow,
+                        const uint8_t * restrict yPlane, uint32_t yBytesPerRow,
+                        const uint8_t * restrict uvPlane, uint32_t uvBytesPerRow,
+                        const uint8_t * restrict alphaPlane, uint32_t alphaBytesPerRow,
+                        uint32_t width, uint32_t height);
+
+// Convert a width x height I420 frame to BGRA pixels. The U and V planes each
+// have (height + 1) / 2 rows of (width + 1) / 2 bytes, both read with uvBytesPerRow.
+
+uint32_t
+maxvid_yuv_i420_to_bgra(const MVYUVCoefficients *coefficients,
+                        uint32_t * restrict outPixels, uint32_t outBytesPerRow,
+                        const uint8_t * restrict yPlane, uint32_t yBytesPerRow,
+                        const uint8_t * restrict uPlane, const uint8_t * restrict vPlane, uint32_t uvBytesPerRow,
+                        const uint8_t * restrict alphaPlane, uint32_t alphaBytesPerRow,
+                        uint32_t width, uint32_t height);
+
+#endif // MAXVID_YUV_H
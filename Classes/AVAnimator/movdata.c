@@ -18,6 +18,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <unistd.h>
+#include <arpa/inet.h>
 
 #include "movdata.h"
 
@@ -45,6 +46,23 @@
 #error "Module should not be compiled in Thumb mode, enable ARM mode by adding -mno-thumb to file specific target flags"
 #endif
 
+// memset_pattern4() is an Apple libc extension, the RLE decoder only ever fills
+// whole words so a word loop is enough when building the command line tools
+// on another OS.
+
+#if !defined(__APPLE__)
+static inline
+void memset_pattern4(void *b, const void *pattern4, size_t len) {
+  uint32_t pixel;
+  memcpy(&pixel, pattern4, sizeof(uint32_t));
+  uint32_t *pixelPtr = (uint32_t *) b;
+  uint32_t *pixelPtrMax = pixelPtr + (len >> 2);
+  while (pixelPtr < pixelPtrMax) {
+    *pixelPtr++ = pixel;
+  }
+}
+#endif // !__APPLE__
+
 // Chunks of data contain 1 to N samples and are stored in mdat.
 // The chunk contains an array of sample pointers and the
 // offset in the file where the chunk begins.
@@ -23,10 +23,15 @@
 
 #import "AVMvidFrameDecoder.h"
 
+#import "AVReverseFrameCache.h"
+
 #import "AVFileUtil.h"
 
 #import "CGFrameBuffer.h"
 
+#include "maxvid_pool.h"
+#include "maxvid_ring.h"
+
 #import "AVFrame.h"
 
 @interface AVFrameDecoderTests : NSObject {
@@ -254,6 +259,85 @@
   return;
 }
 
+// Decode the frames of a 16BPP video with delta frames in reverse order via a
+// reverse frame cache and compare to the frames decoded forward. Each frame
+// must not be decoded from the keyframe again.
+
++ (void) testBounce16ReverseFrameCacheMvid
+{
+  id appDelegate = [[UIApplication sharedApplication] delegate];
+  UIWindow *window = [appDelegate window];
+  NSAssert(window, @"window");
+  
+  NSString *archiveFilename = @"Bounce_16BPP_15FPS.mvid.7z";
+  NSString *entryFilename = @"Bounce_16BPP_15FPS.mvid";
+  NSString *outFilename = @"Bounce_16BPP_15FPS.mvid";
+  NSString *outPath = [AVFileUtil getTmpDirPath:outFilename];
+  
+  [[NSFileManager defaultManager] removeItemAtPath:outPath error:nil];
+  
+  AVAnimatorMedia *media = [AVAnimatorMedia aVAnimatorMedia];
+  
+  AV7zAppResourceLoader *resLoader = [AV7zAppResourceLoader aV7zAppResourceLoader];
+  resLoader.archiveFilename = archiveFilename;
+  resLoader.movieFilename = entryFilename;
+  resLoader.outPath = outPath;
+  
+  media.resourceLoader = resLoader;
+  
+  AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+	media.frameDecoder = frameDecoder;
+  
+  media.animatorFrameDuration = 1.0;
+  
+  [media prepareToAnimate];
+  
+  BOOL worked = [RegressionTests waitUntilTrue:media
+                                      selector:@selector(isReadyToAnimate)
+                                   maxWaitTime:10.0];
+  NSAssert(worked, @"worked");
+  
+  // Save the pixels of each frame decoded forward
+  
+  NSUInteger numFrames = frameDecoder.numFrames;
+  NSMutableArray *forwardPixels = [NSMutableArray array];
+  
+  [frameDecoder rewind];
+  
+  for (NSUInteger i = 0; i < numFrames; i++) @autoreleasepool {
+    AVFrame *frame = [frameDecoder advanceToFrame:i];
+    NSAssert(frame, @"advanceToFrame");
+    CGFrameBuffer *cgFrameBuffer = frame.cgFrameBuffer;
+    [forwardPixels addObject:[NSData dataWithBytes:cgFrameBuffer.pixels length:cgFrameBuffer.numBytes]];
+  }
+  
+  [frameDecoder rewind];
+  
+  AVReverseFrameCache *reverseFrameCache = [AVReverseFrameCache aVReverseFrameCache:frameDecoder numCachedFrames:4];
+  
+  for (NSInteger i = numFrames - 1; i >= 0; i--) @autoreleasepool {
+    AVFrame *frame = [reverseFrameCache frameAtIndex:i];
+    NSAssert(frame, @"frameAtIndex");
+    CGFrameBuffer *cgFrameBuffer = frame.cgFrameBuffer;
+    NSData *expected = [forwardPixels objectAtIndex:i];
+    NSAssert(cgFrameBuffer.numBytes == expected.length, @"numBytes");
+    NSAssert(memcmp(cgFrameBuffer.pixels, expected.bytes, expected.length) == 0, @"frame %d pixels", (int)i);
+  }
+  
+  // Decoding each frame from the start of the movie would decode
+  // N * (N + 1) / 2 frames.
+  
+  NSAssert(reverseFrameCache.numFramesDecoded < (numFrames * (numFrames + 1) / 2), @"numFramesDecoded");
+  
+  // With checkpoints each frame is decoded a bounded number of times
+  
+  NSAssert(reverseFrameCache.numFramesDecoded <= (3 * numFrames), @"numFramesDecoded");
+  
+  [reverseFrameCache flush];
+  
+  return;
+}
+
 // This test case will allocate a frame decoder and then invoke a generic test method that will skip around inside the
 // frames of the 32BPP video.
 
@@ -962,6 +1046,117 @@
   return;
 }
 
+// A framebuffer released when a movie is done playing should be reused
+// by the next framebuffer of the same size instead of mapping new memory.
+// The reused memory must be zeroed.
+
++ (void) testFrameBufferPoolReuse
+{
+  MVPoolStats stats;
+  char *pixels;
+  
+  @autoreleasepool {
+    CGFrameBuffer *frameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:480 height:320];
+    NSAssert(frameBuffer, @"frameBuffer");
+    pixels = frameBuffer.pixels;
+    memset(pixels, 0xFF, frameBuffer.numBytes);
+  }
+  
+  maxvid_pool_stats(&stats);
+  NSAssert(stats.numBytesCached >= maxvid_pool_size_class(480 * 320 * 4), @"numBytesCached");
+  uint32_t numReused = stats.numReused;
+  
+  @autoreleasepool {
+    CGFrameBuffer *frameBuffer = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:480 height:320];
+    NSAssert(frameBuffer, @"frameBuffer");
+    NSAssert(frameBuffer.pixels == pixels, @"pixels not reused");
+    
+    uint32_t *pixels32 = (uint32_t*) frameBuffer.pixels;
+    for (int i = 0; i < (480 * 320); i++) {
+      NSAssert(pixels32[i] == 0, @"pixel not zeroed");
+    }
+  }
+  
+  maxvid_pool_stats(&stats);
+  NSAssert(stats.numReused == (numReused + 1), @"numReused");
+  NSAssert(stats.maxNumBytesInUse >= maxvid_pool_size_class(480 * 320 * 4), @"maxNumBytesInUse");
+  
+  maxvid_pool_trim();
+  maxvid_pool_stats(&stats);
+  NSAssert(stats.numBytesCached == 0, @"numBytesCached");
+  
+  return;
+}
+
+// Push frames into a frame ring and acquire by display time. A frame is only
+// reclaimed once a consumer has acquired a frame with a later time.
+
+static int testFrameRingNumReleased = 0;
+
+static
+void testFrameRingRelease(void *frame)
+{
+  testFrameRingNumReleased++;
+}
+
++ (void) testFrameRingAcquireByTime
+{
+  MVFrameRing ring;
+  static int frames[4];
+  uint32_t status;
+  
+  testFrameRingNumReleased = 0;
+  
+  status = maxvid_ring_init(&ring, 2, testFrameRingRelease);
+  NSAssert(status == 0, @"maxvid_ring_init");
+  
+  NSAssert(maxvid_ring_acquire(&ring, 0.0) == NULL, @"empty ring");
+  
+  status = maxvid_ring_push(&ring, &frames[1], 1, 1.0);
+  NSAssert(status == 0, @"push 1");
+  status = maxvid_ring_push(&ring, &frames[2], 2, 2.0);
+  NSAssert(status == 0, @"push 2");
+  
+  // Ring is full and no frame has been displayed yet
+  
+  status = maxvid_ring_push(&ring, &frames[3], 3, 3.0);
+  NSAssert(status == MV_ERROR_CODE_INVALID_OUTPUT, @"push to full ring");
+  
+  NSAssert(maxvid_ring_acquire(&ring, 0.5) == NULL, @"no frame before time");
+  
+  MVFrameRingSlot *slot = maxvid_ring_acquire(&ring, 1.5);
+  NSAssert(slot != NULL, @"acquire 1.5");
+  NSAssert(slot->frameIndex == 1 && slot->frame == &frames[1], @"frame 1");
+  maxvid_ring_release(&ring, slot);
+  
+  // Frame 1 is still the newest displayed frame, so it can't be reclaimed
+  
+  status = maxvid_ring_push(&ring, &frames[3], 3, 3.0);
+  NSAssert(status == MV_ERROR_CODE_INVALID_OUTPUT, @"push before frame 2 is displayed");
+  
+  slot = maxvid_ring_acquire(&ring, 2.0);
+  NSAssert(slot != NULL && slot->frameIndex == 2, @"frame 2");
+  
+  // Frame 1 is reclaimed while frame 2 is held
+  
+  status = maxvid_ring_push(&ring, &frames[3], 3, 3.0);
+  NSAssert(status == 0, @"push 3");
+  NSAssert(testFrameRingNumReleased == 1, @"frame 1 released");
+  
+  maxvid_ring_release(&ring, slot);
+  
+  NSAssert(maxvid_ring_requested_time(&ring) == 2.0, @"requested time");
+  
+  slot = maxvid_ring_acquire(&ring, 10.0);
+  NSAssert(slot != NULL && slot->frameIndex == 3, @"frame 3");
+  maxvid_ring_release(&ring, slot);
+  
+  maxvid_ring_free(&ring);
+  NSAssert(testFrameRingNumReleased == 3, @"all frames released");
+  
+  return;
+}
+
 // FIXME:
 // In the case where multiple frames need to be decoded in one call, it could
 // be possible that the first would work and the second would fail. Just
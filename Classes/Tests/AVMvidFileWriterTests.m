@@ -30,12 +30,92 @@
 
 #import "AVMvidFileWriter.h"
 
+#import "maxvid_encode.h"
+
+#import "AVY4MConvertMaxvid.h"
+
+#import "AVFrameSourceConvertMaxvid.h"
+
+#import "CGFrameBuffer.h"
+
 #import "AVStreamEncodeDecode.h"
 
+#import "maxvid_validate.h"
+
 @interface AVMvidFileWriterTests : NSObject {
 }
 @end
 
+// Frame source that generates 3 frames of 4x2 pixels, the second frame is the
+// same as the first and the third frame contains a transparent pixel.
+
+@interface AVMvidFileWriterTestsFrameSource : NSObject <AVMvidFrameSource> {
+  int m_frameIndex;
+}
+@end
+
+@implementation AVMvidFileWriterTestsFrameSource
+
+- (BOOL) openFrameSource
+{
+  m_frameIndex = 0;
+  return TRUE;
+}
+
+- (void) closeFrameSource
+{
+}
+
+- (CGSize) frameSourceSize
+{
+  return CGSizeMake(4, 2);
+}
+
+- (NSTimeInterval) frameSourceFrameDuration
+{
+  return 0.1;
+}
+
+- (NSUInteger) frameSourceNumFrames
+{
+  return 3;
+}
+
+- (uint32_t) frameSourceBpp
+{
+  return 0;
+}
+
+- (uint32_t) readFrame:(CGFrameBuffer*)frameBuffer info:(AVMvidFrameSourceInfo*)info
+{
+  if (m_frameIndex == 3) {
+    return AV_FRAME_SOURCE_END_OF_STREAM;
+  }
+  
+  uint32_t *pixels = (uint32_t*) frameBuffer.pixels;
+  
+  info->duration = 0.0f;
+  info->dirtyRect = CGRectMake(0, 0, 4, 2);
+  
+  if (m_frameIndex == 0) {
+    for (int i = 0; i < 8; i++) {
+      pixels[i] = 0xFFFF0000;
+    }
+  } else if (m_frameIndex == 1) {
+    info->dirtyRect = CGRectZero;
+  } else {
+    for (int i = 0; i < 8; i++) {
+      pixels[i] = 0xFF0000FF;
+    }
+    pixels[7] = 0x80000080;
+  }
+  
+  m_frameIndex++;
+  return 0;
+}
+
+@end
+
 // class AVAnimatorMediaTests
 
 @implementation AVMvidFileWriterTests
@@ -308,6 +388,953 @@
   return;
 }
 
+// Write a keyframe followed by a nop frame with genStats enabled and
+// verify the per-frame and file level stats.
+
++ (void) testWriteStats3x1At24BPP
+{
+  BOOL worked;
+  
+  NSString *tmpFilename = @"Vid3x1At24BPPStats.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  NSString *tmpJSONPath = [tmpPath stringByAppendingPathExtension:@"json"];
+  
+  AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+  avMvidFileWriter.mvidPath = tmpPath;
+  avMvidFileWriter.bpp = 24;
+  avMvidFileWriter.frameDuration = 1.0 / 10;
+  avMvidFileWriter.totalNumFrames = (int) 2;
+  avMvidFileWriter.movieSize = CGSizeMake(3, 1);
+  avMvidFileWriter.genStats = TRUE;
+  
+  uint32_t keyframe1Data[] = { 0xFF000000, 0xFF000000, 0xFF000000 };
+  
+  worked = [avMvidFileWriter open];
+  NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe1Data[0] bufferSize:sizeof(keyframe1Data)];
+  [avMvidFileWriter writeNopFrame];
+  
+  worked = [avMvidFileWriter rewriteHeader];
+  NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter close];
+  
+  MVFileStats *stats = avMvidFileWriter.stats;
+  NSAssert(stats != NULL, @"stats");
+  
+  NSAssert(stats->numFrames == 2, @"numFrames");
+  NSAssert(stats->numKeyframes == 1, @"numKeyframes");
+  NSAssert(stats->numDeltaframes == 0, @"numDeltaframes");
+  NSAssert(stats->numNopframes == 1, @"numNopframes");
+  NSAssert(stats->numBytes == sizeof(keyframe1Data), @"numBytes");
+  NSAssert(stats->frames[0].frameType == MV_STATS_KEYFRAME, @"frameType");
+  NSAssert(stats->frames[1].frameType == MV_STATS_NOPFRAME, @"frameType");
+  
+  worked = [avMvidFileWriter writeStatsJSON:tmpJSONPath emitFrames:TRUE];
+  NSAssert(worked, @"writeStatsJSON");
+  
+  NSData *jsonData = [NSData dataWithContentsOfFile:tmpJSONPath];
+  NSDictionary *jsonDict = [NSJSONSerialization JSONObjectWithData:jsonData options:0 error:nil];
+  NSAssert(jsonDict, @"JSONObjectWithData");
+  NSAssert([jsonDict[@"numFrames"] intValue] == 2, @"numFrames");
+  NSAssert([jsonDict[@"frames"] count] == 2, @"frames");
+  
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  [[NSFileManager defaultManager] removeItemAtPath:tmpJSONPath error:nil];
+  
+  return;
+}
+
+// Write in streaming mode without setting totalNumFrames. Enough nop frames are written
+// that the frame table window is written to the temp file more than once, then the
+// frame table at the end of the file is checked and the file is read with the decoder.
+
++ (void) testWriteStreaming3x1At24BPP
+{
+  BOOL worked;
+  
+  NSString *tmpFilename = @"Vid3x1At24BPPStreaming.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  
+  AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+  avMvidFileWriter.mvidPath = tmpPath;
+  avMvidFileWriter.bpp = 24;
+  avMvidFileWriter.frameDuration = 1.0 / 10;
+  avMvidFileWriter.movieSize = CGSizeMake(3, 1);
+  avMvidFileWriter.genAdler = TRUE;
+  avMvidFileWriter.isStreaming = TRUE;
+  
+  uint32_t keyframe1Data[] = { 0xFF000000, 0xFF000000, 0xFF000000, 0x0 };
+  uint32_t keyframe2Data[] = { 0xFF0000FF, 0xFF0000FF, 0xFF0000FF, 0x0 };
+  
+  const int numNopFrames = 2500;
+  const int numFrames = 1 + numNopFrames + 1;
+  
+  worked = [avMvidFileWriter open];
+  NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe1Data[0] bufferSize:sizeof(keyframe1Data)];
+  
+  for (int i = 0; i < numNopFrames; i++) {
+    [avMvidFileWriter writeNopFrame];
+  }
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe2Data[0] bufferSize:sizeof(keyframe2Data)];
+  
+  worked = [avMvidFileWriter rewriteHeader];
+  NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter close];
+  
+  NSAssert(avMvidFileWriter.totalNumFrames == numFrames, @"totalNumFrames");
+  
+  NSData *fileAsData = [NSData dataWithContentsOfFile:tmpPath];
+  NSAssert(fileAsData, @"read file as data");
+  
+  char *fileData = (char*)fileAsData.bytes;
+  uint64_t numBytes = fileAsData.length;
+  
+  maxvid_file_map_verify(fileData);
+  
+  MVFileHeader *fileHeaderPtr = (MVFileHeader*) fileData;
+  
+  NSAssert(fileHeaderPtr->numFrames == numFrames, @"numFrames");
+  NSAssert(maxvid_file_is_frames_at_end(fileHeaderPtr), @"maxvid_file_is_frames_at_end");
+  NSAssert(maxvid_file_is_all_keyframes(fileHeaderPtr), @"maxvid_file_is_all_keyframes");
+  
+  MVFileTrailer *trailer = (MVFileTrailer*) (fileData + numBytes - sizeof(MVFileTrailer));
+  
+  NSAssert(trailer->magic == MV_FILE_TRAILER_MAGIC, @"trailer magic");
+  NSAssert(trailer->numFrames == numFrames, @"trailer numFrames");
+  NSAssert(maxvid_file_validate_trailer(fileHeaderPtr, trailer, numBytes) == 0, @"maxvid_file_validate_trailer");
+  
+  uint64_t framesOffset = maxvid_file_frames_offset(fileData, numBytes);
+  NSAssert(framesOffset == trailer->framesOffset, @"framesOffset");
+  
+  void *framesPtr = (void *) (fileData + framesOffset);
+  
+  NSAssert(maxvid_file_validate(fileHeaderPtr, framesPtr, framesOffset, numBytes) == 0, @"maxvid_file_validate");
+  
+  // Both keyframes are on a page bound and every nop frame refers to the first keyframe
+  
+  MVFrame *frame = maxvid_file_frame(framesPtr, 0);
+  NSAssert(maxvid_frame_offset(frame) == MV_PAGESIZE, @"maxvid_frame_offset");
+  NSAssert(maxvid_frame_length(frame) == sizeof(keyframe1Data), @"maxvid_frame_length");
+  
+  frame = maxvid_file_frame(framesPtr, numNopFrames);
+  NSAssert(maxvid_frame_isnopframe(frame), @"maxvid_frame_isnopframe");
+  NSAssert(maxvid_frame_offset(frame) == MV_PAGESIZE, @"maxvid_frame_offset");
+  
+  frame = maxvid_file_frame(framesPtr, numFrames - 1);
+  NSAssert(maxvid_frame_iskeyframe(frame), @"maxvid_frame_iskeyframe");
+  NSAssert(maxvid_frame_offset(frame) == (2 * MV_PAGESIZE), @"maxvid_frame_offset");
+  
+  // Read the file with the frame decoder
+  
+  AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+  frameDecoder.validateInput = TRUE;
+  
+  worked = [frameDecoder openForReading:tmpPath];
+  NSAssert(worked, @"openForReading");
+  
+  NSAssert([frameDecoder numFrames] == numFrames, @"numFrames");
+  
+  worked = [frameDecoder allocateDecodeResources];
+  NSAssert(worked, @"allocateDecodeResources");
+  
+  AVFrame *avFrame = [frameDecoder advanceToFrame:0];
+  NSAssert(avFrame.image != nil, @"advanceToFrame");
+  
+  avFrame = [frameDecoder advanceToFrame:numFrames - 1];
+  NSAssert(avFrame.image != nil, @"advanceToFrame");
+  
+  [frameDecoder close];
+  
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  
+  return;
+}
+
+// Write a V3 file where each frame has its own duration instead of trailing nop frames,
+// then check that the decoder maps times to frames with the frame durations.
+
++ (void) testWriteFrameDurations3x1At24BPP_V3
+{
+  BOOL worked;
+  
+  NSString *tmpFilename = @"Vid3x1At24BPPDurations.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  
+  AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+  avMvidFileWriter.mvidPath = tmpPath;
+  avMvidFileWriter.bpp = 24;
+  avMvidFileWriter.frameDuration = 1.0 / 10;
+  avMvidFileWriter.totalNumFrames = 3;
+  avMvidFileWriter.movieSize = CGSizeMake(3, 1);
+  avMvidFileWriter.genAdler = TRUE;
+  avMvidFileWriter.genV3 = TRUE;
+  avMvidFileWriter.genFrameDurations = TRUE;
+  
+  uint32_t keyframe1Data[] = { 0xFF000000, 0xFF000000, 0xFF000000, 0x0 };
+  uint32_t keyframe2Data[] = { 0xFF0000FF, 0xFF0000FF, 0xFF0000FF, 0x0 };
+  
+  worked = [avMvidFileWriter open];
+  NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  // Frame 0 is displayed for 0.5 seconds, frame 1 for 0.1 and frame 2 for 0.25
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe1Data[0] bufferSize:sizeof(keyframe1Data)];
+  [avMvidFileWriter writeTrailingNopFrames:0.5f];
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe2Data[0] bufferSize:sizeof(keyframe2Data)];
+  [avMvidFileWriter writeTrailingNopFrames:0.1f];
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe1Data[0] bufferSize:sizeof(keyframe1Data)];
+  [avMvidFileWriter writeTrailingNopFrames:0.25f];
+  
+  NSAssert(avMvidFileWriter.frameNum == 3, @"no nop frames written");
+  
+  worked = [avMvidFileWriter rewriteHeader];
+  NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter close];
+  
+  NSData *fileAsData = [NSData dataWithContentsOfFile:tmpPath];
+  NSAssert(fileAsData, @"read file as data");
+  
+  char *fileData = (char*)fileAsData.bytes;
+  
+  MVFileHeader *fileHeaderPtr = (MVFileHeader*) fileData;
+  
+  NSAssert(maxvid_file_is_frame_durations(fileHeaderPtr), @"maxvid_file_is_frame_durations");
+  NSAssert(maxvid_file_validate_header(fileHeaderPtr, fileAsData.length) == 0, @"maxvid_file_validate_header");
+  
+  void *framesPtr = (void *) (fileData + sizeof(MVFileHeader));
+  
+  NSAssert(maxvid_v3_frame_duration(maxvid_v3_file_frame(framesPtr, 0)) == 500000, @"frame 0 duration");
+  NSAssert(maxvid_v3_frame_duration(maxvid_v3_file_frame(framesPtr, 1)) == 100000, @"frame 1 duration");
+  NSAssert(maxvid_v3_frame_duration(maxvid_v3_file_frame(framesPtr, 2)) == 250000, @"frame 2 duration");
+  
+  // Read the file with the frame decoder
+  
+  AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+  
+  worked = [frameDecoder openForReading:tmpPath];
+  NSAssert(worked, @"openForReading");
+  
+  NSAssert([frameDecoder hasFrameDurations], @"hasFrameDurations");
+  
+  NSAssert([frameDecoder frameStartTime:0] == 0.0, @"frameStartTime");
+  NSAssert(fabs([frameDecoder frameStartTime:1] - 0.5) < 0.0001, @"frameStartTime");
+  NSAssert(fabs([frameDecoder frameStartTime:2] - 0.6) < 0.0001, @"frameStartTime");
+  NSAssert(fabs([frameDecoder frameStartTime:3] - 0.85) < 0.0001, @"total duration");
+  
+  NSAssert([frameDecoder frameIndexAtTime:0.0] == 0, @"frameIndexAtTime");
+  NSAssert([frameDecoder frameIndexAtTime:0.45] == 0, @"frameIndexAtTime");
+  NSAssert([frameDecoder frameIndexAtTime:0.55] == 1, @"frameIndexAtTime");
+  NSAssert([frameDecoder frameIndexAtTime:0.7] == 2, @"frameIndexAtTime");
+  NSAssert([frameDecoder frameIndexAtTime:10.0] == 2, @"frameIndexAtTime");
+  
+  [frameDecoder close];
+  
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  
+  return;
+}
+
+// Write a 5x3 movie with 2 reduced size levels, then open it with display sizes
+// that select each level. The frame durations are the same for every level.
+
++ (void) testWriteLevels5x3At32BPP_V3
+{
+  BOOL worked;
+  
+  NSString *tmpFilename = @"Vid5x3At32BPPLevels.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  
+  AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+  avMvidFileWriter.mvidPath = tmpPath;
+  avMvidFileWriter.bpp = 32;
+  avMvidFileWriter.frameDuration = 1.0 / 10;
+  avMvidFileWriter.totalNumFrames = 3;
+  avMvidFileWriter.movieSize = CGSizeMake(5, 3);
+  avMvidFileWriter.genAdler = TRUE;
+  avMvidFileWriter.genV3 = TRUE;
+  avMvidFileWriter.genFrameDurations = TRUE;
+  avMvidFileWriter.numLevels = 2;
+  
+  // 15 pixels plus the zero padding pixel
+  
+  uint32_t keyframe1Data[16];
+  uint32_t keyframe2Data[16];
+  
+  for (int i = 0; i < 15; i++) {
+    keyframe1Data[i] = 0xFF102030;
+    keyframe2Data[i] = 0x80402010;
+  }
+  keyframe1Data[15] = 0;
+  keyframe2Data[15] = 0;
+  
+  worked = [avMvidFileWriter open];
+  NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe1Data[0] bufferSize:sizeof(keyframe1Data)];
+  [avMvidFileWriter writeTrailingNopFrames:0.2f];
+  
+  [avMvidFileWriter writeNopFrame];
+  
+  [avMvidFileWriter writeKeyframe:(char*)&keyframe2Data[0] bufferSize:sizeof(keyframe2Data)];
+  
+  worked = [avMvidFileWriter rewriteHeader];
+  NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter close];
+  
+  // Display size to expected level and level size
+  
+  const int cases[][5] = {
+    { 0, 0, 0, 5, 3 },
+    { 5, 3, 0, 5, 3 },
+    { 3, 2, 1, 3, 2 },
+    { 3, 1, 1, 3, 2 },
+    { 2, 1, 2, 2, 1 },
+    { 1, 1, 2, 2, 1 },
+  };
+  
+  for (int i = 0; i < (sizeof(cases) / sizeof(cases[0])); i++) @autoreleasepool {
+    AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+    
+    frameDecoder.validateInput = TRUE;
+    frameDecoder.displaySize = CGSizeMake(cases[i][0], cases[i][1]);
+    
+    worked = [frameDecoder openForReading:tmpPath];
+    NSAssert(worked, @"openForReading");
+    
+    NSAssert(frameDecoder.level == cases[i][2], @"level");
+    NSAssert([frameDecoder width] == cases[i][3], @"width");
+    NSAssert([frameDecoder height] == cases[i][4], @"height");
+    NSAssert([frameDecoder numFrames] == 3, @"numFrames");
+    NSAssert(fabs([frameDecoder frameStartTime:1] - 0.2) < 0.0001, @"frameStartTime");
+    
+    worked = [frameDecoder allocateDecodeResources];
+    NSAssert(worked, @"allocateDecodeResources");
+    
+    AVFrame *frame = [frameDecoder advanceToFrame:0];
+    uint32_t *pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+    for (int pixeli = 0; pixeli < (cases[i][3] * cases[i][4]); pixeli++) {
+      NSAssert(pixels[pixeli] == 0xFF102030, @"pixel");
+    }
+    
+    frame = [frameDecoder advanceToFrame:1];
+    NSAssert(frame.isDuplicate, @"isDuplicate");
+    
+    frame = [frameDecoder advanceToFrame:2];
+    pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+    for (int pixeli = 0; pixeli < (cases[i][3] * cases[i][4]); pixeli++) {
+      NSAssert(pixels[pixeli] == 0x80402010, @"pixel");
+    }
+    
+    [frameDecoder close];
+  }
+  
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  
+  return;
+}
+
+// Write a 5x3 movie with 2 reduced size levels made of a keyframe and two
+// delta frames. The second delta swaps two pixels in one 2x2 block, so the
+// box filtered level pixels do not change and a level nop frame is written.
+// Each level frame must be the box filtered full size frame.
+
++ (void) testWriteLevelDeltas5x3At32BPP_V3
+{
+  BOOL worked;
+  
+  NSString *tmpFilename = @"Vid5x3At32BPPLevelDeltas.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  
+  AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+  avMvidFileWriter.mvidPath = tmpPath;
+  avMvidFileWriter.bpp = 32;
+  avMvidFileWriter.frameDuration = 1.0 / 10;
+  avMvidFileWriter.totalNumFrames = 3;
+  avMvidFileWriter.movieSize = CGSizeMake(5, 3);
+  avMvidFileWriter.genAdler = TRUE;
+  avMvidFileWriter.genV3 = TRUE;
+  avMvidFileWriter.numLevels = 2;
+  
+  // 15 pixels plus the zero padding pixel
+  
+  uint32_t frameData[3][16];
+  
+  for (int i = 0; i < 15; i++) {
+    frameData[0][i] = 0xFF102030;
+  }
+  frameData[0][15] = 0;
+  
+  memcpy(frameData[1], frameData[0], sizeof(frameData[0]));
+  frameData[1][0] = 0xFF804020;
+  frameData[1][4] = 0xFF204080;
+  
+  memcpy(frameData[2], frameData[1], sizeof(frameData[1]));
+  frameData[2][0] = frameData[1][1];
+  frameData[2][1] = frameData[1][0];
+  
+  worked = [avMvidFileWriter open];
+  NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  worked = [avMvidFileWriter writeKeyframe:(char*)&frameData[0][0] bufferSize:sizeof(frameData[0])];
+  NSAssert(worked, @"writeKeyframe");
+  
+  for (int frameIndex = 1; frameIndex < 3; frameIndex++) @autoreleasepool {
+    NSData *codes = maxvid_encode_generic_delta_pixels32(frameData[frameIndex-1], frameData[frameIndex], 15, 5, 3, NULL, 0);
+    NSAssert(codes, @"codes");
+    
+    worked = maxvid_write_delta_pixels(avMvidFileWriter, codes, frameData[frameIndex], sizeof(frameData[0]), 15, 0);
+    NSAssert(worked, @"maxvid_write_delta_pixels");
+  }
+  
+  worked = [avMvidFileWriter rewriteHeader];
+  NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter close];
+  
+  for (uint32_t level = 0; level <= 2; level++) @autoreleasepool {
+    uint32_t width = maxvid_file_level_dimension(5, level);
+    uint32_t height = maxvid_file_level_dimension(3, level);
+    
+    AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+    
+    frameDecoder.validateInput = TRUE;
+    frameDecoder.displaySize = CGSizeMake(width, height);
+    
+    worked = [frameDecoder openForReading:tmpPath];
+    NSAssert(worked, @"openForReading");
+    NSAssert(frameDecoder.level == level, @"level");
+    
+    worked = [frameDecoder allocateDecodeResources];
+    NSAssert(worked, @"allocateDecodeResources");
+    
+    MVScale scale;
+    uint32_t expectedPixels[16];
+    
+    if (level > 0) {
+      uint32_t status = maxvid_scale_init(&scale, 5, 3, 32, level, MV_SCALE_BOX);
+      NSAssert(status == 0, @"maxvid_scale_init");
+    }
+    
+    for (int frameIndex = 0; frameIndex < 3; frameIndex++) {
+      if (level > 0) {
+        maxvid_scale_keyframe(&scale, expectedPixels, frameData[frameIndex]);
+      } else {
+        memcpy(expectedPixels, frameData[frameIndex], sizeof(expectedPixels));
+      }
+      
+      AVFrame *frame = [frameDecoder advanceToFrame:frameIndex];
+      NSAssert(frame, @"advanceToFrame");
+      
+      if (frameIndex == 2) {
+        NSAssert(frame.isDuplicate == (level > 0), @"isDuplicate");
+      }
+      
+      uint32_t *pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+      for (uint32_t pixeli = 0; pixeli < (width * height); pixeli++) {
+        NSAssert(pixels[pixeli] == expectedPixels[pixeli], @"pixel");
+      }
+    }
+    
+    if (level > 0) {
+      maxvid_scale_free(&scale);
+    }
+    
+    [frameDecoder close];
+  }
+  
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  
+  return;
+}
+
+// Write a 5x3 palette keyframe, a palette delta that changes 2 pixels,
+// a nop frame and then a regular keyframe, as written when a frame has
+// more than 256 colors.
+
++ (void) testWritePalette5x3At32BPP_V3
+{
+  BOOL worked;
+  BOOL tooManyColors;
+  
+  NSString *tmpFilename = @"Vid5x3At32BPPPalette.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  
+  AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+  avMvidFileWriter.mvidPath = tmpPath;
+  avMvidFileWriter.bpp = 32;
+  avMvidFileWriter.frameDuration = 1.0 / 10;
+  avMvidFileWriter.totalNumFrames = 4;
+  avMvidFileWriter.movieSize = CGSizeMake(5, 3);
+  avMvidFileWriter.genAdler = TRUE;
+  avMvidFileWriter.genV3 = TRUE;
+  avMvidFileWriter.genPalette = TRUE;
+  
+  // 15 pixels plus the zero padding pixel
+  
+  uint32_t keyframeData[16];
+  uint32_t deltaData[16];
+  
+  for (int i = 0; i < 15; i++) {
+    keyframeData[i] = (i < 8) ? 0xFF102030 : 0x80402010;
+  }
+  keyframeData[15] = 0;
+  memcpy(deltaData, keyframeData, sizeof(keyframeData));
+  deltaData[3] = 0xFF00FF00;
+  deltaData[11] = 0xFF0000FF;
+  
+  // A 20x20 frame of 400 different colors can't be a palette frame
+  
+  const int manyWidth = 20;
+  uint32_t manyColorsData[20 * 20];
+  
+  for (int i = 0; i < (manyWidth * manyWidth); i++) {
+    manyColorsData[i] = 0xFF000000 | i;
+  }
+
+  worked = [avMvidFileWriter open];
+  NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  worked = [avMvidFileWriter writePaletteFrame:(char*)&keyframeData[0] prevFrame:NULL bufferSize:sizeof(keyframeData) tooManyColors:&tooManyColors];
+  NSAssert(worked && !tooManyColors, @"writePaletteFrame");
+  
+  worked = [avMvidFileWriter writePaletteFrame:(char*)&deltaData[0] prevFrame:(char*)&keyframeData[0] bufferSize:sizeof(deltaData) tooManyColors:&tooManyColors];
+  NSAssert(worked && !tooManyColors, @"writePaletteFrame");
+  
+  worked = [avMvidFileWriter writePaletteFrame:(char*)&deltaData[0] prevFrame:(char*)&deltaData[0] bufferSize:sizeof(deltaData) tooManyColors:&tooManyColors];
+  NSAssert(worked && !tooManyColors, @"writePaletteFrame");
+  
+  // A 5x3 frame can't have more than 256 colors, so check that the encoder
+  // rejects the larger frame and then write the fallback keyframe.
+  
+  MVPalette palette;
+  uint32_t *words = malloc(maxvid_palette_max_num_words(manyWidth * manyWidth) * sizeof(uint32_t));
+  uint32_t numWords;
+  uint32_t status = maxvid_palette_encode(&palette, NULL, manyColorsData, manyWidth * manyWidth, words, &numWords);
+  NSAssert(status == MV_ERROR_CODE_INVALID_INPUT, @"maxvid_palette_encode");
+  free(words);
+  
+  for (int i = 0; i < 15; i++) {
+    manyColorsData[i] = 0xFF000000 | (i * 0x10);
+  }
+  manyColorsData[15] = 0;
+  
+  [avMvidFileWriter writeKeyframe:(char*)&manyColorsData[0] bufferSize:sizeof(keyframeData)];
+  
+  worked = [avMvidFileWriter rewriteHeader];
+  NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter close];
+  
+  AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+  
+  frameDecoder.validateInput = TRUE;
+  
+  worked = [frameDecoder openForReading:tmpPath];
+  NSAssert(worked, @"openForReading");
+  
+  NSAssert([frameDecoder numFrames] == 4, @"numFrames");
+  
+  worked = [frameDecoder allocateDecodeResources];
+  NSAssert(worked, @"allocateDecodeResources");
+  
+  AVFrame *frame = [frameDecoder advanceToFrame:0];
+  uint32_t *pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+  for (int pixeli = 0; pixeli < 15; pixeli++) {
+    NSAssert(pixels[pixeli] == keyframeData[pixeli], @"pixel");
+  }
+
+  frame = [frameDecoder advanceToFrame:1];
+  pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+  for (int pixeli = 0; pixeli < 15; pixeli++) {
+    NSAssert(pixels[pixeli] == deltaData[pixeli], @"pixel");
+  }
+
+  frame = [frameDecoder advanceToFrame:2];
+  NSAssert(frame.isDuplicate, @"isDuplicate");
+  
+  frame = [frameDecoder advanceToFrame:3];
+  pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+  for (int pixeli = 0; pixeli < 15; pixeli++) {
+    NSAssert(pixels[pixeli] == manyColorsData[pixeli], @"pixel");
+  }
+
+  // Random access back to the palette keyframe
+  
+  frame = [frameDecoder advanceToFrame:0];
+  pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+  for (int pixeli = 0; pixeli < 15; pixeli++) {
+    NSAssert(pixels[pixeli] == keyframeData[pixeli], @"pixel");
+  }
+
+  [frameDecoder close];
+  
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  
+  return;
+}
+
+// Convert a 4x2 Y4M video where RGB and alpha frames alternate. The second
+// frame is the same as the first and the third changes only the right half
+// to red at half alpha, so the output is a keyframe, a nop frame and a delta.
+
++ (void) testConvertMixedAlphaY4MWithDeltas
+{
+  BOOL worked;
+  
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *y4mPath = [tmpDir stringByAppendingPathComponent:@"Mixed4x2.y4m"];
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:@"Mixed4x2.mvid"];
+  
+  uint8_t whiteFrame[] = {
+    235, 235, 235, 235,
+    235, 235, 235, 235,
+    128, 128,
+    128, 128
+  };
+  uint8_t opaqueAlphaFrame[] = {
+    235, 235, 235, 235,
+    235, 235, 235, 235,
+    128, 128,
+    128, 128
+  };
+  uint8_t halfRedFrame[] = {
+    235, 235, 81, 81,
+    235, 235, 81, 81,
+    128, 90,
+    128, 240
+  };
+  uint8_t halfAlphaFrame[] = {
+    235, 235, 126, 126,
+    235, 235, 126, 126,
+    128, 128,
+    128, 128
+  };
+  
+  NSMutableData *y4mData = [NSMutableData data];
+  const char *header = "YUV4MPEG2 W4 H2 F10:1 Ip A1:1 C420jpeg\n";
+  [y4mData appendBytes:header length:strlen(header)];
+  
+  uint8_t *frames[] = { whiteFrame, opaqueAlphaFrame, whiteFrame, opaqueAlphaFrame, halfRedFrame, halfAlphaFrame };
+  for (int i = 0; i < 6; i++) {
+    [y4mData appendBytes:"FRAME\n" length:6];
+    [y4mData appendBytes:frames[i] length:sizeof(whiteFrame)];
+  }
+  
+  worked = [y4mData writeToFile:y4mPath atomically:YES];
+  NSAssert(worked, @"write y4m");
+  
+  AVY4MConvertMaxvid *converter = [AVY4MConvertMaxvid aVY4MConvertMaxvid];
+  converter.inputPath = y4mPath;
+  converter.mvidPath = tmpPath;
+  converter.isMixedAlpha = TRUE;
+  converter.genDeltas = TRUE;
+  converter.genAdler = TRUE;
+  
+  worked = [converter blockingConvert];
+  NSAssert(worked, @"blockingConvert");
+  NSAssert(converter.frameNum == 3, @"frameNum");
+  NSAssert(converter.bpp == 32, @"bpp");
+  NSAssert(fabs(converter.frameDuration - 0.1) < 0.0001, @"frameDuration");
+  
+  AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+  
+  worked = [frameDecoder openForReading:tmpPath];
+  NSAssert(worked, @"openForReading");
+  
+  worked = [frameDecoder allocateDecodeResources];
+  NSAssert(worked, @"allocateDecodeResources");
+  
+  NSAssert([frameDecoder numFrames] == 3, @"numFrames");
+  NSAssert([frameDecoder isAllKeyframes] == FALSE, @"isAllKeyframes");
+  
+  AVFrame *frame = [frameDecoder advanceToFrame:0];
+  uint32_t *pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+  for (int i = 0; i < 8; i++) {
+    NSAssert(pixels[i] == 0xFFFFFFFF, @"pixel");
+  }
+  
+  frame = [frameDecoder advanceToFrame:1];
+  NSAssert(frame.isDuplicate, @"isDuplicate");
+  
+  frame = [frameDecoder advanceToFrame:2];
+  pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+  for (int i = 0; i < 8; i++) {
+    uint32_t expected = ((i % 4) < 2) ? 0xFFFFFFFF : 0x807F0000;
+    NSAssert(pixels[i] == expected, @"pixel");
+  }
+  
+  [frameDecoder close];
+  
+  [[NSFileManager defaultManager] removeItemAtPath:y4mPath error:nil];
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  
+  return;
+}
+
+// Convert frames from a frame source with and without the decode thread. The
+// second frame is not written by the source so it must be emitted as a nop frame,
+// and the transparent pixel in the last frame means the movie is 32 BPP.
+
++ (void) testConvertFrameSource
+{
+  BOOL worked;
+  
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:@"FrameSource4x2.mvid"];
+  
+  for (int isPipelined = 0; isPipelined < 2; isPipelined++) @autoreleasepool {
+    AVMvidFileWriterTestsFrameSource *frameSource = [[AVMvidFileWriterTestsFrameSource alloc] init];
+#if __has_feature(objc_arc)
+#else
+    [frameSource autorelease];
+#endif // objc_arc
+    
+    AVFrameSourceConvertMaxvid *converter = [AVFrameSourceConvertMaxvid aVFrameSourceConvertMaxvid];
+    converter.frameSource = frameSource;
+    converter.mvidPath = tmpPath;
+    converter.isPipelined = isPipelined;
+    converter.genDeltas = TRUE;
+    converter.genAdler = TRUE;
+    
+    worked = [converter blockingConvert];
+    NSAssert(worked, @"blockingConvert");
+    NSAssert(converter.wasSuccessful, @"wasSuccessful");
+    NSAssert(converter.bpp == 32, @"bpp");
+    
+    AVMvidFrameDecoder *frameDecoder = [AVMvidFrameDecoder aVMvidFrameDecoder];
+    
+    worked = [frameDecoder openForReading:tmpPath];
+    NSAssert(worked, @"openForReading");
+    
+    worked = [frameDecoder allocateDecodeResources];
+    NSAssert(worked, @"allocateDecodeResources");
+    
+    NSAssert([frameDecoder numFrames] == 3, @"numFrames");
+    NSAssert(fabs([frameDecoder frameDuration] - 0.1) < 0.0001, @"frameDuration");
+    
+    AVFrame *frame = [frameDecoder advanceToFrame:0];
+    uint32_t *pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+    for (int i = 0; i < 8; i++) {
+      NSAssert(pixels[i] == 0xFFFF0000, @"pixel");
+    }
+    
+    frame = [frameDecoder advanceToFrame:1];
+    NSAssert(frame.isDuplicate, @"isDuplicate");
+    
+    frame = [frameDecoder advanceToFrame:2];
+    pixels = (uint32_t*) frame.cgFrameBuffer.pixels;
+    for (int i = 0; i < 7; i++) {
+      NSAssert(pixels[i] == 0xFF0000FF, @"pixel");
+    }
+    NSAssert(pixels[7] == 0x80000080, @"pixel");
+    
+    [frameDecoder close];
+    
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  }
+  
+  return;
+}
+
+// Write large keyframes so that pixels are passed to the kernel without a copy and the
+// padding after the header is left as a sparse hole, then write the same frames with
+// direct IO. The file contents must be exactly the same in both cases.
+
++ (void) testWriteDirectIO512x512At32BPP_V3
+{
+  BOOL worked;
+  
+  NSString *tmpFilename = @"Vid512x512At32BPPDirect.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  
+  const int width = 512;
+  const int height = 512;
+  const int frameNumBytes = width * height * sizeof(uint32_t);
+  
+  NSMutableData *keyframe1Data = [NSMutableData dataWithLength:frameNumBytes];
+  NSMutableData *keyframe2Data = [NSMutableData dataWithLength:frameNumBytes];
+  
+  uint32_t *keyframe1Pixels = (uint32_t*) keyframe1Data.mutableBytes;
+  uint32_t *keyframe2Pixels = (uint32_t*) keyframe2Data.mutableBytes;
+  
+  for (int i = 0; i < (width * height); i++) {
+    keyframe1Pixels[i] = 0xFF000000 | i;
+    keyframe2Pixels[i] = 0xFF000000 | ~i;
+  }
+
+  for (int isDirectIO = 0; isDirectIO < 2; isDirectIO++) {
+    AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+    avMvidFileWriter.mvidPath = tmpPath;
+    avMvidFileWriter.bpp = 32;
+    avMvidFileWriter.frameDuration = 1.0 / 10;
+    avMvidFileWriter.totalNumFrames = 3;
+    avMvidFileWriter.movieSize = CGSizeMake(width, height);
+    avMvidFileWriter.genAdler = TRUE;
+    avMvidFileWriter.genV3 = TRUE;
+    avMvidFileWriter.isDirectIO = isDirectIO;
+  
+    worked = [avMvidFileWriter open];
+    NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+    worked = [avMvidFileWriter writeKeyframe:(char*)keyframe1Pixels bufferSize:frameNumBytes];
+    NSAssert(worked, @"writeKeyframe");
+  
+    [avMvidFileWriter writeNopFrame];
+  
+    worked = [avMvidFileWriter writeKeyframe:(char*)keyframe2Pixels bufferSize:frameNumBytes];
+    NSAssert(worked, @"writeKeyframe");
+  
+    worked = [avMvidFileWriter rewriteHeader];
+    NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+    [avMvidFileWriter close];
+  
+    NSData *fileAsData = [NSData dataWithContentsOfFile:tmpPath];
+    NSAssert(fileAsData, @"read file as data");
+  
+    char *fileData = (char*)fileAsData.bytes;
+    int numBytes = (int)fileAsData.length;
+  
+    maxvid_file_map_verify(fileData);
+  
+    NSAssert(numBytes == (MV_PAGESIZE + 2 * frameNumBytes), @"numBytes");
+  
+    MVFileHeader *fileHeaderPtr = (MVFileHeader*) fileData;
+  
+    NSAssert(maxvid_file_version(fileHeaderPtr) == 3, @"version");
+    NSAssert(fileHeaderPtr->numFrames == 3, @"numFrames");
+  
+    // Padding between the frame table and the first keyframe reads as zeros
+  
+    char *framesEndPtr = fileData + sizeof(MVFileHeader) + 3 * sizeof(MVV3Frame);
+  
+    for (char *ptr = framesEndPtr; ptr < (fileData + MV_PAGESIZE); ptr++) {
+      NSAssert(*ptr == 0, @"padding");
+    }
+
+    void *framesPtr = (void *) (fileData + sizeof(MVFileHeader));
+  
+    MVV3Frame *frame = maxvid_v3_file_frame(framesPtr, 0);
+    NSAssert(maxvid_v3_frame_offset(frame) == MV_PAGESIZE, @"maxvid_v3_frame_offset");
+    NSAssert(maxvid_v3_frame_length(frame) == frameNumBytes, @"maxvid_v3_frame_length");
+    NSAssert(memcmp(fileData + MV_PAGESIZE, keyframe1Pixels, frameNumBytes) == 0, @"keyframe 1 pixels");
+  
+    frame = maxvid_v3_file_frame(framesPtr, 2);
+    NSAssert(maxvid_v3_frame_offset(frame) == (MV_PAGESIZE + frameNumBytes), @"maxvid_v3_frame_offset");
+    NSAssert(maxvid_v3_frame_length(frame) == frameNumBytes, @"maxvid_v3_frame_length");
+    NSAssert(memcmp(fileData + MV_PAGESIZE + frameNumBytes, keyframe2Pixels, frameNumBytes) == 0, @"keyframe 2 pixels");
+  
+    [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  }
+
+  return;
+}
+
+// Write keyframes aligned to the huge page size, the padding after the
+// frame table and after the first keyframe extends to a 2 MB bound.
+
++ (void) testWriteHugePageAligned512x512At32BPP_V3
+{
+  BOOL worked;
+  
+  NSString *tmpFilename = @"Vid512x512At32BPPHugePage.mvid";
+  NSString *tmpDir = NSTemporaryDirectory();
+  NSString *tmpPath = [tmpDir stringByAppendingPathComponent:tmpFilename];
+  
+  const int width = 512;
+  const int height = 512;
+  const int frameNumBytes = width * height * sizeof(uint32_t);
+  
+  NSMutableData *keyframe1Data = [NSMutableData dataWithLength:frameNumBytes];
+  NSMutableData *keyframe2Data = [NSMutableData dataWithLength:frameNumBytes];
+  
+  uint32_t *keyframe1Pixels = (uint32_t*) keyframe1Data.mutableBytes;
+  uint32_t *keyframe2Pixels = (uint32_t*) keyframe2Data.mutableBytes;
+  
+  for (int i = 0; i < (width * height); i++) {
+    keyframe1Pixels[i] = 0xFF000000 | i;
+    keyframe2Pixels[i] = 0xFF000000 | ~i;
+  }
+  
+  AVMvidFileWriter *avMvidFileWriter = [AVMvidFileWriter aVMvidFileWriter];
+  
+  avMvidFileWriter.mvidPath = tmpPath;
+  avMvidFileWriter.bpp = 32;
+  avMvidFileWriter.frameDuration = 1.0 / 10;
+  avMvidFileWriter.totalNumFrames = 3;
+  avMvidFileWriter.movieSize = CGSizeMake(width, height);
+  avMvidFileWriter.genAdler = TRUE;
+  avMvidFileWriter.genV3 = TRUE;
+  avMvidFileWriter.isHugePageAligned = TRUE;
+  
+  worked = [avMvidFileWriter open];
+  NSAssert(worked, @"error: Could not open .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  worked = [avMvidFileWriter writeKeyframe:(char*)keyframe1Pixels bufferSize:frameNumBytes];
+  NSAssert(worked, @"writeKeyframe");
+  
+  [avMvidFileWriter writeNopFrame];
+  
+  worked = [avMvidFileWriter writeKeyframe:(char*)keyframe2Pixels bufferSize:frameNumBytes];
+  NSAssert(worked, @"writeKeyframe");
+  
+  worked = [avMvidFileWriter rewriteHeader];
+  NSAssert(worked, @"error: Could not write .mvid output file \"%@\"", avMvidFileWriter.mvidPath);
+  
+  [avMvidFileWriter close];
+  
+  NSData *fileAsData = [NSData dataWithContentsOfFile:tmpPath];
+  NSAssert(fileAsData, @"read file as data");
+  
+  char *fileData = (char*)fileAsData.bytes;
+  int numBytes = (int)fileAsData.length;
+  
+  maxvid_file_map_verify(fileData);
+  
+  NSAssert(numBytes == (2 * MV_HUGEPAGESIZE + frameNumBytes), @"numBytes");
+  
+  void *framesPtr = (void *) (fileData + sizeof(MVFileHeader));
+  
+  MVV3Frame *frame = maxvid_v3_file_frame(framesPtr, 0);
+  NSAssert(maxvid_v3_frame_offset(frame) == MV_HUGEPAGESIZE, @"maxvid_v3_frame_offset");
+  NSAssert(memcmp(fileData + MV_HUGEPAGESIZE, keyframe1Pixels, frameNumBytes) == 0, @"keyframe 1 pixels");
+  
+  frame = maxvid_v3_file_frame(framesPtr, 1);
+  NSAssert(maxvid_v3_frame_isnopframe(frame), @"isnopframe");
+  
+  frame = maxvid_v3_file_frame(framesPtr, 2);
+  NSAssert(maxvid_v3_frame_offset(frame) == (2 * MV_HUGEPAGESIZE), @"maxvid_v3_frame_offset");
+  NSAssert(memcmp(fileData + 2 * MV_HUGEPAGESIZE, keyframe2Pixels, frameNumBytes) == 0, @"keyframe 2 pixels");
+  
+  [[NSFileManager defaultManager] removeItemAtPath:tmpPath error:nil];
+  
+  return;
+}
+
 // With a special flag, the file writer can emit BGRA pixels as BGR data that is further
 // compressed with a from of lz compression. Check that writing bytes and decoding them
 // works as expected.
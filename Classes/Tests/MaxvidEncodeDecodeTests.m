@@ -19,6 +19,22 @@
 
 #import "maxvid_decode.h"
 
+#import "maxvid_validate.h"
+
+#import "maxvid_scale.h"
+
+#import "maxvid_crop.h"
+
+#import "maxvid_convert.h"
+
+#import "maxvid_yuv.h"
+
+#import "maxvid_alpha.h"
+
+#import "movdata.h"
+
+#import "CGFrameBuffer.h"
+
 
 @interface MaxvidEncodeTests : NSObject {
 }
@@ -1828,4 +1844,472 @@
 }
 
 
+// The validated decoder must produce the same result as the fast decoder for valid
+// codes and must return an error for codes that would access memory outside
+// of the input buffer or the framebuffer.
+
++ (void) testValidatedDecodeRejectsInvalidCodes16BPP
+{
+  uint16_t prev[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+  uint16_t curr[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x4 };
+  int width = 6;
+  int height = 1;
+  
+  NSData *codes;
+  NSString *results;
+  
+  codes = maxvid_encode_generic_delta_pixels16(prev, curr, sizeof(curr)/sizeof(uint16_t), width, height, NULL, 0);
+  results = [MaxvidEncodeTests util_printMvidCodes16:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 COPY 3 0x1 0x2 0x3 DUP 2 0x4 DONE"], @"isEqualToString");
+  
+  uint32_t frameBufferSize = width * height;
+  
+  NSMutableData *c4Codes = [self util_convertToC4Codes16:codes frameBufferNumPixels:frameBufferSize];
+  
+  uint32_t *inputBuffer32 = (uint32_t*) c4Codes.mutableBytes;
+  uint32_t inputBuffer32NumWords = (uint32_t) (c4Codes.length / sizeof(uint32_t));
+  
+  uint16_t *frameBuffer16 = valloc(4096);
+  memset(frameBuffer16, 0, 4096);
+  
+  uint32_t result;
+  
+  result = maxvid_decode_c4_sample16_validated(frameBuffer16, inputBuffer32, inputBuffer32NumWords, frameBufferSize);
+  NSAssert(result == 0, @"result");
+  NSAssert(memcmp(curr, frameBuffer16, sizeof(curr)) == 0, @"memcmp");
+  
+  // Framebuffer is one pixel too small for the DUP
+  
+  result = maxvid_decode_c4_sample16_validated(frameBuffer16, inputBuffer32, inputBuffer32NumWords, frameBufferSize - 1);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  // Input ends before the DONE code
+  
+  result = maxvid_decode_c4_sample16_validated(frameBuffer16, inputBuffer32, inputBuffer32NumWords - 1, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  // A COPY 0 would underflow the decoder
+  
+  uint32_t invalidCopy[] = { ((uint32_t)COPY << 30) | (0 << 16), (uint32_t)DONE << 30 };
+  result = maxvid_validate_c4_sample16(invalidCopy, 2, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  result = maxvid_decode_c4_sample16_validated(frameBuffer16, invalidCopy, 2, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  // A huge SKIP would move past the end of the framebuffer
+  
+  uint32_t invalidSkip[] = { ((uint32_t)SKIP << 30) | MV_MAX_30_BITS, ((uint32_t)DUP << 30) | (2 << 16), (uint32_t)DONE << 30 };
+  result = maxvid_validate_c4_sample16(invalidSkip, 3, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  result = maxvid_decode_c4_sample16_validated(frameBuffer16, invalidSkip, 3, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  free(frameBuffer16);
+  return;
+}
+
++ (void) testValidatedDecodeRejectsInvalidCodes32BPP
+{
+  uint32_t prev[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+  uint32_t curr[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x4 };
+  int width = 6;
+  int height = 1;
+  
+  NSData *codes;
+  NSString *results;
+  
+  codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), width, height, NULL, 0);
+  results = [MaxvidEncodeTests util_printMvidCodes32:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 COPY 3 0x1 0x2 0x3 DUP 2 0x4 DONE"], @"isEqualToString");
+  
+  uint32_t frameBufferSize = width * height;
+  
+  NSData *c4Codes = [self util_convertToC4Codes32:codes frameBufferNumPixels:frameBufferSize];
+  
+  uint32_t *inputBuffer32 = (uint32_t*) c4Codes.bytes;
+  uint32_t inputBuffer32NumWords = (uint32_t) (c4Codes.length / sizeof(uint32_t));
+  
+  uint32_t *frameBuffer32 = valloc(4096);
+  memset(frameBuffer32, 0, 4096);
+  
+  uint32_t result;
+  
+  result = maxvid_validate_c4_sample32(inputBuffer32, inputBuffer32NumWords, frameBufferSize);
+  NSAssert(result == 0, @"result");
+  
+  result = maxvid_decode_c4_sample32_validated(frameBuffer32, inputBuffer32, inputBuffer32NumWords, frameBufferSize);
+  NSAssert(result == 0, @"result");
+  NSAssert(memcmp(curr, frameBuffer32, sizeof(curr)) == 0, @"memcmp");
+  
+  // Framebuffer is one pixel too small for the DUP
+  
+  result = maxvid_decode_c4_sample32_validated(frameBuffer32, inputBuffer32, inputBuffer32NumWords, frameBufferSize - 1);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  // The fast decoder reads the word after DONE, so the padding word is required
+  
+  result = maxvid_validate_c4_sample32(inputBuffer32, inputBuffer32NumWords - 1, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  // A DUP 1 would underflow the decoder
+  
+  uint32_t invalidDup[] = { (1 << 10) | (DUP << 8), 0x1, (DONE << 8), 0 };
+  result = maxvid_validate_c4_sample32(invalidDup, 4, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  result = maxvid_decode_c4_sample32_validated(frameBuffer32, invalidDup, 4, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  // A COPY that reads past the end of the input
+  
+  uint32_t invalidCopy[] = { (4 << 10) | (COPY << 8), 0x1, 0x2 };
+  result = maxvid_validate_c4_sample32(invalidCopy, 3, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  result = maxvid_decode_c4_sample32_validated(frameBuffer32, invalidCopy, 3, frameBufferSize);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  free(frameBuffer32);
+  return;
+}
+
+// Decode a 4x4 delta frame over a zero previous frame into a 2x2 framebuffer. A
+// point sampled pixel is the top left pixel of each 2x2 block. The box filter
+// average of a delta frame must be the same as the average of the keyframe. Then
+// decode a delta frame that changes only some pixels of each block over the
+// non-zero keyframe, the unchanged pixels of the keyframe must be averaged.
+
++ (void) testScaledDecodeHalfSize32BPP
+{
+  uint32_t prev[16];
+  uint32_t curr[16];
+  int width = 4;
+  int height = 4;
+  
+  memset(prev, 0, sizeof(prev));
+  for (int i = 0; i < 16; i++) {
+    curr[i] = (i < 5) ? 0x0 : (i * 8);
+  }
+  curr[15] = curr[14];
+  
+  NSData *codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), width, height, NULL, 0);
+  NSData *c4Codes = [self util_convertToC4Codes32:codes frameBufferNumPixels:(width * height)];
+  
+  uint32_t *inputBuffer32 = (uint32_t*) c4Codes.bytes;
+  uint32_t inputBuffer32NumWords = (uint32_t) (c4Codes.length / sizeof(uint32_t));
+  
+  uint32_t scaled[4];
+  uint32_t expected[4];
+  uint32_t result;
+  MVScale scale;
+  
+  result = maxvid_scale_init(&scale, width, height, 32, 1, MV_SCALE_POINT);
+  NSAssert(result == 0, @"result");
+  NSAssert(scale.scaledWidth == 2 && scale.scaledHeight == 2, @"scaled size");
+  NSAssert(maxvid_scale_num_bytes(&scale) == sizeof(scaled), @"num bytes");
+  
+  memset(scaled, 0, sizeof(scaled));
+  result = maxvid_decode_c4_scaled(&scale, scaled, inputBuffer32, inputBuffer32NumWords);
+  NSAssert(result == 0, @"result");
+  
+  for (int i = 0; i < 4; i++) {
+    int x = (i % 2) * 2;
+    int y = (i / 2) * 2;
+    expected[i] = curr[(y * width) + x];
+  }
+  NSAssert(memcmp(scaled, expected, sizeof(scaled)) == 0, @"point sampled delta");
+  
+  maxvid_scale_free(&scale);
+  
+  result = maxvid_scale_init(&scale, width, height, 32, 1, MV_SCALE_BOX);
+  NSAssert(result == 0, @"result");
+  
+  for (int i = 0; i < 4; i++) {
+    int x = (i % 2) * 2;
+    int y = (i / 2) * 2;
+    uint32_t sum = curr[(y * width) + x] + curr[(y * width) + x + 1] + curr[((y + 1) * width) + x] + curr[((y + 1) * width) + x + 1];
+    expected[i] = (sum + 2) / 4;
+  }
+  
+  memset(scaled, 0, sizeof(scaled));
+  maxvid_scale_keyframe(&scale, scaled, curr);
+  NSAssert(memcmp(scaled, expected, sizeof(scaled)) == 0, @"box filtered keyframe");
+  
+  maxvid_scale_free(&scale);
+  
+  result = maxvid_scale_init(&scale, width, height, 32, 1, MV_SCALE_BOX);
+  NSAssert(result == 0, @"result");
+  
+  memset(scaled, 0, sizeof(scaled));
+  result = maxvid_decode_c4_scaled(&scale, scaled, inputBuffer32, inputBuffer32NumWords);
+  NSAssert(result == 0, @"result");
+  NSAssert(memcmp(scaled, expected, sizeof(scaled)) == 0, @"box filtered delta");
+  
+  // Change 1 pixel in the top left block and 2 pixels in the bottom right block
+  
+  uint32_t next[16];
+  memcpy(next, curr, sizeof(next));
+  next[0] = 0x7F;
+  next[10] = 0x33;
+  next[15] = 0xC8;
+  
+  codes = maxvid_encode_generic_delta_pixels32(curr, next, sizeof(next)/sizeof(uint32_t), width, height, NULL, 0);
+  c4Codes = [self util_convertToC4Codes32:codes frameBufferNumPixels:(width * height)];
+  
+  for (int i = 0; i < 4; i++) {
+    int x = (i % 2) * 2;
+    int y = (i / 2) * 2;
+    uint32_t sum = next[(y * width) + x] + next[(y * width) + x + 1] + next[((y + 1) * width) + x] + next[((y + 1) * width) + x + 1];
+    expected[i] = (sum + 2) / 4;
+  }
+  
+  result = maxvid_decode_c4_scaled(&scale, scaled, (uint32_t*) c4Codes.bytes, (uint32_t) (c4Codes.length / sizeof(uint32_t)));
+  NSAssert(result == 0, @"result");
+  NSAssert(memcmp(scaled, expected, sizeof(scaled)) == 0, @"box filtered partial delta");
+  
+  // Input ends before the DONE code
+  
+  result = maxvid_decode_c4_scaled(&scale, scaled, inputBuffer32, inputBuffer32NumWords - 2);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  maxvid_scale_free(&scale);
+  return;
+}
+
+
+// Decode a 2x2 crop rectangle at (1, 1) from a 4x4 keyframe and then from a delta
+// frame. Only the cropped pixels are written and the delta frame is applied over
+// the cropped keyframe pixels.
+
++ (void) testCroppedDecode32BPP
+{
+  uint32_t prev[16];
+  uint32_t curr[16];
+  int width = 4;
+  int height = 4;
+  
+  for (int i = 0; i < 16; i++) {
+    prev[i] = 0x100 + i;
+    curr[i] = prev[i];
+  }
+  curr[5] = 0x5;
+  curr[9] = 0x9;
+  curr[10] = 0x9;
+  curr[14] = 0xE;
+  
+  NSData *codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), width, height, NULL, 0);
+  NSData *c4Codes = [self util_convertToC4Codes32:codes frameBufferNumPixels:(width * height)];
+  
+  uint32_t *inputBuffer32 = (uint32_t*) c4Codes.bytes;
+  uint32_t inputBuffer32NumWords = (uint32_t) (c4Codes.length / sizeof(uint32_t));
+  
+  uint32_t cropped[4];
+  uint32_t result;
+  MVCrop crop;
+  
+  result = maxvid_crop_init(&crop, width, height, 32, 3, 0, 2, 2);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"crop outside frame");
+  
+  result = maxvid_crop_init(&crop, width, height, 32, 1, 1, 2, 2);
+  NSAssert(result == 0, @"result");
+  NSAssert(maxvid_crop_num_bytes(&crop) == sizeof(cropped), @"num bytes");
+  
+  maxvid_crop_keyframe(&crop, cropped, prev);
+  NSAssert(cropped[0] == prev[5] && cropped[1] == prev[6], @"cropped keyframe");
+  NSAssert(cropped[2] == prev[9] && cropped[3] == prev[10], @"cropped keyframe");
+  
+  result = maxvid_decode_c4_cropped(&crop, cropped, inputBuffer32, inputBuffer32NumWords);
+  NSAssert(result == 0, @"result");
+  NSAssert(cropped[0] == curr[5] && cropped[1] == curr[6], @"cropped delta");
+  NSAssert(cropped[2] == curr[9] && cropped[3] == curr[10], @"cropped delta");
+  
+  return;
+}
+
+
+// Decode 16 BPP codes straight into a 32 BPP framebuffer, each pixel in a DUP or
+// COPY is expanded and a SKIP leaves the 32 BPP pixel as it was. The COPY starts
+// on an odd pixel so that the first pixel is read from the code word.
+
++ (void) testDecodeC4Sample16To32
+{
+  uint16_t prev[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+  uint16_t curr[] = { 0x0, 0x1F, 0x3E0, 0x7C00, 0x0, 0x7FFF, 0x7FFF };
+  int width = 7;
+  int height = 1;
+  
+  NSData *codes = maxvid_encode_generic_delta_pixels16(prev, curr, sizeof(curr)/sizeof(uint16_t), width, height, NULL, 0);
+  NSData *c4Codes = [self util_convertToC4Codes16:codes frameBufferNumPixels:(width * height)];
+  
+  uint32_t *inputBuffer32 = (uint32_t*) c4Codes.bytes;
+  uint32_t inputBuffer32NumWords = (uint32_t) (c4Codes.length / sizeof(uint32_t));
+  
+  uint32_t frameBuffer32[7];
+  for (int i = 0; i < 7; i++) {
+    frameBuffer32[i] = 0xFF000000;
+  }
+  
+  uint32_t result = maxvid_decode_c4_sample16_to32(frameBuffer32, inputBuffer32, inputBuffer32NumWords, width * height);
+  NSAssert(result == 0, @"result");
+  
+  NSAssert(frameBuffer32[0] == 0xFF000000, @"pixel");
+  NSAssert(frameBuffer32[1] == 0xFF0000FF, @"pixel");
+  NSAssert(frameBuffer32[2] == 0xFF00FF00, @"pixel");
+  NSAssert(frameBuffer32[3] == 0xFFFF0000, @"pixel");
+  NSAssert(frameBuffer32[4] == 0xFF000000, @"pixel");
+  NSAssert(frameBuffer32[5] == 0xFFFFFFFF, @"pixel");
+  NSAssert(frameBuffer32[6] == 0xFFFFFFFF, @"pixel");
+  
+  result = maxvid_decode_c4_sample16_to32(frameBuffer32, inputBuffer32, inputBuffer32NumWords, 4);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  return;
+}
+
+// Every 16 BPP pixel expanded to 32 BPP converts back to the same 16 BPP pixel,
+// with and without dithering.
+
++ (void) testConvert555To8888RoundTrip
+{
+  int width = 256;
+  int height = 128;
+  
+  CGFrameBuffer *fb16 = [CGFrameBuffer cGFrameBufferWithBppDimensions:16 width:width height:height];
+  CGFrameBuffer *fb32 = [CGFrameBuffer cGFrameBufferWithBppDimensions:32 width:width height:height];
+  CGFrameBuffer *result16 = [CGFrameBuffer cGFrameBufferWithBppDimensions:16 width:width height:height];
+  
+  uint16_t *pixels16 = (uint16_t*) fb16.pixels;
+  for (int i = 0; i < (width * height); i++) {
+    pixels16[i] = (uint16_t) i;
+  }
+  
+  [fb32 convertPixels:fb16 dither:FALSE];
+  
+  uint32_t *pixels32 = (uint32_t*) fb32.pixels;
+  NSAssert(pixels32[0] == 0xFF000000, @"pixel");
+  NSAssert(pixels32[0x10] == 0xFF000084, @"pixel");
+  NSAssert(pixels32[0x7FFF] == 0xFFFFFFFF, @"pixel");
+  
+  [result16 convertPixels:fb32 dither:FALSE];
+  NSAssert(memcmp(result16.pixels, fb16.pixels, fb16.numBytes) == 0, @"round trip");
+  
+  [result16 clear];
+  [result16 convertPixels:fb32 dither:TRUE];
+  NSAssert(memcmp(result16.pixels, fb16.pixels, fb16.numBytes) == 0, @"dithered round trip");
+  
+  return;
+}
+
+
+// Convert a 10x2 BT.601 video range frame of black, white, red, green, and blue
+// pixel pairs, as NV12 and as I420, then join an alpha plane where the first
+// row is opaque and the second row is half transparent. Tools/mvidyuvcheck.c
+// checks a larger BT.709 frame against a reference dump outside of Xcode.
+
++ (void) testConvertYUVToBGRA
+{
+  int width = 10;
+  int height = 2;
+  
+  uint8_t yPlane[] = {
+    16, 16, 235, 235, 81, 81, 145, 145, 41, 41,
+    16, 16, 235, 235, 81, 81, 145, 145, 41, 41
+  };
+  uint8_t uPlane[] = { 128, 128, 90, 54, 240 };
+  uint8_t vPlane[] = { 128, 128, 240, 34, 110 };
+  uint8_t uvPlane[10];
+  for (int i = 0; i < 5; i++) {
+    uvPlane[(i * 2)] = uPlane[i];
+    uvPlane[(i * 2) + 1] = vPlane[i];
+  }
+  uint8_t alphaPlane[20];
+  for (int i = 0; i < 20; i++) {
+    alphaPlane[i] = (i < width) ? 235 : 126;
+  }
+  
+  MVYUVCoefficients coefficients;
+  uint32_t result = maxvid_yuv_init(&coefficients, MV_YUV_MATRIX_BT601, MV_YUV_RANGE_VIDEO);
+  NSAssert(result == 0, @"result");
+  
+  uint32_t nv12Pixels[20];
+  uint32_t i420Pixels[20];
+  uint32_t alphaPixels[20];
+  uint32_t outBytesPerRow = width * sizeof(uint32_t);
+  
+  result = maxvid_yuv_nv12_to_bgra(&coefficients, nv12Pixels, outBytesPerRow, yPlane, width, uvPlane, width,
+                                   NULL, 0, width, height);
+  NSAssert(result == 0, @"result");
+  
+  result = maxvid_yuv_i420_to_bgra(&coefficients, i420Pixels, outBytesPerRow, yPlane, width, uPlane, vPlane, width / 2,
+                                   NULL, 0, width, height);
+  NSAssert(result == 0, @"result");
+  
+  result = maxvid_yuv_nv12_to_bgra(&coefficients, alphaPixels, outBytesPerRow, yPlane, width, uvPlane, width,
+                                   alphaPlane, width, width, height);
+  NSAssert(result == 0, @"result");
+  
+  uint32_t expected[] = { 0xFF000000, 0xFFFFFFFF, 0xFFFE0000, 0xFF00FF01, 0xFF0000FF };
+  uint32_t expectedHalfAlpha[] = { 0x80000000, 0x80808080, 0x807F0000, 0x80008001, 0x80000080 };
+  
+  for (int i = 0; i < 20; i++) {
+    int column = i % width;
+    NSAssert(nv12Pixels[i] == expected[column / 2], @"nv12 pixel");
+    NSAssert(i420Pixels[i] == nv12Pixels[i], @"i420 pixel");
+    if (i < width) {
+      NSAssert(alphaPixels[i] == expected[column / 2], @"opaque pixel");
+    } else {
+      NSAssert(alphaPixels[i] == expectedHalfAlpha[column / 2], @"half alpha pixel");
+    }
+  }
+  
+  // Strides too small for the width are rejected
+  
+  result = maxvid_yuv_nv12_to_bgra(&coefficients, nv12Pixels, outBytesPerRow - 4, yPlane, width, uvPlane, width,
+                                   NULL, 0, width, height);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  result = maxvid_yuv_nv12_to_bgra(&coefficients, nv12Pixels, outBytesPerRow, yPlane, width, uvPlane, width - 1,
+                                   NULL, 0, width, height);
+  NSAssert(result == MV_ERROR_CODE_INVALID_INPUT, @"result");
+  
+  return;
+}
+
+// Join RGB and grayscale alpha pixels in place, including the (0 0 1) and
+// (128 127 129) hardware decoder results, then join the same frame again
+// against the first result to check that no changed pixels are found.
+
++ (void) testJoinAlphaPixels
+{
+  premultiply_init();
+  
+  uint32_t rgbPixels[] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00808080 };
+  uint32_t alphaPixels[] = { 0x00FFFFFF, 0x00000000, 0x00000001, 0x00807F81 };
+  uint32_t expected[] = { 0xFFFF0000, 0x0, 0x0, 0x80404040 };
+  
+  uint32_t combinedPixels[4];
+  uint32_t prevPixels[4];
+  
+  uint32_t numChanged = maxvid_alpha_join_pixels(prevPixels, rgbPixels, alphaPixels, NULL, 4);
+  NSAssert(numChanged == 4, @"numChanged");
+  
+  for (int i = 0; i < 4; i++) {
+    NSAssert(prevPixels[i] == expected[i], @"joined pixel");
+  }
+  
+  memcpy(combinedPixels, rgbPixels, sizeof(rgbPixels));
+  
+  numChanged = maxvid_alpha_join_pixels(combinedPixels, combinedPixels, alphaPixels, prevPixels, 4);
+  NSAssert(numChanged == 0, @"numChanged");
+  NSAssert(memcmp(combinedPixels, prevPixels, sizeof(prevPixels)) == 0, @"joined in place");
+  
+  // Only the opaque pixel changes
+  
+  combinedPixels[0] = 0x000000FF;
+  
+  numChanged = maxvid_alpha_join_pixels(combinedPixels, combinedPixels, alphaPixels, prevPixels, 4);
+  NSAssert(numChanged == 1, @"numChanged");
+  NSAssert(combinedPixels[0] == 0xFF0000FF, @"joined pixel");
+  
+  return;
+}
+
 @end
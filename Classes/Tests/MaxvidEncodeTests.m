@@ -19,6 +19,8 @@
 
 #import "maxvid_decode.h"
 
+#import "maxvid_stats.h"
+
 static inline
 uint32_t num_words_16bpp(uint32_t numPixels) {
   // Return the number of words required to contain
@@ -1573,4 +1575,224 @@ uint32_t num_words_16bpp(uint32_t numPixels) {
   return;
 }
 
+// Lossy SKIP : pixels that differ from the previous frame by no more
+// than the tolerance in each channel are treated as unchanged.
+
++ (void) testEncodeLossySkipAt32BPP
+{
+  uint32_t prev[] = { 0x80102030, 0x80102030, 0x80102030 };
+  uint32_t curr[] = { 0x81112131, 0x80102030, 0x80402030 };
+  
+  NSData *codes;
+  NSString *results;
+  
+  uint32_t encodeFlags = MaxvidEncodeFlags_LOSSY_SKIP | MaxvidEncodeFlags_TOLERANCE(2);
+  
+  uint32_t numModified = maxvid_encode_lossy_pixels32(prev, curr, 3, 1, encodeFlags);
+  NSAssert(numModified == 1, @"numModified");
+  NSAssert(curr[0] == 0x80102030, @"curr[0]");
+  NSAssert(curr[2] == 0x80402030, @"curr[2]");
+  
+  codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), 3, 1, NULL, encodeFlags);
+  results = [self util_printMvidCodes32:codes];
+  NSAssert([results isEqualToString:@"SKIP 2 COPY 1 0x80402030 DONE"], @"isEqualToString");
+  
+  return;
+}
+
+// Lossy SKIP at 16BPP, a tolerance of 8 is 1 step in a 5 bit channel
+
++ (void) testEncodeLossySkipAt16BPP
+{
+  uint16_t prev[] = { 0x0, 0x0, 0x0 };
+  uint16_t curr[] = { 0x0421, 0x0002, 0x0 };
+  
+  NSData *codes;
+  NSString *results;
+  
+  uint32_t encodeFlags = MaxvidEncodeFlags_LOSSY_SKIP | MaxvidEncodeFlags_TOLERANCE(8);
+  
+  uint32_t numModified = maxvid_encode_lossy_pixels16(prev, curr, 3, 1, encodeFlags);
+  NSAssert(numModified == 1, @"numModified");
+  
+  codes = maxvid_encode_generic_delta_pixels16(prev, curr, sizeof(curr)/sizeof(uint16_t), 3, 1, NULL, encodeFlags);
+  results = [self util_printMvidCodes16:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 COPY 1 0x2 SKIP 1 DONE"], @"isEqualToString");
+  
+  // A tolerance less than 8 is rounded up to 1 step
+  
+  uint16_t curr2[] = { 0x0421, 0x0002, 0x0 };
+  
+  encodeFlags = MaxvidEncodeFlags_LOSSY_SKIP | MaxvidEncodeFlags_TOLERANCE(1);
+  
+  numModified = maxvid_encode_lossy_pixels16(prev, curr2, 3, 1, encodeFlags);
+  NSAssert(numModified == 1, @"numModified");
+  NSAssert(curr2[0] == 0x0, @"curr2[0]");
+  
+  return;
+}
+
+// Lossy DUP : a nearly flat run of changed pixels is quantized to the
+// value of the first pixel in the run and emitted as a DUP.
+
++ (void) testEncodeLossyDupAt32BPP
+{
+  uint32_t prev[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+  uint32_t curr[] = { 0xFF405060, 0xFF415060, 0xFF405160, 0xFF405061, 0xFF3F5060, 0xFF000000 };
+  
+  NSData *codes;
+  NSString *results;
+  
+  uint32_t encodeFlags = MaxvidEncodeFlags_LOSSY_DUP | MaxvidEncodeFlags_TOLERANCE(1);
+  
+  uint32_t numModified = maxvid_encode_lossy_pixels32(prev, curr, 6, 1, encodeFlags);
+  NSAssert(numModified == 4, @"numModified");
+  
+  codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), 6, 1, NULL, encodeFlags);
+  results = [self util_printMvidCodes32:codes];
+  NSAssert([results isEqualToString:@"DUP 5 0xFF405060 COPY 1 0xFF000000 DONE"], @"isEqualToString");
+  
+  // A run shorter than the minimum is not quantized
+  
+  uint32_t prev2[] = { 0x0, 0x0, 0x0 };
+  uint32_t curr2[] = { 0xFF405060, 0xFF415060, 0xFF405160 };
+  
+  numModified = maxvid_encode_lossy_pixels32(prev2, curr2, 3, 1, encodeFlags);
+  NSAssert(numModified == 0, @"numModified");
+  
+  return;
+}
+
+// Merge DUP : a 4x3 fill where the first pixel of rows 2 and 3 already had
+// the fill color is emitted as one DUP that crosses the row boundaries.
+
++ (void) testEncodeMergeDupAt32BPP
+{
+  uint32_t prev[] = {
+    0x0, 0x0, 0x0, 0x0,
+    0xFF0000FF, 0x0, 0x0, 0x0,
+    0xFF0000FF, 0x0, 0x0, 0x0
+  };
+  uint32_t curr[] = {
+    0x0, 0xFF0000FF, 0xFF0000FF, 0xFF0000FF,
+    0xFF0000FF, 0xFF0000FF, 0xFF0000FF, 0xFF0000FF,
+    0xFF0000FF, 0xFF0000FF, 0xFF0000FF, 0xFF0000FF
+  };
+  
+  NSData *codes;
+  NSString *results;
+  
+  codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), 4, 3, NULL, 0);
+  results = [self util_printMvidCodes32:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 DUP 3 0xFF0000FF SKIP 1 DUP 3 0xFF0000FF SKIP 1 DUP 3 0xFF0000FF DONE"], @"isEqualToString");
+  
+  codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), 4, 3, NULL, MaxvidEncodeFlags_MERGE_DUP);
+  results = [self util_printMvidCodes32:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 DUP 11 0xFF0000FF DONE"], @"isEqualToString");
+  
+  // An unchanged pixel with another color is not merged
+  
+  prev[8] = 0xFF00FF00;
+  curr[8] = 0xFF00FF00;
+  
+  codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), 4, 3, NULL, MaxvidEncodeFlags_MERGE_DUP);
+  results = [self util_printMvidCodes32:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 DUP 7 0xFF0000FF SKIP 1 DUP 3 0xFF0000FF DONE"], @"isEqualToString");
+  
+  return;
+}
+
++ (void) testEncodeMergeDupAt16BPP
+{
+  uint16_t prev[] = {
+    0x0, 0x0, 0x0,
+    0x7C00, 0x0, 0x0
+  };
+  uint16_t curr[] = {
+    0x0, 0x7C00, 0x7C00,
+    0x7C00, 0x7C00, 0x7C00
+  };
+  
+  NSData *codes;
+  NSString *results;
+  
+  codes = maxvid_encode_generic_delta_pixels16(prev, curr, sizeof(curr)/sizeof(uint16_t), 3, 2, NULL, MaxvidEncodeFlags_MERGE_DUP);
+  results = [self util_printMvidCodes16:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 DUP 5 0x7C00 DONE"], @"isEqualToString");
+  
+  return;
+}
+
+// Encode stats : convert generic codes to c4 codes and then count the
+// SKIP, DUP, and COPY codes and pixels in the c4 output.
+
++ (void) testEncodeStatsAt32BPP
+{
+  uint32_t prev[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+  uint32_t curr[] = { 0x0, 0x5, 0x5, 0x5, 0x7, 0x8 };
+  
+  NSData *codes;
+  NSString *results;
+  
+  codes = maxvid_encode_generic_delta_pixels32(prev, curr, sizeof(curr)/sizeof(uint32_t), 6, 1, NULL, 0);
+  results = [self util_printMvidCodes32:codes];
+  NSAssert([results isEqualToString:@"SKIP 1 DUP 3 0x5 COPY 2 0x7 0x8 DONE"], @"isEqualToString");
+  
+  NSMutableData *mC4Data = [NSMutableData data];
+  int retcode = maxvid_encode_c4_sample32((uint32_t*)codes.bytes, (uint32_t)(codes.length / sizeof(uint32_t)), 6, mC4Data, 0);
+  NSAssert(retcode == 0, @"retcode");
+  
+  MVFrameStats frameStats;
+  maxvid_frame_stats_init(&frameStats, 1, MV_STATS_DELTAFRAME);
+  
+  uint32_t status = maxvid_frame_stats_count_c4_codes32(&frameStats, (uint32_t*)mC4Data.bytes, (uint32_t)(mC4Data.length / sizeof(uint32_t)), 6);
+  NSAssert(status == 0, @"status");
+  
+  NSAssert(frameStats.numSkipCodes == 1, @"numSkipCodes");
+  NSAssert(frameStats.numSkipPixels == 1, @"numSkipPixels");
+  NSAssert(frameStats.numDupCodes == 1, @"numDupCodes");
+  NSAssert(frameStats.numDupPixels == 3, @"numDupPixels");
+  NSAssert(frameStats.numCopyCodes == 1, @"numCopyCodes");
+  NSAssert(frameStats.numCopyPixels == 2, @"numCopyPixels");
+  NSAssert(frameStats.numCodeWords == 7, @"numCodeWords");
+  
+  // Codes that cover more pixels than the framebuffer are invalid
+  
+  maxvid_frame_stats_init(&frameStats, 1, MV_STATS_DELTAFRAME);
+  status = maxvid_frame_stats_count_c4_codes32(&frameStats, (uint32_t*)mC4Data.bytes, (uint32_t)(mC4Data.length / sizeof(uint32_t)), 5);
+  NSAssert(status == MV_ERROR_CODE_INVALID_INPUT, @"status");
+  
+  return;
+}
+
++ (void) testEncodeStatsAt16BPP
+{
+  uint16_t prev[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+  uint16_t curr[] = { 0x0, 0x5, 0x5, 0x5, 0x7, 0x8 };
+  
+  NSData *codes;
+  
+  codes = maxvid_encode_generic_delta_pixels16(prev, curr, sizeof(curr)/sizeof(uint16_t), 6, 1, NULL, 0);
+  
+  NSMutableData *mC4Data = [NSMutableData data];
+  int retcode = maxvid_encode_c4_sample16((uint32_t*)codes.bytes, (uint32_t)(codes.length / sizeof(uint32_t)), 6, mC4Data, 0);
+  NSAssert(retcode == 0, @"retcode");
+  
+  MVFrameStats frameStats;
+  maxvid_frame_stats_init(&frameStats, 1, MV_STATS_DELTAFRAME);
+  
+  uint32_t status = maxvid_frame_stats_count_c4_codes16(&frameStats, (uint32_t*)mC4Data.bytes, (uint32_t)(mC4Data.length / sizeof(uint32_t)), 6);
+  NSAssert(status == 0, @"status");
+  
+  NSAssert(frameStats.numSkipCodes == 1, @"numSkipCodes");
+  NSAssert(frameStats.numSkipPixels == 1, @"numSkipPixels");
+  NSAssert(frameStats.numDupCodes == 1, @"numDupCodes");
+  NSAssert(frameStats.numDupPixels == 3, @"numDupPixels");
+  NSAssert(frameStats.numCopyCodes == 1, @"numCopyCodes");
+  NSAssert(frameStats.numCopyPixels == 2, @"numCopyPixels");
+  NSAssert(frameStats.numCodeWords == 5, @"numCodeWords");
+  
+  return;
+}
+
 @end
@@ -0,0 +1,320 @@
+// mvid_bench_util module
+//
+//  License terms defined in License.txt.
+//
+// Minimal micro-benchmark harness shared by the kernel benchmark tools.
+// Each benchmark function processes one unit of work per call. The harness
+// calibrates the number of calls needed to run for a minimum amount of time,
+// repeats the measurement and keeps the median time per call. Results can be
+// written as JSON and compared against a JSON baseline written by a previous
+// run, one benchmark per line so that a baseline can be diffed and parsed
+// without a JSON library. Input data is generated with a fixed seed so that
+// every run measures exactly the same work.
+
+#ifndef MVID_BENCH_UTIL_H
+#define MVID_BENCH_UTIL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "maxvid_decode.h"
+
+#define MVID_BENCH_MAX_RESULTS 256
+#define MVID_BENCH_NAME_LENGTH 64
+#define MVID_BENCH_REPETITIONS 5
+#define MVID_BENCH_MIN_SECONDS 0.1
+
+typedef void (*MvidBenchFunc)(void *ctx);
+
+typedef struct {
+  char name[MVID_BENCH_NAME_LENGTH];
+  double nsPerOp;
+  double bytesPerOp;
+  uint64_t iterations;
+} MvidBenchResult;
+
+typedef struct {
+  MvidBenchResult results[MVID_BENCH_MAX_RESULTS];
+  int numResults;
+  const char *filter;
+} MvidBench;
+
+// xorshift32 PRNG, the same seed always generates the same sequence
+
+static inline
+uint32_t mvid_bench_rand(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static inline
+double mvid_bench_now(void) {
+  struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+  timespec_get(&ts, TIME_UTC);
+#endif
+  return ts.tv_sec + (ts.tv_nsec * 1.0e-9);
+}
+
+static inline
+int mvid_bench_compare_doubles(const void *a, const void *b) {
+  double d1 = *((const double*)a);
+  double d2 = *((const double*)b);
+  return (d1 > d2) - (d1 < d2);
+}
+
+// Run a benchmark and record the median time per call. The bytesPerOp value
+// is the number of bytes processed in one call, used to report MB/s.
+
+static inline
+void mvid_bench_run(MvidBench *bench, const char *name, MvidBenchFunc func, void *ctx, double bytesPerOp) {
+  if (bench->filter != NULL && strstr(name, bench->filter) == NULL) {
+    return;
+  }
+  if (bench->numResults == MVID_BENCH_MAX_RESULTS) {
+    fprintf(stderr, "too many benchmarks\n");
+    return;
+  }
+
+  // Warm up and calibrate so that one repetition runs for at least the min time
+
+  uint64_t iterations = 1;
+  while (1) {
+    double startTime = mvid_bench_now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      func(ctx);
+    }
+    double elapsed = mvid_bench_now() - startTime;
+    if (elapsed >= MVID_BENCH_MIN_SECONDS || iterations >= (1ULL << 40)) {
+      break;
+    }
+    iterations *= (elapsed < (MVID_BENCH_MIN_SECONDS / 100)) ? 10 : 2;
+  }
+
+  double samples[MVID_BENCH_REPETITIONS];
+
+  for (int rep = 0; rep < MVID_BENCH_REPETITIONS; rep++) {
+    double startTime = mvid_bench_now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      func(ctx);
+    }
+    samples[rep] = ((mvid_bench_now() - startTime) * 1.0e9) / iterations;
+  }
+
+  qsort(samples, MVID_BENCH_REPETITIONS, sizeof(double), mvid_bench_compare_doubles);
+
+  MvidBenchResult *result = &bench->results[bench->numResults++];
+  snprintf(result->name, sizeof(result->name), "%s", name);
+  result->nsPerOp = samples[MVID_BENCH_REPETITIONS / 2];
+  result->bytesPerOp = bytesPerOp;
+  result->iterations = iterations;
+
+  double mbPerSecond = (bytesPerOp / (1024.0 * 1024.0)) / (result->nsPerOp * 1.0e-9);
+
+  printf("%-48s %12.1f ns %10.1f MB/s %12llu\n", name, result->nsPerOp, mbPerSecond, (unsigned long long)iterations);
+  fflush(stdout);
+}
+
+// Write all results as JSON, one benchmark object per line
+
+static inline
+int mvid_bench_write_json(MvidBench *bench, const char *path) {
+  FILE *outFile = fopen(path, "w");
+  if (outFile == NULL) {
+    return 1;
+  }
+  fprintf(outFile, "{\n  \"benchmarks\": [\n");
+  for (int i = 0; i < bench->numResults; i++) {
+    MvidBenchResult *result = &bench->results[i];
+    fprintf(outFile, "    { \"name\": \"%s\", \"ns_per_op\": %.3f, \"bytes_per_op\": %.0f, \"iterations\": %llu }%s\n",
+            result->name, result->nsPerOp, result->bytesPerOp, (unsigned long long)result->iterations,
+            (i == (bench->numResults - 1)) ? "" : ",");
+  }
+  fprintf(outFile, "  ]\n}\n");
+  return (fclose(outFile) == 0) ? 0 : 1;
+}
+
+// Compare results to a baseline JSON file written by mvid_bench_write_json().
+// Returns the number of benchmarks that are slower than the baseline by
+// more than thresholdPercent.
+
+static inline
+int mvid_bench_compare_baseline(MvidBench *bench, const char *path, double thresholdPercent) {
+  FILE *inFile = fopen(path, "r");
+  if (inFile == NULL) {
+    fprintf(stderr, "could not open baseline \"%s\"\n", path);
+    return -1;
+  }
+
+  int numRegressions = 0;
+  char line[512];
+
+  printf("\n%-48s %12s %12s %8s\n", "baseline comparison", "baseline ns", "current ns", "change");
+
+  while (fgets(line, sizeof(line), inFile) != NULL) {
+    char name[MVID_BENCH_NAME_LENGTH];
+    double baselineNsPerOp;
+
+    if (sscanf(line, " { \"name\": \"%63[^\"]\", \"ns_per_op\": %lf", name, &baselineNsPerOp) != 2) {
+      continue;
+    }
+
+    for (int i = 0; i < bench->numResults; i++) {
+      MvidBenchResult *result = &bench->results[i];
+      if (strcmp(result->name, name) != 0) {
+        continue;
+      }
+      double changePercent = ((result->nsPerOp - baselineNsPerOp) / baselineNsPerOp) * 100.0;
+      int isRegression = (changePercent > thresholdPercent);
+      if (isRegression) {
+        numRegressions++;
+      }
+      printf("%-48s %12.1f %12.1f %+7.1f%%%s\n", name, baselineNsPerOp, result->nsPerOp, changePercent,
+             isRegression ? " REGRESSION" : "");
+    }
+  }
+
+  fclose(inFile);
+  return numRegressions;
+}
+
+// Percent of pixels that change from one synthetic frame to the next
+
+static const uint32_t mvidBenchChangePercents[] = { 1, 10, 50, 100 };
+
+#define MVID_BENCH_NUM_CHANGE_PERCENTS (sizeof(mvidBenchChangePercents) / sizeof(mvidBenchChangePercents[0]))
+
+// A synthetic frame is a list of runs that cover every pixel. A SKIP run
+// leaves the previous pixels (zero) in place, a DUP run repeats one pixel
+// and a COPY run contains different pixels. The pixels array holds the
+// expected framebuffer contents after the frame is applied.
+
+typedef struct {
+  uint32_t op;
+  uint32_t offset;
+  uint32_t num;
+} MvidBenchRun;
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t bpp;
+  uint32_t *pixels;
+  MvidBenchRun *runs;
+  uint32_t numRuns;
+} MvidBenchFrame;
+
+// Allocate a zeroed and page aligned buffer, exits when out of memory.
+// Release with free().
+
+static inline
+void* mvid_bench_alloc(size_t numBytes) {
+  void *ptr = NULL;
+  if (posix_memalign(&ptr, MV_PAGESIZE, (numBytes + MV_PAGESIZE - 1) & ~((size_t)MV_PAGESIZE - 1)) != 0) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  memset(ptr, 0, numBytes);
+  return ptr;
+}
+
+// Generate a random pixel that fits in the given bpp
+
+static inline
+uint32_t mvid_bench_pixel(uint32_t *seed, uint32_t bpp) {
+  uint32_t pixel = mvid_bench_rand(seed);
+  if (bpp == 16) {
+    return pixel & 0x7FFF;
+  } else if (bpp == 24) {
+    return pixel & 0xFFFFFF;
+  } else {
+    return pixel;
+  }
+}
+
+// Generate a frame where changePercent of the pixels differ from the zero
+// previous frame. A change run is chosen whenever the number of changed pixels
+// so far is behind the requested ratio, so the ratio is met in every region
+// of the frame. Adjacent SKIP and COPY runs are merged as the encoder would.
+
+static inline
+void mvid_bench_frame_init(MvidBenchFrame *frame, uint32_t width, uint32_t height, uint32_t bpp, uint32_t changePercent, uint32_t seed) {
+  uint32_t numPixels = width * height;
+
+  frame->width = width;
+  frame->height = height;
+  frame->bpp = bpp;
+  frame->pixels = mvid_bench_alloc(numPixels * sizeof(uint32_t));
+  frame->runs = mvid_bench_alloc(numPixels * sizeof(MvidBenchRun));
+  frame->numRuns = 0;
+
+  uint32_t numChanged = 0;
+
+  for (uint32_t offset = 0; offset < numPixels; ) {
+    uint32_t isChange = ((uint64_t)numChanged * 100) <= ((uint64_t)offset * changePercent);
+    if (changePercent == 0) {
+      isChange = 0;
+    }
+
+    uint32_t num;
+    uint32_t op;
+
+    if (isChange) {
+      num = 1 + (mvid_bench_rand(&seed) % 32);
+      op = ((num > 1) && ((mvid_bench_rand(&seed) % 3) == 0)) ? DUP : COPY;
+    } else {
+      num = 1 + (mvid_bench_rand(&seed) % 64);
+      op = SKIP;
+    }
+    if (num > (numPixels - offset)) {
+      num = numPixels - offset;
+    }
+    if (op == DUP && num < 2) {
+      op = COPY;
+    }
+
+    if (op == DUP) {
+      uint32_t pixel = mvid_bench_pixel(&seed, bpp);
+      for (uint32_t i = 0; i < num; i++) {
+        frame->pixels[offset + i] = pixel;
+      }
+    } else if (op == COPY) {
+      for (uint32_t i = 0; i < num; i++) {
+        frame->pixels[offset + i] = mvid_bench_pixel(&seed, bpp);
+      }
+    }
+
+    MvidBenchRun *prevRun = (frame->numRuns > 0) ? &frame->runs[frame->numRuns - 1] : NULL;
+
+    if (prevRun != NULL && prevRun->op == op && op != DUP && (prevRun->num + num) <= 1000) {
+      prevRun->num += num;
+    } else {
+      MvidBenchRun *run = &frame->runs[frame->numRuns++];
+      run->op = op;
+      run->offset = offset;
+      run->num = num;
+    }
+
+    if (op != SKIP) {
+      numChanged += num;
+    }
+    offset += num;
+  }
+}
+
+static inline
+void mvid_bench_frame_free(MvidBenchFrame *frame) {
+  free(frame->pixels);
+  free(frame->runs);
+}
+
+#endif // MVID_BENCH_UTIL_H
@@ -0,0 +1,387 @@
+// mvid_poster module
+//
+//  License terms defined in License.txt.
+//
+// This module implements batch poster frame extraction for the command line tools.
+
+#include "mvid_poster.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+  const char **paths;
+  uint32_t numPaths;
+  const MvidPosterOptions *options;
+  MvidPosterFunc func;
+  void *context;
+  pthread_mutex_t *mutex;
+  uint32_t *nextFileIndex;
+  MvidPosterStats stats;
+  // Framebuffer and output buffers are kept from one file to the next
+  void *frameBuffer;
+  uint32_t frameBufferNumBytes;
+  uint32_t *outPixels;
+  uint32_t outNumPixels;
+  uint32_t *sums;
+  uint32_t numSums;
+  pthread_t thread;
+  int isThreadStarted;
+} MvidPosterWorker;
+
+// Return the frame index of the nth selected frame, or UINT32_MAX when there are no more
+
+static inline
+uint32_t mvid_poster_select(const MvidPosterOptions *options, uint32_t numFrames, uint32_t n) {
+  switch (options->select) {
+    case MVID_POSTER_FIRST:
+      return (n == 0) ? 0 : UINT32_MAX;
+    case MVID_POSTER_MIDDLE:
+      return (n == 0) ? (numFrames / 2) : UINT32_MAX;
+    case MVID_POSTER_LAST:
+      return (n == 0) ? (numFrames - 1) : UINT32_MAX;
+    case MVID_POSTER_EVERY_NTH: {
+      uint64_t frameIndex = (uint64_t) n * ((options->everyNth == 0) ? 1 : options->everyNth);
+      return (frameIndex < numFrames) ? (uint32_t) frameIndex : UINT32_MAX;
+    }
+  }
+  return UINT32_MAX;
+}
+
+// Find the keyframe at or before frameIndex. A nop frame repeats the frame
+// before it, so it is passed over like a delta frame.
+
+static inline
+uint32_t mvid_poster_keyframe_before(MvidReader *reader, uint32_t frameIndex) {
+  for ( ; frameIndex > 0; frameIndex--) {
+    MvidReaderFrame frame;
+    mvid_reader_frame(reader, frameIndex, &frame);
+    if (frame.isKeyframe && !frame.isNopframe) {
+      break;
+    }
+  }
+  return frameIndex;
+}
+
+// Expand a framebuffer pixel to 32 bit BGRA
+
+static inline
+uint32_t mvid_poster_pixel(const void *frameBuffer, uint32_t offset, uint32_t bpp) {
+  if (bpp == 16) {
+    uint32_t pixel = ((const uint16_t *) frameBuffer)[offset];
+    uint32_t red = (pixel >> 10) & 0x1F;
+    uint32_t green = (pixel >> 5) & 0x1F;
+    uint32_t blue = pixel & 0x1F;
+    red = (red << 3) | (red >> 2);
+    green = (green << 3) | (green >> 2);
+    blue = (blue << 3) | (blue >> 2);
+    return (0xFFu << 24) | (red << 16) | (green << 8) | blue;
+  } else if (bpp == 24) {
+    return ((const uint32_t *) frameBuffer)[offset] | (0xFFu << 24);
+  } else {
+    return ((const uint32_t *) frameBuffer)[offset];
+  }
+}
+
+// Grow a worker buffer so that it holds at least num elements, returns 1 on success
+
+static
+int mvid_poster_reserve(uint32_t **bufferPtr, uint32_t *numPtr, uint32_t num)
+{
+  if (*numPtr >= num) {
+    return 1;
+  }
+  uint32_t *buffer = realloc(*bufferPtr, (size_t) num * sizeof(uint32_t));
+  if (buffer == NULL) {
+    return 0;
+  }
+  *bufferPtr = buffer;
+  *numPtr = num;
+  return 1;
+}
+
+// Integer factor that makes width and height fit in maxDimension
+
+static inline
+uint32_t mvid_poster_factor(uint32_t width, uint32_t height, uint32_t maxDimension) {
+  if (maxDimension == 0) {
+    return 1;
+  }
+  uint32_t widthFactor = (width + maxDimension - 1) / maxDimension;
+  uint32_t heightFactor = (height + maxDimension - 1) / maxDimension;
+  uint32_t factor = (widthFactor > heightFactor) ? widthFactor : heightFactor;
+  return (factor == 0) ? 1 : factor;
+}
+
+// Convert the framebuffer to BGRA in outPixels and downscale by an integer factor.
+// Each output pixel is the average of a factor x factor block of input pixels,
+// blocks at the right and bottom edges are averaged over the pixels they cover.
+// Averaging premultiplied pixels is correct for alpha.
+
+static
+int mvid_poster_convert(MvidPosterWorker *worker, const void *frameBuffer,
+                        uint32_t width, uint32_t height, uint32_t bpp, MvidPoster *poster)
+{
+  const uint32_t factor = mvid_poster_factor(width, height, worker->options->maxDimension);
+
+  const uint32_t outWidth = (width + factor - 1) / factor;
+  const uint32_t outHeight = (height + factor - 1) / factor;
+
+  if (!mvid_poster_reserve(&worker->outPixels, &worker->outNumPixels, outWidth * outHeight)) {
+    return 0;
+  }
+
+  uint32_t *outPixels = worker->outPixels;
+
+  if (factor == 1) {
+    for (uint32_t offset = 0; offset < (width * height); offset++) {
+      outPixels[offset] = mvid_poster_pixel(frameBuffer, offset, bpp);
+    }
+  } else {
+    if (!mvid_poster_reserve(&worker->sums, &worker->numSums, outWidth * 4)) {
+      return 0;
+    }
+    uint32_t *sums = worker->sums;
+
+    for (uint32_t outRow = 0; outRow < outHeight; outRow++) {
+      memset(sums, 0, outWidth * 4 * sizeof(uint32_t));
+
+      const uint32_t firstRow = outRow * factor;
+      const uint32_t numRows = ((firstRow + factor) <= height) ? factor : (height - firstRow);
+
+      for (uint32_t row = firstRow; row < (firstRow + numRows); row++) {
+        for (uint32_t col = 0; col < width; col++) {
+          uint32_t pixel = mvid_poster_pixel(frameBuffer, (row * width) + col, bpp);
+          uint32_t *sum = &sums[(col / factor) * 4];
+          sum[0] += pixel & 0xFF;
+          sum[1] += (pixel >> 8) & 0xFF;
+          sum[2] += (pixel >> 16) & 0xFF;
+          sum[3] += (pixel >> 24) & 0xFF;
+        }
+      }
+
+      for (uint32_t outCol = 0; outCol < outWidth; outCol++) {
+        const uint32_t firstCol = outCol * factor;
+        const uint32_t numCols = ((firstCol + factor) <= width) ? factor : (width - firstCol);
+        const uint32_t count = numRows * numCols;
+        const uint32_t *sum = &sums[outCol * 4];
+        uint32_t pixel = 0;
+        for (int i = 3; i >= 0; i--) {
+          pixel = (pixel << 8) | ((sum[i] + (count / 2)) / count);
+        }
+        outPixels[(outRow * outWidth) + outCol] = pixel;
+      }
+    }
+  }
+
+  poster->width = outWidth;
+  poster->height = outHeight;
+  poster->pixels = outPixels;
+  return 1;
+}
+
+static
+void mvid_poster_extract_file(MvidPosterWorker *worker, uint32_t fileIndex)
+{
+  MvidPoster poster;
+  memset(&poster, 0, sizeof(MvidPoster));
+  poster.path = worker->paths[fileIndex];
+  poster.fileIndex = fileIndex;
+
+  worker->stats.numFiles++;
+
+  MvidReader reader;
+  const char *errStr = mvid_reader_open(&reader, poster.path);
+
+  if (errStr == NULL && reader.header->numFrames == 0) {
+    errStr = "file contains no frames";
+  }
+
+  // With scaled decode, the largest power of two in the factor, up to 1/8,
+  // is applied while decoding.
+
+  MVScale scale;
+  memset(&scale, 0, sizeof(MVScale));
+  uint32_t frameBufferNumBytes = 0;
+
+  if (errStr == NULL) {
+    const MVFileHeader *header = reader.header;
+    const uint32_t factor = mvid_poster_factor(header->width, header->height, worker->options->maxDimension);
+    uint32_t shift = 0;
+    while (shift < MV_SCALE_MAX_SHIFT && (2u << shift) <= factor) {
+      shift++;
+    }
+
+    if (worker->options->scaledDecode && shift > 0) {
+      if (maxvid_scale_init(&scale, header->width, header->height, header->bpp, shift, worker->options->scaleFilter) != 0) {
+        errStr = "could not setup scaled decode";
+      }
+      frameBufferNumBytes = maxvid_scale_num_bytes(&scale);
+    } else {
+      frameBufferNumBytes = reader.frameBufferNumBytes;
+    }
+  }
+
+  if (errStr == NULL && worker->frameBufferNumBytes != frameBufferNumBytes) {
+    if (worker->frameBuffer != NULL) {
+      maxvid_framebuffer_free(worker->frameBuffer, worker->frameBufferNumBytes);
+    }
+    worker->frameBuffer = maxvid_framebuffer_alloc(frameBufferNumBytes);
+    worker->frameBufferNumBytes = (worker->frameBuffer != NULL) ? frameBufferNumBytes : 0;
+    if (worker->frameBuffer == NULL) {
+      errStr = "could not allocate framebuffer";
+    }
+  }
+
+  if (errStr != NULL) {
+    worker->stats.numFilesFailed++;
+    worker->func(worker->context, &poster, errStr);
+    maxvid_scale_free(&scale);
+    mvid_reader_close(&reader);
+    return;
+  }
+
+  poster.bpp = reader.header->bpp;
+
+  // decodedIndex is the frame in the framebuffer, UINT32_MAX when none
+
+  uint32_t decodedIndex = UINT32_MAX;
+  uint32_t frameIndex;
+
+  for (uint32_t n = 0; (frameIndex = mvid_poster_select(worker->options, reader.header->numFrames, n)) != UINT32_MAX; n++) {
+    // Start at the keyframe, unless the frame already decoded is between the keyframe and this frame
+
+    uint32_t keyframeIndex = mvid_poster_keyframe_before(&reader, frameIndex);
+    uint32_t startIndex = keyframeIndex;
+
+    if (decodedIndex != UINT32_MAX && decodedIndex >= keyframeIndex && decodedIndex <= frameIndex) {
+      startIndex = decodedIndex + 1;
+    }
+
+    for (uint32_t i = startIndex; i <= frameIndex && errStr == NULL; i++) {
+      uint32_t status;
+      if (scale.shift > 0) {
+        status = mvid_reader_decode_frame_scaled(&reader, i, &scale, worker->frameBuffer);
+      } else {
+        status = mvid_reader_decode_frame(&reader, i, worker->frameBuffer);
+      }
+      if (status != 0) {
+        errStr = "frame could not be decoded";
+      } else {
+        worker->stats.numFramesDecoded++;
+        decodedIndex = i;
+      }
+    }
+
+    poster.frameIndex = frameIndex;
+    poster.pixels = NULL;
+
+    const uint32_t width = (scale.shift > 0) ? scale.scaledWidth : reader.header->width;
+    const uint32_t height = (scale.shift > 0) ? scale.scaledHeight : reader.header->height;
+
+    if (errStr == NULL && !mvid_poster_convert(worker, worker->frameBuffer, width, height, poster.bpp, &poster)) {
+      errStr = "could not allocate output buffer";
+    }
+
+    if (errStr != NULL) {
+      worker->stats.numFilesFailed++;
+      worker->func(worker->context, &poster, errStr);
+      break;
+    }
+
+    worker->stats.numPosters++;
+    worker->func(worker->context, &poster, NULL);
+  }
+
+  maxvid_scale_free(&scale);
+  mvid_reader_close(&reader);
+}
+
+static
+void* mvid_poster_worker_entry(void *arg)
+{
+  MvidPosterWorker *worker = (MvidPosterWorker *) arg;
+
+  while (1) {
+    pthread_mutex_lock(worker->mutex);
+    uint32_t fileIndex = (*worker->nextFileIndex)++;
+    pthread_mutex_unlock(worker->mutex);
+
+    if (fileIndex >= worker->numPaths) {
+      break;
+    }
+
+    mvid_poster_extract_file(worker, fileIndex);
+  }
+
+  if (worker->frameBuffer != NULL) {
+    maxvid_framebuffer_free(worker->frameBuffer, worker->frameBufferNumBytes);
+  }
+  free(worker->outPixels);
+  free(worker->sums);
+
+  return NULL;
+}
+
+uint32_t
+mvid_poster_extract(const char **paths, uint32_t numPaths, const MvidPosterOptions *options,
+                    MvidPosterFunc func, void *context, MvidPosterStats *stats)
+{
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  uint32_t nextFileIndex = 0;
+
+  uint32_t numThreads = options->numThreads;
+  if (numThreads == 0) {
+    long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    numThreads = (numCPUs > 0) ? (uint32_t) numCPUs : 1;
+  }
+  if (numThreads > numPaths) {
+    numThreads = (numPaths > 0) ? numPaths : 1;
+  }
+
+  MvidPosterWorker *workers = calloc(numThreads, sizeof(MvidPosterWorker));
+  if (workers == NULL) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  for (uint32_t i = 0; i < numThreads; i++) {
+    MvidPosterWorker *worker = &workers[i];
+    worker->paths = paths;
+    worker->numPaths = numPaths;
+    worker->options = options;
+    worker->func = func;
+    worker->context = context;
+    worker->mutex = &mutex;
+    worker->nextFileIndex = &nextFileIndex;
+  }
+
+  // The calling thread is the first worker, if a thread can't be started
+  // the other workers process its share of the files.
+
+  for (uint32_t i = 1; i < numThreads; i++) {
+    workers[i].isThreadStarted = (pthread_create(&workers[i].thread, NULL, mvid_poster_worker_entry, &workers[i]) == 0);
+  }
+
+  mvid_poster_worker_entry(&workers[0]);
+
+  MvidPosterStats totalStats;
+  memset(&totalStats, 0, sizeof(MvidPosterStats));
+
+  for (uint32_t i = 0; i < numThreads; i++) {
+    if (workers[i].isThreadStarted) {
+      pthread_join(workers[i].thread, NULL);
+    }
+    totalStats.numFiles += workers[i].stats.numFiles;
+    totalStats.numFilesFailed += workers[i].stats.numFilesFailed;
+    totalStats.numPosters += workers[i].stats.numPosters;
+    totalStats.numFramesDecoded += workers[i].stats.numFramesDecoded;
+  }
+
+  free(workers);
+
+  if (stats != NULL) {
+    *stats = totalStats;
+  }
+
+  return (totalStats.numFilesFailed == 0) ? 0 : MV_ERROR_CODE_INVALID_INPUT;
+}
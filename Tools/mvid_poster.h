@@ -0,0 +1,78 @@
+// mvid_poster module
+//
+//  License terms defined in License.txt.
+//
+// This module extracts poster frames from many .mvid files at once. Each file
+// is opened with mvid_reader_open(), which maps the file and checks only the
+// header and the frame table, so frame data that is not needed is never read.
+// To decode a selected frame, decoding starts at the nearest keyframe at or
+// before the frame instead of at the first frame, and continues from the
+// previous selected frame when that is closer. Files are distributed over a
+// pool of threads and each extracted frame can be downscaled by an integer
+// factor with a box filter before it is passed to the callback. With scaled
+// decode, frames are decoded straight into a 1/2, 1/4 or 1/8 size framebuffer,
+// see maxvid_scale.h, and only the remaining factor is applied afterwards.
+
+#ifndef MVID_POSTER_H
+#define MVID_POSTER_H
+
+#include "mvid_reader.h"
+
+typedef enum {
+  MVID_POSTER_FIRST = 0,
+  MVID_POSTER_MIDDLE,
+  MVID_POSTER_LAST,
+  MVID_POSTER_EVERY_NTH
+} MvidPosterSelect;
+
+typedef struct {
+  MvidPosterSelect select;
+  // Frame interval for MVID_POSTER_EVERY_NTH
+  uint32_t everyNth;
+  // Downscale so that width and height are not larger than this, 0 for no downscale
+  uint32_t maxDimension;
+  // Decode into a scaled framebuffer when downscaling by 2 or more, with
+  // MV_SCALE_POINT or MV_SCALE_BOX as the scale filter
+  uint32_t scaledDecode;
+  uint32_t scaleFilter;
+  // Number of threads, 0 for one thread per CPU
+  uint32_t numThreads;
+} MvidPosterOptions;
+
+// An extracted frame. Pixels are 32 bit BGRA, as in a 32 bpp framebuffer. The
+// alpha is premultiplied for a 32 bpp file and 0xFF for a 16 or 24 bpp file.
+
+typedef struct {
+  const char *path;
+  uint32_t fileIndex;
+  uint32_t frameIndex;
+  uint32_t bpp;
+  uint32_t width;
+  uint32_t height;
+  const uint32_t *pixels;
+} MvidPoster;
+
+typedef struct {
+  uint32_t numFiles;
+  uint32_t numFilesFailed;
+  uint32_t numPosters;
+  // Number of frames decoded, including delta frames decoded to get to a poster frame
+  uint64_t numFramesDecoded;
+} MvidPosterStats;
+
+// Invoked for each extracted frame, the pixels are only valid until the callback
+// returns. When a file can't be opened or a frame can't be decoded, errStr
+// describes the problem and poster->pixels is NULL. The callback is invoked from
+// worker threads, more than one call can run at the same time.
+
+typedef void (*MvidPosterFunc)(void *context, const MvidPoster *poster, const char *errStr);
+
+// Extract poster frames from each of the numPaths files and wait until all
+// the files are done. Returns 0 if every file was processed without error,
+// otherwise MV_ERROR_CODE_INVALID_INPUT. Stats can be NULL.
+
+uint32_t
+mvid_poster_extract(const char **paths, uint32_t numPaths, const MvidPosterOptions *options,
+                    MvidPosterFunc func, void *context, MvidPosterStats *stats);
+
+#endif // MVID_POSTER_H
@@ -0,0 +1,382 @@
+// mvid_reader module
+//
+//  License terms defined in License.txt.
+//
+// This module implements the file access and frame decode logic shared by the
+// command line tools.
+
+#include "mvid_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+// Check the header and frame table of the file data at mappedPtr
+
+static
+const char*
+mvid_reader_check(MvidReader *reader);
+
+const char*
+mvid_reader_open(MvidReader *reader, const char *path)
+{
+  memset(reader, 0, sizeof(MvidReader));
+  reader->fd = -1;
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return "could not open file";
+  }
+  reader->fd = fd;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    return "could not stat file";
+  }
+
+  if (st.st_size < (off_t)sizeof(MVFileHeader)) {
+    return "file is smaller than the header";
+  }
+
+  char *mappedPtr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mappedPtr == MAP_FAILED) {
+    return "could not map file";
+  }
+  reader->mappedPtr = mappedPtr;
+  reader->mappedNumBytes = (size_t)st.st_size;
+  reader->mapKeyframes = 1;
+
+  return mvid_reader_check(reader);
+}
+
+const char*
+mvid_reader_open_buffer(MvidReader *reader, const void *buffer, size_t numBytes)
+{
+  memset(reader, 0, sizeof(MvidReader));
+  reader->fd = -1;
+
+  if (numBytes < sizeof(MVFileHeader)) {
+    return "file is smaller than the header";
+  }
+
+  reader->mappedPtr = (char *) buffer;
+  reader->mappedNumBytes = numBytes;
+
+  return mvid_reader_check(reader);
+}
+
+static
+const char*
+mvid_reader_check(MvidReader *reader)
+{
+  char *mappedPtr = reader->mappedPtr;
+
+  MVFileHeader *header = (MVFileHeader*) mappedPtr;
+  reader->header = header;
+  reader->framesPtr = mappedPtr + sizeof(MVFileHeader);
+
+  if (header->magic != MV_FILE_MAGIC) {
+    return "invalid magic number";
+  }
+
+  if (header->bpp != 16 && header->bpp != 24 && header->bpp != 32) {
+    return "invalid bpp";
+  }
+
+  if (maxvid_file_validate_header(header, reader->mappedNumBytes) != 0) {
+    return "invalid header or frame table is larger than the file";
+  }
+
+  // A file written in streaming mode has the frame table at the end, the
+  // trailer is copied since the file size is not known to be word aligned.
+
+  uint64_t framesOffset = sizeof(MVFileHeader);
+
+  if (maxvid_file_is_frames_at_end(header)) {
+    MVFileTrailer trailer;
+    memcpy(&trailer, mappedPtr + reader->mappedNumBytes - sizeof(MVFileTrailer), sizeof(MVFileTrailer));
+    if (maxvid_file_validate_trailer(header, &trailer, reader->mappedNumBytes) != 0) {
+      return "invalid trailer or frame table is not at the end of the file";
+    }
+    framesOffset = trailer.framesOffset;
+    reader->framesPtr = mappedPtr + framesOffset;
+  }
+
+  reader->isV3 = (maxvid_file_version(header) >= MV_FILE_VERSION_THREE);
+
+  // Like CGFrameBuffer, allocate an even number of pixels so that an odd
+  // sized keyframe includes a zero padding pixel. The header check ensures
+  // that the number of bytes fits in 32 bits.
+
+  uint32_t frameBufferNumPixels = header->width * header->height;
+  uint32_t numPixelsToAllocate = frameBufferNumPixels + (frameBufferNumPixels & 0x1);
+  reader->frameBufferNumPixels = frameBufferNumPixels;
+  reader->frameBufferNumBytes = numPixelsToAllocate * ((header->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+
+  if (maxvid_file_validate(header, reader->framesPtr, framesOffset, reader->mappedNumBytes) != 0) {
+    return "frame table entry is invalid or frame data is past the end of the file";
+  }
+
+  return NULL;
+}
+
+void
+mvid_reader_close(MvidReader *reader)
+{
+  if (reader->fullFrameBuffer != NULL) {
+    mvid_reader_free_framebuffer(reader, reader->fullFrameBuffer);
+    reader->fullFrameBuffer = NULL;
+  }
+
+  // A buffer passed to mvid_reader_open_buffer() is owned by the caller
+
+  if (reader->mappedPtr && reader->fd != -1) {
+    munmap(reader->mappedPtr, reader->mappedNumBytes);
+  }
+  reader->mappedPtr = NULL;
+  if (reader->fd != -1) {
+    close(reader->fd);
+    reader->fd = -1;
+  }
+}
+
+void
+mvid_reader_frame(MvidReader *reader, uint32_t frameIndex, MvidReaderFrame *frame)
+{
+  if (reader->isV3) {
+    MVV3Frame *mvFrame = maxvid_v3_file_frame(reader->framesPtr, frameIndex);
+    frame->offset = maxvid_v3_frame_offset(mvFrame);
+    frame->length = maxvid_v3_frame_length(mvFrame);
+    frame->adler = mvFrame->adler;
+    frame->isKeyframe = maxvid_v3_frame_iskeyframe(mvFrame);
+    frame->isNopframe = maxvid_v3_frame_isnopframe(mvFrame);
+    frame->isCompressed = maxvid_v3_frame_iscompressed(mvFrame);
+    frame->isPalette = maxvid_v3_frame_ispalette(mvFrame);
+  } else {
+    MVFrame *mvFrame = maxvid_file_frame(reader->framesPtr, frameIndex);
+    frame->offset = maxvid_frame_offset(mvFrame);
+    frame->length = maxvid_frame_length(mvFrame);
+    frame->adler = mvFrame->adler;
+    frame->isKeyframe = maxvid_frame_iskeyframe(mvFrame);
+    frame->isNopframe = maxvid_frame_isnopframe(mvFrame);
+    frame->isCompressed = 0;
+    frame->isPalette = 0;
+  }
+}
+
+void*
+mvid_reader_alloc_framebuffer(MvidReader *reader)
+{
+  uint32_t flags = reader->hugePages ? MV_FRAMEBUFFER_HUGEPAGES : 0;
+  return maxvid_framebuffer_alloc_flags(reader->frameBufferNumBytes, flags);
+}
+
+void
+mvid_reader_free_framebuffer(MvidReader *reader, void *frameBuffer)
+{
+  maxvid_framebuffer_free(frameBuffer, reader->frameBufferNumBytes);
+}
+
+uint32_t
+mvid_reader_decode_frame(MvidReader *reader, uint32_t frameIndex, void *frameBuffer)
+{
+  MvidReaderFrame frame;
+  mvid_reader_frame(reader, frameIndex, &frame);
+
+  if (frame.isNopframe) {
+    return 0;
+  }
+
+#if MV_ENABLE_DELTAS
+  if (maxvid_file_is_deltas(reader->header)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+#endif // MV_ENABLE_DELTAS
+
+  if (frame.isCompressed) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  const char *inputPtr = reader->mappedPtr + frame.offset;
+
+  if (frame.isPalette) {
+    // A palette keyframe or delta frame is checked as it is decoded
+    return maxvid_palette_decode(frameBuffer, (const uint32_t *) inputPtr, frame.length >> 2, reader->frameBufferNumPixels);
+  }
+
+  if (frame.isKeyframe) {
+    // Map the keyframe pages copy on write, the pages a delta frame does not
+    // write to are never copied. Falls back to a copy if the pages can't be
+    // mapped, a large keyframe is copied around the cache.
+
+    if (reader->mapKeyframes && (frame.length == reader->frameBufferNumBytes) &&
+        (maxvid_framebuffer_map(frameBuffer, reader->frameBufferNumBytes, reader->fd,
+                                frame.offset, reader->mappedNumBytes) == 0)) {
+      return 0;
+    }
+
+    maxvid_blit_copy(frameBuffer, inputPtr, frame.length);
+    return 0;
+  }
+
+  const uint32_t *inputBuffer32 = (const uint32_t *) inputPtr;
+  const uint32_t inputBuffer32NumWords = frame.length >> 2;
+
+  if (reader->header->bpp == 16) {
+    return maxvid_decode_c4_sample16_validated(frameBuffer, inputBuffer32, inputBuffer32NumWords, reader->frameBufferNumPixels);
+  } else {
+    return maxvid_decode_c4_sample32_validated(frameBuffer, inputBuffer32, inputBuffer32NumWords, reader->frameBufferNumPixels);
+  }
+}
+
+// A palette delta frame is applied over the full size pixels of the previous
+// frame and the frames between palette frames can be c4 delta frames, so
+// every frame of a file with palette frames is decoded into a full size
+// framebuffer owned by the reader before it is scaled or cropped.
+
+static
+uint32_t
+mvid_reader_decode_frame_full(MvidReader *reader, uint32_t frameIndex)
+{
+  if (reader->fullFrameBuffer == NULL) {
+    reader->fullFrameBuffer = mvid_reader_alloc_framebuffer(reader);
+    if (reader->fullFrameBuffer == NULL) {
+      return MV_ERROR_CODE_OUT_OF_MEMORY;
+    }
+  }
+
+  return mvid_reader_decode_frame(reader, frameIndex, reader->fullFrameBuffer);
+}
+
+uint32_t
+mvid_reader_decode_frame_scaled(MvidReader *reader, uint32_t frameIndex, MVScale *scale, void *scaledFrameBuffer)
+{
+  MvidReaderFrame frame;
+  mvid_reader_frame(reader, frameIndex, &frame);
+
+  if (frame.isNopframe) {
+    return 0;
+  }
+
+#if MV_ENABLE_DELTAS
+  if (maxvid_file_is_deltas(reader->header)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+#endif // MV_ENABLE_DELTAS
+
+  if (frame.isCompressed) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  if (maxvid_file_is_palette(reader->header)) {
+    uint32_t status = mvid_reader_decode_frame_full(reader, frameIndex);
+    if (status == 0) {
+      maxvid_scale_keyframe(scale, scaledFrameBuffer, reader->fullFrameBuffer);
+    }
+    return status;
+  }
+
+  const char *inputPtr = reader->mappedPtr + frame.offset;
+
+  if (frame.isKeyframe) {
+    // The frame table check ensures that the keyframe holds every pixel
+    maxvid_scale_keyframe(scale, scaledFrameBuffer, inputPtr);
+    return 0;
+  }
+
+  return maxvid_decode_c4_scaled(scale, scaledFrameBuffer, (const uint32_t *) inputPtr, frame.length >> 2);
+}
+
+uint32_t
+mvid_reader_decode_frame_cropped(MvidReader *reader, uint32_t frameIndex, const MVCrop *crop, void *cropFrameBuffer)
+{
+  MvidReaderFrame frame;
+  mvid_reader_frame(reader, frameIndex, &frame);
+
+  if (frame.isNopframe) {
+    return 0;
+  }
+
+#if MV_ENABLE_DELTAS
+  if (maxvid_file_is_deltas(reader->header)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+#endif // MV_ENABLE_DELTAS
+
+  if (frame.isCompressed) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  if (maxvid_file_is_palette(reader->header)) {
+    uint32_t status = mvid_reader_decode_frame_full(reader, frameIndex);
+    if (status == 0) {
+      maxvid_crop_keyframe(crop, cropFrameBuffer, reader->fullFrameBuffer);
+    }
+    return status;
+  }
+
+  const char *inputPtr = reader->mappedPtr + frame.offset;
+
+  if (frame.isKeyframe) {
+    maxvid_crop_keyframe(crop, cropFrameBuffer, inputPtr);
+    return 0;
+  }
+
+  return maxvid_decode_c4_cropped(crop, cropFrameBuffer, (const uint32_t *) inputPtr, frame.length >> 2);
+}
+
+uint32_t
+mvid_reader_decode_frame_to32(MvidReader *reader, uint32_t frameIndex, uint32_t *frameBuffer32)
+{
+  MvidReaderFrame frame;
+  mvid_reader_frame(reader, frameIndex, &frame);
+
+  if (reader->header->bpp != 16) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  if (frame.isNopframe) {
+    return 0;
+  }
+
+#if MV_ENABLE_DELTAS
+  if (maxvid_file_is_deltas(reader->header)) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+#endif // MV_ENABLE_DELTAS
+
+  if (frame.isCompressed) {
+    return MV_ERROR_CODE_INVALID_INPUT;
+  }
+
+  const char *inputPtr = reader->mappedPtr + frame.offset;
+  const uint32_t frameBufferSize = reader->header->width * reader->header->height;
+
+  if (frame.isKeyframe) {
+    maxvid_convert_555_to_8888(frameBuffer32, (const uint16_t *) inputPtr, frameBufferSize);
+    return 0;
+  }
+
+  return maxvid_decode_c4_sample16_to32(frameBuffer32, (const uint32_t *) inputPtr, frame.length >> 2, frameBufferSize);
+}
+
+uint32_t
+mvid_reader_check_adler(MvidReader *reader, uint32_t frameIndex, void *frameBuffer)
+{
+  MvidReaderFrame frame;
+  mvid_reader_frame(reader, frameIndex, &frame);
+
+  if (frame.isNopframe || frame.adler == 0) {
+    return 1;
+  }
+
+  // File rev 0 did not include zero padding pixels in a delta frame checksum
+
+  uint32_t numBytes = reader->frameBufferNumBytes;
+
+  if (maxvid_file_version(reader->header) == MV_FILE_VERSION_ZERO && !frame.isKeyframe) {
+    numBytes = reader->frameBufferNumPixels * ((reader->header->bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+  }
+
+  uint32_t adler = maxvid_adler32(0, (unsigned char *)frameBuffer, numBytes);
+  return (adler == frame.adler);
+}
@@ -0,0 +1,136 @@
+// mvid_reader module
+//
+//  License terms defined in License.txt.
+//
+// This module implements the file access and frame decode logic shared by the
+// command line tools. A .mvid file is memory mapped read only and each frame
+// can be decoded into a page aligned framebuffer. The file is validated when
+// opened and each delta frame is decoded with the bounds checked decoder, so
+// a corrupt or hostile file is reported as an error. When the file is opened
+// by path, a keyframe is mapped copy on write into the framebuffer instead of
+// being copied, see maxvid_framebuffer.h. A palette frame is expanded into
+// the framebuffer, see maxvid_palette.h. Files with compressed v3
+// keyframes or files written with the -deltas option depend on Apple only APIs
+// and can't be decoded here.
+
+#ifndef MVID_READER_H
+#define MVID_READER_H
+
+#include "maxvid_validate.h"
+
+#include "maxvid_framebuffer.h"
+
+#include "maxvid_scale.h"
+
+#include "maxvid_crop.h"
+
+#include "maxvid_convert.h"
+
+#include "maxvid_palette.h"
+
+#include "maxvid_blit.h"
+
+// Version independent view of an entry in the frame table
+
+typedef struct {
+  uint64_t offset;
+  uint32_t length;
+  uint32_t adler;
+  uint32_t isKeyframe;
+  uint32_t isNopframe;
+  uint32_t isCompressed;
+  uint32_t isPalette;
+} MvidReaderFrame;
+
+typedef struct {
+  int fd;
+  char *mappedPtr;
+  size_t mappedNumBytes;
+  MVFileHeader *header;
+  void *framesPtr;
+  uint32_t isV3;
+  uint32_t frameBufferNumPixels;
+  uint32_t frameBufferNumBytes;
+  uint32_t mapKeyframes;
+  uint32_t hugePages;
+  void *fullFrameBuffer;
+} MvidReader;
+
+// Open and map the file, then check that the header and frame table are
+// consistent with the file size. Returns NULL on success, otherwise a
+// string that describes the problem. Keyframes are mapped into the
+// framebuffer unless mapKeyframes is set to zero after opening. Set
+// hugePages after opening to allocate framebuffers with huge pages.
+
+const char*
+mvid_reader_open(MvidReader *reader, const char *path);
+
+// Same checks as mvid_reader_open() for file data that is already in memory.
+// The buffer is not copied and must stay valid until the reader is closed.
+
+const char*
+mvid_reader_open_buffer(MvidReader *reader, const void *buffer, size_t numBytes);
+
+void
+mvid_reader_close(MvidReader *reader);
+
+void
+mvid_reader_frame(MvidReader *reader, uint32_t frameIndex, MvidReaderFrame *frame);
+
+// Allocate a page aligned framebuffer large enough to hold one frame,
+// the framebuffer is zeroed. Release with mvid_reader_free_framebuffer().
+
+void*
+mvid_reader_alloc_framebuffer(MvidReader *reader);
+
+void
+mvid_reader_free_framebuffer(MvidReader *reader, void *frameBuffer);
+
+// Decode the indicated frame over the contents of frameBuffer. A keyframe
+// replaces all the pixels, a delta frame is applied over the previous frame
+// and a nop frame does nothing. The frameBuffer must have been allocated with
+// mvid_reader_alloc_framebuffer(). Returns 0 on success, otherwise
+// MV_ERROR_CODE_INVALID_INPUT for an invalid frame or a frame that
+// can't be decoded here.
+
+uint32_t
+mvid_reader_decode_frame(MvidReader *reader, uint32_t frameIndex, void *frameBuffer);
+
+// Decode the indicated frame over the contents of a scaled framebuffer, see
+// maxvid_scale.h. The scale must have been setup with the width, height and
+// bpp of the file. A keyframe is scaled straight from the mapped file, so no
+// full size framebuffer is needed. When the file contains palette frames, each
+// frame is decoded into a full size framebuffer owned by the reader and then
+// scaled like a keyframe. Returns 0 on success, otherwise
+// MV_ERROR_CODE_INVALID_INPUT as for mvid_reader_decode_frame() or
+// MV_ERROR_CODE_OUT_OF_MEMORY when that framebuffer can't be allocated.
+
+uint32_t
+mvid_reader_decode_frame_scaled(MvidReader *reader, uint32_t frameIndex, MVScale *scale, void *scaledFrameBuffer);
+
+// Decode the crop rectangle of the indicated frame over the contents of a
+// cropped framebuffer, see maxvid_crop.h. Frames must be decoded in order
+// starting at a keyframe, a keyframe is cropped straight from the mapped file.
+// A file with palette frames is decoded at full size first, as for
+// mvid_reader_decode_frame_scaled(). Returns 0 on success, otherwise
+// MV_ERROR_CODE_INVALID_INPUT as for mvid_reader_decode_frame() or
+// MV_ERROR_CODE_OUT_OF_MEMORY.
+
+uint32_t
+mvid_reader_decode_frame_cropped(MvidReader *reader, uint32_t frameIndex, const MVCrop *crop, void *cropFrameBuffer);
+
+// Decode the indicated frame of a 16 bpp file over the contents of a 32 bpp
+// framebuffer of width x height pixels, see maxvid_convert.h. Returns 0 on
+// success, otherwise MV_ERROR_CODE_INVALID_INPUT as for mvid_reader_decode_frame()
+// or when the file is not 16 bpp.
+
+uint32_t
+mvid_reader_decode_frame_to32(MvidReader *reader, uint32_t frameIndex, uint32_t *frameBuffer32);
+
+// Return non-zero if the adler stored for the frame matches the framebuffer.
+// Frames that do not have an adler always match.
+
+uint32_t
+mvid_reader_check_adler(MvidReader *reader, uint32_t frameIndex, void *frameBuffer);
+
+#endif // MVID_READER_H
@@ -0,0 +1,348 @@
+// mvidbench command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool measures full file decode throughput with the same decode core used
+// on the device. Each thread decodes every frame of the file into its own page
+// aligned framebuffer, the timing of each non-nop frame is recorded so that
+// p50 and p99 per-frame latency can be reported along with frames/s and MB/s.
+// The MB/s value is in terms of framebuffer bytes written by the decoder.
+//
+// In -hot mode (the default) the file pages are touched before timing starts.
+// In -cold mode the file pages are dropped from the page cache before each
+// iteration so that decode time includes reading from disk.
+//
+// Keyframes are mapped copy on write into the framebuffer by default, so a
+// delta frame only copies the pages it writes to. The -copy option copies
+// each keyframe with memcpy() so that the two can be compared.
+//
+// The -hugepages option allocates each framebuffer on a 2 MB bound with
+// transparent huge pages. On Linux the number of data TLB misses is read from
+// the CPU performance counters, if available, along with the number of bytes
+// of anonymous memory backed by huge pages, so that 4 kB pages and huge pages
+// can be compared. Use a V3 file written with isHugePageAligned so that
+// mapped keyframes are also on a 2 MB bound.
+//
+// Build:
+//
+// gcc -std=gnu99 -O2 -pthread -I../Classes/AVAnimator -o mvidbench mvidbench.c mvid_reader.c
+//   ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c
+//   ../Classes/AVAnimator/maxvid_validate.c ../Classes/AVAnimator/maxvid_framebuffer.c
+//   ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_crop.c ../Classes/AVAnimator/maxvid_convert.c
+//   ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c -lm
+//
+// Usage:
+//
+// mvidbench [-threads N] [-iterations N] [-hot | -cold] [-copy] [-hugepages] FILE.mvid
+
+#include "mvid_reader.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#if defined(__linux__)
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+#endif // __linux__
+
+typedef struct {
+  MvidReader *reader;
+  void *frameBuffer;
+  double *latencies;
+  uint32_t numLatencies;
+  uint32_t numFramesDecoded;
+  uint32_t status;
+} BenchThread;
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidbench [-threads N] [-iterations N] [-hot | -cold] [-copy] [-hugepages] FILE.mvid\n");
+}
+
+// Open a counter of data TLB read misses in user mode for this thread and
+// the threads it creates. Returns -1 when counters are not available.
+
+static
+int open_tlb_counter(void) {
+#if defined(__linux__)
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif // __linux__
+}
+
+static
+void enable_tlb_counter(int fd, int enable) {
+#if defined(__linux__)
+  if (fd != -1) {
+    ioctl(fd, enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+  }
+#endif // __linux__
+}
+
+// Number of kB of anonymous memory backed by huge pages, -1 if not known
+
+static
+long anon_huge_pages_kb(void) {
+  long numKB = -1;
+#if defined(__linux__)
+  FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "AnonHugePages: %ld kB", &numKB) == 1) {
+      break;
+    }
+  }
+  fclose(fp);
+#endif // __linux__
+  return numKB;
+}
+
+static inline
+double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (ts.tv_nsec * 1.0e-9);
+}
+
+static
+int compare_doubles(const void *a, const void *b) {
+  double d1 = *((const double*)a);
+  double d2 = *((const double*)b);
+  return (d1 > d2) - (d1 < d2);
+}
+
+// Nearest rank percentile of sorted values
+
+static
+double percentile(const double *sorted, uint32_t count, double pct) {
+  if (count == 0) {
+    return 0.0;
+  }
+  uint32_t rank = (uint32_t) ceil((pct / 100.0) * count);
+  if (rank < 1) {
+    rank = 1;
+  }
+  return sorted[rank - 1];
+}
+
+// Read one byte from each page so that the whole file is in the page cache
+// and mapped before timing starts.
+
+static
+void touch_pages(MvidReader *reader) {
+  volatile uint8_t sum = 0;
+  for (size_t offset = 0; offset < reader->mappedNumBytes; offset += 4096) {
+    sum += ((uint8_t*)reader->mappedPtr)[offset];
+  }
+  (void)sum;
+}
+
+// Drop mapped pages and ask the kernel to evict the file from the page cache
+
+static
+void evict_pages(MvidReader *reader) {
+  (void)madvise(reader->mappedPtr, reader->mappedNumBytes, MADV_DONTNEED);
+#if defined(POSIX_FADV_DONTNEED)
+  (void)posix_fadvise(reader->fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif // POSIX_FADV_DONTNEED
+}
+
+static
+void* bench_thread_main(void *arg) {
+  BenchThread *bt = (BenchThread *) arg;
+  MvidReader *reader = bt->reader;
+  uint32_t numFrames = reader->header->numFrames;
+
+  for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+    MvidReaderFrame frame;
+    mvid_reader_frame(reader, frameIndex, &frame);
+
+    if (frame.isNopframe) {
+      continue;
+    }
+
+    double startTime = now_seconds();
+    uint32_t status = mvid_reader_decode_frame(reader, frameIndex, bt->frameBuffer);
+    double endTime = now_seconds();
+
+    if (status != 0) {
+      bt->status = status;
+      return NULL;
+    }
+
+    bt->latencies[bt->numLatencies++] = endTime - startTime;
+    bt->numFramesDecoded++;
+  }
+
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  int numThreads = 1;
+  int numIterations = 5;
+  int coldCache = 0;
+  int copyKeyframes = 0;
+  int hugePages = 0;
+  char *mvidPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-threads") == 0) && ((i + 1) < argc)) {
+      numThreads = atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "-iterations") == 0) && ((i + 1) < argc)) {
+      numIterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-hot") == 0) {
+      coldCache = 0;
+    } else if (strcmp(argv[i], "-cold") == 0) {
+      coldCache = 1;
+    } else if (strcmp(argv[i], "-copy") == 0) {
+      copyKeyframes = 1;
+    } else if (strcmp(argv[i], "-hugepages") == 0) {
+      hugePages = 1;
+    } else if (mvidPath == NULL) {
+      mvidPath = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (mvidPath == NULL || numThreads < 1 || numIterations < 1) {
+    usage();
+    return 1;
+  }
+
+  MvidReader reader;
+  const char *errStr = mvid_reader_open(&reader, mvidPath);
+  if (errStr != NULL) {
+    fprintf(stderr, "%s: %s\n", mvidPath, errStr);
+    mvid_reader_close(&reader);
+    return 1;
+  }
+
+  if (copyKeyframes) {
+    reader.mapKeyframes = 0;
+  }
+  reader.hugePages = hugePages;
+
+  uint32_t numFrames = reader.header->numFrames;
+
+  BenchThread *threads = calloc(numThreads, sizeof(BenchThread));
+  pthread_t *threadIds = calloc(numThreads, sizeof(pthread_t));
+  assert(threads && threadIds);
+
+  for (int t = 0; t < numThreads; t++) {
+    threads[t].reader = &reader;
+    threads[t].frameBuffer = mvid_reader_alloc_framebuffer(&reader);
+    threads[t].latencies = malloc(sizeof(double) * numFrames * numIterations);
+    assert(threads[t].frameBuffer && threads[t].latencies);
+  }
+
+  if (!coldCache) {
+    touch_pages(&reader);
+  }
+
+  int tlbCounterFd = open_tlb_counter();
+  double wallTime = 0.0;
+
+  for (int iteration = 0; iteration < numIterations; iteration++) {
+    if (coldCache) {
+      evict_pages(&reader);
+    }
+
+    double startTime = now_seconds();
+    enable_tlb_counter(tlbCounterFd, 1);
+
+    for (int t = 0; t < numThreads; t++) {
+      int err = pthread_create(&threadIds[t], NULL, bench_thread_main, &threads[t]);
+      assert(err == 0);
+    }
+    for (int t = 0; t < numThreads; t++) {
+      pthread_join(threadIds[t], NULL);
+    }
+
+    enable_tlb_counter(tlbCounterFd, 0);
+    wallTime += now_seconds() - startTime;
+  }
+
+  // Merge per-thread latency samples
+
+  uint64_t numFramesDecoded = 0;
+  uint32_t numLatencies = 0;
+  for (int t = 0; t < numThreads; t++) {
+    if (threads[t].status != 0) {
+      fprintf(stderr, "%s: decode failed, compressed or -deltas frames are not supported\n", mvidPath);
+      return 1;
+    }
+    numFramesDecoded += threads[t].numFramesDecoded;
+    numLatencies += threads[t].numLatencies;
+  }
+
+  double *latencies = malloc(sizeof(double) * (numLatencies + 1));
+  assert(latencies);
+  uint32_t latencyOffset = 0;
+  for (int t = 0; t < numThreads; t++) {
+    memcpy(&latencies[latencyOffset], threads[t].latencies, sizeof(double) * threads[t].numLatencies);
+    latencyOffset += threads[t].numLatencies;
+  }
+  qsort(latencies, numLatencies, sizeof(double), compare_doubles);
+
+  double numMegabytes = (numFramesDecoded * (double)reader.frameBufferNumBytes) / (1024.0 * 1024.0);
+
+  // The counter includes the threads that have exited
+
+  uint64_t numTlbMisses = 0;
+  if (tlbCounterFd != -1 && read(tlbCounterFd, &numTlbMisses, sizeof(numTlbMisses)) != sizeof(numTlbMisses)) {
+    close(tlbCounterFd);
+    tlbCounterFd = -1;
+  }
+  long hugePagesKB = anon_huge_pages_kb();
+
+  printf("file: %s\n", mvidPath);
+  printf("%u x %u at %u BPP, %u frames\n", reader.header->width, reader.header->height, reader.header->bpp, numFrames);
+  printf("threads: %d, iterations: %d, cache: %s, keyframes: %s, pages: %s\n", numThreads, numIterations,
+         coldCache ? "cold" : "hot", reader.mapKeyframes ? "mapped" : "copied", reader.hugePages ? "huge" : "default");
+  printf("frames decoded: %llu\n", (unsigned long long)numFramesDecoded);
+  printf("wall time: %.4f s\n", wallTime);
+  printf("frames/s: %.1f\n", (wallTime > 0.0) ? (numFramesDecoded / wallTime) : 0.0);
+  printf("MB/s: %.1f\n", (wallTime > 0.0) ? (numMegabytes / wallTime) : 0.0);
+  printf("latency p50: %.2f us\n", percentile(latencies, numLatencies, 50.0) * 1.0e6);
+  printf("latency p99: %.2f us\n", percentile(latencies, numLatencies, 99.0) * 1.0e6);
+  printf("latency max: %.2f us\n", percentile(latencies, numLatencies, 100.0) * 1.0e6);
+  if (tlbCounterFd != -1) {
+    printf("dTLB misses/frame: %.1f\n", (numFramesDecoded > 0) ? ((double)numTlbMisses / numFramesDecoded) : 0.0);
+    close(tlbCounterFd);
+  } else {
+    printf("dTLB misses/frame: not available\n");
+  }
+  if (hugePagesKB >= 0) {
+    printf("anon huge pages: %ld kB\n", hugePagesKB);
+  }
+
+  for (int t = 0; t < numThreads; t++) {
+    mvid_reader_free_framebuffer(&reader, threads[t].frameBuffer);
+    free(threads[t].latencies);
+  }
+  free(threads);
+  free(threadIds);
+  free(latencies);
+
+  mvid_reader_close(&reader);
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+// mvidencodebench command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool runs micro-benchmarks of the encode kernels, it is the Foundation
+// based companion of mvidkernelbench. The generic delta kernels compare a zero
+// previous frame to a synthetic frame where 1, 10, 50, or 100 percent of the
+// pixels change, the c4 kernels then convert the generic codes for that frame.
+// Frames are generated from the same fixed seed as mvidkernelbench, so results
+// from the two tools describe the same frames. The -json, -baseline, and
+// -threshold options work the same way as in mvidkernelbench.
+//
+// Build (Mac OS X):
+//
+// clang -fobjc-arc -O2 -DNDEBUG -I../Classes/AVAnimator -framework Foundation -framework QuartzCore
+//   -o mvidencodebench mvidencodebench.m ../Classes/AVAnimator/maxvid_encode.m
+//   ../Classes/AVAnimator/AVMvidFileWriter.m ../Classes/AVAnimator/maxvid_stats.c
+//   ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c
+//   ../Classes/AVAnimator/maxvid_writer.c ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_palette.c
+//   ../Classes/AVAnimator/maxvid_blit.c
+//
+// Usage:
+//
+// mvidencodebench [-filter STR] [-json OUT.json] [-baseline IN.json] [-threshold PCT]
+
+#import <Foundation/Foundation.h>
+
+#import "maxvid_encode.h"
+
+#include "mvid_bench_util.h"
+
+#define BENCH_WIDTH 480
+#define BENCH_HEIGHT 320
+#define BENCH_SEED 0x2545F491
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  const void *prevFrame;
+  const void *currentFrame;
+  const uint32_t *genericCodes;
+  uint32_t genericCodesNumWords;
+  void *c4Data;
+} EncodeBench;
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidencodebench [-filter STR] [-json OUT.json] [-baseline IN.json] [-threshold PCT]\n");
+}
+
+static
+void bench_encode_generic_delta_pixels16(void *ctx) {
+  EncodeBench *eb = ctx;
+  @autoreleasepool {
+    NSData *codes = maxvid_encode_generic_delta_pixels16(eb->prevFrame, eb->currentFrame, eb->width * eb->height,
+                                                         eb->width, eb->height, NULL, 0);
+    assert(codes);
+    (void)codes;
+  }
+}
+
+static
+void bench_encode_generic_delta_pixels32(void *ctx) {
+  EncodeBench *eb = ctx;
+  @autoreleasepool {
+    NSData *codes = maxvid_encode_generic_delta_pixels32(eb->prevFrame, eb->currentFrame, eb->width * eb->height,
+                                                         eb->width, eb->height, NULL, 0);
+    assert(codes);
+    (void)codes;
+  }
+}
+
+static
+void bench_encode_c4_sample16(void *ctx) {
+  EncodeBench *eb = ctx;
+  NSMutableData *mC4Data = (__bridge NSMutableData *) eb->c4Data;
+  [mC4Data setLength:0];
+  int retcode = maxvid_encode_c4_sample16(eb->genericCodes, eb->genericCodesNumWords, eb->width * eb->height, mC4Data, 0);
+  assert(retcode == 0);
+  (void)retcode;
+}
+
+static
+void bench_encode_c4_sample32(void *ctx) {
+  EncodeBench *eb = ctx;
+  NSMutableData *mC4Data = (__bridge NSMutableData *) eb->c4Data;
+  [mC4Data setLength:0];
+  int retcode = maxvid_encode_c4_sample32(eb->genericCodes, eb->genericCodesNumWords, eb->width * eb->height, mC4Data, 0);
+  assert(retcode == 0);
+  (void)retcode;
+}
+
+static
+void run_encode_benchmarks(MvidBench *bench) {
+  const uint32_t bpps[] = { 16, 32 };
+  const uint32_t numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+
+  for (int b = 0; b < 2; b++) {
+    uint32_t bpp = bpps[b];
+    uint32_t frameBufferNumBytes = numPixels * ((bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+
+    for (int c = 0; c < MVID_BENCH_NUM_CHANGE_PERCENTS; c++) {
+      MvidBenchFrame frame;
+      mvid_bench_frame_init(&frame, BENCH_WIDTH, BENCH_HEIGHT, bpp, mvidBenchChangePercents[c], BENCH_SEED);
+
+      void *prevFrame = mvid_bench_alloc(frameBufferNumBytes);
+      void *currentFrame = mvid_bench_alloc(frameBufferNumBytes);
+
+      for (uint32_t i = 0; i < numPixels; i++) {
+        if (bpp == 16) {
+          ((uint16_t *)currentFrame)[i] = (uint16_t) frame.pixels[i];
+        } else {
+          ((uint32_t *)currentFrame)[i] = frame.pixels[i];
+        }
+      }
+
+      NSData *genericCodes;
+      if (bpp == 16) {
+        genericCodes = maxvid_encode_generic_delta_pixels16(prevFrame, currentFrame, numPixels, BENCH_WIDTH, BENCH_HEIGHT, NULL, 0);
+      } else {
+        genericCodes = maxvid_encode_generic_delta_pixels32(prevFrame, currentFrame, numPixels, BENCH_WIDTH, BENCH_HEIGHT, NULL, 0);
+      }
+      NSMutableData *mC4Data = [NSMutableData dataWithCapacity:frameBufferNumBytes * 2];
+
+      EncodeBench eb;
+      eb.width = BENCH_WIDTH;
+      eb.height = BENCH_HEIGHT;
+      eb.prevFrame = prevFrame;
+      eb.currentFrame = currentFrame;
+      eb.genericCodes = (const uint32_t *) genericCodes.bytes;
+      eb.genericCodesNumWords = (uint32_t) (genericCodes.length / sizeof(uint32_t));
+      eb.c4Data = (__bridge void *) mC4Data;
+
+      char name[MVID_BENCH_NAME_LENGTH];
+
+      snprintf(name, sizeof(name), "encode_generic_delta_pixels%u/change=%u", bpp, mvidBenchChangePercents[c]);
+      mvid_bench_run(bench, name, (bpp == 16) ? bench_encode_generic_delta_pixels16 : bench_encode_generic_delta_pixels32,
+                     &eb, frameBufferNumBytes);
+
+      snprintf(name, sizeof(name), "encode_c4_sample%u/change=%u", bpp, mvidBenchChangePercents[c]);
+      mvid_bench_run(bench, name, (bpp == 16) ? bench_encode_c4_sample16 : bench_encode_c4_sample32,
+                     &eb, frameBufferNumBytes);
+
+      free(prevFrame);
+      free(currentFrame);
+      mvid_bench_frame_free(&frame);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  static MvidBench bench;
+  char *jsonPath = NULL;
+  char *baselinePath = NULL;
+  double thresholdPercent = 10.0;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-filter") == 0) && ((i + 1) < argc)) {
+      bench.filter = argv[++i];
+    } else if ((strcmp(argv[i], "-json") == 0) && ((i + 1) < argc)) {
+      jsonPath = argv[++i];
+    } else if ((strcmp(argv[i], "-baseline") == 0) && ((i + 1) < argc)) {
+      baselinePath = argv[++i];
+    } else if ((strcmp(argv[i], "-threshold") == 0) && ((i + 1) < argc)) {
+      thresholdPercent = atof(argv[++i]);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  @autoreleasepool {
+    printf("%-48s %15s %15s %12s\n", "benchmark", "time/op", "throughput", "iterations");
+
+    run_encode_benchmarks(&bench);
+  }
+
+  if (jsonPath != NULL && mvid_bench_write_json(&bench, jsonPath) != 0) {
+    fprintf(stderr, "could not write \"%s\"\n", jsonPath);
+    return 1;
+  }
+
+  if (baselinePath != NULL) {
+    int numRegressions = mvid_bench_compare_baseline(&bench, baselinePath, thresholdPercent);
+    if (numRegressions != 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+// mvidfuzz_c4 fuzz target
+//
+//  License terms defined in License.txt.
+//
+// libFuzzer target for the validated c4 decoders. The first byte selects
+// 16 or 32 BPP, the next two bytes are the number of pixels in the framebuffer
+// and the rest of the input is taken as c4 code words for one delta frame.
+// The code words and the framebuffer are allocated with their exact size so
+// that AddressSanitizer reports any access past the end of either buffer.
+//
+// Build (libFuzzer):
+//
+// clang -g -O1 -fsanitize=fuzzer,address -pthread -I../Classes/AVAnimator -o mvidfuzz_c4 mvidfuzz_c4.c
+//   ../Classes/AVAnimator/maxvid_decode.c ../Classes/AVAnimator/maxvid_validate.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Build (replay inputs without libFuzzer):
+//
+// gcc -std=gnu99 -g -O1 -fsanitize=address -DMVID_FUZZ_MAIN -pthread -I../Classes/AVAnimator -o mvidfuzz_c4 mvidfuzz_c4.c
+//   ../Classes/AVAnimator/maxvid_decode.c ../Classes/AVAnimator/maxvid_validate.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Usage:
+//
+// mvidfuzz_c4 CORPUS_DIR
+
+#include "maxvid_validate.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 3 + sizeof(uint32_t)) {
+    return 0;
+  }
+
+  const uint32_t bpp = (data[0] & 0x1) ? 32 : 16;
+  const uint32_t frameBufferSize = 1 + ((data[1] << 8) | data[2]);
+  data += 3;
+  size -= 3;
+
+  const uint32_t inputBuffer32NumWords = (uint32_t) (size / sizeof(uint32_t));
+  uint32_t *inputBuffer32 = malloc(inputBuffer32NumWords * sizeof(uint32_t));
+  if (inputBuffer32 == NULL) {
+    return 0;
+  }
+  memcpy(inputBuffer32, data, inputBuffer32NumWords * sizeof(uint32_t));
+
+  // Like CGFrameBuffer, allocate an even number of pixels
+
+  uint32_t numPixelsToAllocate = frameBufferSize + (frameBufferSize & 0x1);
+  size_t frameBufferNumBytes = numPixelsToAllocate * ((bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+
+  void *frameBuffer = NULL;
+  if (posix_memalign(&frameBuffer, MV_PAGESIZE, frameBufferNumBytes) == 0) {
+    memset(frameBuffer, 0, frameBufferNumBytes);
+
+    if (bpp == 16) {
+      (void) maxvid_decode_c4_sample16_validated(frameBuffer, inputBuffer32, inputBuffer32NumWords, frameBufferSize);
+    } else {
+      (void) maxvid_decode_c4_sample32_validated(frameBuffer, inputBuffer32, inputBuffer32NumWords, frameBufferSize);
+    }
+
+    free(frameBuffer);
+  }
+
+  free(inputBuffer32);
+  return 0;
+}
+
+#if defined(MVID_FUZZ_MAIN)
+
+// Run each file named on the command line through the fuzz target
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    FILE *inFile = fopen(argv[i], "rb");
+    if (inFile == NULL) {
+      fprintf(stderr, "could not open \"%s\"\n", argv[i]);
+      return 1;
+    }
+    fseek(inFile, 0L, SEEK_END);
+    long size = ftell(inFile);
+    fseek(inFile, 0L, SEEK_SET);
+    uint8_t *data = malloc(size + 1);
+    if (data == NULL || fread(data, 1, size, inFile) != (size_t)size) {
+      fprintf(stderr, "could not read \"%s\"\n", argv[i]);
+      return 1;
+    }
+    fclose(inFile);
+    LLVMFuzzerTestOneInput(data, (size_t)size);
+    free(data);
+  }
+  return 0;
+}
+
+#endif // MVID_FUZZ_MAIN
@@ -0,0 +1,97 @@
+// mvidfuzz_file fuzz target
+//
+//  License terms defined in License.txt.
+//
+// libFuzzer target that treats the input as a complete .mvid file. The file
+// is checked with the same validation used by the command line tools and then
+// every frame is decoded, so any input that gets past validation must decode
+// without reading or writing outside of the file data or the framebuffer.
+// The input and the framebuffer are allocated with their exact size so that
+// AddressSanitizer reports an access that is even one byte out of bounds.
+//
+// Build (libFuzzer):
+//
+// clang -g -O1 -fsanitize=fuzzer,address -pthread -I../Classes/AVAnimator -o mvidfuzz_file mvidfuzz_file.c mvid_reader.c
+//   ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c ../Classes/AVAnimator/maxvid_validate.c
+//   ../Classes/AVAnimator/maxvid_framebuffer.c ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_crop.c
+//   ../Classes/AVAnimator/maxvid_convert.c ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Build (replay inputs without libFuzzer):
+//
+// gcc -std=gnu99 -g -O1 -fsanitize=address -DMVID_FUZZ_MAIN -pthread -I../Classes/AVAnimator -o mvidfuzz_file mvidfuzz_file.c
+//   mvid_reader.c ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c
+//   ../Classes/AVAnimator/maxvid_validate.c ../Classes/AVAnimator/maxvid_framebuffer.c
+//   ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_crop.c ../Classes/AVAnimator/maxvid_convert.c
+//   ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Usage:
+//
+// mvidfuzz_file CORPUS_DIR (seed the corpus with the .mvid files in Classes/Tests)
+
+#include "mvid_reader.h"
+
+// Skip decoding when the framebuffer would be larger than this, a valid
+// header can describe a framebuffer that is too large for the fuzzer.
+
+#define MVID_FUZZ_MAX_FRAMEBUFFER_NUM_BYTES (16 * 1024 * 1024)
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  void *buffer = malloc(size + 1);
+  if (buffer == NULL) {
+    return 0;
+  }
+  memcpy(buffer, data, size);
+
+  MvidReader reader;
+  const char *errStr = mvid_reader_open_buffer(&reader, buffer, size);
+
+  if (errStr == NULL && reader.frameBufferNumBytes <= MVID_FUZZ_MAX_FRAMEBUFFER_NUM_BYTES) {
+    void *frameBuffer = NULL;
+    if (posix_memalign(&frameBuffer, MV_PAGESIZE, reader.frameBufferNumBytes) == 0) {
+      memset(frameBuffer, 0, reader.frameBufferNumBytes);
+
+      for (uint32_t frameIndex = 0; frameIndex < reader.header->numFrames; frameIndex++) {
+        if (mvid_reader_decode_frame(&reader, frameIndex, frameBuffer) != 0) {
+          break;
+        }
+        (void) mvid_reader_check_adler(&reader, frameIndex, frameBuffer);
+      }
+
+      free(frameBuffer);
+    }
+  }
+
+  mvid_reader_close(&reader);
+  free(buffer);
+  return 0;
+}
+
+#if defined(MVID_FUZZ_MAIN)
+
+// Run each file named on the command line through the fuzz target
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    FILE *inFile = fopen(argv[i], "rb");
+    if (inFile == NULL) {
+      fprintf(stderr, "could not open \"%s\"\n", argv[i]);
+      return 1;
+    }
+    fseek(inFile, 0L, SEEK_END);
+    long size = ftell(inFile);
+    fseek(inFile, 0L, SEEK_SET);
+    uint8_t *data = malloc(size + 1);
+    if (data == NULL || fread(data, 1, size, inFile) != (size_t)size) {
+      fprintf(stderr, "could not read \"%s\"\n", argv[i]);
+      return 1;
+    }
+    fclose(inFile);
+    LLVMFuzzerTestOneInput(data, (size_t)size);
+    free(data);
+  }
+  return 0;
+}
+
+#endif // MVID_FUZZ_MAIN
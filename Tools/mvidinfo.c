@@ -0,0 +1,200 @@
+// mvidinfo command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool prints the header, flags, and frame table of a .mvid file.
+// The layout line shows one character for each frame, K for a keyframe,
+// D for a delta frame, and N for a nop frame, so that the keyframe
+// spacing in a specific asset can be seen at a glance. The sample
+// movies stored as .mvid.7z need to be extracted with 7za first.
+//
+// Build:
+//
+// gcc -std=gnu99 -O2 -pthread -I../Classes/AVAnimator -o mvidinfo mvidinfo.c mvid_reader.c
+//   ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c
+//   ../Classes/AVAnimator/maxvid_validate.c ../Classes/AVAnimator/maxvid_framebuffer.c
+//   ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_crop.c ../Classes/AVAnimator/maxvid_convert.c
+//   ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Usage:
+//
+// mvidinfo [-frames] [-verify] FILE.mvid
+
+#include "mvid_reader.h"
+
+#define LAYOUT_LINE_LENGTH 64
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidinfo [-frames] [-verify] FILE.mvid\n");
+}
+
+static
+char frame_layout_char(MvidReaderFrame *frame) {
+  if (frame->isNopframe) {
+    return 'N';
+  } else if (frame->isKeyframe) {
+    return 'K';
+  } else {
+    return 'D';
+  }
+}
+
+int main(int argc, char **argv) {
+  int printFrames = 0;
+  int verify = 0;
+  char *mvidPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-frames") == 0) {
+      printFrames = 1;
+    } else if (strcmp(argv[i], "-verify") == 0) {
+      verify = 1;
+    } else if (mvidPath == NULL) {
+      mvidPath = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (mvidPath == NULL) {
+    usage();
+    return 1;
+  }
+
+  MvidReader reader;
+  const char *errStr = mvid_reader_open(&reader, mvidPath);
+  if (errStr != NULL) {
+    fprintf(stderr, "%s: %s\n", mvidPath, errStr);
+    mvid_reader_close(&reader);
+    return 1;
+  }
+
+  MVFileHeader *header = reader.header;
+  uint32_t numFrames = header->numFrames;
+
+  uint32_t numKeyframes = 0;
+  uint32_t numDeltaframes = 0;
+  uint32_t numNopframes = 0;
+  uint32_t numCompressed = 0;
+  uint64_t numKeyframeBytes = 0;
+  uint64_t numDeltaframeBytes = 0;
+
+  for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+    MvidReaderFrame frame;
+    mvid_reader_frame(&reader, frameIndex, &frame);
+
+    if (frame.isNopframe) {
+      numNopframes++;
+    } else if (frame.isKeyframe) {
+      numKeyframes++;
+      numKeyframeBytes += frame.length;
+    } else {
+      numDeltaframes++;
+      numDeltaframeBytes += frame.length;
+    }
+    if (frame.isCompressed) {
+      numCompressed++;
+    }
+  }
+
+  printf("file: %s\n", mvidPath);
+  printf("file size: %llu bytes\n", (unsigned long long)reader.mappedNumBytes);
+  printf("version: %d\n", maxvid_file_version(header));
+  printf("flags:");
+  if (maxvid_file_is_all_keyframes(header)) {
+    printf(" ALL_KEYFRAMES");
+  }
+#if MV_ENABLE_DELTAS
+  if (maxvid_file_is_deltas(header)) {
+    printf(" DELTAS");
+  }
+#endif // MV_ENABLE_DELTAS
+  if (maxvid_file_is_frames_at_end(header)) {
+    printf(" FRAMES_AT_END");
+  }
+  if (maxvid_file_is_frame_durations(header)) {
+    printf(" FRAME_DURATIONS");
+  }
+  printf("\n");
+  printf("width x height: %u x %u\n", header->width, header->height);
+  printf("bpp: %u\n", header->bpp);
+  printf("frame duration: %.4f (%.2f FPS)\n", header->frameDuration, 1.0 / header->frameDuration);
+  double *startTimes = malloc(sizeof(double) * (numFrames + 1));
+  if (startTimes == NULL) {
+    fprintf(stderr, "can't allocate frame start times\n");
+    mvid_reader_close(&reader);
+    return 1;
+  }
+  maxvid_file_frame_start_times(header, reader.framesPtr, startTimes);
+  printf("num frames: %u (%.2f seconds)\n", numFrames, startTimes[numFrames]);
+  free(startTimes);
+  printf("framebuffer: %u bytes\n", reader.frameBufferNumBytes);
+  printf("keyframes: %u (%llu bytes)\n", numKeyframes, (unsigned long long)numKeyframeBytes);
+  printf("delta frames: %u (%llu bytes)\n", numDeltaframes, (unsigned long long)numDeltaframeBytes);
+  printf("nop frames: %u\n", numNopframes);
+  if (numCompressed > 0) {
+    printf("compressed frames: %u\n", numCompressed);
+  }
+
+  printf("layout:\n");
+  for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+    MvidReaderFrame frame;
+    mvid_reader_frame(&reader, frameIndex, &frame);
+
+    if ((frameIndex % LAYOUT_LINE_LENGTH) == 0) {
+      printf("  %6u ", frameIndex);
+    }
+    putchar(frame_layout_char(&frame));
+    if (((frameIndex % LAYOUT_LINE_LENGTH) == (LAYOUT_LINE_LENGTH - 1)) || (frameIndex == (numFrames - 1))) {
+      putchar('\n');
+    }
+  }
+
+  if (printFrames) {
+    printf("frames:\n");
+    printf("  %6s %4s %12s %10s %10s\n", "index", "type", "offset", "length", "adler");
+
+    for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+      MvidReaderFrame frame;
+      mvid_reader_frame(&reader, frameIndex, &frame);
+
+      printf("  %6u %4c %12llu %10u 0x%08X%s\n", frameIndex, frame_layout_char(&frame),
+             (unsigned long long)frame.offset, frame.length, frame.adler,
+             frame.isCompressed ? " compressed" : "");
+    }
+  }
+
+  int retcode = 0;
+
+  if (verify) {
+    void *frameBuffer = mvid_reader_alloc_framebuffer(&reader);
+    uint32_t numMismatched = 0;
+
+    for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+      if (mvid_reader_decode_frame(&reader, frameIndex, frameBuffer) != 0) {
+        fprintf(stderr, "frame %u can't be decoded\n", frameIndex);
+        retcode = 1;
+        break;
+      }
+      if (!mvid_reader_check_adler(&reader, frameIndex, frameBuffer)) {
+        fprintf(stderr, "frame %u adler mismatch\n", frameIndex);
+        numMismatched++;
+        retcode = 1;
+      }
+    }
+
+    if (retcode == 0) {
+      printf("verify: all %u frames decoded\n", numFrames);
+    } else {
+      printf("verify: FAILED with %u adler mismatches\n", numMismatched);
+    }
+
+    mvid_reader_free_framebuffer(&reader, frameBuffer);
+  }
+
+  mvid_reader_close(&reader);
+
+  return retcode;
+}
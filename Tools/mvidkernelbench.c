@@ -0,0 +1,1042 @@
+// mvidkernelbench command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool runs micro-benchmarks of the individual decode kernels so that
+// a change to one kernel shows up as a number instead of getting lost in
+// the noise of a full file decode. Each c4 and RLE decode kernel is run over
+// synthetic frames where 1, 10, 50, or 100 percent of the pixels change,
+// the frames are generated from a fixed seed and every decode is checked
+// against the expected pixels once before timing. The c4 kernels are also
+// measured with validation of the codes, see maxvid_validate.h, and when only
+// a centered crop rectangle is decoded, see maxvid_crop.h. The 16 bpp c4
+// kernel is also measured when it writes 32 bpp pixels, see maxvid_convert.h.
+// The palette decode kernel is run over the same frames reduced to 64 colors,
+// see maxvid_palette.h. A full screen color wipe is compared to memset, see
+// maxvid_blit.h. A large keyframe copy is measured with cached and with
+// non-temporal stores, alone and composed with the decode of 8 small clips
+// whose framebuffers and codes should stay in the cache.
+// The adler32, premultiply, 16 <-> 32 bpp conversion, YUV to BGRA conversion and
+// alpha join kernels run over a whole frame of pixels, see maxvid_yuv.h and
+// maxvid_alpha.h.
+//
+// With -json the results are written as a baseline, with -baseline the results
+// are compared to a previous baseline and the exit status is non-zero when any
+// benchmark is slower than the baseline by more than the -threshold percent.
+// With -file, a full decode of every frame in a real .mvid is also measured.
+//
+// The encode kernels depend on Foundation, see mvidencodebench.m.
+//
+// Build:
+//
+// gcc -std=gnu99 -O2 -DNDEBUG -pthread -I../Classes/AVAnimator -o mvidkernelbench mvidkernelbench.c mvid_reader.c
+//   ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c ../Classes/AVAnimator/maxvid_validate.c
+//   ../Classes/AVAnimator/maxvid_framebuffer.c ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_crop.c
+//   ../Classes/AVAnimator/maxvid_convert.c ../Classes/AVAnimator/maxvid_yuv.c ../Classes/AVAnimator/maxvid_alpha.c
+//   ../Classes/AVAnimator/movdata.c ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c -lm
+//
+// Usage:
+//
+// mvidkernelbench [-filter STR] [-json OUT.json] [-baseline IN.json] [-threshold PCT] [-file FILE.mvid]
+
+#include "mvid_reader.h"
+#include "mvid_bench_util.h"
+
+#include "movdata.h"
+
+#include "maxvid_yuv.h"
+
+#include "maxvid_alpha.h"
+
+#include "maxvid_palette.h"
+
+#define BENCH_WIDTH 480
+#define BENCH_HEIGHT 320
+#define BENCH_SEED 0x2545F491
+
+// movdata.c does not declare the exported decode functions in a header
+
+void exported_decode_rle_sample16(void *sampleBuffer, uint32_t sampleBufferSize, uint32_t isKeyFrame,
+                                  void *frameBuffer, uint32_t frameBufferWidth, uint32_t frameBufferHeight);
+
+void exported_decode_rle_sample24(void *sampleBuffer, uint32_t sampleBufferSize, uint32_t isKeyFrame,
+                                  void *frameBuffer, uint32_t frameBufferWidth, uint32_t frameBufferHeight);
+
+void exported_decode_rle_sample32(void *sampleBuffer, uint32_t sampleBufferSize, uint32_t isKeyFrame,
+                                  void *frameBuffer, uint32_t frameBufferWidth, uint32_t frameBufferHeight);
+
+typedef struct {
+  MvidBenchFrame *frame;
+  void *frameBuffer;
+  uint32_t frameBufferNumBytes;
+  void *input;
+  uint32_t inputNumBytes;
+  uint32_t isKeyframe;
+  MvidReader *reader;
+  MVCrop *crop;
+  void *output;
+  MVYUVCoefficients *yuv;
+  uint32_t *prevPixels;
+} KernelBench;
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidkernelbench [-filter STR] [-json OUT.json] [-baseline IN.json] [-threshold PCT] [-file FILE.mvid]\n");
+}
+
+// Emit 16 BPP c4 codes for a synthetic frame. The first COPY pixel is stored
+// in the code word when the framebuffer is half word aligned or when only one
+// pixel is copied, the rest follow packed two to a word.
+
+static
+uint32_t synth_emit_c4_sample16(MvidBenchFrame *frame, uint32_t *outWords) {
+  uint32_t *outPtr = outWords;
+
+  for (uint32_t r = 0; r < frame->numRuns; r++) {
+    MvidBenchRun *run = &frame->runs[r];
+    const uint32_t *pixels = &frame->pixels[run->offset];
+
+    if (run->op == SKIP) {
+      *outPtr++ = run->num;
+    } else if (run->op == DUP) {
+      *outPtr++ = (DUP << 30) | (run->num << 16) | pixels[0];
+    } else {
+      uint32_t numLeft = run->num;
+      uint32_t firstPixel = 0;
+      if ((run->offset & 0x1) || (run->num == 1)) {
+        firstPixel = *pixels++;
+        numLeft--;
+      }
+      *outPtr++ = (COPY << 30) | (run->num << 16) | firstPixel;
+      for ( ; numLeft >= 2; numLeft -= 2, pixels += 2) {
+        *outPtr++ = (pixels[1] << 16) | pixels[0];
+      }
+      if (numLeft == 1) {
+        *outPtr++ = pixels[0];
+      }
+    }
+  }
+
+  *outPtr++ = (DONE << 30);
+  return (uint32_t)(outPtr - outWords);
+}
+
+// Emit 32 BPP c4 codes for a synthetic frame. A small SKIP that follows
+// a DUP or COPY is folded into the skipAfter field of that code.
+
+static
+uint32_t synth_emit_c4_sample32(MvidBenchFrame *frame, uint32_t *outWords) {
+  uint32_t *outPtr = outWords;
+
+  for (uint32_t r = 0; r < frame->numRuns; r++) {
+    MvidBenchRun *run = &frame->runs[r];
+    const uint32_t *pixels = &frame->pixels[run->offset];
+
+    if (run->op == SKIP) {
+      *outPtr++ = (run->num << 10) | (SKIP << 8);
+      continue;
+    }
+
+    uint32_t skipAfter = 0;
+    MvidBenchRun *nextRun = ((r + 1) < frame->numRuns) ? &frame->runs[r + 1] : NULL;
+    if (nextRun != NULL && nextRun->op == SKIP && nextRun->num <= MV_MAX_8_BITS) {
+      skipAfter = nextRun->num;
+      r++;
+    }
+
+    *outPtr++ = (run->num << 10) | (run->op << 8) | skipAfter;
+
+    if (run->op == DUP) {
+      *outPtr++ = pixels[0];
+    } else {
+      memcpy(outPtr, pixels, run->num * sizeof(uint32_t));
+      outPtr += run->num;
+    }
+  }
+
+  // The decoder reads one word past DONE, emit the zero padding word like the encoder
+
+  *outPtr++ = (DONE << 8);
+  *outPtr++ = 0;
+  return (uint32_t)(outPtr - outWords);
+}
+
+// Emit a Quicktime Animation (RLE) sample for a synthetic frame. A frame
+// where every pixel changes is emitted as a keyframe, otherwise as a delta
+// that updates every line. Runs are split at line boundaries, a SKIP is
+// emitted as skip codes and DUP and COPY runs are emitted as RLE codes of
+// at most 127 pixels.
+
+static inline
+uint8_t* rle_emit_pixel(uint8_t *outPtr, uint32_t bpp, uint32_t pixel) {
+  if (bpp == 16) {
+    *outPtr++ = (uint8_t)(pixel >> 8);
+    *outPtr++ = (uint8_t)pixel;
+  } else if (bpp == 24) {
+    *outPtr++ = (uint8_t)(pixel >> 16);
+    *outPtr++ = (uint8_t)(pixel >> 8);
+    *outPtr++ = (uint8_t)pixel;
+  } else {
+    *outPtr++ = (uint8_t)(pixel >> 24);
+    *outPtr++ = (uint8_t)(pixel >> 16);
+    *outPtr++ = (uint8_t)(pixel >> 8);
+    *outPtr++ = (uint8_t)pixel;
+  }
+  return outPtr;
+}
+
+static
+uint8_t* rle_emit_skip(uint8_t *outPtr, uint32_t numToSkip, uint32_t isLineStart) {
+  if (!isLineStart) {
+    if (numToSkip == 0) {
+      return outPtr;
+    }
+    *outPtr++ = 0;
+  }
+  while (1) {
+    uint32_t numThisCode = (numToSkip > 254) ? 254 : numToSkip;
+    *outPtr++ = (uint8_t)(numThisCode + 1);
+    numToSkip -= numThisCode;
+    if (numToSkip == 0) {
+      break;
+    }
+    *outPtr++ = 0;
+  }
+  return outPtr;
+}
+
+static
+uint32_t synth_emit_rle_sample(MvidBenchFrame *frame, uint8_t *outBytes, uint32_t isKeyframe) {
+  uint8_t *outPtr = outBytes + 4;
+  const uint32_t bpp = frame->bpp;
+
+  if (isKeyframe) {
+    *outPtr++ = 0;
+    *outPtr++ = 0;
+  } else {
+    uint8_t deltaHeader[10] = { 0x00, 0x08, 0, 0, 0, 0, (uint8_t)(frame->height >> 8), (uint8_t)frame->height, 0, 0 };
+    memcpy(outPtr, deltaHeader, sizeof(deltaHeader));
+    outPtr += sizeof(deltaHeader);
+  }
+
+  uint32_t runIndex = 0;
+  uint32_t runUsed = 0;
+
+  for (uint32_t y = 0; y < frame->height; y++) {
+    uint32_t pendingSkip = 0;
+    uint32_t isLineStart = 1;
+
+    for (uint32_t x = 0; x < frame->width; ) {
+      MvidBenchRun *run = &frame->runs[runIndex];
+      uint32_t num = run->num - runUsed;
+      if (num > (frame->width - x)) {
+        num = frame->width - x;
+      }
+      const uint32_t *pixels = &frame->pixels[run->offset + runUsed];
+
+      if (run->op == SKIP) {
+        pendingSkip += num;
+      } else {
+        outPtr = rle_emit_skip(outPtr, pendingSkip, isLineStart);
+        pendingSkip = 0;
+        isLineStart = 0;
+
+        for (uint32_t numLeft = num; numLeft > 0; ) {
+          uint32_t numThisCode = (numLeft > 127) ? 127 : numLeft;
+          if (run->op == DUP && numThisCode > 1) {
+            *outPtr++ = (uint8_t)(-((int8_t)numThisCode));
+            outPtr = rle_emit_pixel(outPtr, bpp, pixels[0]);
+          } else {
+            *outPtr++ = (uint8_t)numThisCode;
+            for (uint32_t i = 0; i < numThisCode; i++) {
+              outPtr = rle_emit_pixel(outPtr, bpp, pixels[i]);
+            }
+          }
+          pixels += numThisCode;
+          numLeft -= numThisCode;
+        }
+      }
+
+      x += num;
+      runUsed += num;
+      if (runUsed == run->num) {
+        runIndex++;
+        runUsed = 0;
+      }
+    }
+
+    if (isLineStart) {
+      *outPtr++ = 1;
+    }
+    *outPtr++ = 0xFF;
+  }
+
+  *outPtr++ = 0;
+
+  uint32_t numBytes = (uint32_t)(outPtr - outBytes);
+  outBytes[0] = (uint8_t)(numBytes >> 24);
+  outBytes[1] = (uint8_t)(numBytes >> 16);
+  outBytes[2] = (uint8_t)(numBytes >> 8);
+  outBytes[3] = (uint8_t)numBytes;
+  return numBytes;
+}
+
+// Compare the decoded framebuffer to the expected pixels, the RLE decoder
+// premultiplies 32 BPP pixels as they are read.
+
+static
+int synth_frame_check(MvidBenchFrame *frame, const void *frameBuffer, uint32_t isPremultiplied, const char *name) {
+  uint32_t numPixels = frame->width * frame->height;
+  for (uint32_t i = 0; i < numPixels; i++) {
+    uint32_t expected = frame->pixels[i];
+    uint32_t actual;
+    if (frame->bpp == 16) {
+      actual = ((const uint16_t *)frameBuffer)[i];
+    } else {
+      actual = ((const uint32_t *)frameBuffer)[i];
+      if (isPremultiplied) {
+        expected = premultiply_bgra_inline((expected >> 16) & 0xFF, (expected >> 8) & 0xFF, expected & 0xFF, expected >> 24);
+      }
+    }
+    if (actual != expected) {
+      fprintf(stderr, "%s: decoded pixel %u is 0x%X, expected 0x%X\n", name, i, actual, expected);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Compare the cropped framebuffer to the expected pixels inside the crop rectangle
+
+static
+int synth_crop_check(MvidBenchFrame *frame, const MVCrop *crop, const void *cropFrameBuffer, const char *name) {
+  for (uint32_t y = 0; y < crop->cropHeight; y++) {
+    for (uint32_t x = 0; x < crop->cropWidth; x++) {
+      uint32_t expected = frame->pixels[((crop->cropY + y) * frame->width) + crop->cropX + x];
+      uint32_t i = (y * crop->cropWidth) + x;
+      uint32_t actual = (frame->bpp == 16) ? ((const uint16_t *)cropFrameBuffer)[i] : ((const uint32_t *)cropFrameBuffer)[i];
+      if (actual != expected) {
+        fprintf(stderr, "%s: cropped pixel (%u, %u) is 0x%X, expected 0x%X\n", name, x, y, actual, expected);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Benchmark functions, each call decodes or processes one frame
+
+static
+void bench_decode_c4_sample16(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_decode_c4_sample16(kb->frameBuffer, kb->input, kb->inputNumBytes >> 2, kb->frame->width * kb->frame->height);
+}
+
+static
+void bench_decode_c4_sample32(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_decode_c4_sample32(kb->frameBuffer, kb->input, kb->inputNumBytes >> 2, kb->frame->width * kb->frame->height);
+}
+
+static
+void bench_decode_c4_sample16_validated(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_decode_c4_sample16_validated(kb->frameBuffer, kb->input, kb->inputNumBytes >> 2, kb->frame->width * kb->frame->height);
+}
+
+static
+void bench_decode_c4_sample32_validated(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_decode_c4_sample32_validated(kb->frameBuffer, kb->input, kb->inputNumBytes >> 2, kb->frame->width * kb->frame->height);
+}
+
+static
+void bench_decode_c4_cropped(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_decode_c4_cropped(kb->crop, kb->frameBuffer, kb->input, kb->inputNumBytes >> 2);
+}
+
+static
+void bench_decode_c4_sample16_to32(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_decode_c4_sample16_to32(kb->output, kb->input, kb->inputNumBytes >> 2, kb->frame->width * kb->frame->height);
+}
+
+static
+void bench_decode_rle_sample16(void *ctx) {
+  KernelBench *kb = ctx;
+  exported_decode_rle_sample16(kb->input, kb->inputNumBytes, kb->isKeyframe, kb->frameBuffer, kb->frame->width, kb->frame->height);
+}
+
+static
+void bench_decode_rle_sample24(void *ctx) {
+  KernelBench *kb = ctx;
+  exported_decode_rle_sample24(kb->input, kb->inputNumBytes, kb->isKeyframe, kb->frameBuffer, kb->frame->width, kb->frame->height);
+}
+
+static
+void bench_decode_rle_sample32(void *ctx) {
+  KernelBench *kb = ctx;
+  exported_decode_rle_sample32(kb->input, kb->inputNumBytes, kb->isKeyframe, kb->frameBuffer, kb->frame->width, kb->frame->height);
+}
+
+static
+void bench_adler32(void *ctx) {
+  KernelBench *kb = ctx;
+  volatile uint32_t adler = maxvid_adler32(0, kb->input, kb->inputNumBytes);
+  (void)adler;
+}
+
+static
+void bench_premultiply(void *ctx) {
+  KernelBench *kb = ctx;
+  const uint32_t *inPixels = kb->input;
+  uint32_t *outPixels = kb->frameBuffer;
+  uint32_t numPixels = kb->inputNumBytes >> 2;
+  for (uint32_t i = 0; i < numPixels; i++) {
+    uint32_t pixel = inPixels[i];
+    outPixels[i] = premultiply_bgra_inline((pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF, pixel >> 24);
+  }
+}
+
+// The input words are not valid premultiplied pixels, a color component can
+// be larger than alpha, so unpremultiply reads the premultiplied pixels in
+// the output buffer.
+
+static
+void bench_unpremultiply(void *ctx) {
+  KernelBench *kb = ctx;
+  const uint32_t *inPixels = kb->output;
+  uint32_t *outPixels = kb->frameBuffer;
+  uint32_t numPixels = kb->inputNumBytes >> 2;
+  for (uint32_t i = 0; i < numPixels; i++) {
+    outPixels[i] = unpremultiply_bgra(inPixels[i]);
+  }
+}
+
+static
+void bench_convert_555_to_8888(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_convert_555_to_8888(kb->frameBuffer, kb->input, BENCH_WIDTH * BENCH_HEIGHT);
+}
+
+static
+void bench_convert_8888_to_555(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_convert_8888_to_555(kb->output, kb->input, BENCH_WIDTH, BENCH_HEIGHT, 0);
+}
+
+static
+void bench_convert_8888_to_555_dither(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_convert_8888_to_555(kb->output, kb->input, BENCH_WIDTH, BENCH_HEIGHT, 1);
+}
+
+// The YUV planes are laid out one after another in the input, the Y plane,
+// then the UV plane or the U and V planes, then the alpha plane.
+
+static
+void bench_yuv_nv12_to_bgra(void *ctx) {
+  KernelBench *kb = ctx;
+  const uint8_t *yPlane = kb->input;
+  maxvid_yuv_nv12_to_bgra(kb->yuv, kb->frameBuffer, BENCH_WIDTH * sizeof(uint32_t),
+                          yPlane, BENCH_WIDTH, yPlane + (BENCH_WIDTH * BENCH_HEIGHT), BENCH_WIDTH,
+                          NULL, 0, BENCH_WIDTH, BENCH_HEIGHT);
+}
+
+static
+void bench_yuv_nv12_to_bgra_alpha(void *ctx) {
+  KernelBench *kb = ctx;
+  const uint8_t *yPlane = kb->input;
+  const uint32_t numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+  maxvid_yuv_nv12_to_bgra(kb->yuv, kb->frameBuffer, BENCH_WIDTH * sizeof(uint32_t),
+                          yPlane, BENCH_WIDTH, yPlane + numPixels, BENCH_WIDTH,
+                          yPlane + numPixels + (numPixels / 2), BENCH_WIDTH, BENCH_WIDTH, BENCH_HEIGHT);
+}
+
+static
+void bench_yuv_i420_to_bgra(void *ctx) {
+  KernelBench *kb = ctx;
+  const uint8_t *yPlane = kb->input;
+  const uint32_t numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+  maxvid_yuv_i420_to_bgra(kb->yuv, kb->frameBuffer, BENCH_WIDTH * sizeof(uint32_t),
+                          yPlane, BENCH_WIDTH, yPlane + numPixels, yPlane + numPixels + (numPixels / 4), BENCH_WIDTH / 2,
+                          NULL, 0, BENCH_WIDTH, BENCH_HEIGHT);
+}
+
+// The output is the input RGB pixels joined with the alpha pixels in output,
+// with prevPixels set the output is also compared to the previous frame.
+
+static
+void bench_alpha_join_pixels(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_alpha_join_pixels(kb->frameBuffer, kb->input, kb->output, kb->prevPixels, BENCH_WIDTH * BENCH_HEIGHT);
+}
+
+static
+void bench_decode_palette(void *ctx) {
+  KernelBench *kb = ctx;
+  maxvid_palette_decode(kb->frameBuffer, kb->input, kb->inputNumBytes >> 2, kb->frame->width * kb->frame->height);
+}
+
+static
+void bench_memset(void *ctx) {
+  KernelBench *kb = ctx;
+  memset(kb->frameBuffer, 0x80, kb->frameBufferNumBytes);
+}
+
+typedef struct {
+  KernelBench *clips;
+  uint32_t numClips;
+  void *keyframe;
+  void *frameBuffer;
+  uint32_t frameBufferNumBytes;
+} CompositionBench;
+
+static
+void bench_keyframe_copy(void *ctx) {
+  CompositionBench *cb = ctx;
+  maxvid_blit_copy(cb->frameBuffer, cb->keyframe, cb->frameBufferNumBytes);
+}
+
+// Copy the large keyframe, then decode a delta frame of each small clip
+
+static
+void bench_compose_clips(void *ctx) {
+  CompositionBench *cb = ctx;
+  maxvid_blit_copy(cb->frameBuffer, cb->keyframe, cb->frameBufferNumBytes);
+  for (uint32_t i = 0; i < cb->numClips; i++) {
+    bench_decode_c4_sample32(&cb->clips[i]);
+  }
+}
+
+static
+void bench_decode_file(void *ctx) {
+  KernelBench *kb = ctx;
+  for (uint32_t frameIndex = 0; frameIndex < kb->reader->header->numFrames; frameIndex++) {
+    mvid_reader_decode_frame(kb->reader, frameIndex, kb->frameBuffer);
+  }
+}
+
+// Generate the c4 input for each bpp and change ratio, check the decode
+// result, then run the benchmark.
+
+static
+int run_c4_benchmarks(MvidBench *bench) {
+  const uint32_t bpps[] = { 16, 32 };
+
+  for (int b = 0; b < 2; b++) {
+    uint32_t bpp = bpps[b];
+
+    for (uint32_t c = 0; c < MVID_BENCH_NUM_CHANGE_PERCENTS; c++) {
+      char name[MVID_BENCH_NAME_LENGTH];
+      snprintf(name, sizeof(name), "decode_c4_sample%u/change=%u", bpp, mvidBenchChangePercents[c]);
+
+      MvidBenchFrame frame;
+      mvid_bench_frame_init(&frame, BENCH_WIDTH, BENCH_HEIGHT, bpp, mvidBenchChangePercents[c], BENCH_SEED);
+
+      uint32_t numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+      KernelBench kb;
+      memset(&kb, 0, sizeof(kb));
+      kb.frame = &frame;
+      kb.frameBufferNumBytes = numPixels * ((bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+      kb.frameBuffer = mvid_bench_alloc(kb.frameBufferNumBytes);
+      kb.input = mvid_bench_alloc((numPixels * 2 + 1) * sizeof(uint32_t));
+
+      uint32_t numWords;
+      uint32_t status;
+      if (bpp == 16) {
+        numWords = synth_emit_c4_sample16(&frame, kb.input);
+        status = maxvid_decode_c4_sample16_validated(kb.frameBuffer, kb.input, numWords, numPixels);
+      } else {
+        numWords = synth_emit_c4_sample32(&frame, kb.input);
+        status = maxvid_decode_c4_sample32_validated(kb.frameBuffer, kb.input, numWords, numPixels);
+      }
+      kb.inputNumBytes = numWords * sizeof(uint32_t);
+
+      if (status != 0) {
+        fprintf(stderr, "%s: validation failed\n", name);
+        return 1;
+      }
+
+      if (synth_frame_check(&frame, kb.frameBuffer, 0, name) != 0) {
+        return 1;
+      }
+
+      mvid_bench_run(bench, name, (bpp == 16) ? bench_decode_c4_sample16 : bench_decode_c4_sample32, &kb, kb.frameBufferNumBytes);
+
+      // The validated decode should cost less than 10% more than the plain decode
+
+      snprintf(name, sizeof(name), "decode_c4_sample%u_validated/change=%u", bpp, mvidBenchChangePercents[c]);
+      mvid_bench_run(bench, name, (bpp == 16) ? bench_decode_c4_sample16_validated : bench_decode_c4_sample32_validated,
+                     &kb, kb.frameBufferNumBytes);
+
+      // Decode only a centered crop rectangle that is half the width and height,
+      // the codes below the rectangle are not read.
+
+      MVCrop crop;
+      maxvid_crop_init(&crop, BENCH_WIDTH, BENCH_HEIGHT, bpp, BENCH_WIDTH / 4, BENCH_HEIGHT / 4, BENCH_WIDTH / 2, BENCH_HEIGHT / 2);
+      kb.crop = &crop;
+      memset(kb.frameBuffer, 0, kb.frameBufferNumBytes);
+
+      snprintf(name, sizeof(name), "decode_c4_cropped%u/change=%u", bpp, mvidBenchChangePercents[c]);
+      if (maxvid_decode_c4_cropped(&crop, kb.frameBuffer, kb.input, numWords) != 0 ||
+          synth_crop_check(&frame, &crop, kb.frameBuffer, name) != 0) {
+        fprintf(stderr, "%s: cropped decode failed\n", name);
+        return 1;
+      }
+
+      mvid_bench_run(bench, name, bench_decode_c4_cropped, &kb, maxvid_crop_num_bytes(&crop));
+
+      // Decode 16 bpp codes straight into a 32 bpp framebuffer that holds the
+      // expanded zero previous frame, compare to expanding the expected pixels.
+
+      if (bpp == 16) {
+        uint32_t *frameBuffer32 = mvid_bench_alloc(numPixels * sizeof(uint32_t));
+        for (uint32_t i = 0; i < numPixels; i++) {
+          frameBuffer32[i] = maxvid_convert_pixel_555_to_8888(0);
+        }
+        kb.output = frameBuffer32;
+
+        snprintf(name, sizeof(name), "decode_c4_sample16_to32/change=%u", mvidBenchChangePercents[c]);
+        if (maxvid_decode_c4_sample16_to32(frameBuffer32, kb.input, numWords, numPixels) != 0) {
+          fprintf(stderr, "%s: validation failed\n", name);
+          return 1;
+        }
+        for (uint32_t i = 0; i < numPixels; i++) {
+          uint32_t expected = maxvid_convert_pixel_555_to_8888(frame.pixels[i]);
+          if (frameBuffer32[i] != expected) {
+            fprintf(stderr, "%s: decoded pixel %u is 0x%X, expected 0x%X\n", name, i, frameBuffer32[i], expected);
+            return 1;
+          }
+        }
+
+        mvid_bench_run(bench, name, bench_decode_c4_sample16_to32, &kb, numPixels * sizeof(uint32_t));
+
+        free(frameBuffer32);
+        kb.output = NULL;
+      }
+
+      free(kb.frameBuffer);
+      free(kb.input);
+      mvid_bench_frame_free(&frame);
+    }
+  }
+
+  return 0;
+}
+
+// A full screen color wipe is one DUP that covers the whole framebuffer and
+// should run close to a memset of the framebuffer. The 1080p wipe is written
+// with non-temporal stores when it is at least maxvid_blit_stream_min_num_bytes().
+
+static
+int run_wipe_benchmarks(MvidBench *bench) {
+  const uint32_t sizes[][2] = { { BENCH_WIDTH, BENCH_HEIGHT }, { 1920, 1080 } };
+  const uint32_t pixel = 0xFF8040C0;
+
+  for (int s = 0; s < 2; s++) {
+    char name[MVID_BENCH_NAME_LENGTH];
+
+    MvidBenchFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.width = sizes[s][0];
+    frame.height = sizes[s][1];
+    frame.bpp = 32;
+
+    uint32_t numPixels = frame.width * frame.height;
+    KernelBench kb;
+    memset(&kb, 0, sizeof(kb));
+    kb.frame = &frame;
+    kb.frameBufferNumBytes = numPixels * sizeof(uint32_t);
+    kb.frameBuffer = mvid_bench_alloc(kb.frameBufferNumBytes);
+    kb.inputNumBytes = 4 * sizeof(uint32_t);
+    kb.input = mvid_bench_alloc(kb.inputNumBytes);
+
+    uint32_t *codes = kb.input;
+    codes[0] = (numPixels << 10) | (DUP << 8);
+    codes[1] = pixel;
+    codes[2] = (DONE << 8);
+    codes[3] = 0;
+
+    snprintf(name, sizeof(name), "decode_c4_sample32_wipe/size=%ux%u", frame.width, frame.height);
+
+    if (maxvid_decode_c4_sample32_validated(kb.frameBuffer, codes, 4, numPixels) != 0) {
+      fprintf(stderr, "%s: validation failed\n", name);
+      return 1;
+    }
+    for (uint32_t i = 0; i < numPixels; i++) {
+      if (((uint32_t *)kb.frameBuffer)[i] != pixel) {
+        fprintf(stderr, "%s: decoded pixel %u is 0x%X, expected 0x%X\n", name, i, ((uint32_t *)kb.frameBuffer)[i], pixel);
+        return 1;
+      }
+    }
+
+    mvid_bench_run(bench, name, bench_decode_c4_sample32, &kb, kb.frameBufferNumBytes);
+
+    snprintf(name, sizeof(name), "memset/size=%ux%u", frame.width, frame.height);
+    mvid_bench_run(bench, name, bench_memset, &kb, kb.frameBufferNumBytes);
+
+    free(kb.frameBuffer);
+    free(kb.input);
+  }
+
+  return 0;
+}
+
+// A composition plays a large clip next to several small ones. A large
+// keyframe that is copied through the cache evicts the framebuffers and codes
+// of the small clips, so the next decode of each small clip misses. The copy
+// is run with cached stores and with non-temporal stores by setting the
+// stream size, the small clips are decoded with the same code either way.
+
+#define COMPOSE_NUM_CLIPS 8
+
+static
+int run_composition_benchmarks(MvidBench *bench) {
+  const uint32_t sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+  const uint32_t numClipPixels = BENCH_WIDTH * BENCH_HEIGHT;
+
+  MvidBenchFrame frames[COMPOSE_NUM_CLIPS];
+  KernelBench clips[COMPOSE_NUM_CLIPS];
+
+  for (int i = 0; i < COMPOSE_NUM_CLIPS; i++) {
+    mvid_bench_frame_init(&frames[i], BENCH_WIDTH, BENCH_HEIGHT, 32, 10, BENCH_SEED + i);
+
+    KernelBench *kb = &clips[i];
+    memset(kb, 0, sizeof(*kb));
+    kb->frame = &frames[i];
+    kb->frameBufferNumBytes = numClipPixels * sizeof(uint32_t);
+    kb->frameBuffer = mvid_bench_alloc(kb->frameBufferNumBytes);
+    kb->input = mvid_bench_alloc((numClipPixels * 2 + 1) * sizeof(uint32_t));
+    kb->inputNumBytes = synth_emit_c4_sample32(&frames[i], kb->input) * sizeof(uint32_t);
+
+    if (maxvid_decode_c4_sample32_validated(kb->frameBuffer, kb->input, kb->inputNumBytes >> 2, numClipPixels) != 0 ||
+        synth_frame_check(&frames[i], kb->frameBuffer, 0, "compose_clips") != 0) {
+      fprintf(stderr, "compose_clips: validation failed\n");
+      return 1;
+    }
+  }
+
+  for (int s = 0; s < 2; s++) {
+    char name[MVID_BENCH_NAME_LENGTH];
+
+    CompositionBench cb;
+    cb.clips = clips;
+    cb.numClips = COMPOSE_NUM_CLIPS;
+    cb.frameBufferNumBytes = sizes[s][0] * sizes[s][1] * sizeof(uint32_t);
+    cb.keyframe = mvid_bench_alloc(cb.frameBufferNumBytes);
+    cb.frameBuffer = mvid_bench_alloc(cb.frameBufferNumBytes);
+
+    uint32_t *keyframe = cb.keyframe;
+    for (uint32_t i = 0; i < (cb.frameBufferNumBytes >> 2); i++) {
+      keyframe[i] = (i * 2654435761U) | 0xFF000000;
+    }
+
+    const double composeNumBytes = cb.frameBufferNumBytes + (double) COMPOSE_NUM_CLIPS * numClipPixels * sizeof(uint32_t);
+
+    for (int stream = 0; stream < 2; stream++) {
+      // Only the keyframe copy is streamed, the DUP fills of the small clips
+      // are smaller than the stream size in both cases.
+
+      maxvid_blit_set_stream_min_num_bytes(stream ? cb.frameBufferNumBytes : SIZE_MAX);
+      const char *mode = stream ? "stream" : "cached";
+
+      memset(cb.frameBuffer, 0, cb.frameBufferNumBytes);
+      bench_keyframe_copy(&cb);
+      if (memcmp(cb.frameBuffer, cb.keyframe, cb.frameBufferNumBytes) != 0) {
+        fprintf(stderr, "keyframe_copy_%s: copied pixels do not match\n", mode);
+        return 1;
+      }
+
+      snprintf(name, sizeof(name), "keyframe_copy_%s/size=%ux%u", mode, sizes[s][0], sizes[s][1]);
+      mvid_bench_run(bench, name, bench_keyframe_copy, &cb, cb.frameBufferNumBytes);
+
+      snprintf(name, sizeof(name), "compose_clips_%s/size=%ux%u", mode, sizes[s][0], sizes[s][1]);
+      mvid_bench_run(bench, name, bench_compose_clips, &cb, composeNumBytes);
+    }
+
+    maxvid_blit_set_stream_min_num_bytes(0);
+
+    free(cb.keyframe);
+    free(cb.frameBuffer);
+  }
+
+  for (int i = 0; i < COMPOSE_NUM_CLIPS; i++) {
+    free(clips[i].frameBuffer);
+    free(clips[i].input);
+    mvid_bench_frame_free(&frames[i]);
+  }
+
+  return 0;
+}
+
+// Reduce the synthetic 32 bpp pixels to 64 colors, encode them as a palette
+// frame against the zero previous frame, check the decode result, then run
+// the benchmark.
+
+static
+int run_palette_benchmarks(MvidBench *bench) {
+  for (uint32_t c = 0; c < MVID_BENCH_NUM_CHANGE_PERCENTS; c++) {
+    char name[MVID_BENCH_NAME_LENGTH];
+    snprintf(name, sizeof(name), "decode_palette/change=%u", mvidBenchChangePercents[c]);
+
+    MvidBenchFrame frame;
+    mvid_bench_frame_init(&frame, BENCH_WIDTH, BENCH_HEIGHT, 32, mvidBenchChangePercents[c], BENCH_SEED);
+
+    uint32_t numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+    for (uint32_t i = 0; i < numPixels; i++) {
+      if (frame.pixels[i] != 0) {
+        frame.pixels[i] = 0xFF000000 | ((frame.pixels[i] & 0x3F) * 0x040404);
+      }
+    }
+
+    KernelBench kb;
+    memset(&kb, 0, sizeof(kb));
+    kb.frame = &frame;
+    kb.frameBufferNumBytes = numPixels * sizeof(uint32_t);
+    kb.frameBuffer = mvid_bench_alloc(kb.frameBufferNumBytes);
+    kb.input = mvid_bench_alloc(maxvid_palette_max_num_words(numPixels) * sizeof(uint32_t));
+    kb.prevPixels = mvid_bench_alloc(kb.frameBufferNumBytes);
+
+    MVPalette *palette = mvid_bench_alloc(sizeof(MVPalette));
+    uint32_t numWords;
+
+    if (maxvid_palette_encode(palette, kb.prevPixels, frame.pixels, numPixels, kb.input, &numWords) != 0 ||
+        maxvid_palette_decode(kb.frameBuffer, kb.input, numWords, numPixels) != 0) {
+      fprintf(stderr, "%s: palette encode or decode failed\n", name);
+      return 1;
+    }
+    kb.inputNumBytes = numWords * sizeof(uint32_t);
+
+    if (synth_frame_check(&frame, kb.frameBuffer, 0, name) != 0) {
+      return 1;
+    }
+
+    mvid_bench_run(bench, name, bench_decode_palette, &kb, kb.frameBufferNumBytes);
+
+    free(palette);
+    free(kb.frameBuffer);
+    free(kb.input);
+    free(kb.prevPixels);
+    mvid_bench_frame_free(&frame);
+  }
+
+  return 0;
+}
+
+static
+int run_rle_benchmarks(MvidBench *bench) {
+  const uint32_t bpps[] = { 16, 24, 32 };
+  const MvidBenchFunc funcs[] = { bench_decode_rle_sample16, bench_decode_rle_sample24, bench_decode_rle_sample32 };
+
+  for (int b = 0; b < 3; b++) {
+    uint32_t bpp = bpps[b];
+
+    for (uint32_t c = 0; c < MVID_BENCH_NUM_CHANGE_PERCENTS; c++) {
+      char name[MVID_BENCH_NAME_LENGTH];
+      snprintf(name, sizeof(name), "decode_rle_sample%u/change=%u", bpp, mvidBenchChangePercents[c]);
+
+      MvidBenchFrame frame;
+      mvid_bench_frame_init(&frame, BENCH_WIDTH, BENCH_HEIGHT, bpp, mvidBenchChangePercents[c], BENCH_SEED);
+
+      uint32_t numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+      KernelBench kb;
+      memset(&kb, 0, sizeof(kb));
+      kb.frame = &frame;
+      kb.isKeyframe = (mvidBenchChangePercents[c] == 100);
+      kb.frameBufferNumBytes = numPixels * ((bpp == 16) ? sizeof(uint16_t) : sizeof(uint32_t));
+      kb.frameBuffer = mvid_bench_alloc(kb.frameBufferNumBytes);
+      kb.input = mvid_bench_alloc(numPixels * 10 + BENCH_HEIGHT * 16 + 64);
+      kb.inputNumBytes = synth_emit_rle_sample(&frame, kb.input, kb.isKeyframe);
+
+      funcs[b](&kb);
+
+      if (synth_frame_check(&frame, kb.frameBuffer, (bpp == 32), name) != 0) {
+        return 1;
+      }
+
+      mvid_bench_run(bench, name, funcs[b], &kb, kb.frameBufferNumBytes);
+
+      free(kb.frameBuffer);
+      free(kb.input);
+      mvid_bench_frame_free(&frame);
+    }
+  }
+
+  return 0;
+}
+
+static
+void run_pixel_benchmarks(MvidBench *bench) {
+  uint32_t numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+  uint32_t seed = BENCH_SEED;
+
+  KernelBench kb;
+  memset(&kb, 0, sizeof(kb));
+  kb.frameBufferNumBytes = numPixels * sizeof(uint32_t);
+  kb.frameBuffer = mvid_bench_alloc(kb.frameBufferNumBytes);
+  kb.inputNumBytes = numPixels * sizeof(uint32_t);
+  kb.input = mvid_bench_alloc(kb.inputNumBytes);
+
+  uint32_t *inPixels = kb.input;
+  for (uint32_t i = 0; i < numPixels; i++) {
+    inPixels[i] = mvid_bench_rand(&seed);
+  }
+
+  premultiply_init();
+
+  mvid_bench_run(bench, "adler32", bench_adler32, &kb, kb.inputNumBytes);
+  mvid_bench_run(bench, "premultiply_bgra", bench_premultiply, &kb, kb.inputNumBytes);
+
+  uint32_t *premultipliedPixels = mvid_bench_alloc(numPixels * sizeof(uint32_t));
+  for (uint32_t i = 0; i < numPixels; i++) {
+    uint32_t pixel = inPixels[i];
+    premultipliedPixels[i] = premultiply_bgra_inline((pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF, pixel >> 24);
+  }
+  kb.output = premultipliedPixels;
+
+  mvid_bench_run(bench, "unpremultiply_bgra", bench_unpremultiply, &kb, kb.inputNumBytes);
+
+  free(premultipliedPixels);
+
+  kb.output = mvid_bench_alloc(numPixels * sizeof(uint16_t));
+  mvid_bench_run(bench, "convert_555_to_8888", bench_convert_555_to_8888, &kb, numPixels * sizeof(uint32_t));
+  mvid_bench_run(bench, "convert_8888_to_555", bench_convert_8888_to_555, &kb, kb.inputNumBytes);
+  mvid_bench_run(bench, "convert_8888_to_555_dither", bench_convert_8888_to_555_dither, &kb, kb.inputNumBytes);
+  free(kb.output);
+
+  // The random input words are used as YUV samples, the bytes processed are
+  // the bytes of BGRA pixels written.
+
+  MVYUVCoefficients yuv;
+  maxvid_yuv_init(&yuv, MV_YUV_MATRIX_BT709, MV_YUV_RANGE_VIDEO);
+  kb.yuv = &yuv;
+  mvid_bench_run(bench, "yuv_nv12_to_bgra", bench_yuv_nv12_to_bgra, &kb, kb.frameBufferNumBytes);
+  mvid_bench_run(bench, "yuv_nv12_to_bgra_alpha", bench_yuv_nv12_to_bgra_alpha, &kb, kb.frameBufferNumBytes);
+  mvid_bench_run(bench, "yuv_i420_to_bgra", bench_yuv_i420_to_bgra, &kb, kb.frameBufferNumBytes);
+
+  // The alpha frame is a matte that is mostly transparent or opaque with a
+  // gray edge, as decoded from H.264 the gray values can be off by one.
+
+  uint32_t *alphaPixels = mvid_bench_alloc(numPixels * sizeof(uint32_t));
+  for (uint32_t i = 0; i < numPixels; i++) {
+    uint32_t column = i % BENCH_WIDTH;
+    uint32_t gray = (column < (BENCH_WIDTH / 3)) ? 0 : ((column < (BENCH_WIDTH / 2)) ? (column & 0xFF) : 0xFF);
+    alphaPixels[i] = (gray << 16) | (gray << 8) | gray;
+    if (gray != 0 && gray != 0xFF && (i & 0x1)) {
+      alphaPixels[i] -= 0x100;
+    }
+  }
+  kb.output = alphaPixels;
+
+  mvid_bench_run(bench, "alpha_join_pixels", bench_alpha_join_pixels, &kb, kb.frameBufferNumBytes);
+
+  kb.prevPixels = mvid_bench_alloc(numPixels * sizeof(uint32_t));
+  maxvid_alpha_join_pixels(kb.prevPixels, kb.input, alphaPixels, NULL, numPixels);
+  mvid_bench_run(bench, "alpha_join_pixels_prev", bench_alpha_join_pixels, &kb, kb.frameBufferNumBytes);
+
+  free(kb.prevPixels);
+  free(alphaPixels);
+
+  free(kb.frameBuffer);
+  free(kb.input);
+}
+
+static
+int run_file_benchmark(MvidBench *bench, const char *mvidPath) {
+  MvidReader reader;
+  const char *errStr = mvid_reader_open(&reader, mvidPath);
+  if (errStr != NULL) {
+    fprintf(stderr, "%s: %s\n", mvidPath, errStr);
+    mvid_reader_close(&reader);
+    return 1;
+  }
+
+  KernelBench kb;
+  memset(&kb, 0, sizeof(kb));
+  kb.reader = &reader;
+  kb.frameBuffer = mvid_reader_alloc_framebuffer(&reader);
+
+  for (uint32_t frameIndex = 0; frameIndex < reader.header->numFrames; frameIndex++) {
+    if (mvid_reader_decode_frame(&reader, frameIndex, kb.frameBuffer) != 0) {
+      fprintf(stderr, "%s: decode failed, compressed or -deltas frames are not supported\n", mvidPath);
+      free(kb.frameBuffer);
+      mvid_reader_close(&reader);
+      return 1;
+    }
+  }
+
+  const char *baseName = strrchr(mvidPath, '/');
+  baseName = (baseName == NULL) ? mvidPath : (baseName + 1);
+
+  char name[MVID_BENCH_NAME_LENGTH];
+  snprintf(name, sizeof(name), "decode_file/%s", baseName);
+
+  mvid_bench_run(bench, name, bench_decode_file, &kb, (double)reader.header->numFrames * reader.frameBufferNumBytes);
+
+  free(kb.frameBuffer);
+  mvid_reader_close(&reader);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  static MvidBench bench;
+  char *jsonPath = NULL;
+  char *baselinePath = NULL;
+  char *mvidPath = NULL;
+  double thresholdPercent = 10.0;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-filter") == 0) && ((i + 1) < argc)) {
+      bench.filter = argv[++i];
+    } else if ((strcmp(argv[i], "-json") == 0) && ((i + 1) < argc)) {
+      jsonPath = argv[++i];
+    } else if ((strcmp(argv[i], "-baseline") == 0) && ((i + 1) < argc)) {
+      baselinePath = argv[++i];
+    } else if ((strcmp(argv[i], "-threshold") == 0) && ((i + 1) < argc)) {
+      thresholdPercent = atof(argv[++i]);
+    } else if ((strcmp(argv[i], "-file") == 0) && ((i + 1) < argc)) {
+      mvidPath = argv[++i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  printf("%-48s %15s %15s %12s\n", "benchmark", "time/op", "throughput", "iterations");
+
+  if (run_c4_benchmarks(&bench) != 0) {
+    return 1;
+  }
+  if (run_rle_benchmarks(&bench) != 0) {
+    return 1;
+  }
+  if (run_palette_benchmarks(&bench) != 0) {
+    return 1;
+  }
+  if (run_wipe_benchmarks(&bench) != 0) {
+    return 1;
+  }
+  if (run_composition_benchmarks(&bench) != 0) {
+    return 1;
+  }
+  run_pixel_benchmarks(&bench);
+  if (mvidPath != NULL && run_file_benchmark(&bench, mvidPath) != 0) {
+    return 1;
+  }
+
+  if (jsonPath != NULL && mvid_bench_write_json(&bench, jsonPath) != 0) {
+    fprintf(stderr, "could not write \"%s\"\n", jsonPath);
+    return 1;
+  }
+
+  if (baselinePath != NULL) {
+    int numRegressions = mvid_bench_compare_baseline(&bench, baselinePath, thresholdPercent);
+    if (numRegressions != 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
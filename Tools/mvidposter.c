@@ -0,0 +1,235 @@
+// mvidposter command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool extracts poster frames from many .mvid files at once, the first,
+// middle or last frame or every Nth frame, see mvid_poster.h. Files are listed
+// on the command line or one path per line in a list file with -list, which
+// is needed for more files than fit in the argument list. With -o each frame
+// is written to DIR as NAME_FRAME.ppm, or as NAME_FRAME.pam with straight
+// alpha for a 32 bpp file. Without -o frames are extracted but not written,
+// so that extraction throughput can be measured on its own. The number of
+// files and frames per second is printed when all files are done. With
+// -scaled box or -scaled point, frames that are downscaled by 2 or more are
+// decoded into a 1/2, 1/4 or 1/8 size framebuffer, see maxvid_scale.h.
+//
+// Build:
+//
+// gcc -std=gnu99 -O2 -pthread -I../Classes/AVAnimator -o mvidposter mvidposter.c mvid_poster.c mvid_reader.c
+//   ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c
+//   ../Classes/AVAnimator/maxvid_validate.c ../Classes/AVAnimator/maxvid_framebuffer.c
+//   ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_crop.c ../Classes/AVAnimator/maxvid_convert.c
+//   ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Usage:
+//
+// mvidposter [-first | -middle | -last | -every N] [-maxsize N] [-scaled box|point] [-threads N] [-o DIR] [-list FILE] [FILE.mvid ...]
+
+#include "mvid_poster.h"
+
+#include "mvid_bench_util.h"
+
+typedef struct {
+  const char *outDir;
+} PosterContext;
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidposter [-first | -middle | -last | -every N] [-maxsize N] [-scaled box|point] [-threads N] [-o DIR] [-list FILE] [FILE.mvid ...]\n");
+}
+
+// Append path to a growing array of paths, exits when out of memory
+
+static
+void append_path(char ***pathsPtr, uint32_t *numPathsPtr, uint32_t *maxNumPathsPtr, char *path) {
+  if (*numPathsPtr == *maxNumPathsPtr) {
+    *maxNumPathsPtr = (*maxNumPathsPtr == 0) ? 1024 : (*maxNumPathsPtr * 2);
+    *pathsPtr = realloc(*pathsPtr, *maxNumPathsPtr * sizeof(char*));
+    if (*pathsPtr == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  (*pathsPtr)[(*numPathsPtr)++] = path;
+}
+
+// Read one path per line, empty lines are ignored. Returns 0 on success.
+
+static
+int read_list(const char *listPath, char ***pathsPtr, uint32_t *numPathsPtr, uint32_t *maxNumPathsPtr) {
+  FILE *listFile = fopen(listPath, "r");
+  if (listFile == NULL) {
+    return 1;
+  }
+  char line[4096];
+  while (fgets(line, sizeof(line), listFile) != NULL) {
+    size_t len = strcspn(line, "\r\n");
+    line[len] = '\0';
+    if (len == 0) {
+      continue;
+    }
+    append_path(pathsPtr, numPathsPtr, maxNumPathsPtr, strdup(line));
+  }
+  fclose(listFile);
+  return 0;
+}
+
+// Write BGRA pixels as a binary PPM, or as a PAM with straight alpha when hasAlpha is set
+
+static
+int write_poster(const char *path, const MvidPoster *poster, int hasAlpha) {
+  FILE *outFile = fopen(path, "wb");
+  if (outFile == NULL) {
+    return 1;
+  }
+
+  if (hasAlpha) {
+    fprintf(outFile, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", poster->width, poster->height);
+  } else {
+    fprintf(outFile, "P6\n%u %u\n255\n", poster->width, poster->height);
+  }
+
+  const uint32_t numBytesPerPixel = hasAlpha ? 4 : 3;
+  uint8_t *row = malloc(poster->width * numBytesPerPixel);
+  if (row == NULL) {
+    fclose(outFile);
+    return 1;
+  }
+
+  for (uint32_t y = 0; y < poster->height; y++) {
+    const uint32_t *pixels = &poster->pixels[y * poster->width];
+    uint8_t *outPtr = row;
+    for (uint32_t x = 0; x < poster->width; x++) {
+      uint32_t pixel = pixels[x];
+      uint32_t alpha = pixel >> 24;
+      uint32_t red = (pixel >> 16) & 0xFF;
+      uint32_t green = (pixel >> 8) & 0xFF;
+      uint32_t blue = pixel & 0xFF;
+      if (hasAlpha) {
+        // Undo premultiplication
+        if (alpha != 0 && alpha != 0xFF) {
+          red = ((red * 255) + (alpha / 2)) / alpha;
+          green = ((green * 255) + (alpha / 2)) / alpha;
+          blue = ((blue * 255) + (alpha / 2)) / alpha;
+        }
+        *outPtr++ = red;
+        *outPtr++ = green;
+        *outPtr++ = blue;
+        *outPtr++ = alpha;
+      } else {
+        *outPtr++ = red;
+        *outPtr++ = green;
+        *outPtr++ = blue;
+      }
+    }
+    fwrite(row, 1, poster->width * numBytesPerPixel, outFile);
+  }
+
+  free(row);
+  return (fclose(outFile) == 0) ? 0 : 1;
+}
+
+static
+void poster_callback(void *context, const MvidPoster *poster, const char *errStr) {
+  PosterContext *posterContext = (PosterContext *) context;
+
+  if (errStr != NULL) {
+    fprintf(stderr, "%s: %s\n", poster->path, errStr);
+    return;
+  }
+
+  if (posterContext->outDir == NULL) {
+    return;
+  }
+
+  // NAME.mvid becomes NAME_FRAME.ppm in the output directory
+
+  const char *name = strrchr(poster->path, '/');
+  name = (name == NULL) ? poster->path : (name + 1);
+  size_t nameLen = strlen(name);
+  if (nameLen > 5 && strcmp(name + nameLen - 5, ".mvid") == 0) {
+    nameLen -= 5;
+  }
+
+  int hasAlpha = (poster->bpp == 32);
+  char outPath[4096];
+  snprintf(outPath, sizeof(outPath), "%s/%.*s_%u.%s", posterContext->outDir, (int)nameLen, name,
+           poster->frameIndex, hasAlpha ? "pam" : "ppm");
+
+  if (write_poster(outPath, poster, hasAlpha) != 0) {
+    fprintf(stderr, "%s: could not write %s\n", poster->path, outPath);
+  }
+}
+
+int main(int argc, char **argv) {
+  MvidPosterOptions options;
+  memset(&options, 0, sizeof(options));
+  options.select = MVID_POSTER_FIRST;
+
+  PosterContext context;
+  context.outDir = NULL;
+
+  char **paths = NULL;
+  uint32_t numPaths = 0;
+  uint32_t maxNumPaths = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-first") == 0) {
+      options.select = MVID_POSTER_FIRST;
+    } else if (strcmp(argv[i], "-middle") == 0) {
+      options.select = MVID_POSTER_MIDDLE;
+    } else if (strcmp(argv[i], "-last") == 0) {
+      options.select = MVID_POSTER_LAST;
+    } else if (strcmp(argv[i], "-every") == 0 && (i + 1) < argc) {
+      options.select = MVID_POSTER_EVERY_NTH;
+      options.everyNth = (uint32_t) atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-maxsize") == 0 && (i + 1) < argc) {
+      options.maxDimension = (uint32_t) atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-scaled") == 0 && (i + 1) < argc) {
+      const char *filter = argv[++i];
+      options.scaledDecode = 1;
+      if (strcmp(filter, "box") == 0) {
+        options.scaleFilter = MV_SCALE_BOX;
+      } else if (strcmp(filter, "point") == 0) {
+        options.scaleFilter = MV_SCALE_POINT;
+      } else {
+        usage();
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-threads") == 0 && (i + 1) < argc) {
+      options.numThreads = (uint32_t) atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0 && (i + 1) < argc) {
+      context.outDir = argv[++i];
+    } else if (strcmp(argv[i], "-list") == 0 && (i + 1) < argc) {
+      const char *listPath = argv[++i];
+      if (read_list(listPath, &paths, &numPaths, &maxNumPaths) != 0) {
+        fprintf(stderr, "could not read list \"%s\"\n", listPath);
+        return 1;
+      }
+    } else if (argv[i][0] == '-') {
+      usage();
+      return 1;
+    } else {
+      append_path(&paths, &numPaths, &maxNumPaths, argv[i]);
+    }
+  }
+
+  if (numPaths == 0 || (options.select == MVID_POSTER_EVERY_NTH && options.everyNth == 0)) {
+    usage();
+    return 1;
+  }
+
+  MvidPosterStats stats;
+  double startTime = mvid_bench_now();
+  uint32_t status = mvid_poster_extract((const char **) paths, numPaths, &options, poster_callback, &context, &stats);
+  double elapsed = mvid_bench_now() - startTime;
+
+  printf("files: %u (%u failed)\n", stats.numFiles, stats.numFilesFailed);
+  printf("posters: %u\n", stats.numPosters);
+  printf("frames decoded: %llu\n", (unsigned long long)stats.numFramesDecoded);
+  printf("seconds: %.3f\n", elapsed);
+  printf("files/s: %.1f\n", stats.numFiles / elapsed);
+  printf("posters/s: %.1f\n", stats.numPosters / elapsed);
+
+  return (status == 0) ? 0 : 1;
+}
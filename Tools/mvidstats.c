@@ -0,0 +1,111 @@
+// mvidstats command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool reads an existing .mvid file and emits encoder stats as JSON.
+// Each delta frame is walked to count the SKIP, DUP, and COPY codes so that
+// assets that compress poorly can be found without access to the encoder.
+// The encode time is not stored in a .mvid file, so it is always zero here;
+// use AVMvidFileWriter.genStats to collect timing while encoding.
+//
+// Build:
+//
+// gcc -std=gnu99 -O2 -pthread -I../Classes/AVAnimator -o mvidstats mvidstats.c mvid_reader.c
+//   ../Classes/AVAnimator/maxvid_stats.c ../Classes/AVAnimator/maxvid_file.c
+//   ../Classes/AVAnimator/maxvid_decode.c ../Classes/AVAnimator/maxvid_validate.c
+//   ../Classes/AVAnimator/maxvid_framebuffer.c ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_crop.c ../Classes/AVAnimator/maxvid_convert.c
+//   ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Usage:
+//
+// mvidstats [-summary] FILE.mvid
+
+#include "maxvid_stats.h"
+
+#include "mvid_reader.h"
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidstats [-summary] FILE.mvid\n");
+}
+
+int main(int argc, char **argv) {
+  int emitFrames = 1;
+  char *mvidPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-summary") == 0) {
+      emitFrames = 0;
+    } else if (mvidPath == NULL) {
+      mvidPath = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (mvidPath == NULL) {
+    usage();
+    return 1;
+  }
+
+  MvidReader reader;
+  const char *errStr = mvid_reader_open(&reader, mvidPath);
+  if (errStr != NULL) {
+    fprintf(stderr, "%s: %s\n", mvidPath, errStr);
+    mvid_reader_close(&reader);
+    return 1;
+  }
+
+  MVFileHeader *mvHeader = reader.header;
+
+  MVFileStats *fileStats = maxvid_file_stats_alloc();
+  fileStats->width = mvHeader->width;
+  fileStats->height = mvHeader->height;
+  fileStats->bpp = mvHeader->bpp;
+
+  for (uint32_t frameNum = 0; frameNum < mvHeader->numFrames; frameNum++) {
+    MvidReaderFrame frame;
+    mvid_reader_frame(&reader, frameNum, &frame);
+
+    MVFrameStats frameStats;
+
+    if (frame.isNopframe) {
+      maxvid_frame_stats_init(&frameStats, frameNum, MV_STATS_NOPFRAME);
+    } else if (frame.isKeyframe) {
+      maxvid_frame_stats_init(&frameStats, frameNum, MV_STATS_KEYFRAME);
+      frameStats.numBytes = frame.length;
+    } else {
+      maxvid_frame_stats_init(&frameStats, frameNum, MV_STATS_DELTAFRAME);
+      frameStats.numBytes = frame.length;
+
+      if (!frame.isCompressed) {
+        const uint32_t *inputBuffer32 = (const uint32_t *) (reader.mappedPtr + frame.offset);
+        uint32_t status;
+
+        if (mvHeader->bpp == 16) {
+          status = maxvid_frame_stats_count_c4_codes16(&frameStats, inputBuffer32, frame.length / sizeof(uint32_t), reader.frameBufferNumPixels);
+        } else {
+          status = maxvid_frame_stats_count_c4_codes32(&frameStats, inputBuffer32, frame.length / sizeof(uint32_t), reader.frameBufferNumPixels);
+        }
+
+        if (status != 0) {
+          fprintf(stderr, "frame %u contains invalid c4 codes\n", frameNum);
+          return 1;
+        }
+      }
+    }
+
+    if (maxvid_file_stats_append(fileStats, &frameStats) != 0) {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+    }
+  }
+
+  uint32_t status = maxvid_file_stats_write_json(stdout, fileStats, emitFrames);
+
+  maxvid_file_stats_free(fileStats);
+  mvid_reader_close(&reader);
+
+  return (status == 0) ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+// mvidy4m command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool converts YUV4MPEG2 (.y4m) or raw I420 video to a .mvid file with
+// AVY4MConvertMaxvid, so that video can be converted without AVFoundation. A
+// path of "-" reads from stdin, so the output of an external decoder can be
+// piped in and the decoder is throttled by the pipe as frames are encoded:
+//
+// ffmpeg -i in.m4v -f yuv4mpegpipe -pix_fmt yuv420p - | mvidy4m - out.mvid
+//
+// With -alpha the Y plane of a second video is joined as the alpha channel,
+// with -mixed the input frames alternate between RGB and alpha frames. With
+// -deltas frames are written as delta frames, -lossy sets a lossy SKIP and
+// DUP tolerance for those deltas, see maxvid_encode.h. The number of frames
+// and frames per second is printed when done, so the whole ingest path can be
+// measured.
+//
+// Build (Mac OS X):
+//
+// clang -fobjc-arc -O2 -DNDEBUG -I../Classes/AVAnimator -framework Foundation -framework QuartzCore
+//   -framework CoreGraphics -o mvidy4m mvidy4m.m ../Classes/AVAnimator/AVY4MConvertMaxvid.m
+//   ../Classes/AVAnimator/AVFrameSourceConvertMaxvid.m ../Classes/AVAnimator/AVMvidFileWriter.m ../Classes/AVAnimator/CGFrameBuffer.m
+//   ../Classes/AVAnimator/maxvid_encode.m ../Classes/AVAnimator/maxvid_stats.c
+//   ../Classes/AVAnimator/maxvid_file.c ../Classes/AVAnimator/maxvid_decode.c
+//   ../Classes/AVAnimator/maxvid_writer.c ../Classes/AVAnimator/maxvid_y4m.c ../Classes/AVAnimator/maxvid_yuv.c
+//   ../Classes/AVAnimator/maxvid_scale.c ../Classes/AVAnimator/maxvid_palette.c ../Classes/AVAnimator/maxvid_blit.c
+//
+// Usage:
+//
+// mvidy4m [-alpha ALPHA.y4m | -mixed] [-deltas] [-lossy TOL] [-bt709] [-raw WxH -fps FPS] [-adler] IN.y4m OUT.mvid
+
+#import <Foundation/Foundation.h>
+
+#import "AVY4MConvertMaxvid.h"
+
+#import "maxvid_encode.h"
+
+#include "mvid_bench_util.h"
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidy4m [-alpha ALPHA.y4m | -mixed] [-deltas] [-lossy TOL] [-bt709] [-raw WxH -fps FPS] [-adler] IN.y4m OUT.mvid\n");
+}
+
+int main(int argc, char **argv) {
+  char *alphaPath = NULL;
+  int isMixed = 0;
+  int genDeltas = 0;
+  int genAdler = 0;
+  int lossyTolerance = 0;
+  int isBT709 = 0;
+  unsigned int rawWidth = 0;
+  unsigned int rawHeight = 0;
+  double fps = 0.0;
+  char *paths[2];
+  int numPaths = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-alpha") == 0) && ((i + 1) < argc)) {
+      alphaPath = argv[++i];
+    } else if (strcmp(argv[i], "-mixed") == 0) {
+      isMixed = 1;
+    } else if (strcmp(argv[i], "-deltas") == 0) {
+      genDeltas = 1;
+    } else if ((strcmp(argv[i], "-lossy") == 0) && ((i + 1) < argc)) {
+      lossyTolerance = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-bt709") == 0) {
+      isBT709 = 1;
+    } else if ((strcmp(argv[i], "-raw") == 0) && ((i + 1) < argc)) {
+      if (sscanf(argv[++i], "%ux%u", &rawWidth, &rawHeight) != 2) {
+        usage();
+        return 1;
+      }
+    } else if ((strcmp(argv[i], "-fps") == 0) && ((i + 1) < argc)) {
+      fps = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-adler") == 0) {
+      genAdler = 1;
+    } else if ((argv[i][0] == '-' && argv[i][1] != '\0') || numPaths == 2) {
+      usage();
+      return 1;
+    } else {
+      paths[numPaths++] = argv[i];
+    }
+  }
+
+  if (numPaths != 2 || (alphaPath != NULL && isMixed) || (rawWidth != 0 && fps <= 0.0)) {
+    usage();
+    return 1;
+  }
+
+  int status = 1;
+
+  @autoreleasepool {
+    AVY4MConvertMaxvid *converter = [AVY4MConvertMaxvid aVY4MConvertMaxvid];
+
+    converter.inputPath = [NSString stringWithUTF8String:paths[0]];
+    converter.mvidPath = [NSString stringWithUTF8String:paths[1]];
+    if (alphaPath != NULL) {
+      converter.alphaPath = [NSString stringWithUTF8String:alphaPath];
+    }
+    converter.isMixedAlpha = isMixed;
+    converter.genDeltas = genDeltas;
+    converter.genAdler = genAdler;
+    uint32_t encodeFlags = MaxvidEncodeFlags_MERGE_DUP;
+    if (lossyTolerance > 0) {
+      encodeFlags |= MaxvidEncodeFlags_LOSSY_SKIP | MaxvidEncodeFlags_LOSSY_DUP | MaxvidEncodeFlags_TOLERANCE(lossyTolerance);
+    }
+    converter.encodeFlags = encodeFlags;
+    if (isBT709) {
+      converter.matrix = MV_YUV_MATRIX_BT709;
+    }
+    if (rawWidth != 0) {
+      converter.rawSize = CGSizeMake(rawWidth, rawHeight);
+      converter.frameDuration = (float) (1.0 / fps);
+    }
+
+    double startTime = mvid_bench_now();
+    BOOL worked = [converter blockingConvert];
+    double elapsed = mvid_bench_now() - startTime;
+
+    if (worked) {
+      printf("frames: %d\n", converter.frameNum);
+      printf("seconds: %.3f\n", elapsed);
+      printf("frames/s: %.1f\n", converter.frameNum / elapsed);
+      status = 0;
+    } else {
+      fprintf(stderr, "could not convert \"%s\"\n", paths[0]);
+    }
+  }
+
+  return status;
+}
@@ -0,0 +1,198 @@
+// mvidyuvcheck command line tool
+//
+//  License terms defined in License.txt.
+//
+// This tool checks the YUV to BGRA kernels, see maxvid_yuv.h, where the Xcode
+// tests can't run. A raw I420 frame, the Y plane followed by the U and V planes
+// with no row padding, is converted as I420 and then as NV12 after the U and V
+// planes are interleaved. Both results must exactly match a reference dump of
+// the BGRA pixels, stored as 32 bit words in little endian order. The exit
+// status is non-zero when any pixel differs. With -write the I420 result is
+// written to the reference file instead of being compared.
+//
+// The checked in fixture is a BT.709 video range frame with an odd width and
+// height, so that the last column and row of the UV planes are covered, and
+// with Y and UV values outside of video range so that clamping is covered:
+//
+// mvidyuvcheck -size 33x17 ../Classes/Tests/33x17_BT709_I420.yuv ../Classes/Tests/33x17_BT709_I420.bgra
+//
+// Build:
+//
+// gcc -std=gnu99 -O2 -I../Classes/AVAnimator -o mvidyuvcheck mvidyuvcheck.c ../Classes/AVAnimator/maxvid_yuv.c
+//
+// Usage:
+//
+// mvidyuvcheck [-bt601 | -bt709] [-full] [-write] -size WxH IN.yuv REFERENCE.bgra
+
+#include "maxvid_yuv.h"
+
+static
+void usage(void) {
+  fprintf(stderr, "usage: mvidyuvcheck [-bt601 | -bt709] [-full] [-write] -size WxH IN.yuv REFERENCE.bgra\n");
+}
+
+// Read exactly numBytes from the file at path, returns NULL on failure
+
+static
+uint8_t* read_file(const char *path, size_t numBytes) {
+  FILE *inFile = fopen(path, "rb");
+  if (inFile == NULL) {
+    fprintf(stderr, "could not open \"%s\"\n", path);
+    return NULL;
+  }
+  fseek(inFile, 0L, SEEK_END);
+  long size = ftell(inFile);
+  fseek(inFile, 0L, SEEK_SET);
+  if (size != (long)numBytes) {
+    fprintf(stderr, "\"%s\" is %ld bytes, expected %zu bytes\n", path, size, numBytes);
+    fclose(inFile);
+    return NULL;
+  }
+  uint8_t *data = malloc(numBytes);
+  if (data == NULL || fread(data, 1, numBytes, inFile) != numBytes) {
+    fprintf(stderr, "could not read \"%s\"\n", path);
+    free(data);
+    fclose(inFile);
+    return NULL;
+  }
+  fclose(inFile);
+  return data;
+}
+
+// Compare converted pixels to the reference, print the first mismatch and
+// return the number of pixels that differ
+
+static
+uint32_t compare_pixels(const char *name, const uint32_t *pixels, const uint8_t *reference,
+                        uint32_t width, uint32_t height) {
+  uint32_t numMismatched = 0;
+  for (uint32_t i = 0; i < (width * height); i++) {
+    const uint8_t *bytes = &reference[i * sizeof(uint32_t)];
+    uint32_t expected = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    if (pixels[i] != expected) {
+      if (numMismatched == 0) {
+        fprintf(stderr, "%s: pixel (%u, %u) is 0x%08X, expected 0x%08X\n", name, i % width, i / width, pixels[i], expected);
+      }
+      numMismatched++;
+    }
+  }
+  if (numMismatched > 0) {
+    fprintf(stderr, "%s: %u of %u pixels differ\n", name, numMismatched, width * height);
+  }
+  return numMismatched;
+}
+
+int main(int argc, char **argv) {
+  MVYUVMatrix matrix = MV_YUV_MATRIX_BT709;
+  MVYUVRange range = MV_YUV_RANGE_VIDEO;
+  int write = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  char *yuvPath = NULL;
+  char *referencePath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-bt601") == 0) {
+      matrix = MV_YUV_MATRIX_BT601;
+    } else if (strcmp(argv[i], "-bt709") == 0) {
+      matrix = MV_YUV_MATRIX_BT709;
+    } else if (strcmp(argv[i], "-full") == 0) {
+      range = MV_YUV_RANGE_FULL;
+    } else if (strcmp(argv[i], "-write") == 0) {
+      write = 1;
+    } else if (strcmp(argv[i], "-size") == 0 && (i + 1) < argc) {
+      if (sscanf(argv[++i], "%ux%u", &width, &height) != 2) {
+        usage();
+        return 1;
+      }
+    } else if (yuvPath == NULL) {
+      yuvPath = argv[i];
+    } else if (referencePath == NULL) {
+      referencePath = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (yuvPath == NULL || referencePath == NULL || width == 0 || height == 0 || width > 0x4000 || height > 0x4000) {
+    usage();
+    return 1;
+  }
+
+  const uint32_t uvWidth = (width + 1) / 2;
+  const uint32_t uvHeight = (height + 1) / 2;
+  const size_t yNumBytes = (size_t)width * height;
+  const size_t uvNumBytes = (size_t)uvWidth * uvHeight;
+
+  uint8_t *yuv = read_file(yuvPath, yNumBytes + (uvNumBytes * 2));
+  if (yuv == NULL) {
+    return 1;
+  }
+
+  const uint8_t *yPlane = yuv;
+  const uint8_t *uPlane = yuv + yNumBytes;
+  const uint8_t *vPlane = uPlane + uvNumBytes;
+
+  uint8_t *uvPlane = malloc(uvNumBytes * 2);
+  for (size_t i = 0; i < uvNumBytes; i++) {
+    uvPlane[(i * 2)] = uPlane[i];
+    uvPlane[(i * 2) + 1] = vPlane[i];
+  }
+
+  MVYUVCoefficients coefficients;
+  maxvid_yuv_init(&coefficients, matrix, range);
+
+  const uint32_t outBytesPerRow = width * sizeof(uint32_t);
+  uint32_t *i420Pixels = malloc(yNumBytes * sizeof(uint32_t));
+  uint32_t *nv12Pixels = malloc(yNumBytes * sizeof(uint32_t));
+
+  uint32_t status = maxvid_yuv_i420_to_bgra(&coefficients, i420Pixels, outBytesPerRow, yPlane, width,
+                                            uPlane, vPlane, uvWidth, NULL, 0, width, height);
+  if (status == 0) {
+    status = maxvid_yuv_nv12_to_bgra(&coefficients, nv12Pixels, outBytesPerRow, yPlane, width,
+                                     uvPlane, uvWidth * 2, NULL, 0, width, height);
+  }
+  if (status != 0) {
+    fprintf(stderr, "conversion failed\n");
+    return 1;
+  }
+
+  int exitStatus = 0;
+
+  if (write) {
+    FILE *outFile = fopen(referencePath, "wb");
+    for (size_t i = 0; outFile != NULL && i < yNumBytes; i++) {
+      uint32_t pixel = i420Pixels[i];
+      uint8_t bytes[4] = { pixel & 0xFF, (pixel >> 8) & 0xFF, (pixel >> 16) & 0xFF, pixel >> 24 };
+      fwrite(bytes, sizeof(bytes), 1, outFile);
+    }
+    if (outFile == NULL || fclose(outFile) != 0) {
+      fprintf(stderr, "could not write \"%s\"\n", referencePath);
+      exitStatus = 1;
+    }
+  } else {
+    uint8_t *reference = read_file(referencePath, yNumBytes * sizeof(uint32_t));
+    if (reference == NULL) {
+      exitStatus = 1;
+    } else {
+      if (compare_pixels("i420", i420Pixels, reference, width, height) != 0) {
+        exitStatus = 1;
+      }
+      if (compare_pixels("nv12", nv12Pixels, reference, width, height) != 0) {
+        exitStatus = 1;
+      }
+      if (exitStatus == 0) {
+        printf("%ux%u: i420 and nv12 match the reference\n", width, height);
+      }
+      free(reference);
+    }
+  }
+
+  free(i420Pixels);
+  free(nv12Pixels);
+  free(uvPlane);
+  free(yuv);
+
+  return exitStatus;
+}